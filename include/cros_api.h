@@ -310,6 +310,17 @@ typedef CallbackResponse (*PublisherApiCallback)(cRosMessage *message, void *con
 cRosErrCodePack cRosNodeSerializeOutgoingMessage(DynBuffer *buffer, void *context_);
 // Transfer data from packet buffer (buffer) of the Service caller to the input mesage buffer (context_)
 cRosErrCodePack cRosNodeDeserializeIncomingPacket(DynBuffer *buffer, void *context_);
+// Obtain the header fields of the last message received by a subscriber (context_). Returns 1 if the message starts with a std_msgs/Header, 0 otherwise
+int cRosNodeGetIncomingHeader(void *context_, uint32_t *seq, uint32_t *stamp_secs, uint32_t *stamp_nsecs);
+// Obtain the message that the Publisher/Service caller (context_) will send next
+cRosMessage *cRosNodeGetOutgoingMessage(void *context_);
+// Obtain the last message received by a subscriber (context_)
+cRosMessage *cRosNodeGetIncomingMessage(void *context_);
+// Check whether a subscriber (context_) was registered with the type CROS_ANY_MSG_TYPE
+int cRosNodeIsAnyTypeSubscriber(void *context_);
+// Make a subscriber of any type (context_) receive messages of the type sent by a publisher in its connection header.
+// The definition is built only if the type differs from the current one, and then only if can_change is 1
+cRosErrCodePack cRosNodeSetIncomingType(void *context_, const char *msg_type, const char *md5sum, const char *full_text, int can_change);
 
 // Intermediary functions that call the user callback functions
 // context is a structure (object) opaque for the caller function
@@ -317,6 +328,8 @@ cRosErrCodePack cRosNodeSubscriberCallback(void *context_);
 cRosErrCodePack cRosNodePublisherCallback(void *context_);
 cRosErrCodePack cRosNodeServiceCallerCallback(int call_resp_flag, void* contex_);
 cRosErrCodePack cRosNodeServiceProviderCallback(void *context_);
+// Exchange the request and response messages of a service caller (context_) with the specified ones
+void cRosNodeServiceCallerSwapMessages(void *context_, cRosMessage **request, cRosMessage **response);
 void cRosNodeStatusCallback(CrosNodeStatusUsr *status, void* context_);
 
 // Master api: register/unregister methods
@@ -325,9 +338,69 @@ void cRosApiReleaseServiceCaller(CrosNode *node, int svcidx);
 cRosErrCodePack cRosApiRegisterServiceProvider(CrosNode *node, const char *service_name, const char *service_type, ServiceProviderApiCallback callback, NodeStatusApiCallback status_callback, void *context, int *svcidx_ptr);
 cRosErrCodePack cRosApiUnregisterServiceProvider(CrosNode *node, int svcidx);
 void cRosApiReleaseServiceProvider(CrosNode *node, int svcidx);
+/*! \brief Register a subscriber of a topic
+ *
+ *  If topic_type is CROS_ANY_MSG_TYPE ("*"), no message file is needed: the type, MD5 sum and definition of the
+ *  messages are taken from the connection header of the first publisher, and the definition is built in memory and reused
+ *  while the publishers keep sending the same type. The subscriber adopts a new type only when no other publisher is connected.
+ *  The callback can check the type of the received messages with cRosApiGetSubscriberMessageType()
+ *  \param node Pointer to the CrosNode object
+ *  \param topic_name Name of the topic
+ *  \param topic_type Type of the messages (package/Type), or CROS_ANY_MSG_TYPE
+ *  \param callback Function called for each received message. NULL = no function
+ *  \param status_callback Function called when the state of the subscriber changes. NULL = no function
+ *  \param context Pointer passed to the functions
+ *  \param tcp_nodelay If 1, the publishers are asked to set TCP_NODELAY on their sockets
+ *  \param subidx_ptr Pointer to a variable where the index of the new subscriber is stored. It can be NULL
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, otherwise an error code
+ */
 cRosErrCodePack cRosApiRegisterSubscriber(CrosNode *node, const char *topic_name, const char *topic_type, SubscriberApiCallback callback, NodeStatusApiCallback status_callback, void *context, int tcp_nodelay, int *subidx_ptr);
 cRosErrCodePack cRosApiUnregisterSubscriber(CrosNode *node, int subidx);
 void cRosApiReleaseSubscriber(CrosNode *node, int subidx);
+
+/*! \brief Get the type of the messages received by a subscriber
+ *
+ *  \param node Pointer to the CrosNode object
+ *  \param subidx Index of the subscriber
+ *  \param msg_type Pointer to a variable where the type (package/Type) is stored. For a subscriber of any type it is NULL
+ *                  until the first publisher connects. It can be NULL
+ *  \param md5sum Pointer to a variable where the MD5 sum of the type is stored. It can be NULL
+ *  \param definition Pointer to a variable where the full text of the message definition is stored. It can be NULL
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, otherwise an error code. The strings are valid until the type changes or the subscriber is released
+ */
+cRosErrCodePack cRosApiGetSubscriberMessageType(CrosNode *node, int subidx, const char **msg_type, const char **md5sum, const char **definition);
+
+/*! \brief Allow the callback of a subscriber to retain the received messages without copying them
+ *
+ *  pool_size spare messages are allocated for the subscriber. When the callback retains the received message with
+ *  cRosApiRetainSubscriberMessage(), a spare message takes its place for receiving the next one, and the application
+ *  must give it back with cRosApiReleaseSubscriberMessage() when it does not need it anymore.
+ *  In this mode the received messages are not copied to the subscriber queue, so they cannot be obtained with cRosNodeReceiveTopicMsg().
+ *  \param node Pointer to the CrosNode object
+ *  \param subidx Index of the subscriber
+ *  \param pool_size Max number of messages that can be retained at the same time. 0 disables the retention
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, otherwise an error code
+ */
+cRosErrCodePack cRosApiSetSubscriberMessagePool(CrosNode *node, int subidx, int pool_size);
+
+/*! \brief Take the ownership of the message passed to the subscriber callback. It must be called from the callback
+ *
+ *  \param node Pointer to the CrosNode object
+ *  \param subidx Index of the subscriber
+ *  \return The retained message (the one passed to the callback), or NULL if all the spare messages are already retained
+ *          or the retention has not been enabled with cRosApiSetSubscriberMessagePool()
+ */
+cRosMessage *cRosApiRetainSubscriberMessage(CrosNode *node, int subidx);
+
+/*! \brief Give back a message retained with cRosApiRetainSubscriberMessage(), so that it can be reused to receive messages
+ *
+ *  \param node Pointer to the CrosNode object
+ *  \param subidx Index of the subscriber that provided the message
+ *  \param msg The retained message. It must not be used after calling this function
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, otherwise an error code (the message is freed anyway)
+ */
+cRosErrCodePack cRosApiReleaseSubscriberMessage(CrosNode *node, int subidx, cRosMessage *msg);
+
 cRosErrCodePack cRosApiRegisterPublisher(CrosNode *node, const char *topic_name, const char *topic_type, int loop_period, PublisherApiCallback callback, NodeStatusApiCallback status_callback, void *context, int *pubidx_ptr);
 cRosErrCodePack cRosApiUnregisterPublisher(CrosNode *node, int pubidx);
 void cRosApiReleasePublisher(CrosNode *node, int pubidx);
@@ -398,10 +471,42 @@ cRosErrCodePack cRosApiGetParamNames(CrosNode *node, GetParamNamesCallback callb
 
 // Message polling
 cRosErrCodePack cRosNodeReceiveTopicMsg(CrosNode *node, int subidx, cRosMessage *msg, unsigned char *buff_overflow, unsigned long time_out);
+
+/*! \brief Wait until any of several subscribers has a received message in its queue
+ *
+ *  The node event loop is run (as in cRosNodeReceiveTopicMsg()) until a message is available, so no polling is needed.
+ *  The message can be then obtained without blocking by calling cRosNodeReceiveTopicMsg() with the returned subscriber index.
+ *  \param node Pointer to the CrosNode object
+ *  \param subidx_list Array of subscriber indices to wait for. If several of them have messages, the first one in the array is returned
+ *  \param n_subs Number of elements of subidx_list
+ *  \param rcv_subidx Pointer to a variable where the index of the subscriber with a message is returned (-1 on timeout). It can be NULL
+ *  \param time_out Max time to wait (in msec) or CROS_INFINITE_TIMEOUT
+ *  \return CROS_SUCCESS_ERR_PACK (0) if a message is available, CROS_RCV_TOP_TIMEOUT_ERR if the timeout is reached,
+ *          CROS_BAD_PARAM_ERR if any subscriber is not valid or another error code if the event loop failed
+ */
+cRosErrCodePack cRosNodeWaitAnyTopicMsg(CrosNode *node, const int subidx_list[], int n_subs, int *rcv_subidx, unsigned long time_out);
 cRosErrCodePack cRosNodeQueueTopicMsg( CrosNode *node, int pubidx, cRosMessage *msg );
 cRosErrCodePack cRosNodeSendTopicMsg(CrosNode *node, int pubidx, cRosMessage *msg, unsigned long time_out);
 cRosErrCodePack cRosNodeServiceCall(CrosNode *node, int svcidx, cRosMessage *req_msg, cRosMessage *resp_msg, unsigned long time_out);
+
+/*! \brief Make a service call without copying the request and response messages
+ *
+ *  Unlike cRosNodeServiceCall(), the request is serialized directly from req_msg and the response is deserialized
+ *  directly into resp_msg, so no message is copied and, with a persistent caller, no memory is allocated in each call.
+ *  Both messages are used by the node only until this function returns. If the timeout is reached after sending the request,
+ *  the late response is dropped when it arrives: it is neither stored in resp_msg nor passed to the service-caller callback.
+ *  \param node Pointer to the CrosNode object
+ *  \param svcidx Index of the service caller
+ *  \param req_msg Request message, e.g. created with cRosApiCreateServiceCallerRequest()
+ *  \param resp_msg Message where the response is stored, e.g. created with cRosApiCreateServiceCallerResponse()
+ *  \param time_out Max time to wait (in msec) for the whole call or CROS_INFINITE_TIMEOUT
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_SVC_RES_OK_BYTE_ERR if the service provider answered with an error,
+ *          CROS_CALL_SVC_TIMEOUT_ERR if the timeout is reached, the deserialization error if the response does not fit in resp_msg
+ *          or another error code
+ */
+cRosErrCodePack cRosNodeServiceCallInPlace(CrosNode *node, int svcidx, cRosMessage *req_msg, cRosMessage *resp_msg, unsigned long time_out);
 cRosMessage *cRosApiCreatePublisherMessage(CrosNode *node, int pubidx);
 cRosMessage *cRosApiCreateServiceCallerRequest(CrosNode *node, int svcidx);
+cRosMessage *cRosApiCreateServiceCallerResponse(CrosNode *node, int svcidx);
 
 #endif // _CROS_API_H_
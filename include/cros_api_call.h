@@ -21,6 +21,7 @@ struct RosApiCall
   char *host;                                 //! Host to contact for the api
   int port;                                   //! Tcp port of the host to contact for the api
   int provider_idx;                           //! Provider (sub, pub, service provider or service caller) index
+  void *provider_context;                     //! Context of the provider when an unregistration call is created. It identifies the provider if its slot is released and reused before the call finishes
   ResultCallback result_callback;             //! Response callback
   void *context_data;                         //! Result callback context
   FetchResultCallback fetch_result_callback;  //! Callback to fetch the result
@@ -127,7 +127,21 @@ int cRosNodeRecruitTcprosClientProc(CrosNode *node, int subidx);
  */
 int cRosNodeFindFirstTcprosClientProc(CrosNode *node, int subidx, const char *tcpros_hostname, int tcpros_port);
 
+/*! \brief Register again all the publishers, subscribers, service providers and parameter subscriptions of the node, after
+ *         the master has lost them (it restarted). The registrations are sent gradually, at most CN_REREGISTRATION_RATE per
+ *         second, and the status callbacks are notified of the restart and of the recovery
+ *
+ *  \param node Pointer to CrosNode structure that has previously been created with cRosNodeCreate
+ */
 void restartAdversing(CrosNode* node);
+
+/*! \brief Check with a lookupNode() call whether the master still knows the node after it has been unreachable, since
+ *         a master restarted with the same PID (e.g. in a container) is not detected by the ping. If it does not, the
+ *         node is registered again (see restartAdversing())
+ *
+ *  \param node Pointer to CrosNode structure that has previously been created with cRosNodeCreate
+ */
+void checkMasterRegistrations(CrosNode* node);
 int enqueueRequestTopic(CrosNode *node, int subidx, const char *host, int port);
 int enqueueMasterApiCall(CrosNode *node, RosApiCall *call);
 int enqueueSlaveApiCall(CrosNode *node, RosApiCall *call, const char *host, int port);
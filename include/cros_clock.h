@@ -19,6 +19,25 @@
  *  @{
  */
 
+/*! \brief Kind of time source of a CrosClock */
+typedef enum CrosClockType
+{
+  CROS_CLOCK_SYSTEM = 0,              //! The system real-time clock (see cRosClockGetTimeMs())
+  CROS_CLOCK_SIMULATED                //! A virtual clock that only advances when it is requested
+} CrosClockType;
+
+/*! \brief Time source used by a node to schedule its operations (publication periods, I/O timeouts, master pings...) */
+typedef struct CrosClock CrosClock;
+struct CrosClock
+{
+  CrosClockType type;                 //! Kind of time source
+  uint64_t sim_time;                  //! Current time of a simulated clock (in msec, since the Epoch)
+  int auto_advance;                   //! If 1, the event loop of a node using this simulated clock moves the time forward to its next scheduled operation instead of waiting for it
+  struct cRosMutex *lock;             //! If not NULL, protects sim_time, since the clock may be read and advanced from several threads. Set by the node that uses the clock
+  void (*advance_hook)(void *context); //! If not NULL, called by cRosClockAdvance() to wake up the event loops that wait for the time. Set by the node that uses the clock
+  void *advance_hook_context;         //! Context passed to advance_hook
+};
+
 /*! \brief Return the current time, expressed as seconds and microseconds since the Epoch
  *
  *  \return The current time
@@ -31,6 +50,36 @@ struct timeval cRosClockGetTimeSecUsec( void );
  */
 uint64_t cRosClockGetTimeMs( void );
 
+/*! \brief Initialize a clock that follows the system real-time clock
+ *
+ *  \param clock Pointer to the clock
+ */
+void cRosClockInit( CrosClock *clock );
+
+/*! \brief Initialize a simulated clock. Its time only advances when cRosClockAdvance() is called or,
+ *         if auto_advance is 1, when the event loop of the node that uses it has nothing to do until a later time
+ *
+ *  \param clock Pointer to the clock
+ *  \param start_time Initial time of the clock (in msec, since the Epoch)
+ *  \param auto_advance 1 to let the node event loop advance the clock, 0 otherwise
+ */
+void cRosClockInitSimulated( CrosClock *clock, uint64_t start_time, int auto_advance );
+
+/*! \brief Return the current time of a clock, expressed as milliseconds since the Epoch
+ *
+ *  \param clock Pointer to the clock. If it is NULL, the system clock is used
+ *  \return The current time
+ */
+uint64_t cRosClockGetTime( const CrosClock *clock );
+
+/*! \brief Move forward the time of a simulated clock. It has no effect on the system clock
+ *
+ *  It can be called from any thread: the event loops of the node that uses the clock are woken up to handle the new time
+ *  \param clock Pointer to the clock
+ *  \param msec Time to advance (in msec)
+ */
+void cRosClockAdvance( CrosClock *clock, uint64_t msec );
+
 /*! \brief Convert an interval expressed as milliseconds in a timeval structure,
  *         that express the same interval as seconds and microseconds
  *
@@ -55,6 +55,17 @@
   MSG_COD_ELEM(CROS_SOCK_OPEN_TIMEOUT_ERR, "The specified timeout was up while waiting for the specified port to be open") \
   MSG_COD_ELEM(CROS_SOCK_OPEN_CONN_ERR, "An error occurred when the specified target port was tried to be connected (target address could not be resolved?)") \
   MSG_COD_ELEM(CROS_EXTRACT_MSG_INT_ERR, "An internal error occurred when sending an inmediate message: The message could not be extracted from the queue") \
+  MSG_COD_ELEM(CROS_IO_SHARD_OPEN_ERR, "The listener sockets of the I/O shards could not be opened on the node TCPROS port (SO_REUSEPORT not supported?)") \
+  MSG_COD_ELEM(CROS_TCPROS_LISTENER_OPEN_ERR, "The TCPROS listener socket could not be bound again to the node TCPROS port: no new TCPROS connection can be accepted") \
+  MSG_COD_ELEM(CROS_RX_TIMESTAMP_ERR, "The kernel reception time stamps could not be enabled on the connections (SO_TIMESTAMPNS not supported?)") \
+  MSG_COD_ELEM(CROS_ZEROCOPY_ERR, "The zero-copy sends could not be enabled on the connections (SO_ZEROCOPY not supported?): they use copying sends") \
+  MSG_COD_ELEM(CROS_DATA_LISTENER_OPEN_ERR, "The TCPROS data listener socket could not be opened on the specified data host (is the address assigned to this host?)") \
+  MSG_COD_ELEM(CROS_TF_CONNECTIVITY_ERR, "The transform cannot be computed: one of the frames is unknown or the frames are not connected by the transform tree") \
+  MSG_COD_ELEM(CROS_TF_EXTRAPOLATION_ERR, "The transform cannot be computed: the requested time is out of the time range of the transforms received for a frame") \
+  MSG_COD_ELEM(CROS_DEPACK_FRAME_SIZE_ERR, "Error decoding a received packet: The decoded message is shorter than the TCPROS frame that contains it (do the publisher and subscriber use the same message definition?)") \
+  MSG_COD_ELEM(CROS_SER_THREADS_ERR, "The worker threads of the parallel (de)serialization of messages could not be started") \
+  MSG_COD_ELEM(CROS_SER_RANGE_LENGTH_ERR, "Internal error serializing an array of messages in parallel: the serialized length of a range of elements differs from the computed one") \
+  MSG_COD_ELEM(CROS_MSG_DEF_RECURSION_ERR, "The message definition text is invalid: a custom type contains itself (directly or through other types) or the custom types are nested too deeply") \
   MSG_COD_ELEM(LAST_ERR_LIST_CODE, "") // Sentinel code used to mark the last element of the global error list
 
 #define CROS_SUCCESS_ERR_PACK 0U //! Function return value indicating success
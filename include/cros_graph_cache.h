@@ -0,0 +1,129 @@
+#ifndef _CROS_GRAPH_CACHE_H_
+#define _CROS_GRAPH_CACHE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*! \defgroup cros_graph_cache cROS graph cache
+ *
+ *  Local mirror of the ROS graph state (publishers, subscribers and service providers registered in the master),
+ *  indexed by topic or service name. The node refreshes it with the master getSystemState() call (see cRosNodeEnableGraphCache())
+ *  and reports the differences between consecutive refreshes
+ */
+
+/*! \addtogroup cros_graph_cache
+ *  @{
+ */
+
+#define CROS_GRAPH_CACHE_MIN_BUCKETS 64   //! Initial number of buckets of each index of the graph cache
+
+struct GetSystemStateResult;
+
+/*! \brief Kind of the resources of the ROS graph */
+typedef enum CrosGraphKind
+{
+  CROS_GRAPH_PUBLISHER = 0,           //! Topic publishers
+  CROS_GRAPH_SUBSCRIBER,              //! Topic subscribers
+  CROS_GRAPH_SERVICE,                 //! Service providers
+  CROS_GRAPH_N_KINDS
+} CrosGraphKind;
+
+/*! \brief Function called for each change found when the graph cache is refreshed
+ *
+ *  \param kind Kind of the resource
+ *  \param name Name of the topic or service
+ *  \param node Name of the node that has been added to or removed from the topic or service
+ *  \param added 1 if the node has been added, 0 if it has been removed
+ *  \param context Context specified with the callback
+ */
+typedef void (*CrosGraphChangeCallback)( CrosGraphKind kind, const char *name, const char *node, int added, void *context );
+
+/*! \brief Topic or service of the graph cache and the nodes that publish, subscribe or provide it */
+typedef struct CrosGraphEntry CrosGraphEntry;
+struct CrosGraphEntry
+{
+  char *name;                         //! Name of the topic or service
+  char **nodes;                       //! Names of the nodes (in the order reported by the master)
+  size_t n_nodes;                     //! Number of elements of nodes
+  uint32_t hash;                      //! Hash of name
+  uint32_t generation;                //! Last refresh that reported this entry
+  CrosGraphEntry *next;               //! Next entry of the same bucket
+};
+
+/*! \brief Hash table of the topics or services of a kind */
+typedef struct CrosGraphIndex CrosGraphIndex;
+struct CrosGraphIndex
+{
+  CrosGraphEntry **buckets;           //! Array of n_buckets lists of entries
+  size_t n_buckets;                   //! Number of buckets (a power of 2)
+  size_t n_entries;                   //! Number of entries in the table
+};
+
+/*! \brief Graph cache. Don't modify directly its internal members: use the related functions instead */
+typedef struct CrosGraphCache CrosGraphCache;
+struct CrosGraphCache
+{
+  CrosGraphIndex index[CROS_GRAPH_N_KINDS]; //! One index for each kind of resource
+  uint32_t generation;                //! Number of refreshes applied
+  unsigned long n_changes;            //! Number of node additions and removals found since the cache was initialized
+};
+
+/*! \brief Initialize an empty graph cache
+ *
+ *  \param cache Pointer to the graph cache
+ */
+void cRosGraphCacheInit( CrosGraphCache *cache );
+
+/*! \brief Release the memory of a graph cache, leaving it empty
+ *
+ *  \param cache Pointer to the graph cache
+ */
+void cRosGraphCacheRelease( CrosGraphCache *cache );
+
+/*! \brief Replace the content of the graph cache with the state returned by the master and report the differences
+ *
+ *  \param cache Pointer to the graph cache
+ *  \param state State returned by cRosApiGetSystemState()
+ *  \param callback Function called for each node added to or removed from a topic or service. It can be NULL
+ *  \param context Context passed to callback
+ *
+ *  \return The number of changes found, or -1 if there is not enough memory (the cache is left partially updated)
+ */
+long cRosGraphCacheApply( CrosGraphCache *cache, const struct GetSystemStateResult *state, CrosGraphChangeCallback callback, void *context );
+
+/*! \brief Find a topic or service in the graph cache
+ *
+ *  \param cache Pointer to the graph cache
+ *  \param kind Kind of the resource
+ *  \param name Name of the topic or service
+ *  \param n_nodes Pointer to a variable where the number of nodes is stored
+ *
+ *  \return The names of the nodes that publish, subscribe or provide name (n_nodes elements), or NULL if there are none.
+ *          The array is valid until the next refresh of the cache
+ */
+const char *const *cRosGraphCacheGetNodes( const CrosGraphCache *cache, CrosGraphKind kind, const char *name, size_t *n_nodes );
+
+/*! \brief Check whether a node publishes, subscribes or provides a topic or service according to the graph cache
+ *
+ *  \param cache Pointer to the graph cache
+ *  \param kind Kind of the resource
+ *  \param name Name of the topic or service
+ *  \param node Name of the node
+ *
+ *  \return 1 if it does, 0 otherwise
+ */
+int cRosGraphCacheHasNode( const CrosGraphCache *cache, CrosGraphKind kind, const char *name, const char *node );
+
+/*! \brief Call a function for each topic or service of a kind in the graph cache (in no particular order)
+ *
+ *  \param cache Pointer to the graph cache
+ *  \param kind Kind of the resource
+ *  \param visit Function called for each entry. The iteration stops when it returns a value different from 0
+ *  \param context Context passed to visit
+ */
+void cRosGraphCacheForEach( const CrosGraphCache *cache, CrosGraphKind kind,
+                            int (*visit)( const CrosGraphEntry *entry, void *context ), void *context );
+
+/*! @}*/
+
+#endif // _CROS_GRAPH_CACHE_H_
@@ -3,6 +3,7 @@
 
 #include "dyn_buffer.h"
 #include "cros_err_codes.h"
+#include "cros_thread.h"
 
 /*! \defgroup cros_message cROS TCPROS
  *
@@ -13,6 +14,16 @@
  *  @{
  */
 
+/*! Max num. of nested custom types in a message definition built from its text (see cRosMessageDefBuildFromText()) */
+#define CROS_MSG_MAX_DEF_DEPTH 32
+
+/*! Max num. of threads that can (de)serialize a large array of messages in parallel (see cRosMessageParallelismSet()) */
+#define CROS_MSG_MAX_SERIALIZATION_THREADS 16
+
+/*! Default min. serialized size (in bytes) of an array of messages to be (de)serialized in parallel. Handing the ranges
+ *  of a smaller array to the worker threads costs about as much as (de)serializing it in the calling thread */
+#define CROS_MSG_DEFAULT_PARALLEL_MIN_SIZE (1024 * 1024)
+
 typedef enum CrosMessageType
 {
   CROS_CUSTOM_TYPE = 0,
@@ -100,6 +111,36 @@ cRosErrCodePack cRosMessageDefBuild(cRosMessageDef **msg_def_ptr, const char *ms
 
 cRosErrCodePack cRosMessageNewBuild(const char *msg_root_dir, const char *msg_type, cRosMessage **new_msg_ptr);
 
+/*! \brief Build a message definition from its full text, as sent by a publisher in the message_definition field of its
+ *         TCPROS connection header, without reading message files
+ *
+ *  The text of the main type comes first. The text of each custom type used by the message follows a separator line
+ *  (a line of '=' characters) and a "MSG: package/Type" line (see computeFullTextMsg()).
+ *  \param msg_def_ptr Pointer to a variable where the new definition is stored. It must be freed with cRosMessageDefFree()
+ *  \param msg_type Type of the message (package/Type)
+ *  \param full_text Full text of the message definition
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, or an error code if the text cannot be parsed or it lacks the definition of a custom type.
+ *          CROS_MSG_DEF_RECURSION_ERR if a custom type contains itself or more than CROS_MSG_MAX_DEF_DEPTH custom types are nested
+ */
+cRosErrCodePack cRosMessageDefBuildFromText(cRosMessageDef **msg_def_ptr, const char *msg_type, const char *full_text);
+
+/*! \brief Get the full text of a message definition: the text of the message type followed by the text of each custom
+ *         type that it uses (see cRosMessageDefBuildFromText()). It is sent by publishers in their connection header
+ *
+ *  \param msg_def The message definition
+ *  \return A new string that must be freed by the caller, or NULL if there is not enough memory
+ */
+char *cRosMessageDefGetFullText(cRosMessageDef *msg_def);
+
+/*! \brief Create a message from the full text of its definition (see cRosMessageDefBuildFromText())
+ *
+ *  \param msg_type Type of the message (package/Type)
+ *  \param full_text Full text of the message definition
+ *  \param new_msg_ptr Pointer to a variable where the new message is stored. It must be freed with cRosMessageFree()
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, or an error code otherwise
+ */
+cRosErrCodePack cRosMessageNewBuildFromText(const char *msg_type, const char *full_text, cRosMessage **new_msg_ptr);
+
 void cRosMessageFieldsPrint(cRosMessage *msg, int n_indent);
 
 int cRosMessageFieldCopy(cRosMessageField *new_field, cRosMessageField *orig_field);
@@ -194,6 +235,151 @@ cRosErrCodePack cRosMessageSerialize(cRosMessage *message, DynBuffer *buffer);
 
 cRosErrCodePack cRosMessageDeserialize(cRosMessage *message, DynBuffer *buffer);
 
+/*! \brief Settings and worker threads of the parallel (de)serialization of large arrays of messages (e.g. the points of
+ *         a trajectory_msgs/JointTrajectory). Each node has its own one (see cRosNodeSetParallelSerialization()).
+ *         Don't modify its internal members: use the related functions instead */
+typedef struct cRosMessageParallelism cRosMessageParallelism;
+struct cRosMessageParallelism
+{
+  int n_threads;                      //! Number of threads that (de)serialize each large array, including the calling one. 1 = sequential
+  size_t min_size;                    //! Min. serialized size (in bytes) of an array of messages to be (de)serialized in parallel
+  cRosThreadPool pool;                //! The n_threads - 1 worker threads. Only valid if n_threads > 1
+};
+
+/*! \brief Initialize the parallelism settings with sequential (de)serialization
+ *
+ *  \param par Pointer to the settings
+ */
+void cRosMessageParallelismInit(cRosMessageParallelism *par);
+
+/*! \brief Configure the parallel (de)serialization of large arrays of messages
+ *
+ *  The serialized offset of each array element is computed first, and then disjoint ranges of elements are
+ *  (de)serialized by n_threads threads (including the calling one). The resulting packet or message is identical
+ *  to the one obtained sequentially. The n_threads - 1 worker threads are started by this function and wait for
+ *  arrays until the settings are changed or released, so they must not be changed while a message is being
+ *  (de)serialized with them. Several threads can (de)serialize with the same settings at the same time: the arrays of
+ *  a thread that finds the worker threads busy are (de)serialized sequentially
+ *  \param par Pointer to settings initialized with cRosMessageParallelismInit()
+ *  \param n_threads Number of threads used for each large array (up to CROS_MSG_MAX_SERIALIZATION_THREADS). 1 disables the parallel mode
+ *  \param min_size Min. serialized size (in bytes) of an array of messages to be (de)serialized in parallel. 0 = CROS_MSG_DEFAULT_PARALLEL_MIN_SIZE
+ *  \return 1 on success, 0 if the worker threads could not be started (the settings are then sequential)
+ */
+int cRosMessageParallelismSet(cRosMessageParallelism *par, int n_threads, size_t min_size);
+
+/*! \brief Stop the worker threads of the parallelism settings and make them sequential
+ *
+ *  \param par Pointer to the settings
+ */
+void cRosMessageParallelismRelease(cRosMessageParallelism *par);
+
+/*! \brief Serialize a message like cRosMessageSerialize(), (de)serializing its large arrays of messages in parallel
+ *
+ *  \param message Message to serialize
+ *  \param buffer Buffer to which the serialized message is appended
+ *  \param par Parallelism settings. NULL = sequential serialization
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, or an error code
+ */
+cRosErrCodePack cRosMessageSerializeParallel(cRosMessage *message, DynBuffer *buffer, cRosMessageParallelism *par);
+
+/*! \brief Deserialize a message like cRosMessageDeserialize(), deserializing its large arrays of messages in parallel
+ *
+ *  \param message Message that receives the deserialized fields
+ *  \param buffer Buffer whose current position is the start of the serialized message
+ *  \param par Parallelism settings. NULL = sequential deserialization
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, or an error code
+ */
+cRosErrCodePack cRosMessageDeserializeParallel(cRosMessage *message, DynBuffer *buffer, cRosMessageParallelism *par);
+
+/*! \brief Compute the number of bytes that cRosMessageSerialize() appends to a buffer for a message, without serializing it
+ *
+ *  \param message Message to consider
+ *  \return The size (in bytes) of the serialized message
+ */
+size_t cRosMessageSerializedSize(cRosMessage *message);
+
+/*! Max length of a field path in a cRosMessageDeadband (see cRosMessageEqual()) */
+#define CROS_MSG_MAX_FIELD_PATH_LEN 256
+
+/*! \brief Tolerance of a numeric field of a message, used by cRosMessageEqual() */
+typedef struct cRosMessageDeadband cRosMessageDeadband;
+struct cRosMessageDeadband
+{
+  const char *field_path;             //! Names of the fields from the message root, separated by dots (e.g. "pose.position.x"). Array indices are not included: the deadband applies to all the elements of an array
+  double deadband;                    //! Two values of the field are considered equal if their absolute difference is not greater than this
+};
+
+/*! \brief Compare the content of two messages field by field (including the content of submessages and arrays)
+ *
+ *  \param m1 Pointer to the first message
+ *  \param m2 Pointer to the second message
+ *  \param deadbands Tolerances of some numeric fields. The fields without tolerance must be exactly equal. It can be NULL
+ *  \param n_deadbands Number of elements of deadbands
+ *  \return 1 if the messages have the same fields and equal values (within the deadbands), 0 otherwise
+ */
+int cRosMessageEqual(cRosMessage *m1, cRosMessage *m2, const cRosMessageDeadband *deadbands, int n_deadbands);
+
+/*! Max number of fields in the path of a cRosMessageFilter (including the compared field) */
+#define CROS_MSG_FILTER_MAX_DEPTH 16
+
+/*! \brief Comparison operator of a cRosMessageFilter */
+typedef enum CrosMessageFilterOp
+{
+  CROS_MSG_FILTER_EQ = 0,             //! ==
+  CROS_MSG_FILTER_NE,                 //! !=
+  CROS_MSG_FILTER_LT,                 //! <
+  CROS_MSG_FILTER_LE,                 //! <=
+  CROS_MSG_FILTER_GT,                 //! >
+  CROS_MSG_FILTER_GE                  //! >=
+} CrosMessageFilterOp;
+
+/*! \brief Content filter of messages: a comparison between a field and a constant (see cRosMessageFilterCompile()).
+ *         Don't modify directly its internal members: use the related functions instead */
+typedef struct cRosMessageFilter cRosMessageFilter;
+struct cRosMessageFilter
+{
+  int field_inds[CROS_MSG_FILTER_MAX_DEPTH]; //! Index of each field of the path in its (sub)message, from the message root
+  int depth;                          //! Number of elements of field_inds. 0 = the filter is empty and matches all the messages
+  CrosMessageFilterOp op;             //! Comparison operator
+  double num_value;                   //! Constant compared with a numeric field
+  char *str_value;                    //! Constant compared with a string field (NULL for numeric fields)
+};
+
+/*! \brief Initialize an empty filter, which matches all the messages
+ *
+ *  \param filter Pointer to the filter
+ */
+void cRosMessageFilterInit(cRosMessageFilter *filter);
+
+/*! \brief Parse a filter expression and resolve its field path in the fields of a message
+ *
+ *  The expression has the form "field_path op constant", e.g. "level >= 8", "header.frame_id == 'robot3'" or "id != 2".
+ *  field_path contains the names of the fields from the message root separated by dots. The compared field must be a
+ *  numeric, bool or string field: if it is an array, the filter matches the messages in which any element satisfies
+ *  the comparison. op is ==, !=, <, <=, > or >=. String constants can be enclosed in single or double quotes.
+ *  The numeric fields are compared as double values. The filter can only be used with messages of the same type as msg
+ *  \param filter Pointer to an initialized filter. Its previous expression is released
+ *  \param expr The filter expression. An empty expression (or NULL) makes a filter that matches all the messages
+ *  \param msg A message of the type that will be filtered
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the expression is not valid for the message type
+ *          (the filter is left empty), or CROS_MEM_ALLOC_ERR
+ */
+cRosErrCodePack cRosMessageFilterCompile(cRosMessageFilter *filter, const char *expr, cRosMessage *msg);
+
+/*! \brief Evaluate a filter on a message
+ *
+ *  \param filter Pointer to the filter
+ *  \param msg The message, of the type specified when the filter was compiled
+ *  \return 1 if the message satisfies the filter (or the filter is empty), 0 otherwise
+ */
+int cRosMessageFilterMatch(const cRosMessageFilter *filter, cRosMessage *msg);
+
+/*! \brief Release the memory of a filter, leaving it empty
+ *
+ *  \param filter Pointer to the filter
+ */
+void cRosMessageFilterRelease(cRosMessageFilter *filter);
+
 CrosMessageType getMessageType(const char *type);
 
 const char * getMessageTypeString(CrosMessageType type);
@@ -22,6 +22,10 @@
 #include "cros_api_call.h"
 #include "cros_message_queue.h"
 #include "cros_err_codes.h"
+#include "cros_thread.h"
+#include "cros_clock.h"
+#include "cros_graph_cache.h"
+#include "tcpip_uring.h"
 
 /*! \defgroup cros_node cROS Node */
 
@@ -47,8 +51,11 @@
 /*! Max num serving XMLRPC connections */
 #define CN_MAX_XMLRPC_SERVER_CONNECTIONS 5
 
-/*! Max num serving TCPROS connections */
-#define CN_MAX_TCPROS_SERVER_CONNECTIONS 5
+/*! Max num serving TCPROS connections. They are distributed among the I/O shards, so each shard can serve several subscribers */
+#define CN_MAX_TCPROS_SERVER_CONNECTIONS 16
+
+/*! Max num I/O shards (event loops) serving the TCPROS connections of the node, including the main loop */
+#define CN_MAX_IO_SHARDS 4
 
 /*! Max num serving RPCROS connections */
 #define CN_MAX_RPCROS_SERVER_CONNECTIONS CN_MAX_SERVICE_PROVIDERS
@@ -73,9 +80,41 @@
 /*! Node automatic XMLRPC ping cycle period (in msec) */
 #define CN_PING_LOOP_PERIOD 1000
 
+/*! Max number of registrations per second that the node sends to the master when it re-registers after a master restart,
+ *  so that the nodes that recover at the same time do not flood the new master */
+#define CN_REREGISTRATION_RATE 50
+
+/*! Number of registrations that the node sends to the master at once when a re-registration starts */
+#define CN_REREGISTRATION_BURST 10
+
 /*! Maximum I/O operations timeout (in msec) */
 #define CN_IO_TIMEOUT 3000
 
+/*! Max num bytes that a bulk-priority TCPROS connection can transfer in each pass of the event loop */
+#define CN_BULK_MAX_BYTES_PER_LOOP 65536
+
+/*! Max num bytes that a TCPROS client (subscriber) connection reads in advance, after the end of the current frame, in each
+ *  recv() call. Small frames received together are parsed without more select() and recv() calls. Define it as 0 to read one frame at a time */
+#ifndef CN_TCPROS_READ_AHEAD_SIZE
+#  define CN_TCPROS_READ_AHEAD_SIZE 16384
+#endif
+
+/*! When the socket buffers of a topic are auto-sized (see CrosTcpTuning), they are made this many times larger than the largest message observed */
+#define CN_TCP_AUTO_BUF_MSGS 4
+
+/*! Default max size (in bytes) of a batch of messages of a publisher with batching enabled (see cRosNodeSetPublisherBatching()) */
+#define CN_DEFAULT_BATCH_MAX_BYTES 1460
+
+/*! Max num of subscriber connections and disconnections that can wait for the main loop to call the publisher callbacks
+ *  (see cRosNodeSetPublisherSubscriberCallbacks()) */
+#define CN_MAX_SUBSCRIBER_EVENTS (4 * CN_MAX_TCPROS_SERVER_CONNECTIONS)
+
+/*! Message type of the subscribers that take the type of the messages from the publishers (see cRosApiRegisterSubscriber()) */
+#define CROS_ANY_MSG_TYPE "*"
+
+/*! Factor by which the refresh period of the graph cache grows after each refresh that finds no changes (see cRosNodeEnableGraphCache()) */
+#define CN_GRAPH_CACHE_BACKOFF 2
+
 /*! Maximum time that the node will wait for unregistering all publishers, subscribers, servicer providers... in the ROS master (in msec) */
 #define CN_UNREGISTRATION_TIMEOUT 3000
 
@@ -95,8 +134,126 @@ typedef enum CrosNodeStatus
   CROS_STATUS_PARAM_UNSUBSCRIBED,
   CROS_STATUS_PARAM_SUBSCRIBED,
   CROS_STATUS_PARAM_UPDATE,
+  CROS_STATUS_MASTER_RESTARTED,       //! The master has lost the registrations of the node (it restarted): they are being registered again
+  CROS_STATUS_MASTER_RECOVERED,       //! All the registrations of the node have been sent again to the master (see recovery_time)
 } CrosNodeStatus;
 
+/*! \brief Priority class of a topic. It defines the order in which the TCPROS connections of the topic are served
+ *         by the event loop, how much data they can transfer in each loop pass and the priority of their packets */
+typedef enum CrosTopicPriority
+{
+  CROS_TOPIC_PRIORITY_BULK = -1,      //! Large and latency-tolerant messages (e.g. images or maps): served last and at most CN_BULK_MAX_BYTES_PER_LOOP bytes per loop pass
+  CROS_TOPIC_PRIORITY_NORMAL = 0,     //! Default priority
+  CROS_TOPIC_PRIORITY_HIGH = 1        //! Latency-critical messages (e.g. e-stop or velocity commands): served first in each loop pass
+} CrosTopicPriority;
+
+/*! \brief Progress of a service call made by cRosNodeServiceCallInPlace() */
+typedef enum CrosInPlaceCallState
+{
+  CROS_IN_PLACE_CALL_NONE = 0,        //! No in-place call in progress
+  CROS_IN_PLACE_CALL_REQUESTED,       //! The request must be sent as soon as the RPCROS connection is ready
+  CROS_IN_PLACE_CALL_SENT,            //! The request has been sent and the response is awaited
+  CROS_IN_PLACE_CALL_DONE,            //! The response has been deserialized into the application message
+  CROS_IN_PLACE_CALL_FAILED,          //! The service provider answered with an error or the response could not be deserialized
+  CROS_IN_PLACE_CALL_ABANDONED        //! The call timed out after sending the request: its late response must be dropped
+} CrosInPlaceCallState;
+
+/*! \brief What to do with a message when the token bucket of its publisher or connection is in debt */
+typedef enum CrosShapingPolicy
+{
+  CROS_SHAPING_DEFER = 0,             //! The message is sent later, when the bucket has been refilled
+  CROS_SHAPING_DROP                   //! The message is discarded
+} CrosShapingPolicy;
+
+/*! \brief Built-in publishers and services of a node. They are created on demand (see cRosNodeSetBuiltins()) */
+typedef enum CrosNodeBuiltin
+{
+  CROS_BUILTIN_NONE = 0x0,
+  CROS_BUILTIN_ROSOUT = 0x1,          //! Publisher of the /rosout topic: registered when the first log message is printed
+  CROS_BUILTIN_LOGGER_SERVICES = 0x2, //! Services ~get_loggers and ~set_logger_level: registered by the node event loop once the master has answered the registrations requested before it runs
+  CROS_BUILTIN_ALL = 0x3
+} CrosNodeBuiltin;
+
+/*! \brief Kind of application-defined callback whose execution time is supervised (see cRosNodeSetCallbackBudget()) */
+typedef enum CrosCallbackKind
+{
+  CROS_CALLBACK_PUBLISHER = 0,        //! Publisher callback (fills the next message)
+  CROS_CALLBACK_SUBSCRIBER,           //! Subscriber callback (processes a received message)
+  CROS_CALLBACK_SERVICE_PROVIDER,     //! Service provider callback (computes a response)
+  CROS_CALLBACK_SERVICE_CALLER,       //! Service caller callback (fills a request or processes a response)
+  CROS_CALLBACK_PARAMETER             //! Parameter subscription callback (processes a new parameter value)
+} CrosCallbackKind;
+
+/*! \brief Execution-time budgets and overrun counters of the callback of a publisher, subscriber, service or parameter subscription */
+typedef struct CrosCallbackBudget CrosCallbackBudget;
+struct CrosCallbackBudget
+{
+  uint32_t soft_budget;               //! An execution longer than this (in usec) is a soft overrun. 0 = no soft budget
+  uint32_t hard_budget;               //! An execution longer than this (in usec) is a hard overrun. 0 = no hard budget
+  unsigned long n_soft_overruns;      //! Number of executions that exceeded the soft budget but not the hard one
+  unsigned long n_hard_overruns;      //! Number of executions that exceeded the hard budget
+  double max_duration;                //! Longest execution time measured (in usec). Executions are only measured when a budget is set
+};
+
+/*! \brief Description of a callback execution that exceeded its budget, passed to the CallbackOverrunHook */
+typedef struct CrosCallbackOverrun
+{
+  CrosCallbackKind kind;              //! Kind of callback
+  int idx;                            //! Index of the publisher, subscriber, service provider, service caller or parameter subscription
+  const char *name;                   //! Name of the topic, service or parameter
+  double duration;                    //! Execution time of the callback (in usec)
+  uint32_t budget;                    //! Exceeded budget (in usec)
+  int hard;                           //! 1 if the hard budget was exceeded, 0 if only the soft budget was exceeded
+  uint64_t time;                      //! Time at which the callback finished (in msec, node clock)
+} CrosCallbackOverrun;
+
+/*! \brief Function called when an application-defined callback exceeds its execution-time budget */
+typedef void (*CallbackOverrunHook)(const CrosCallbackOverrun *overrun, void *context);
+
+/*! \brief Address advertised to the subscribers of a topic, when the node has a separate data host (see cRosNodeSetDataHost()) */
+typedef enum CrosTopicNetwork
+{
+  CROS_TOPIC_NETWORK_DATA = 0,        //! The subscribers connect to the data host (or to the node host if no data host has been set)
+  CROS_TOPIC_NETWORK_CONTROL          //! The subscribers always connect to the node host (e.g. for small latency-critical topics)
+} CrosTopicNetwork;
+
+/*! \brief Socket options of the TCPROS connections of a publisher or subscriber (see cRosNodeSetPublisherTcpTuning()).
+ *         The fields set to 0 keep the default value */
+typedef struct CrosTcpTuning CrosTcpTuning;
+struct CrosTcpTuning
+{
+  uint32_t user_timeout;              //! Max time (in msec) that sent data may remain unacknowledged before the kernel closes the connection (TCP_USER_TIMEOUT). 0 = system default
+  uint32_t keepalive_idle;            //! Time (in sec) without traffic before the first keepalive probe is sent. 0 = 60 s
+  uint32_t keepalive_interval;        //! Time (in sec) between keepalive probes. 0 = 10 s
+  uint32_t keepalive_count;           //! Num. of unanswered keepalive probes after which the connection is closed. 0 = 9
+  uint32_t write_timeout;             //! Max time (in msec) that a message write to a subscriber may make no progress before the subscriber is evicted (publishers only). 0 = CN_IO_TIMEOUT
+  size_t snd_buf_size;                //! Minimum size (in bytes) of the kernel send buffer (SO_SNDBUF). 0 = system default
+  size_t rcv_buf_size;                //! Minimum size (in bytes) of the kernel receive buffer (SO_RCVBUF). 0 = system default
+  unsigned char auto_buf_size;        //! If 1, the send buffer of a publisher (receive buffer of a subscriber) is enlarged to hold CN_TCP_AUTO_BUF_MSGS times the largest message observed
+};
+
+/*! \brief Why a connection was considered dead and closed (see DeadPeerHook) */
+typedef enum CrosDeadPeerReason
+{
+  CROS_DEAD_PEER_WRITE_STALLED = 0,   //! A message write to the subscriber made no progress during the write timeout of the publisher
+  CROS_DEAD_PEER_TIMED_OUT            //! The kernel closed the connection because the peer stopped acknowledging data (TCP_USER_TIMEOUT) or keepalive probes
+} CrosDeadPeerReason;
+
+/*! \brief Description of a TCPROS connection closed because its peer vanished, passed to the DeadPeerHook */
+typedef struct CrosDeadPeer
+{
+  int is_publisher;                   //! 1 if the connection belonged to a publisher (the peer is a subscriber), 0 if it belonged to a subscriber
+  int topic_idx;                      //! Index of the publisher or subscriber
+  const char *topic_name;             //! Name of the topic
+  const char *peer;                   //! Caller ID of the subscriber, or address (host:port) of the publisher
+  CrosDeadPeerReason reason;          //! Why the connection was closed
+  size_t unsent_bytes;                //! Bytes of the message being written that could not be sent (publishers only)
+  uint64_t time;                      //! Time at which the connection was closed (in msec, node clock)
+} CrosDeadPeer;
+
+/*! \brief Function called when a TCPROS connection is closed because its peer vanished without closing it */
+typedef void (*DeadPeerHook)(const CrosDeadPeer *dead_peer, void *context);
+
 typedef struct CrosNodeStatusUsr
 {
   // FIXME: this is a work in progress
@@ -107,11 +264,16 @@ typedef struct CrosNodeStatusUsr
   int xmlrpc_port;
   const char *parameter_key;
   XmlrpcParam *parameter_value;
+  uint64_t recovery_time;       //! With CROS_STATUS_MASTER_RECOVERED, time (in msec) from the first failed master ping (or from the detection of the restart) until the node was registered again
 } CrosNodeStatusUsr;
 
 /*! \brief Callback to communicate publisher or subscriber status */
 typedef void (*NodeStatusApiCallback)(CrosNodeStatusUsr *status, void* context);
 
+/*! \brief Callback to communicate that a subscriber has connected to or disconnected from a publisher
+ *         (see cRosNodeSetPublisherSubscriberCallbacks()). n_subscribers is the number of subscribers connected after the change */
+typedef void (*PublisherSubscriberApiCallback)(int pubidx, const char *subscriber, int n_subscribers, void *context);
+
 /*! Structure that define a published topic */
 struct PublisherNode
 {
@@ -124,6 +286,42 @@ struct PublisherNode
   int loop_period;                    //! Period (in msec) for publication cycle
   uint64_t wake_up_time;              //! The time for the next automatic message publication (in msec, since the Epoch)
   cRosMessageQueue msg_queue;         //! Messages on this topic wait in this queue to be send for every process
+  CrosTopicPriority priority;         //! Priority class of the connections of this publisher
+  CrosTokenBucket shaper;             //! Limits the output byte rate of the publisher
+  uint32_t conn_byte_rate;            //! Byte rate limit for each connection of this publisher (in bytes/s). 0 = unlimited
+  uint32_t conn_burst;                //! Burst size for each connection of this publisher (in bytes)
+  CrosShapingPolicy shaping_policy;   //! What to do with the messages when the publisher or connection rate is exceeded
+  unsigned char shaping_deferred;     //! If 1, the next message has been already deferred (and counted) by the publisher shaper
+  unsigned long n_shaped_msgs;        //! Number of messages deferred by the shapers of the publisher and its connections
+  unsigned long n_dropped_msgs;       //! Number of messages dropped by the shapers of the publisher and its connections
+  DynBuffer packet;                   //! Last serialized message. It is shared by all the TcprosProcesses (and I/O shards) of this publisher
+  size_t packet_size;                 //! Size (in bytes) of the last message packet, also when it is serialized by the I/O shards
+  unsigned char shard_serialization;  //! If 1, the last message has not been serialized in packet: each I/O shard serializes it in shard_packets
+  unsigned int packet_seq;            //! Incremented each time a new message starts to be published
+  DynBuffer shard_packets[CN_MAX_IO_SHARDS]; //! Last message serialized by each I/O shard for its processes (see shard_serialization)
+  unsigned int shard_packet_seqs[CN_MAX_IO_SHARDS]; //! packet_seq of the message serialized in each element of shard_packets
+  uint32_t batch_window;              //! Max time (in msec) that a message can wait to be sent together with the next ones. 0 = no batching
+  uint32_t batch_max_bytes;           //! The batched messages are sent as soon as they reach this size (in bytes)
+  uint64_t batch_flush_time;          //! The time when the batched messages must be sent (in msec, since the Epoch)
+  DynBuffer batch;                    //! Serialized messages waiting to be sent in a single write to each subscriber
+  size_t zerocopy_min_size;           //! Writes of at least this size (in bytes) are sent with MSG_ZEROCOPY. 0 = copying sends only
+  PublisherSubscriberApiCallback subscriber_connect_callback;    //! Called when a subscriber connects. NULL = no callback
+  PublisherSubscriberApiCallback subscriber_disconnect_callback; //! Called when a subscriber disconnects. NULL = no callback
+  void *subscriber_callback_context;  //! Context passed to subscriber_connect_callback and subscriber_disconnect_callback
+  unsigned char on_change;            //! If 1, a message is only sent if it differs from the last sent one (see cRosNodeSetPublisherOnChange())
+  uint32_t heartbeat_period;          //! An unchanged message is sent anyway if this time (in msec) has elapsed since the last sent message. 0 = never
+  cRosMessageDeadband *deadbands;     //! Tolerances of the numeric fields used to compare the messages. NULL = the serialized messages are compared
+  int n_deadbands;                    //! Number of elements of deadbands
+  cRosMessage *last_sent_msg;         //! Copy of the last sent message (only kept when there are deadbands)
+  DynBuffer last_sent_frame;          //! Last sent message serialized as a TCPROS frame (only kept when there are no deadbands)
+  uint64_t last_sent_time;            //! The time when the last message was sent (in msec, since the Epoch)
+  unsigned char on_change_resend;     //! If 1, the next message is sent even if it has not changed (because a new subscriber has connected)
+  unsigned long n_unchanged_msgs;     //! Number of messages that have not been sent because they had not changed
+  CrosTcpTuning tcp_tuning;           //! Socket options of the connections of this publisher (see cRosNodeSetPublisherTcpTuning())
+  size_t max_msg_size;                //! Size (in bytes) of the largest packet written to the subscribers
+  CrosTopicNetwork network;           //! Address advertised to the subscribers (see cRosNodeSetPublisherNetwork())
+  CrosCallbackBudget cb_budget;       //! Execution-time budgets of the callback (see cRosNodeSetCallbackBudget())
+  unsigned long n_filtered_msgs;      //! Number of times that a message has not been sent to a subscriber because it did not satisfy its content filter
 };
 
 /*! Structure that define a subscribed topic */
@@ -137,6 +335,16 @@ struct SubscriberNode
   void *context;                      //! Pointer to an internal library structure that stores received messages and its type
   cRosMessageQueue msg_queue;         //! Each time a message on this topic is received it is queued here
   unsigned char msg_queue_overflow;   //! If 1, the subscriber tried to insert a message in the queue but it was full
+  CrosTopicPriority priority;         //! Priority class of the connections of this subscriber
+  unsigned char rx_timestamps;        //! If 1, the kernel reception time of the received messages is obtained (see cRosNodeSetSubscriberRxTimestamps())
+  int64_t msg_rx_time_stamp;          //! Kernel reception time of the last received message (see cRosClockGetTimeStamp()). 0 if it is not available
+  int64_t msg_dequeue_time_stamp;     //! Time at which the last received message was read from the socket (see cRosClockGetTimeStamp()). 0 if it is not available
+  uint32_t stats_window;              //! Length (in msec) of the windows of the statistics published on /statistics for each connection. 0 = no statistics
+  CrosTcpTuning tcp_tuning;           //! Socket options of the connections of this subscriber (see cRosNodeSetSubscriberTcpTuning())
+  size_t max_msg_size;                //! Size (in bytes) of the largest frame received from the publishers
+  CrosCallbackBudget cb_budget;       //! Execution-time budgets of the callback (see cRosNodeSetCallbackBudget())
+  char *filter_expr;                  //! Content filter sent to the publishers (see cRosNodeSetSubscriberFilter()). NULL = no filter
+  cRosMessageFilter filter;           //! filter_expr compiled for the received messages. It is also applied locally
 };
 
 struct ServiceProviderNode
@@ -147,6 +355,7 @@ struct ServiceProviderNode
   char *serviceresponse_type;
   char *md5sum;
   void *context;
+  CrosCallbackBudget cb_budget;       //! Execution-time budgets of the callback (see cRosNodeSetCallbackBudget())
 };
 
 struct ServiceCallerNode
@@ -166,6 +375,9 @@ struct ServiceCallerNode
   int loop_period;                    //! Period (in msec) for service-call cycle
   uint64_t wake_up_time;              //! The time for the next automatic service call (in msec, since the Epoch)
   cRosMessageQueue msg_queue;         //! Service requests and service responses for this service wait in this queue to be send
+  CrosInPlaceCallState in_place_call; //! State of the current call made by cRosNodeServiceCallInPlace()
+  cRosErrCodePack in_place_err;       //! Error of the failed call made by cRosNodeServiceCallInPlace()
+  CrosCallbackBudget cb_budget;       //! Execution-time budgets of the callback (see cRosNodeSetCallbackBudget())
 };
 
 struct ParameterSubscription
@@ -174,6 +386,26 @@ struct ParameterSubscription
   XmlrpcParam parameter_value;
   void *context;
   NodeStatusApiCallback status_api_callback;
+  CrosCallbackBudget cb_budget;       //! Execution-time budgets of the callback (see cRosNodeSetCallbackBudget())
+};
+
+/*! Structure that define an additional I/O shard: an event loop that serves a subset of the TCPROS server connections */
+typedef struct CrosIoShard CrosIoShard;
+struct CrosIoShard
+{
+  TcprosProcess tcpros_listner_proc;  //! Accept new TCPROS connections on the node TCPROS port (the port is shared using SO_REUSEPORT)
+  int wake_up_fd[2];                  //! Pipe used by the main loop to wake up the shard loop when a new message must be written
+  TcpIpUring *io_uring;               //! io_uring instance used by the shard loop to wait for its sockets. NULL if it uses select()
+};
+
+/*! Connection or disconnection of a subscriber that waits for the main loop to call the corresponding publisher callback */
+typedef struct CrosSubscriberEvent CrosSubscriberEvent;
+struct CrosSubscriberEvent
+{
+  int topic_idx;                      //! Index of the publisher
+  unsigned char connected;            //! 1 if the subscriber has connected, 0 if it has disconnected
+  int n_subscribers;                  //! Number of subscribers connected to the publisher after the change
+  DynString caller_id;                //! Name of the subscriber node
 };
 
 /*! \brief CrosNode object. Don't modify its internal members: use the related functions instead */
@@ -185,6 +417,8 @@ struct CrosNode
   unsigned short xmlrpc_port;   //! The node port for the XMLRPC protocol
   unsigned short tcpros_port;   //! The node port for the TCPROS protocol
   unsigned short rpcros_port;   //! The node port for the RPCROS protocol
+  char *data_host;              //! Address of the TCPROS data listener (ipv4, e.g. 10.0.0.2). NULL if all the TCPROS connections use the node host
+  unsigned short data_tcpros_port; //! The port of the TCPROS data listener
 
   int pid;                      //! cROS node process ID
   int roscore_pid;              //! Roscore PID
@@ -195,12 +429,47 @@ struct CrosNode
   char *message_root_path;      //! Directory with the message register
 
   CrosLogLevel log_level;
-  int rosout_pub_idx;           //! Index of the publisher of the /rosout topic for ROS log messages
+  int rosout_pub_idx;           //! Index of the publisher of the /rosout topic for ROS log messages. -1 if it has not been registered yet
+  unsigned int builtins;        //! Built-in publishers and services enabled for this node (CrosNodeBuiltin flags)
+  unsigned int builtins_created; //! Built-in publishers and services already registered (CrosNodeBuiltin flags)
+  int statistics_pub_idx;       //! Index of the publisher of the /statistics topic for subscriber statistics. -1 if it has not been registered yet
+  CrosClock clock;              //! Time source of all the node scheduling (publication periods, I/O timeouts, select() timeouts...)
+  cRosMutex clock_lock;         //! Protects the time of a simulated clock, which is read by the I/O shards and may be advanced from other threads
+  int main_wake_up_fd[2];       //! Pipe written to wake up the main loop when a simulated clock is advanced or an I/O shard queues a subscriber event. -1 if it has not been created
+  TcpIpUring *io_uring;         //! io_uring instance used by the main loop to wait for its sockets (see tcpip_uring.h). NULL if it uses select()
 
   uint64_t xmlrpc_master_wake_up_time; //! The time (in msec, since the Epoch) for the next automatic operation cycle of the xmlrpc_client_proc[0] (xmlrpc master-node client proc)
 
   uint32_t log_last_id;         //! Sequence number of the last transmitted rosout log message
 
+  CallbackOverrunHook callback_overrun_hook; //! Function called when a callback exceeds its budget. NULL if it has not been set
+  void *callback_overrun_context; //! Context passed to callback_overrun_hook
+  uint32_t callback_overrun_log_period; //! Minimum time (in msec) between two callback-overrun warnings in the log. 0 = no warnings
+  uint64_t callback_overrun_last_log; //! Time (in msec) of the last callback-overrun warning
+  unsigned long n_unlogged_overruns; //! Callback overruns that have not been logged since the last warning because of the rate limit
+  DeadPeerHook dead_peer_hook;  //! Function called when a connection is closed because its peer vanished. NULL if it has not been set
+  void *dead_peer_context;      //! Context passed to dead_peer_hook
+  unsigned long n_dead_peers;   //! Number of connections closed because their peer vanished
+
+  uint64_t master_unreachable_time; //! Time (in msec) of the first failed master ping of the current master outage. 0 if the master answers and it keeps the registrations of the node
+  int master_check_call_id;     //! ID of the lookupNode() call that checks whether the master still knows the node after an outage. -1 if there is none
+  uint64_t master_restart_time; //! Time (in msec) when the recovery from the current master restart started: the first failed master ping or the detection of the restart. 0 if the node is not re-registering
+  int reregistration_cursor;    //! Next provider to register again: publishers, subscribers, service providers and parameter subscriptions, in this order. -1 when all have been enqueued
+  CrosTokenBucket reregistration_shaper; //! Limits the rate of the re-registration calls (one token per call)
+  unsigned long n_master_restarts; //! Number of master restarts detected
+  uint64_t last_recovery_time;  //! Duration (in msec) of the last recovery from a master restart (see CrosNodeStatusUsr::recovery_time)
+
+  CrosGraphCache graph_cache;   //! Local mirror of the graph state of the master (see cRosNodeEnableGraphCache())
+  unsigned char graph_cache_enabled; //! If 1, the graph cache is refreshed periodically
+  unsigned char graph_cache_valid; //! If 1, the graph cache has been filled by at least one refresh
+  int graph_cache_call_id;      //! ID of the getSystemState() call in progress. -1 if there is none
+  uint32_t graph_cache_min_period; //! Refresh period (in msec) of the graph cache after a change has been found
+  uint32_t graph_cache_max_period; //! Maximum refresh period (in msec) of the graph cache while it does not change
+  uint32_t graph_cache_period;  //! Current refresh period (in msec) of the graph cache
+  uint64_t graph_cache_wake_up_time; //! The time (in msec) for the next refresh of the graph cache
+  CrosGraphChangeCallback graph_change_callback; //! Function called for each change found in the graph. NULL if it has not been set
+  void *graph_change_context;   //! Context passed to graph_change_callback
+
   unsigned int next_call_id;
   ApiCallQueue master_api_queue;
   ApiCallQueue slave_api_queue;
@@ -214,10 +483,19 @@ struct CrosNode
   //! Manage connections for TCPROS calls from this node to others
   TcprosProcess tcpros_client_proc[CN_MAX_TCPROS_CLIENT_CONNECTIONS];
   TcprosProcess tcpros_listner_proc;   //! Accept new TCPROS connections from roscore or other nodes
+  TcprosProcess tcpros_data_listner_proc; //! Accept new TCPROS connections on the data host (see cRosNodeSetDataHost()). Served by the main loop
 
   /*! Manage connections for TCPROS between this and other nodes  */
   TcprosProcess tcpros_server_proc[CN_MAX_TCPROS_SERVER_CONNECTIONS];
 
+  int n_io_shards;              //! Number of I/O shards serving tcpros_server_proc[]. tcpros_server_proc[i] is served by shard i % n_io_shards. Shard 0 is the main loop
+  CrosIoShard io_shards[CN_MAX_IO_SHARDS-1]; //! Additional I/O shards: io_shards[k-1] corresponds to shard k
+  cRosMessageParallelism serialization_parallelism; //! Parallel (de)serialization settings of the messages of this node (see cRosNodeSetParallelSerialization())
+  cRosMutex io_shard_lock;      //! Protects the state of the TCPROS server processes and the publisher process lists when they are shared with I/O shards
+  CrosSubscriberEvent subscriber_events[CN_MAX_SUBSCRIBER_EVENTS]; //! Circular queue of the subscriber events waiting for the main loop. Protected by io_shard_lock
+  int subscriber_events_head;   //! Index of the oldest event of subscriber_events
+  int n_subscriber_events;      //! Number of events in subscriber_events
+
   //! Manage connections for RPCROS calls from this node to others
   TcprosProcess rpcros_client_proc[CN_MAX_RPCROS_CLIENT_CONNECTIONS];
   TcprosProcess rpcros_listner_proc;   //! Accept new TCPROS connections from roscore or other nodes
@@ -263,6 +541,66 @@ void cRosGetMsgFilePath(CrosNode *node, char *buffer, size_t bufsize, const char
 CrosNode *cRosNodeCreate(const char *node_name, const char *node_host, const char *roscore_host, unsigned short roscore_port,
                          const char *message_root_path);
 
+/*! \brief Set the time source used by a node to schedule its operations
+ *
+ *  By default the node uses the system clock. With a simulated clock (see cRosClockInitSimulated()) the time does not pass
+ *  unless cRosClockAdvance() is called on the node clock (see cRosNodeGetClock()) or the clock auto-advances, which allows
+ *  testing the timing behavior of a node deterministically and faster than real time. An auto-advancing clock makes the
+ *  event loop poll the sockets and jump to the next scheduled operation when it is idle. Otherwise the event loop waits
+ *  for the sockets as usual (bounding the wait with the simulated timeouts taken as real ones) and it is woken up when
+ *  cRosClockAdvance() is called, even from another thread (not supported on Windows, where it waits until the timeout).
+ *  It should be called just after cRosNodeCreate(), since the times already scheduled are not converted.
+ *  I/O shards (see cRosNodeSetIoShards()) follow the node clock in the same way: they are woken up when it is advanced.
+ *  \param n A pointer to a CrosNode object
+ *  \param clock Pointer to the clock to be copied in the node
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if n or clock is NULL
+ */
+cRosErrCodePack cRosNodeSetClock( CrosNode *n, const CrosClock *clock );
+
+/*! \brief Get the clock used by a node, e.g. to advance its simulated time with cRosClockAdvance()
+ *
+ *  \param n A pointer to a CrosNode object
+ *  \return A pointer to the node clock, or NULL if n is NULL
+ */
+CrosClock *cRosNodeGetClock( CrosNode *n );
+
+/*! \brief Select the built-in publishers and services of a node
+ *
+ *  All the built-ins are enabled by default, but they are only registered when they are needed, so creating a node
+ *  does not load their message definitions nor contacts the ROS master. The logger services are registered when the
+ *  event loop finds the node idle (no call to the master pending or running), so the publishers, subscribers and
+ *  services registered by the application before running the event loop are registered first. This function only
+ *  affects the built-ins that have not been registered yet: call it just after cRosNodeCreate() to disable them.
+ *  \param n A pointer to a CrosNode object
+ *  \param builtins Combination of CrosNodeBuiltin flags
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if n is NULL
+ */
+cRosErrCodePack cRosNodeSetBuiltins( CrosNode *n, unsigned int builtins );
+
+/*! \brief Get the index of the /rosout publisher of a node, registering it if it has not been registered yet
+ *
+ *  \param n A pointer to a CrosNode object
+ *  \return The publisher index, or -1 if n is NULL, the /rosout built-in is disabled or it could not be registered
+ */
+int cRosNodeGetRosoutPublisher( CrosNode *n );
+
+/*! \brief Start measuring the execution time of an application-defined callback. It is called just before invoking the callback
+ *
+ *  \param budget Pointer to the budgets of the callback
+ *  \return The current time stamp (see cRosClockGetTimeStamp()) if a budget is set for the callback, or 0 otherwise
+ */
+int64_t cRosNodeCallbackStart( const CrosCallbackBudget *budget );
+
+/*! \brief Finish measuring the execution time of an application-defined callback, and report it if it exceeded its budgets.
+ *         It is called just after the callback returns
+ *
+ *  \param n A pointer to a CrosNode object
+ *  \param kind Kind of callback
+ *  \param idx Index of the publisher, subscriber, service provider, service caller or parameter subscription
+ *  \param start_time_stamp Value returned by cRosNodeCallbackStart(). If it is 0, nothing is done
+ */
+void cRosNodeCallbackEnd( CrosNode *n, CrosCallbackKind kind, int idx, int64_t start_time_stamp );
+
 /*! \brief Unregister from ROS master and release all the internal allocated memory for a CrosNode
  *          object previously crated with cRosNodeCreate()
  *
@@ -306,6 +644,407 @@ cRosErrCodePack cRosNodeDoEventsLoop( CrosNode *n, uint64_t max_timeout );
  */
 cRosErrCodePack cRosNodeStart( CrosNode *n, unsigned long time_out, unsigned char *exit_flag );
 
+/*! \brief Set the number of I/O shards that serve the TCPROS (topic publication) connections of the node
+ *
+ *  Each additional shard has its own TCPROS listener socket bound to the node TCPROS port (SO_REUSEPORT), so the
+ *  kernel distributes the incoming subscriber connections among the shards, and its own subset of
+ *  TcprosProcess objects (tcpros_server_proc[i] belongs to shard i % n_shards).
+ *  Shard 0 is served by cRosNodeDoEventsLoop() together with the XMLRPC and RPCROS processes, while each shard
+ *  k >= 1 must be served by calling cRosNodeDoShardEventsLoop() (or cRosNodeStartShard()) from its own thread.
+ *  The main loop calls the publisher callbacks, and each shard serializes the topic messages once for all its connections
+ *  and writes them. The messages compared with the last sent one (see cRosNodeSetPublisherOnChange()) or filtered by a
+ *  subscriber are serialized once by the main loop instead.
+ *  Since the kernel keeps routing connections to a shard whose processes are all in use, such a shard accepts and
+ *  immediately closes them, so the subscriber retries instead of waiting in the listener backlog.
+ *  This function must be called after creating the node and before any subscriber connects to it.
+ *  The shard loops must be stopped before unregistering a publisher or calling cRosNodeDestroy().
+ *  \param n A pointer to a CrosNode object (e.g., created with cRosNodeCreate())
+ *  \param n_shards Number of shards (from 1 to CN_MAX_IO_SHARDS). 1 means that only the main loop is used
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success. CROS_BAD_PARAM_ERR if n_shards is not valid or the TCPROS connections
+ *          are already in use. CROS_IO_SHARD_OPEN_ERR if the shard listeners could not be opened (e.g. the platform does not
+ *          support SO_REUSEPORT): the node is left with one shard. CROS_TCPROS_LISTENER_OPEN_ERR is added if the main
+ *          listener could not be bound again to the node TCPROS port
+ */
+cRosErrCodePack cRosNodeSetIoShards( CrosNode *n, int n_shards );
+
+/*! \brief Perform a loop of an additional I/O shard of the node
+ *
+ *  It waits for and serves the TCPROS listener socket and the TCPROS server connections of the specified shard.
+ *  \param n A pointer to a CrosNode object
+ *  \param shard_idx Index of the shard (from 1 to n_shards-1, see cRosNodeSetIoShards())
+ *  \param max_timeout Maximum time in milliseconds that this function will take to finish (it may finish before).
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success
+ */
+cRosErrCodePack cRosNodeDoShardEventsLoop( CrosNode *n, int shard_idx, uint64_t max_timeout );
+
+/*! \brief Run an additional I/O shard of the node for a specific time while the exit flag provided by the user is 0
+ *
+ *  This function is the cRosNodeStart() counterpart for cRosNodeDoShardEventsLoop(). It is intended to be the body
+ *  of the thread that serves the shard.
+ *  \param n A pointer to a CrosNode object
+ *  \param shard_idx Index of the shard (from 1 to n_shards-1, see cRosNodeSetIoShards())
+ *  \param time_out Time in milliseconds that this function will block running the shard, or CROS_INFINITE_TIMEOUT.
+ *  \param exit_flag Pointer to an unsigned char variable: the function will exit if this variable becomes
+ *         different from zero. It can be NULL.
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success
+ */
+cRosErrCodePack cRosNodeStartShard( CrosNode *n, int shard_idx, unsigned long time_out, unsigned char *exit_flag );
+
+/*! \brief Configure the parallel (de)serialization of the large arrays of messages of a node
+ *
+ *  The messages published, received, sent in service calls and service responses by the node are (de)serialized
+ *  with these settings (see cRosMessageParallelismSet()). Other nodes of the process keep their own settings, so a node
+ *  that handles large trajectories can use worker threads while the others stay sequential. Parallel (de)serialization
+ *  only pays off for large arrays on a multi-core host: measure it with the parallel-serialization-test sample.
+ *  It must be called while the event loops of the node are not running.
+ *  \param n A pointer to a CrosNode object
+ *  \param n_threads Number of threads used for each large array (up to CROS_MSG_MAX_SERIALIZATION_THREADS). 1 (default) disables the parallel mode
+ *  \param min_size Min. serialized size (in bytes) of an array of messages to be (de)serialized in parallel. 0 = CROS_MSG_DEFAULT_PARALLEL_MIN_SIZE
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if n is NULL, CROS_SER_THREADS_ERR if the worker
+ *          threads could not be started (the node then (de)serializes sequentially)
+ */
+cRosErrCodePack cRosNodeSetParallelSerialization( CrosNode *n, int n_threads, size_t min_size );
+
+/*! \brief Set the priority class of a publisher
+ *
+ *  The TCPROS connections of high-priority topics are served before the others in each pass of the event loop,
+ *  while bulk topics are served last and transfer at most CN_BULK_MAX_BYTES_PER_LOOP bytes per connection
+ *  and pass, so a large message cannot delay a small command for long. The sockets of the connections are
+ *  also tagged accordingly (SO_PRIORITY and DSCP), including the connections that are already established.
+ *  \param n A pointer to a CrosNode object
+ *  \param pubidx Index of the publisher
+ *  \param priority New priority class
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the publisher is not valid
+ */
+cRosErrCodePack cRosNodeSetPublisherPriority( CrosNode *n, int pubidx, CrosTopicPriority priority );
+
+/*! \brief Set the priority class of a subscriber
+ *
+ *  See cRosNodeSetPublisherPriority(). The priority affects the reception of the messages of the topic
+ *  \param n A pointer to a CrosNode object
+ *  \param subidx Index of the subscriber
+ *  \param priority New priority class
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the subscriber is not valid
+ */
+cRosErrCodePack cRosNodeSetSubscriberPriority( CrosNode *n, int subidx, CrosTopicPriority priority );
+
+/*! \brief Enable or disable the kernel reception time stamps of the messages received by a subscriber
+ *
+ *  When enabled, the connections of the subscriber are read with recvmsg() and SO_TIMESTAMPNS, so that the time at which
+ *  each message arrived (the segment containing the start of its frame) can be distinguished from the time at which
+ *  the event loop read it. Both times can be obtained with cRosNodeGetSubscriberMsgTimeStamps()
+ *  \param n A pointer to a CrosNode object
+ *  \param subidx Index of the subscriber
+ *  \param enable 1 to obtain the time stamps, 0 to stop obtaining them
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the subscriber is not valid or
+ *          CROS_RX_TIMESTAMP_ERR if the time stamps could not be enabled on an open connection
+ */
+cRosErrCodePack cRosNodeSetSubscriberRxTimestamps( CrosNode *n, int subidx, int enable );
+
+/*! \brief Get the time stamps of the last message received by a subscriber. It is usually called from the subscriber callback
+ *
+ *  The time stamps have the same base as cRosClockGetTimeStamp(), so they can be subtracted from each other or from
+ *  the current time to obtain latencies. They are 0 if they are not available (e.g. if cRosNodeSetSubscriberRxTimestamps() was not called)
+ *  \param n A pointer to a CrosNode object
+ *  \param subidx Index of the subscriber
+ *  \param rx_time_stamp Pointer to a variable where the kernel reception time of the message is stored. It can be NULL
+ *  \param dequeue_time_stamp Pointer to a variable where the time at which the library read the message is stored. It can be NULL
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the subscriber is not valid
+ */
+cRosErrCodePack cRosNodeGetSubscriberMsgTimeStamps( CrosNode *n, int subidx, int64_t *rx_time_stamp, int64_t *dequeue_time_stamp );
+
+/*! \brief Enable or disable the publication of the statistics of the messages received by a subscriber
+ *
+ *  When enabled, each connection of the subscriber accumulates the number of received messages and bytes, the period
+ *  between messages and, for messages that start with a std_msgs/Header, the age of their stamps and the messages lost
+ *  according to their sequence numbers. At the end of each window a rosgraph_msgs/TopicStatistics message is published
+ *  for each connection on the topic /statistics (the publisher is registered with the first call)
+ *  \param n A pointer to a CrosNode object
+ *  \param subidx Index of the subscriber
+ *  \param window Length of the statistics windows (in msec). 0 stops collecting statistics
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the subscriber is not valid,
+ *          or the error of the /statistics publisher registration
+ */
+cRosErrCodePack cRosNodeSetSubscriberStatistics( CrosNode *n, int subidx, uint32_t window );
+
+/*! \brief Send the messages of a publisher only when they change
+ *
+ *  Each message produced by the publisher (periodic or queued) is compared with the last message sent: if they are equal,
+ *  the message is not sent. Without deadbands the serialized messages are compared byte by byte. With deadbands the
+ *  messages are compared field by field with cRosMessageEqual() before serializing them, so the serialization of
+ *  unchanged messages is saved as well. The next message is always sent after a new subscriber connects
+ *  \param n A pointer to a CrosNode object
+ *  \param pubidx Index of the publisher
+ *  \param enable 1 to send only the messages that have changed, 0 to send all the messages
+ *  \param heartbeat_period An unchanged message is sent anyway if this time (in msec) has elapsed since the last sent message. 0 = never
+ *  \param deadbands Tolerances of the numeric fields (copied by the function). NULL if the messages must be exactly equal
+ *  \param n_deadbands Number of elements of deadbands
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the publisher is not valid or CROS_MEM_ALLOC_ERR
+ */
+cRosErrCodePack cRosNodeSetPublisherOnChange( CrosNode *n, int pubidx, int enable, uint32_t heartbeat_period,
+                                              const cRosMessageDeadband *deadbands, int n_deadbands );
+
+/*! \brief Get the number of messages of a publisher that have not been sent because they had not changed (see cRosNodeSetPublisherOnChange())
+ *
+ *  \param n A pointer to a CrosNode object
+ *  \param pubidx Index of the publisher
+ *  \param n_unchanged Pointer to a variable where the number of unsent messages is returned
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the publisher is not valid
+ */
+cRosErrCodePack cRosNodeGetPublisherUnchangedMsgs( CrosNode *n, int pubidx, unsigned long *n_unchanged );
+
+/*! \brief Receive only the messages of a subscriber that satisfy a content filter
+ *
+ *  The filter expression (see cRosMessageFilterCompile()) is sent to the publishers in the connection header, and the
+ *  publishers that support it (cROS nodes) evaluate it on each message and do not send the messages that do not satisfy it.
+ *  The subscriber applies the filter as well, so the result is the same with publishers that ignore it.
+ *  The filter only affects the connections established after this call. Since the skipped messages are not sent,
+ *  they are counted as lost in the statistics of the subscriber (see cRosNodeSetSubscriberStatistics())
+ *  \param n A pointer to a CrosNode object
+ *  \param subidx Index of the subscriber
+ *  \param filter_expr The filter expression (copied by the function), e.g. "level >= 8". NULL to remove the filter
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the subscriber is not valid or the expression is
+ *          not valid for its message type, or CROS_MEM_ALLOC_ERR
+ */
+cRosErrCodePack cRosNodeSetSubscriberFilter( CrosNode *n, int subidx, const char *filter_expr );
+
+/*! \brief Get the number of messages of a publisher that have not been sent to a subscriber because they did not satisfy its
+ *         content filter (see cRosNodeSetSubscriberFilter()). Each message is counted once for each subscriber that skips it
+ *
+ *  \param n A pointer to a CrosNode object
+ *  \param pubidx Index of the publisher
+ *  \param n_filtered Pointer to a variable where the number of skipped messages is returned
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the publisher is not valid
+ */
+cRosErrCodePack cRosNodeGetPublisherFilteredMsgs( CrosNode *n, int pubidx, unsigned long *n_filtered );
+
+/*! \brief Accept the TCPROS connections of the publishers on a separate network interface (data plane)
+ *
+ *  The XMLRPC and RPCROS listeners, and the TCPROS listener of the I/O shards, stay bound to the node host. An additional
+ *  TCPROS listener is bound to data_host and its address is advertised in the requestTopic responses of the publishers
+ *  that use the data network (see cRosNodeSetPublisherNetwork()), so that high-bandwidth topics do not load the control network.
+ *  The existing connections are not affected
+ *  \param n A pointer to a CrosNode object
+ *  \param data_host Address (ipv4) of the data network interface of this host. NULL to close the data listener
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if n is NULL, CROS_MEM_ALLOC_ERR
+ *          or CROS_DATA_LISTENER_OPEN_ERR if the listener socket could not be opened
+ */
+cRosErrCodePack cRosNodeSetDataHost( CrosNode *n, const char *data_host );
+
+/*! \brief Select which address is advertised to the subscribers of a publisher when the node has a data host
+ *
+ *  \param n A pointer to a CrosNode object
+ *  \param pubidx Index of the publisher
+ *  \param network CROS_TOPIC_NETWORK_DATA (default) to use the data host or CROS_TOPIC_NETWORK_CONTROL to use the node host
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the publisher is not valid
+ */
+cRosErrCodePack cRosNodeSetPublisherNetwork( CrosNode *n, int pubidx, CrosTopicNetwork network );
+
+/*! \brief Set the socket options of the TCPROS connections of a publisher, to detect and evict the subscribers that vanish
+ *         without closing the connection (e.g. power loss or link drop) and to size the kernel socket buffers
+ *
+ *  Until a dead subscriber is evicted, its connection never becomes ready for the next message, so the publication to
+ *  all the subscribers of the topic stalls. The options are applied to the current and future connections of the publisher
+ *  \param n A pointer to a CrosNode object
+ *  \param pubidx Index of the publisher
+ *  \param tuning Socket options (copied by the function)
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the publisher or tuning is not valid
+ */
+cRosErrCodePack cRosNodeSetPublisherTcpTuning( CrosNode *n, int pubidx, const CrosTcpTuning *tuning );
+
+/*! \brief Set the socket options of the TCPROS connections of a subscriber, to detect the publishers that vanish
+ *         without closing the connection and to size the kernel socket buffers. The write_timeout option is ignored
+ *
+ *  \param n A pointer to a CrosNode object
+ *  \param subidx Index of the subscriber
+ *  \param tuning Socket options (copied by the function)
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the subscriber or tuning is not valid
+ */
+cRosErrCodePack cRosNodeSetSubscriberTcpTuning( CrosNode *n, int subidx, const CrosTcpTuning *tuning );
+
+/*! \brief Set the function called when a TCPROS connection is closed because its peer vanished without closing it
+ *
+ *  \param n A pointer to a CrosNode object
+ *  \param hook Function called for each evicted connection (from the event loop or I/O shard that served the connection). NULL = no function
+ *  \param context Pointer passed to the hook
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if n is NULL
+ */
+cRosErrCodePack cRosNodeSetDeadPeerHook( CrosNode *n, DeadPeerHook hook, void *context );
+
+/*! \brief Get the number of TCPROS connections of a node closed because their peer vanished
+ *
+ *  \param n A pointer to a CrosNode object
+ *  \return The number of evicted connections
+ */
+unsigned long cRosNodeGetDeadPeerCount( CrosNode *n );
+
+/*! \brief Keep a local mirror of the publishers, subscribers and service providers registered in the master
+ *
+ *  The event loop refreshes the graph cache with the master getSystemState() call, so that the application can look up
+ *  the providers of a topic or service locally (see cRosNodeGetGraphCache() and cRosGraphCacheGetNodes()) instead of
+ *  calling the master API. The refresh period adapts to the activity of the graph: it starts at min_period and,
+ *  each time a refresh finds no changes, it is multiplied by CN_GRAPH_CACHE_BACKOFF up to max_period.
+ *  A refresh that finds changes sets it back to min_period.
+ *  \param n A pointer to a CrosNode object
+ *  \param min_period Minimum refresh period (in msec). 0 disables the graph cache and releases it
+ *  \param max_period Maximum refresh period (in msec). It is raised to min_period if it is lower
+ *  \param callback Function called by the event loop for each node added to or removed from a topic or service. NULL = no function.
+ *                  The first refresh reports the whole graph as added
+ *  \param context Pointer passed to callback
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if n is NULL
+ */
+cRosErrCodePack cRosNodeEnableGraphCache( CrosNode *n, uint32_t min_period, uint32_t max_period,
+                                          CrosGraphChangeCallback callback, void *context );
+
+/*! \brief Refresh the graph cache as soon as possible (e.g. after the application has registered new topics) and
+ *         set its refresh period back to the minimum
+ *
+ *  \param n A pointer to a CrosNode object
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the graph cache is not enabled
+ */
+cRosErrCodePack cRosNodeRefreshGraphCache( CrosNode *n );
+
+/*! \brief Get the graph cache of a node to look up topics and services (see cRosGraphCacheGetNodes()).
+ *         It must only be used from the thread that runs the event loop, since the loop updates it
+ *
+ *  \param n A pointer to a CrosNode object
+ *  \return A pointer to the graph cache, or NULL if it is not enabled or it has not been refreshed yet
+ */
+const CrosGraphCache *cRosNodeGetGraphCache( CrosNode *n );
+
+/*! \brief Set the functions called when a subscriber connects to or disconnects from a publisher
+ *
+ *  The functions receive the number of subscribers connected after the change, so that a producer of expensive
+ *  messages can be started when the first subscriber arrives and stopped when the last one leaves (when there are no
+ *  subscribers the publisher callback is not called anyway). A subscriber is counted once its connection header has been
+ *  accepted. The functions are always called by the main loop (cRosNodeDoEventsLoop()), after the connection has been
+ *  served, even if the connection is served by an I/O shard (see cRosNodeSetIoShards()). Therefore they can use the node API
+ *  (e.g. to stop the publisher)
+ *  \param n A pointer to a CrosNode object
+ *  \param pubidx Index of the publisher
+ *  \param connect_callback Function called when a subscriber connects. NULL = no function
+ *  \param disconnect_callback Function called when a subscriber disconnects. NULL = no function
+ *  \param context Pointer passed to the functions
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the publisher is not valid
+ */
+cRosErrCodePack cRosNodeSetPublisherSubscriberCallbacks( CrosNode *n, int pubidx, PublisherSubscriberApiCallback connect_callback,
+                                                         PublisherSubscriberApiCallback disconnect_callback, void *context );
+
+/*! \brief Get the number of subscribers connected to a publisher
+ *
+ *  \param n A pointer to a CrosNode object
+ *  \param pubidx Index of the publisher
+ *  \return The number of connected subscribers, or -1 if the publisher is not valid
+ */
+int cRosNodeGetPublisherSubscriberCount( CrosNode *n, int pubidx );
+
+/*! \brief Set the execution-time budgets of the callback of a publisher, subscriber, service or parameter subscription
+ *
+ *  Since the callbacks are executed by the single-threaded event loop, a slow callback delays all the other node
+ *  operations. When a budget is set, each execution of the callback is timed (two clock reads) and the executions that
+ *  exceed the budgets are counted (see cRosNodeGetCallbackOverruns()) and reported (see cRosNodeSetCallbackOverrunHook()).
+ *  The callback is not interrupted when it exceeds the hard budget: the overrun is just reported as hard
+ *  \param n A pointer to a CrosNode object
+ *  \param kind Kind of callback
+ *  \param idx Index of the publisher, subscriber, service provider, service caller or parameter subscription
+ *  \param soft_budget Execution time (in usec) above which the execution is reported as a soft overrun. 0 = no soft budget
+ *  \param hard_budget Execution time (in usec) above which the execution is reported as a hard overrun. 0 = no hard budget
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the callback owner is not valid
+ */
+cRosErrCodePack cRosNodeSetCallbackBudget( CrosNode *n, CrosCallbackKind kind, int idx, uint32_t soft_budget, uint32_t hard_budget );
+
+/*! \brief Get the overrun counters of the callback of a publisher, subscriber, service or parameter subscription
+ *
+ *  \param n A pointer to a CrosNode object
+ *  \param kind Kind of callback
+ *  \param idx Index of the publisher, subscriber, service provider, service caller or parameter subscription
+ *  \param n_soft_overruns Pointer to a variable where the number of soft overruns is stored. It can be NULL
+ *  \param n_hard_overruns Pointer to a variable where the number of hard overruns is stored. It can be NULL
+ *  \param max_duration Pointer to a variable where the longest measured execution time (in usec) is stored. It can be NULL
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the callback owner is not valid
+ */
+cRosErrCodePack cRosNodeGetCallbackOverruns( CrosNode *n, CrosCallbackKind kind, int idx, unsigned long *n_soft_overruns, unsigned long *n_hard_overruns, double *max_duration );
+
+/*! \brief Set how the callback overruns of a node are reported
+ *
+ *  \param n A pointer to a CrosNode object
+ *  \param hook Function called (from the event loop) for each callback execution that exceeds a budget. NULL = no function
+ *  \param context Pointer passed to the hook
+ *  \param log_period Minimum time (in msec) between two overrun warnings printed with ROS_WARN(). The overruns that occur
+ *         in between are only counted in the next warning. 0 = no warnings
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if n is NULL
+ */
+cRosErrCodePack cRosNodeSetCallbackOverrunHook( CrosNode *n, CallbackOverrunHook hook, void *context, uint32_t log_period );
+
+/*! \brief Limit the output byte rate of a publisher with a token bucket
+ *
+ *  The limit is applied when a message publication is triggered (periodic or queued messages): if the publisher
+ *  bucket is in debt, the message is deferred until the bucket is refilled or it is dropped, depending on the policy.
+ *  The node wakes up when the bucket is refilled through the select() timeout (no busy polling).
+ *  \param n A pointer to a CrosNode object
+ *  \param pubidx Index of the publisher
+ *  \param byte_rate Maximum average byte rate (in bytes/s). 0 removes the limit
+ *  \param burst Maximum number of bytes that can be sent at once after an idle period
+ *  \param policy What to do with the messages when the rate is exceeded (also used by the connection limits)
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the publisher is not valid
+ */
+cRosErrCodePack cRosNodeSetPublisherRateLimit( CrosNode *n, int pubidx, uint32_t byte_rate, uint32_t burst, CrosShapingPolicy policy );
+
+/*! \brief Limit the output byte rate of each connection (subscriber) of a publisher with a token bucket
+ *
+ *  A connection whose bucket is in debt does not start writing a new message: the message is deferred or dropped
+ *  for that connection only, according to the policy set with cRosNodeSetPublisherRateLimit(). A deferred connection
+ *  does not hold back the publication to the other connections: if a new message is published meanwhile, it replaces
+ *  the deferred one (which is counted as dropped), so a limited subscriber receives the latest messages at its rate.
+ *  \param n A pointer to a CrosNode object
+ *  \param pubidx Index of the publisher
+ *  \param byte_rate Maximum average byte rate of each connection (in bytes/s). 0 removes the limit
+ *  \param burst Maximum number of bytes that can be sent at once through a connection after an idle period
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the publisher is not valid
+ */
+cRosErrCodePack cRosNodeSetConnectionRateLimit( CrosNode *n, int pubidx, uint32_t byte_rate, uint32_t burst );
+
+/*! \brief Get the number of messages of a publisher that have been deferred or dropped by its rate limits
+ *
+ *  \param n A pointer to a CrosNode object
+ *  \param pubidx Index of the publisher
+ *  \param n_shaped Pointer to a variable where the number of deferred messages is returned. It can be NULL
+ *  \param n_dropped Pointer to a variable where the number of dropped messages is returned. It can be NULL
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the publisher is not valid
+ */
+cRosErrCodePack cRosNodeGetPublisherShapingStats( CrosNode *n, int pubidx, unsigned long *n_shaped, unsigned long *n_dropped );
+
+/*! \brief Batch the small messages of a publisher, so that they are sent to each subscriber in a single write
+ *
+ *  The published messages are serialized as usual but they are accumulated until the oldest one has waited
+ *  flush_window msec or the batch reaches max_batch_bytes; then the whole batch is sent to each subscriber with one
+ *  system call (and usually in one TCP segment). High-priority publishers (see cRosNodeSetPublisherPriority())
+ *  ignore this setting and always send each message immediately.
+ *  \param n A pointer to a CrosNode object
+ *  \param pubidx Index of the publisher
+ *  \param flush_window Max time (in msec) that a message can be delayed. 0 disables batching
+ *  \param max_batch_bytes Size (in bytes) of the batch that triggers an early flush. 0 selects CN_DEFAULT_BATCH_MAX_BYTES
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the publisher is not valid
+ */
+cRosErrCodePack cRosNodeSetPublisherBatching( CrosNode *n, int pubidx, uint32_t flush_window, uint32_t max_batch_bytes );
+
+/*! \brief Send the large messages of a publisher with zero-copy sends (MSG_ZEROCOPY)
+ *
+ *  The messages of at least min_size bytes are not copied to the connection buffers: they are written to each subscriber
+ *  directly from the buffer where they were serialized once (the publisher packet, the packet of the I/O shard or the
+ *  frames filtered for the subscriber), and the kernel transmits the writes of at least min_size bytes from it without
+ *  copying them. This buffer stays pinned until the event loops collect the send completion notifications of all the
+ *  connections; meanwhile the publication of the next message waits. Zero-copy sends only save CPU for large messages
+ *  (tens of KB or more) and they fall back to copying sends when not supported (e.g. on loopback or on platforms without
+ *  SO_ZEROCOPY); the messages are still not copied to the connection buffers then
+ *  \param n A pointer to a CrosNode object
+ *  \param pubidx Index of the publisher
+ *  \param min_size Minimum size (in bytes) of the writes sent without copy. 0 disables the zero-copy sends
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR if the publisher is not valid or CROS_ZEROCOPY_ERR if the
+ *          zero-copy sends could not be enabled on the connected subscribers
+ */
+cRosErrCodePack cRosNodeSetPublisherZeroCopy( CrosNode *n, int pubidx, size_t min_size );
+
 XmlrpcParam *cRosNodeGetParameterValue( CrosNode *n, const char *key);
 /*! @}*/
 
@@ -53,6 +53,18 @@ void cRosMessagePrepareSubcriptionHeader( CrosNode *n, int client_idx );
  */
 void cRosMessagePreparePublicationHeader( CrosNode *n, int server_idx );
 
+/*! \brief Serialize the current outgoing message of a publisher and append it (as a TCPROS frame) to a buffer.
+ *         The message is usually serialized in the publisher shared packet buffer (PublisherNode::packet), or in its batch
+ *         buffer (PublisherNode::batch), and then copied to each subscriber connection by cRosMessagePreparePublicationPacket().
+ *         When the node has I/O shards, each shard may serialize it in its own buffer (PublisherNode::shard_packets)
+ *
+ *  \param n Ponter to the CrosNode object
+ *  \param pub_idx Index of the publisher ( pubs[pub_idx] ) to be considered
+ *  \param packet Buffer where the message is appended
+ *  \return CROS_SUCCESS_ERR_PACK on success, otherwise an error code
+ */
+cRosErrCodePack cRosMessagePreparePublicationData( CrosNode *n, int pub_idx, DynBuffer *packet );
+
 /*! \brief Prepare a TCPROS message (with data) to be sent to a subscriber
  *
  *  \param n Ponter to the CrosNode object
@@ -0,0 +1,135 @@
+#ifndef _CROS_TF_BUFFER_H_
+#define _CROS_TF_BUFFER_H_
+
+#include <stdint.h>
+
+#include "cros_node.h"
+
+/*! \defgroup cros_tf_buffer cROS transform buffer
+ *
+ *  Buffer of the coordinate frame transforms published on the /tf and /tf_static topics (tf2_msgs/TFMessage), which
+ *  answers which is the transform between two frames at a specified time. The received transforms are decoded once into
+ *  a ring buffer for each frame, so that the lookups do not access the message fields
+ */
+
+/*! \addtogroup cros_tf_buffer
+ *  @{
+ */
+
+#define CROS_TF_BUFFER_DEFAULT_CAPACITY 100 //! Default number of transforms kept for each non-static frame
+#define CROS_TF_MAX_TREE_DEPTH 64           //! Max number of frames from a frame to the root of its frame tree
+#define CROS_TF_PATH_CACHE_SIZE 16          //! Number of frame-tree paths kept by the lookup cache
+
+/*! \brief Rigid transform. It converts the points expressed in a child frame into its parent frame: p_parent = rotation * p_child + translation */
+typedef struct CrosTransform CrosTransform;
+struct CrosTransform
+{
+  double translation[3];              //! x, y and z
+  double rotation[4];                 //! Unit quaternion: x, y, z and w
+};
+
+/*! \brief Transform received for a frame at a specified time */
+typedef struct CrosTfSample CrosTfSample;
+struct CrosTfSample
+{
+  int64_t stamp;                      //! Time of the transform (in nsec)
+  CrosTransform transform;            //! Transform from the frame to its parent
+};
+
+/*! \brief Coordinate frame of the transform tree */
+typedef struct CrosTfFrame CrosTfFrame;
+struct CrosTfFrame
+{
+  char *name;                         //! Frame id, without leading '/'
+  uint32_t hash;                      //! Hash value of name
+  int next_in_bucket;                 //! Index of the next frame of the same hash bucket (-1 = last)
+  int parent;                         //! Index of the parent frame (-1 = root of a tree)
+  int is_static;                      //! 1 if the transform of the frame has been received on /tf_static: it is valid at any time
+  CrosTfSample *samples;              //! Ring buffer of transforms, sorted by stamp
+  int samples_size;                   //! Number of elements allocated in samples
+  int first_sample;                   //! Position of the oldest transform in samples
+  int n_samples;                      //! Number of transforms in samples
+};
+
+/*! \brief Frames whose transforms are composed to convert between a source frame and a target frame */
+typedef struct CrosTfPath CrosTfPath;
+struct CrosTfPath
+{
+  int source;                         //! Index of the source frame (-1 = unused cache entry)
+  int target;                         //! Index of the target frame
+  uint32_t tree_version;              //! Value of the tree_version of the buffer when the path was obtained
+  int n_source_frames;                //! Frames from the source frame (included) up to the common ancestor (excluded)
+  int n_target_frames;                //! Frames from the target frame (included) up to the common ancestor (excluded)
+  int frames[2*CROS_TF_MAX_TREE_DEPTH]; //! Indices of the frames: the source-side ones from position 0 and the target-side ones from position CROS_TF_MAX_TREE_DEPTH
+};
+
+/*! \brief Transform buffer. Don't modify directly its internal members: use the related functions instead */
+typedef struct CrosTfBuffer CrosTfBuffer;
+struct CrosTfBuffer
+{
+  CrosNode *node;                     //! Node of the subscribers (NULL if the buffer does not subscribe)
+  int tf_subidx;                      //! Index of the /tf subscriber (-1 = none)
+  int tf_static_subidx;               //! Index of the /tf_static subscriber (-1 = none)
+  int capacity;                       //! Number of transforms kept for each non-static frame
+  CrosTfFrame *frames;                //! Known frames
+  int n_frames;                       //! Number of elements of frames in use
+  int frames_size;                    //! Number of elements allocated in frames
+  int *buckets;                       //! Index of the first frame of each hash bucket (-1 = empty)
+  int n_buckets;                      //! Number of elements of buckets (power of 2)
+  uint32_t tree_version;              //! Incremented when the parent of a frame changes. It invalidates the cached paths
+  CrosTfPath path_cache[CROS_TF_PATH_CACHE_SIZE]; //! Recently used paths
+  unsigned long n_transforms;         //! Number of transforms inserted
+  unsigned long n_discarded_transforms; //! Number of received transforms that have been discarded (older than the buffered ones or malformed)
+};
+
+/*! \brief Create a transform buffer and register its subscribers to /tf and /tf_static
+ *
+ *  The message root directory of the node must contain the definitions of tf2_msgs/TFMessage and of the geometry_msgs
+ *  types that it uses (they are included in samples/rosdb)
+ *  \param node Pointer to the CrosNode object. It must have two free subscribers. If it is NULL no subscriber is
+ *              registered and the transforms must be inserted with cRosTfBufferSetTransform()
+ *  \param capacity Number of transforms kept for each non-static frame (e.g. CROS_TF_BUFFER_DEFAULT_CAPACITY). When it
+ *                  is full the oldest transform of the frame is discarded
+ *  \param buf_ptr Pointer to a variable where the new buffer is stored. It must be destroyed with cRosTfBufferDestroy()
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR, CROS_MEM_ALLOC_ERR or the error of a subscriber registration
+ */
+cRosErrCodePack cRosTfBufferCreate( CrosNode *node, int capacity, CrosTfBuffer **buf_ptr );
+
+/*! \brief Unregister the subscribers of a transform buffer and release its memory
+ *
+ *  \param buf Pointer to the buffer
+ */
+void cRosTfBufferDestroy( CrosTfBuffer *buf );
+
+/*! \brief Insert the transform of a frame, as the subscribers do for each received transform
+ *
+ *  If the parent of the frame changes, the transforms previously inserted for the frame are discarded
+ *  \param buf Pointer to the buffer
+ *  \param parent_frame Frame id of the parent frame (header.frame_id of geometry_msgs/TransformStamped)
+ *  \param child_frame Frame id of the frame (child_frame_id of geometry_msgs/TransformStamped)
+ *  \param stamp Time of the transform (in nsec)
+ *  \param transform Transform from child_frame to parent_frame
+ *  \param is_static 1 if the transform is valid at any time (as the ones received on /tf_static)
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR or CROS_MEM_ALLOC_ERR
+ */
+cRosErrCodePack cRosTfBufferSetTransform( CrosTfBuffer *buf, const char *parent_frame, const char *child_frame,
+                                          int64_t stamp, const CrosTransform *transform, int is_static );
+
+/*! \brief Obtain the transform that converts the points expressed in a source frame into a target frame at a specified time
+ *
+ *  The transform of each frame in the path between the two frames is interpolated between the two buffered transforms
+ *  nearest to time (linear interpolation of the translation and spherical of the rotation). The path is cached until the
+ *  transform tree changes
+ *  \param buf Pointer to the buffer
+ *  \param target_frame Frame id of the target frame
+ *  \param source_frame Frame id of the source frame
+ *  \param time Time of the transform (in nsec). 0 requests the latest time for which all the transforms in the path are available
+ *  \param transform Pointer to the variable where the transform is stored
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR, CROS_TF_CONNECTIVITY_ERR or CROS_TF_EXTRAPOLATION_ERR
+ */
+cRosErrCodePack cRosTfBufferLookup( CrosTfBuffer *buf, const char *target_frame, const char *source_frame, int64_t time,
+                                    CrosTransform *transform );
+
+/*! @}*/
+
+#endif // _CROS_TF_BUFFER_H_
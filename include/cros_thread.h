@@ -0,0 +1,186 @@
+/*! \file cros_thread.h
+ *  \brief This header file declares the portable synchronization primitives used internally by cROS
+ *         when some node resources are accessed from more than one thread (e.g. by the I/O shard loops),
+ *         and the threads created internally (e.g. to serialize large messages in parallel).
+ */
+
+#ifndef _CROS_THREAD_H_
+#define _CROS_THREAD_H_
+
+#ifdef _WIN32
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
+/*! \defgroup cros_thread cROS thread synchronization */
+
+/*! \addtogroup cros_thread
+ *  @{
+ */
+
+/*! \brief Mutual exclusion lock. Don't modify directly its internal members: use the related functions instead */
+typedef struct cRosMutex cRosMutex;
+struct cRosMutex
+{
+#ifdef _WIN32
+  CRITICAL_SECTION cs; //! Windows critical section object
+#else
+  pthread_mutex_t mtx; //! POSIX mutex object
+#endif
+};
+
+/*! \brief Condition variable used to wait for a condition protected by a cRosMutex.
+ *         Don't modify directly its internal members: use the related functions instead */
+typedef struct cRosCondition cRosCondition;
+struct cRosCondition
+{
+#ifdef _WIN32
+  CONDITION_VARIABLE cv; //! Windows condition variable object
+#else
+  pthread_cond_t cv; //! POSIX condition variable object
+#endif
+};
+
+/*! \brief Function executed by a thread created with cRosThreadCreate() */
+typedef void (*cRosThreadFunc)( void *arg );
+
+/*! \brief Thread of execution. Don't modify directly its internal members: use the related functions instead */
+typedef struct cRosThread cRosThread;
+struct cRosThread
+{
+#ifdef _WIN32
+  HANDLE handle; //! Windows thread handle
+#else
+  pthread_t tid; //! POSIX thread ID
+#endif
+  cRosThreadFunc func; //! Function executed by the thread
+  void *arg; //! Argument passed to func
+};
+
+/*! Max num. of worker threads of a cRosThreadPool */
+#define CROS_THREAD_POOL_MAX_THREADS 16
+
+/*! \brief Persistent worker threads that run batches of tasks (see cRosThreadPoolRun()).
+ *         Don't modify directly its internal members: use the related functions instead */
+typedef struct cRosThreadPool cRosThreadPool;
+struct cRosThreadPool
+{
+  cRosThread threads[CROS_THREAD_POOL_MAX_THREADS]; //! Worker threads
+  int n_threads;              //! Number of worker threads started
+  cRosMutex lock;             //! Protects the following members
+  cRosCondition tasks_ready;  //! Signaled when a batch of tasks is started or when the workers must finish
+  cRosCondition tasks_done;   //! Signaled when the last task of the batch finishes
+  cRosThreadFunc func;        //! Function executed for each task of the current batch
+  unsigned char *tasks;       //! Array of tasks of the current batch. Each task is the argument passed to func
+  size_t task_size;           //! Size of each task (in bytes)
+  int n_tasks;                //! Number of tasks of the current batch
+  int next_task;              //! Index of the next task of the batch that has not been taken by a thread
+  int n_pending;              //! Number of tasks of the batch that have not finished yet
+  int busy;                   //! 1 while a batch is being run
+  int stop;                   //! 1 when the workers must finish
+};
+
+/*! \brief Initialize a mutex. It must be called before using the mutex for the first time
+ *
+ *  \param m Pointer to the mutex
+ *
+ *  \return Returns 1 on success, 0 on failure
+ */
+int cRosMutexInit( cRosMutex *m );
+
+/*! \brief Block until the mutex can be acquired
+ *
+ *  \param m Pointer to the mutex
+ */
+void cRosMutexLock( cRosMutex *m );
+
+/*! \brief Release a mutex previously acquired with cRosMutexLock()
+ *
+ *  \param m Pointer to the mutex
+ */
+void cRosMutexUnlock( cRosMutex *m );
+
+/*! \brief Free the resources allocated for a mutex. cRosMutexInit() must be called before using it again
+ *
+ *  \param m Pointer to the mutex
+ */
+void cRosMutexRelease( cRosMutex *m );
+
+/*! \brief Create a new thread that executes a function
+ *
+ *  \param t Pointer to the thread object. It must remain valid until cRosThreadJoin() returns
+ *  \param func Function executed by the new thread
+ *  \param arg Argument passed to func
+ *
+ *  \return Returns 1 on success, 0 on failure
+ */
+int cRosThreadCreate( cRosThread *t, cRosThreadFunc func, void *arg );
+
+/*! \brief Block until a thread created with cRosThreadCreate() finishes, and free its resources
+ *
+ *  \param t Pointer to the thread object
+ */
+void cRosThreadJoin( cRosThread *t );
+
+/*! \brief Initialize a condition variable. It must be called before using it for the first time
+ *
+ *  \param c Pointer to the condition variable
+ *
+ *  \return Returns 1 on success, 0 on failure
+ */
+int cRosConditionInit( cRosCondition *c );
+
+/*! \brief Release the mutex, block until the condition variable is signaled and acquire the mutex again.
+ *         The waited condition must be checked again when it returns
+ *
+ *  \param c Pointer to the condition variable
+ *  \param m Pointer to the mutex, which must be locked by the calling thread
+ */
+void cRosConditionWait( cRosCondition *c, cRosMutex *m );
+
+/*! \brief Wake up all the threads waiting for a condition variable
+ *
+ *  \param c Pointer to the condition variable
+ */
+void cRosConditionBroadcast( cRosCondition *c );
+
+/*! \brief Free the resources allocated for a condition variable. No thread must be waiting for it
+ *
+ *  \param c Pointer to the condition variable
+ */
+void cRosConditionRelease( cRosCondition *c );
+
+/*! \brief Start the worker threads of a pool. They wait for tasks until cRosThreadPoolDestroy() is called
+ *
+ *  \param pool Pointer to the pool object
+ *  \param n_threads Number of worker threads (up to CROS_THREAD_POOL_MAX_THREADS). The pool can have fewer threads
+ *         if some of them cannot be created: the calling thread of cRosThreadPoolRun() runs the tasks too
+ *
+ *  \return Returns 1 on success, 0 if the synchronization objects of the pool could not be created
+ */
+int cRosThreadPoolCreate( cRosThreadPool *pool, int n_threads );
+
+/*! \brief Run a function for each task of an array in the worker threads and in the calling thread,
+ *         and wait until all of them finish
+ *
+ *  If the pool is already running a batch for another thread, all the tasks are run in the calling thread.
+ *
+ *  \param pool Pointer to the pool object
+ *  \param func Function executed for each task
+ *  \param tasks Pointer to the first task. A pointer to each task is passed to func
+ *  \param task_size Size of each task (in bytes)
+ *  \param n_tasks Number of tasks
+ */
+void cRosThreadPoolRun( cRosThreadPool *pool, cRosThreadFunc func, void *tasks, size_t task_size, int n_tasks );
+
+/*! \brief Finish the worker threads of a pool and free its resources. No batch must be running
+ *
+ *  \param pool Pointer to the pool object
+ */
+void cRosThreadPoolDestroy( cRosThreadPool *pool );
+
+/*! @}*/
+
+#endif // _CROS_THREAD_H_
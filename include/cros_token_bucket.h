@@ -0,0 +1,70 @@
+#ifndef _CROS_TOKEN_BUCKET_H_
+#define _CROS_TOKEN_BUCKET_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*! \defgroup cros_token_bucket cROS token bucket
+ *
+ *  Token-bucket rate limiter used to shape the output byte rate of publishers and connections
+ */
+
+/*! \addtogroup cros_token_bucket
+ *  @{
+ */
+
+/*! \brief Token bucket. The bucket is refilled at byte_rate bytes per second up to burst bytes.
+ *         A message can be sent when the bucket is not in debt (tokens >= 0), and then its whole size is consumed,
+ *         so messages bigger than the burst size can be sent as well while the long-term rate is kept.
+ *         Don't modify directly its internal members: use the related functions instead */
+typedef struct CrosTokenBucket CrosTokenBucket;
+struct CrosTokenBucket
+{
+  uint32_t byte_rate;                 //! Refill rate (in bytes/s). 0 means that the bucket is disabled (unlimited rate)
+  uint32_t burst;                     //! Maximum number of bytes that can be accumulated in the bucket
+  int64_t tokens;                     //! Current number of tokens (in thousandths of byte). It is negative when the bucket is in debt
+  uint64_t last_update_time;          //! Last time that the bucket was refilled (in msec)
+};
+
+/*! \brief Initialize a token bucket. The bucket starts full
+ *
+ *  \param b Pointer to the token bucket
+ *  \param byte_rate Refill rate (in bytes/s). 0 disables the bucket
+ *  \param burst Bucket size (in bytes)
+ *  \param cur_time Current time (in msec)
+ */
+void cRosTokenBucketInit( CrosTokenBucket *b, uint32_t byte_rate, uint32_t burst, uint64_t cur_time );
+
+/*! \brief Check whether the bucket is enabled
+ *
+ *  \param b Pointer to the token bucket
+ *  \return 1 if the bucket limits the rate, 0 otherwise
+ */
+int cRosTokenBucketIsEnabled( CrosTokenBucket *b );
+
+/*! \brief Refill the bucket and check whether a new message can be sent
+ *
+ *  \param b Pointer to the token bucket
+ *  \param cur_time Current time (in msec)
+ *  \return 1 if the bucket is disabled or it is not in debt, 0 otherwise
+ */
+int cRosTokenBucketReady( CrosTokenBucket *b, uint64_t cur_time );
+
+/*! \brief Consume the tokens corresponding to a message that is being sent
+ *
+ *  \param b Pointer to the token bucket
+ *  \param n_bytes Size of the message (in bytes)
+ */
+void cRosTokenBucketConsume( CrosTokenBucket *b, size_t n_bytes );
+
+/*! \brief Calculate the time until a new message can be sent
+ *
+ *  \param b Pointer to the token bucket
+ *  \param cur_time Current time (in msec)
+ *  \return The waiting time (in msec). 0 if a message can be sent now
+ */
+uint64_t cRosTokenBucketWaitTime( CrosTokenBucket *b, uint64_t cur_time );
+
+/*! @}*/
+
+#endif // _CROS_TOKEN_BUCKET_H_
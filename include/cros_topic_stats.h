@@ -0,0 +1,86 @@
+#ifndef _CROS_TOPIC_STATS_H_
+#define _CROS_TOPIC_STATS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*! \defgroup cros_topic_stats cROS topic statistics
+ *
+ *  Accumulators of the statistics of the messages received through a subscriber connection
+ *  (see cRosNodeSetSubscriberStatistics())
+ */
+
+/*! \addtogroup cros_topic_stats
+ *  @{
+ */
+
+/*! \brief Running mean, variance (Welford's method) and maximum of a series of samples.
+ *         Don't modify directly its internal members: use the related functions instead */
+typedef struct CrosStatsMoments CrosStatsMoments;
+struct CrosStatsMoments
+{
+  uint32_t n;                         //! Number of samples
+  double mean;                        //! Mean of the samples
+  double m2;                          //! Sum of the squared differences from the mean
+  double max;                         //! Maximum sample
+};
+
+/*! \brief Statistics of the messages received through a connection during the current window.
+ *         Don't modify directly its internal members: use the related functions instead */
+typedef struct CrosTopicStats CrosTopicStats;
+struct CrosTopicStats
+{
+  uint64_t window_start;              //! Start time of the current window (in msec, node clock)
+  uint32_t delivered_msgs;            //! Number of messages received in the window
+  uint32_t dropped_msgs;              //! Number of messages lost in the window (gaps in the header sequence numbers)
+  uint64_t traffic;                   //! Number of message bytes received in the window
+  CrosStatsMoments period;            //! Time between consecutive messages (in usec)
+  CrosStatsMoments stamp_age;         //! Time from the header stamp of the messages to their reception (in usec)
+  int64_t last_arrival;               //! Arrival time of the previous message (see cRosClockGetTimeStamp()). 0 if no message has been received yet
+  uint32_t last_seq;                  //! Header sequence number of the previous message
+  unsigned char last_seq_valid;       //! If 1, last_seq contains the sequence number of the previous message
+};
+
+/*! \brief Initialize the statistics of a new connection and start its first window
+ *
+ *  \param s Pointer to the statistics
+ *  \param cur_time Current time (in msec)
+ */
+void cRosTopicStatsInit( CrosTopicStats *s, uint64_t cur_time );
+
+/*! \brief Start a new window, discarding the statistics of the current one.
+ *         The previous message is still used to calculate the period and drops of the next one
+ *
+ *  \param s Pointer to the statistics
+ *  \param cur_time Current time (in msec)
+ */
+void cRosTopicStatsStartWindow( CrosTopicStats *s, uint64_t cur_time );
+
+/*! \brief Account for a received message
+ *
+ *  \param s Pointer to the statistics
+ *  \param n_bytes Size of the serialized message (in bytes)
+ *  \param arrival_time_stamp Reception time of the message (see cRosClockGetTimeStamp())
+ */
+void cRosTopicStatsAddMessage( CrosTopicStats *s, size_t n_bytes, int64_t arrival_time_stamp );
+
+/*! \brief Account for the header of the last received message (only for messages that start with a std_msgs/Header)
+ *
+ *  \param s Pointer to the statistics
+ *  \param seq Sequence number of the header
+ *  \param stamp_age Time elapsed since the header stamp (in usec)
+ */
+void cRosTopicStatsAddHeader( CrosTopicStats *s, uint32_t seq, double stamp_age );
+
+/*! \brief Obtain the mean, standard deviation and maximum of a series of samples. They are 0 if there are no samples
+ *
+ *  \param m Pointer to the accumulator of the samples
+ *  \param mean Pointer to a variable where the mean is stored
+ *  \param stddev Pointer to a variable where the (population) standard deviation is stored
+ *  \param max Pointer to a variable where the maximum is stored
+ */
+void cRosStatsMomentsGet( const CrosStatsMoments *m, double *mean, double *stddev, double *max );
+
+/*! @}*/
+
+#endif // _CROS_TOPIC_STATS_H_
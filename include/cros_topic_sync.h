@@ -0,0 +1,99 @@
+#ifndef _CROS_TOPIC_SYNC_H_
+#define _CROS_TOPIC_SYNC_H_
+
+#include <stdint.h>
+
+#include "cros_node.h"
+
+/*! \defgroup cros_topic_sync cROS topic synchronizer
+ *
+ *  Matching of the messages received on several topics by the stamp of their std_msgs/Header, for applications
+ *  (e.g. sensor fusion) that must process a set of messages taken at the same time. The synchronizer registers one
+ *  subscriber for each topic and retains the received messages without copying them (see cRosApiRetainSubscriberMessage())
+ *  until they are matched or discarded
+ */
+
+/*! \addtogroup cros_topic_sync
+ *  @{
+ */
+
+#define CROS_TOPIC_SYNC_MAX_TOPICS 8  //! Max number of topics of a synchronizer
+
+/*! \brief How the messages of the different topics are matched */
+typedef enum CrosTopicSyncPolicy
+{
+  CROS_TOPIC_SYNC_EXACT = 0,          //! The messages of a set have exactly the same stamp
+  CROS_TOPIC_SYNC_APPROXIMATE         //! The stamps of the messages of a set differ at most by max_interval
+} CrosTopicSyncPolicy;
+
+/*! \brief Function called for each matched set of messages
+ *
+ *  \param msgs One message for each topic, in the order of the topics of the synchronizer. They are released when the
+ *              function returns, so they must be copied (see cRosMessageCopy()) to be used afterwards
+ *  \param n_topics Number of elements of msgs
+ *  \param context Context specified when the synchronizer was created
+ */
+typedef void (*CrosTopicSyncCallback)( cRosMessage **msgs, int n_topics, void *context );
+
+typedef struct CrosTopicSync CrosTopicSync;
+
+/*! \brief Messages of a topic waiting to be matched, ordered by stamp */
+typedef struct CrosTopicSyncQueue CrosTopicSyncQueue;
+struct CrosTopicSyncQueue
+{
+  CrosTopicSync *sync;                //! Synchronizer of the topic (context of the subscriber callback)
+  int subidx;                         //! Index of the subscriber of the topic
+  cRosMessage **msgs;                 //! Retained messages (queue_size elements allocated)
+  int64_t *stamps;                    //! Stamp of each message (in nsec)
+  int n_msgs;                         //! Number of messages in the queue
+  int64_t last_matched_stamp;         //! Stamp of the last message of this topic that has been matched (-1 = none). Older messages are discarded
+};
+
+/*! \brief Topic synchronizer. Don't modify directly its internal members: use the related functions instead */
+struct CrosTopicSync
+{
+  CrosNode *node;                     //! Node of the subscribers
+  CrosTopicSyncPolicy policy;         //! Matching policy
+  uint64_t max_interval;              //! Max difference between the stamps of a set (in nsec). Only used by CROS_TOPIC_SYNC_APPROXIMATE
+  int queue_size;                     //! Max number of messages of each topic waiting to be matched
+  CrosTopicSyncCallback callback;     //! Function called for each matched set
+  void *context;                      //! Context passed to callback
+  int n_topics;                       //! Number of elements of queues
+  CrosTopicSyncQueue queues[CROS_TOPIC_SYNC_MAX_TOPICS]; //! Queue of each topic
+  cRosMessage *matched[CROS_TOPIC_SYNC_MAX_TOPICS];      //! The set of messages passed to callback
+  unsigned long n_sets;               //! Number of sets of messages matched
+  unsigned long n_discarded_msgs;     //! Number of received messages that have not been matched (too old, unmatched or without header)
+};
+
+/*! \brief Create a synchronizer and register a subscriber for each of its topics
+ *
+ *  Each received message is inserted in the queue of its topic (a sorted array), and the queues of the other topics are
+ *  searched (binary search) for the messages with the nearest stamps. When a message of each topic is found that
+ *  matches the policy, the callback is called with the set, and the matched messages and the older ones are released.
+ *  A set is reported as soon as it is complete: with CROS_TOPIC_SYNC_APPROXIMATE a closer message that arrives later is
+ *  not considered. When a queue is full its oldest message is discarded. The messages must start with a std_msgs/Header
+ *  \param node Pointer to the CrosNode object
+ *  \param topic_names Names of the topics (n_topics elements)
+ *  \param topic_types Types of the messages of each topic (n_topics elements)
+ *  \param n_topics Number of topics (from 2 to CROS_TOPIC_SYNC_MAX_TOPICS). The node must have a free subscriber for each one
+ *  \param policy Matching policy
+ *  \param max_interval Max difference between the stamps of the messages of a set (in nsec), for CROS_TOPIC_SYNC_APPROXIMATE
+ *  \param queue_size Max number of messages of each topic waiting to be matched
+ *  \param callback Function called for each matched set
+ *  \param context Context passed to callback
+ *  \param sync_ptr Pointer to a variable where the new synchronizer is stored. It must be destroyed with cRosTopicSyncDestroy()
+ *  \return CROS_SUCCESS_ERR_PACK (0) on success, CROS_BAD_PARAM_ERR, CROS_MEM_ALLOC_ERR or the error of a subscriber registration
+ */
+cRosErrCodePack cRosTopicSyncCreate( CrosNode *node, const char **topic_names, const char **topic_types, int n_topics,
+                                     CrosTopicSyncPolicy policy, uint64_t max_interval, int queue_size,
+                                     CrosTopicSyncCallback callback, void *context, CrosTopicSync **sync_ptr );
+
+/*! \brief Unregister the subscribers of a synchronizer and release its memory, including the messages waiting to be matched
+ *
+ *  \param sync Pointer to the synchronizer
+ */
+void cRosTopicSyncDestroy( CrosTopicSync *sync );
+
+/*! @}*/
+
+#endif // _CROS_TOPIC_SYNC_H_
@@ -18,6 +18,7 @@ struct DynBuffer
   size_t pos_offset;              //! Current position indicator
   size_t max;                     //! Max buffer size
   unsigned char *data;         //! buffer data
+  int fixed;                      //! 1 if data is memory owned by the caller (see dynBufferInitFixed()): it is never reallocated or freed
 };
 
 /*! \brief Initialize a dynamic buffer
@@ -26,6 +27,16 @@ struct DynBuffer
  */
 void dynBufferInit( DynBuffer *d_buf );
 
+/*! \brief Initialize a dynamic buffer that uses a fixed block of memory owned by the caller.
+ *         The buffer cannot grow: the functions that would need more than max bytes fail
+ *
+ *  \param d_buf Pointer to a DynBuffer object to be initialized
+ *  \param data Pointer to the memory block. dynBufferRelease() does not free it
+ *  \param size Number of bytes of the block that are already content of the buffer
+ *  \param max Size of the memory block (in bytes)
+ */
+void dynBufferInitFixed( DynBuffer *d_buf, unsigned char *data, size_t size, size_t max );
+
 /*! \brief Release a dynamic buffer
  *
  *  \param d_buf Pointer to a DynBuffer object to be released
@@ -42,6 +53,38 @@ void dynBufferRelease( DynBuffer *d_buf );
  */
 int dynBufferPushBackBuf( DynBuffer *d_buf, const unsigned char *new_buf, size_t n );
 
+/*! \brief Make sure that at least n more bytes can be appended to the dynamic buffer without reallocating it.
+ *         The bytes can be written directly in the returned memory and then appended with dynBufferCommit()
+ *
+ *  \param d_buf Pointer to a DynBuffer object
+ *  \param n Number of bytes to be reserved
+ *
+ *  \return Pointer to the first byte after the current content, or NULL on failure
+ */
+unsigned char *dynBufferReserve( DynBuffer *d_buf, size_t n );
+
+/*! \brief Append to the dynamic buffer content the n bytes written in the memory obtained with dynBufferReserve()
+ *
+ *  \param d_buf Pointer to a DynBuffer object
+ *  \param n Number of written bytes. It must not be greater than the number of reserved bytes
+ */
+void dynBufferCommit( DynBuffer *d_buf, size_t n );
+
+/*! \brief Discard the content of the dynamic buffer after its first size bytes (the internal memory IS NOT released)
+ *
+ *  \param d_buf Pointer to a DynBuffer object
+ *  \param size New size of the content. If it is not smaller than the current size, nothing is done
+ */
+void dynBufferTruncate( DynBuffer *d_buf, size_t size );
+
+/*! \brief Remove the first n bytes of the dynamic buffer, moving the remaining content to the beginning.
+ *         The position indicator is reset (the internal memory IS NOT released)
+ *
+ *  \param d_buf Pointer to a DynBuffer object
+ *  \param n Number of bytes to be removed
+ */
+void dynBufferEraseFront( DynBuffer *d_buf, size_t n );
+
 /*! \brief Replace the content of the dynamic buffer starting from current position indicator with the content
  *         of the buffer cont_buf.
  *
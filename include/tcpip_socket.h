@@ -55,6 +55,15 @@ struct TcpIpSocket
   unsigned char connected; //! It is 1 if the socket is connected (inbound or outbound). Otherwise it is 0
   unsigned char listening; //! It is 1 if the socket is already in the listening state (ready to accept connections). Otherwise it is 0
   unsigned char is_nonblocking; //! It is 1 if the socket has been configured as non blocking. Otherwise it is 0
+  unsigned char rx_timestamps; //! It is 1 if the kernel reception time of the read data is requested (see tcpIpSocketSetRxTimestamps()). Otherwise it is 0
+  int64_t rx_time_stamp; //! Kernel reception time of the data returned by the last read, expressed as a cRosClockGetTimeStamp() time stamp. 0 if it is not available
+  size_t zerocopy_min_size; //! Writes of at least this num. of bytes are sent with MSG_ZEROCOPY (see tcpIpSocketSetZeroCopy()). 0 if zero-copy sends are disabled
+  uint32_t zerocopy_sent; //! Num. of MSG_ZEROCOPY sends performed through this socket
+  uint32_t zerocopy_done; //! Num. of MSG_ZEROCOPY sends whose completion has already been notified by the kernel
+  int last_error; //! System error code of the last read or write that failed or found the socket disconnected. 0 if none has failed
+  struct TcpIpUring *uring; //! io_uring instance that performs some operations of this socket (see tcpIpUringAttachSocket()). NULL if it uses the socket calls only
+  uint32_t uring_serial; //! Serial number of the attachment of this socket to its io_uring instance
+  unsigned char uring_ops; //! TCPIP_URING_OP_* operations performed through the io_uring instance
 };
 
 /*! \brief Initialize the TcpIpSocket object with default values
@@ -104,6 +113,57 @@ int tcpIpSocketSetNoDelay ( TcpIpSocket *s );
  */
 int tcpIpSocketSetReuse ( TcpIpSocket *s );
 
+/*! \brief Allow several TCP/IP4 sockets to be bound to the same address and port (SO_REUSEPORT).
+ *         The kernel distributes the incoming connections among all the listening sockets bound to the port
+ *
+ *  \param s Pointer to a TcpIpSocket object
+ *
+ *  \return Returns 1 on success, 0 on failure or if the option is not supported by the platform
+ */
+int tcpIpSocketSetReusePort ( TcpIpSocket *s );
+
+/*! \brief Set the priority of the packets sent through a TCP/IP4 socket. The priority is used by the local
+ *         queuing discipline (SO_PRIORITY) and by the network (DSCP field of the IP header)
+ *
+ *  \param s Pointer to a TcpIpSocket object
+ *  \param priority Protocol-defined priority for the packets (0-6 can be set without special privileges).
+ *         It is ignored on platforms without SO_PRIORITY support
+ *  \param dscp Differentiated Services Code Point (0-63) written in the IP header of the sent packets
+ *
+ *  \return Returns 1 on success, 0 on failure
+ */
+int tcpIpSocketSetPriority( TcpIpSocket *s, int priority, int dscp );
+
+/*! \brief Enable or disable the kernel reception time stamps (SO_TIMESTAMPNS) of the data read through a TCP/IP4 socket.
+ *         When enabled, each read stores in s->rx_time_stamp the time at which the kernel received the (last) segment of the read data
+ *
+ *  \param s Pointer to a TcpIpSocket object
+ *  \param enable 1 to enable the time stamps, 0 to disable them
+ *
+ *  \return Returns 1 on success, 0 on failure or if the option is not supported by the platform
+ */
+int tcpIpSocketSetRxTimestamps( TcpIpSocket *s, int enable );
+
+/*! \brief Enable or disable the zero-copy sends (SO_ZEROCOPY) through a TCP/IP4 socket. When enabled, the writes of at least
+ *         min_size bytes are sent with the MSG_ZEROCOPY flag: the kernel transmits the data directly from the user buffer, so this
+ *         buffer must not be modified or freed until tcpIpSocketZeroCopyPending() returns 0
+ *
+ *  \param s Pointer to a TcpIpSocket object
+ *  \param min_size Minimum size (in bytes) of the writes to be sent without copy. 0 to disable the zero-copy sends
+ *
+ *  \return Returns 1 on success, 0 on failure or if the option is not supported by the platform
+ */
+int tcpIpSocketSetZeroCopy( TcpIpSocket *s, size_t min_size );
+
+/*! \brief Collect the completion notifications of the zero-copy sends (from the socket error queue) and check whether
+ *         the kernel may still be reading any of the sent user buffers
+ *
+ *  \param s Pointer to a TcpIpSocket object
+ *
+ *  \return Returns 1 if some MSG_ZEROCOPY send has not been completed yet, 0 otherwise
+ */
+int tcpIpSocketZeroCopyPending( TcpIpSocket *s );
+
 /*! \brief Set a TCP/IP4 socket to prevent disconnection
  *
  *  \param s Pointer to a TcpIpSocket object
@@ -115,6 +175,36 @@ int tcpIpSocketSetReuse ( TcpIpSocket *s );
  */
 int tcpIpSocketSetKeepAlive( TcpIpSocket *s, unsigned int idle, unsigned int interval, unsigned int count );
 
+/*! \brief Set the maximum time that transmitted data may remain unacknowledged before the kernel closes the connection (TCP_USER_TIMEOUT).
+ *         After that, the reads and writes of the socket fail and tcpIpSocketTimedOut() returns 1
+ *
+ *  \param s Pointer to a TcpIpSocket object
+ *  \param timeout The maximum time (in msec). 0 restores the system default
+ *
+ *  \return Returns 1 on success, 0 on failure or if the option is not supported by the platform
+ */
+int tcpIpSocketSetUserTimeout( TcpIpSocket *s, unsigned int timeout );
+
+/*! \brief Set the size of the kernel send and receive buffers of a TCP/IP4 socket (SO_SNDBUF and SO_RCVBUF).
+ *         The kernel may adjust the sizes (e.g. Linux doubles them and limits them to net.core.wmem_max and rmem_max)
+ *
+ *  \param s Pointer to a TcpIpSocket object
+ *  \param snd_buf_size Size of the send buffer (in bytes). 0 = unchanged
+ *  \param rcv_buf_size Size of the receive buffer (in bytes). 0 = unchanged
+ *
+ *  \return Returns 1 on success, 0 on failure
+ */
+int tcpIpSocketSetBufferSizes( TcpIpSocket *s, size_t snd_buf_size, size_t rcv_buf_size );
+
+/*! \brief Check whether the last failed read or write of a socket failed because the peer stopped acknowledging the data
+ *         or the keepalive probes (see tcpIpSocketSetUserTimeout() and tcpIpSocketSetKeepAlive())
+ *
+ *  \param s Pointer to a TcpIpSocket object
+ *
+ *  \return Returns 1 if the connection timed out, 0 otherwise
+ */
+int tcpIpSocketTimedOut( TcpIpSocket *s );
+
 /*! \brief Connect a TCP/IP4 socket to a server
  *
  *  \param s Pointer to a TcpIpSocket object
@@ -184,6 +274,21 @@ int tcpIpSocketDisconnect( TcpIpSocket *s );
  */
 TcpIpSocketState tcpIpSocketWriteBuffer( TcpIpSocket *s, DynBuffer *d_buf );
 
+/*! \brief Send at most a specified number of bytes of a binary message on a connected socket
+ *
+ *  \param s Pointer to a TcpIpSocket object
+ *  \param d_buf The dynamic buffer to be written
+ *  \param max_size Maximum number of bytes to be written in this call
+ *  \param n_writes Pointer to a variable in which the number of written bytes is returned
+ *
+ *  \return Returns TCPIPSOCKET_DONE if all the remaining data of the buffer has been written,
+ *          TCPIPSOCKET_IN_PROGRESS if the write operation is not yet completed (max_size bytes were
+ *          written or the non-blocking socket would block),
+ *          TCPIPSOCKET_DISCONNECTED if the socket has been disconnectd,
+ *          or TCPIPSOCKET_FAILED on failure
+ */
+TcpIpSocketState tcpIpSocketWriteBufferEx( TcpIpSocket *s, DynBuffer *d_buf, size_t max_size, size_t *n_writes );
+
 /*! \brief Send a string on a connected socket
  *
  *  \param s Pointer to a TcpIpSocket object
@@ -0,0 +1,127 @@
+/*! \file tcpip_uring.h
+ *  \brief This header file declares the io_uring backend that the event loops of the node can use
+ *         instead of select() and the socket calls.
+ *
+ *  The backend keeps a poll request armed in the kernel for each socket being waited for, so a wait only costs
+ *  the sockets that became ready instead of all of them. The sockets attached to an instance with tcpIpUringAttachSocket()
+ *  also perform their operations through it: their reads are received in advance into registered buffers, their
+ *  connections are accepted by a multishot request and their writes are queued as chains of linked send requests,
+ *  which are all submitted in one system call by tcpIpUringFlushSends().
+ *  It is compiled in when CROS_USE_IO_URING is defined (CMake option CROS_USE_IO_URING) on Linux. If it is not compiled in
+ *  or the kernel does not support the needed io_uring features, tcpIpUringCreate() returns NULL, tcpIpUringSelect() falls
+ *  back to tcpIpSocketSelect() and the sockets are not attached.
+ */
+
+#ifndef _TCPIP_URING_H_
+#define _TCPIP_URING_H_
+
+#include "tcpip_socket.h"
+
+/*! \defgroup tcpip_uring TCP/IP io_uring backend */
+
+/*! \addtogroup tcpip_uring
+ *  @{
+ */
+
+#define TCPIP_URING_OP_RECV 0x01          //! The data is received in advance into the registered buffers of the instance (the kernel reception time stamps are not available)
+#define TCPIP_URING_OP_SEND_FRAMES 0x02   //! The writes of TCPROS frames are queued as chains of linked send requests (the zero-copy sends are not available)
+#define TCPIP_URING_OP_ACCEPT 0x04        //! The connections of a listening socket are accepted in advance by a multishot accept request
+
+/*! \brief io_uring instance of an event loop. Its members are private: use the related functions instead */
+typedef struct TcpIpUring TcpIpUring;
+
+/*! \brief Create the io_uring instance of an event loop. It must be used by one thread at a time
+ *
+ *  \return Returns a pointer to the new instance or NULL if the backend is not compiled in or not supported by the kernel
+ */
+TcpIpUring *tcpIpUringCreate( void );
+
+/*! \brief Free an io_uring instance created with tcpIpUringCreate(). The sockets attached to it must not be used afterwards,
+ *         except for closing them
+ *
+ *  \param u Pointer to the instance. It can be NULL
+ */
+void tcpIpUringDestroy( TcpIpUring *u );
+
+/*! \brief Perform some operations of a socket through an io_uring instance until the socket is closed
+ *
+ *  The socket must only be read, written or accepted by the thread of the event loop that owns the instance. Attaching a
+ *  socket that is already attached to the instance does nothing, so it can be called in each loop pass.
+ *
+ *  \param u Pointer to the io_uring instance. If it is NULL, the socket is not attached
+ *  \param s Pointer to an open TcpIpSocket object
+ *  \param ops TCPIP_URING_OP_* operations to perform through the instance. The ones that the kernel does not support are
+ *         performed with the socket calls. TCPIP_URING_OP_SEND_FRAMES is ignored if the zero-copy sends of the socket are
+ *         enabled, and TCPIP_URING_OP_RECV if its reception time stamps are
+ *
+ *  \return Returns 1 if the socket is attached to the instance, 0 otherwise
+ */
+int tcpIpUringAttachSocket( TcpIpUring *u, TcpIpSocket *s, unsigned ops );
+
+/*! \brief Wait until at least one of the file descriptors is ready, like tcpIpSocketSelect()
+ *
+ *  The arguments and the return value are the same as the ones of tcpIpSocketSelect(). TCP urgent data is the only
+ *  exceptional condition reported in exceptfds, as select() does on Linux. A socket attached with TCPIP_URING_OP_RECV or
+ *  TCPIP_URING_OP_ACCEPT is reported as readable when its data or connection has been received in advance.
+ *  The send chains that are still queued are submitted first.
+ *
+ *  \param u Pointer to the io_uring instance of the calling event loop. If it is NULL, tcpIpSocketSelect() is called
+ *
+ *  \return Returns the number of file descriptors set, 0 on timeout or interruption or -1 on error
+ */
+int tcpIpUringSelect( TcpIpUring *u, int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, uint64_t time_out );
+
+/*! \brief Submit the send chains queued by the writes of the attached sockets in one system call and collect their results
+ *
+ *  The sends do not wait for room in the sockets, so they have completed when the function returns. The result of each chain
+ *  is returned by the next write of its socket (see tcpIpUringSendDone()).
+ *
+ *  \param u Pointer to the io_uring instance. It can be NULL
+ *
+ *  \return Returns the number of send chains completed or -1 on error
+ */
+int tcpIpUringFlushSends( TcpIpUring *u );
+
+/*! \brief Check whether the send chain of an attached socket has completed, and so its next write returns its result
+ *
+ *  \param s Pointer to a TcpIpSocket object
+ *
+ *  \return Returns 1 if the result of a send chain is waiting, 0 otherwise
+ */
+int tcpIpUringSendDone( TcpIpSocket *s );
+
+/*! \brief Read from an attached socket, like recv(). Called by tcpIpSocketReadBufferEx()
+ *
+ *  \return Returns the number of bytes read, 0 on end of file or -1 with errno set (EAGAIN if no data has been received yet)
+ */
+int tcpIpUringRecv( TcpIpSocket *s, char *buf, size_t max_size );
+
+/*! \brief Write to an attached socket, like send(). Called by tcpIpSocketWriteBufferEx()
+ *
+ *  The first call queues a chain of linked send requests for the data, one for each group of TCPROS frames (a 4-byte
+ *  little-endian length followed by the data), and fails with EAGAIN. Once the chain has been submitted (see
+ *  tcpIpUringFlushSends()), the next call with the same data returns the number of bytes sent by the chain.
+ *  The data must not be changed or freed until then.
+ *
+ *  \return Returns the number of bytes sent or -1 with errno set (EAGAIN if the data has been queued or the socket is full)
+ */
+int tcpIpUringSend( TcpIpSocket *s, const char *data, size_t size );
+
+/*! \brief Accept a connection on an attached listening socket, like accept(). Called by tcpIpSocketAccept()
+ *
+ *  \return Returns the file descriptor of the new connection or -1 with errno set (EAGAIN if no connection has been accepted yet)
+ */
+int tcpIpUringAccept( TcpIpSocket *s, struct sockaddr_in *rem_addr );
+
+/*! \brief Remove the requests of a socket from all the io_uring instances before it is closed. Called by tcpIpSocketClose()
+ *         from any thread
+ *
+ *  The requests hold a reference to the socket, so they would keep it open after its file descriptor is closed, and the poll
+ *  requests would watch the old socket if the file descriptor number is assigned to a new one. Only the requests of this file
+ *  descriptor are removed. The send chain queued for the socket is dropped.
+ */
+void tcpIpUringDetachSocket( TcpIpSocket *s );
+
+/*! @}*/
+
+#endif // _TCPIP_URING_H_
@@ -2,6 +2,10 @@
 #define _TCPROS_PROCESS_H_
 
 #include "tcpip_socket.h"
+#include "cros_token_bucket.h"
+#include "cros_clock.h"
+#include "cros_topic_stats.h"
+#include "cros_message.h"
 
 /*! \defgroup tcpros_process TCPROS process */
 
@@ -41,12 +45,14 @@ struct TcprosProcess
   DynString servicerequest_type;        //! The service request type
   DynString serviceresponse_type;       //! The service response type
   DynString md5sum;                     //! The MD5 sum of the message type
+  DynString message_definition;         //! The full text of the message definition sent by the publisher
   DynString caller_id;                  //! The name of subscriber or service caller
   unsigned char latching;               //! If 1, the publisher is sending latched messages. Otherwise 0
   unsigned char tcp_nodelay;            //! If 1, the publisher should set TCP_NODELAY on the socket, if possible. Otherwise 0
   unsigned char persistent;             //! If 1, the service connection should be kept open for multiple requests. Otherwise it should be 0
   DynBuffer packet;                     //! The incoming/outgoing TCPROS packet
-  uint64_t last_change_time;            //! Last state change time (in ms)
+  uint64_t last_change_time;            //! Last state change (or write progress) time (in ms)
+  const CrosClock *clock;               //! Clock used to time the state changes (the clock of the node). NULL: system clock
   int topic_idx;                        //! Index used to associate the process to a publisher or a subscriber
   int service_idx;                      //! Index used to associate the process to a service provider or a service client
   size_t left_to_recv;                  //! Remaining to receive
@@ -54,6 +60,15 @@ struct TcprosProcess
   int probe;							              //! The current session is a probing one
   int sub_tcpros_port;                  //! Port (obtained from a publisher node) to which the process must connect
   char *sub_tcpros_host;                //! Host (obtained from a publisher node) to which the process must connect
+  CrosTokenBucket shaper;               //! Limits the output byte rate of a publisher connection
+  unsigned char shaping_deferred;       //! If 1, the message that must be written has been already deferred (and counted) by the shaper
+  int64_t frame_rx_time_stamp;          //! Kernel reception time (see cRosClockGetTimeStamp()) of the segment where the frame being read starts. 0 if it is not available
+  CrosTopicStats stats;                 //! Statistics of the messages received through a subscriber connection (see cRosNodeSetSubscriberStatistics())
+  DynString filter_expr;                //! Content filter requested by the subscriber of a publisher connection (see cRosNodeSetSubscriberFilter())
+  cRosMessageFilter filter;             //! filter_expr compiled for the messages of the publisher. It is empty if the subscriber requested no filter
+  DynBuffer filtered_batch;             //! Frames that satisfy the filter, waiting for the next publication (only used with a non-empty filter)
+  DynBuffer filtered_packet;            //! Frames that satisfy the filter, being sent instead of the publisher packet (only used with a non-empty filter)
+  DynBuffer shared_packet;              //! Fixed view of the publisher buffer that is being sent with zero-copy instead of packet (see tcprosProcessGetWritePacket()). Its data is NULL when packet is sent
 };
 
 
@@ -76,6 +91,15 @@ void tcprosProcessRelease( TcprosProcess *p );
  */
 void tcprosProcessClear( TcprosProcess *p );
 
+/*! \brief Get the outgoing TCPROS packet of a TcprosProcess object: packet, or shared_packet if the process is sending
+ *         a publisher buffer without copying it
+ *
+ *  \param s Pointer to TcprosProcess object
+ *
+ *  \return The buffer whose remaining data must be written
+ */
+DynBuffer *tcprosProcessGetWritePacket( TcprosProcess *p );
+
 /*! \brief Reset the state and clear all the content of a TcprosProcess object (the
  *         internal memory IS NOT released, so we can continue using the process)
  *
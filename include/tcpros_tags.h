@@ -29,6 +29,7 @@ static TcprosTagStrDim TCPROS_PERSISTENT_TAG = { "persistent=", 11 }; // WARNING
 static TcprosTagStrDim TCPROS_PROBE_TAG = { "probe=", 6 };
 static TcprosTagStrDim TCPROS_ERROR_TAG = { "error=", 6 };
 static TcprosTagStrDim TCPROS_EMPTY_MD5SUM_TAG = { "md5sum=*", 8 };
+static TcprosTagStrDim TCPROS_FILTER_TAG = { "filter=", 7 }; // cROS extension: content filter requested by a subscriber
 
 enum
 {
@@ -46,7 +47,8 @@ enum
   TCPROS_PROBE_FLAG = 0x800,
   TCPROS_EMPTY_MD5SUM_FLAG = 0x1000,
   TCPROS_SERVICE_REQUESTTYPE_FLAG = 0x2000,
-  TCPROS_SERVICE_RESPONSETYPE_FLAG = 0x4000
+  TCPROS_SERVICE_RESPONSETYPE_FLAG = 0x4000,
+  TCPROS_FILTER_FLAG = 0x8000
 };
 
 // http://wiki.ros.org/ROS/TCPROS mentions message_definition as compulsory but
@@ -4,6 +4,7 @@
 #include "tcpip_socket.h"
 #include "xmlrpc_protocol.h"
 #include "cros_api_call.h"
+#include "cros_clock.h"
 
 /*! \defgroup xmlrpc_process XMLRPC process */
 
@@ -39,6 +40,7 @@ struct XmlrpcProcess
     *  (e.g., generated using generateXmlrpcMessage() ) */
   DynString message;
   uint64_t last_change_time;            //! Last state change time (in ms)
+  const CrosClock *clock;               //! Clock used to time the state changes (the clock of the node). NULL: system clock
   char host[256];
   int port;
 };
@@ -0,0 +1,259 @@
+/*! \file content-filter-bench.c
+ *  \brief This file measures the cost of the content filters of the subscribers (see cRosNodeSetSubscriberFilter())
+ *         and the bandwidth that they save.
+ *
+ *  First, it measures the time taken to evaluate several filters on a rosgraph_msgs/Log message and compares it with
+ *  the time taken to serialize the message, which the publisher avoids for each filtered message.
+ *  Then a publisher node publishes a rosgraph_msgs/Log on /filter_bench every PUB_PERIOD ms, cycling through the five
+ *  log levels, to two subscriber nodes, each one run by its own thread: one without filter and one with the filter
+ *  FILTER_EXPR. It prints the messages and bytes received by each subscriber, the messages skipped by the publisher
+ *  and the bandwidth saved, and checks that all the messages received by the filtered subscriber satisfy the filter.
+ *  It needs the ROS master and the message definitions described in sample_utils.h.
+ *
+ *  Usage: content-filter-bench [run period in seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cros.h"
+#include "cros_clock.h"
+#include "cros_thread.h"
+#include "sample_utils.h"
+
+#define N_MATCH_ITERATIONS 2000000 // Num. of evaluations of each filter in the microbenchmark
+#define N_SERIALIZE_ITERATIONS 200000
+#define PUB_PERIOD 1               // Publication period of /filter_bench (in ms)
+#define FILTER_EXPR "level >= 8"   // Filter of the second subscriber: the ERROR and FATAL messages (2 of each 5)
+#define DEFAULT_RUN_SECS 3
+
+typedef struct SubscriberRun SubscriberRun;
+struct SubscriberRun
+{
+  CrosNode *node;
+  cRosMessageFilter check_filter;  // Filter checked on each received message (empty for the subscriber without filter)
+  unsigned long n_rcv_msgs;
+  unsigned long n_not_matching;    // Received messages that do not satisfy check_filter
+};
+
+static const uint8_t Log_levels[] = {1, 2, 4, 8, 16};
+static unsigned long Pub_count = 0;
+static unsigned char Exit_flag;    // Set to 1 to stop the subscriber threads
+
+static void fillLogMessage(cRosMessage *msg, unsigned long count)
+{
+  char name[32], text[201];
+
+  cRosMessageGetField(msg, "level")->data.as_uint8 = Log_levels[count % (sizeof(Log_levels) / sizeof(Log_levels[0]))];
+  snprintf(name, sizeof(name), "robot%lu", count % 10);
+  cRosMessageSetFieldValueString(cRosMessageGetField(msg, "name"), name);
+  memset(text, 'x', sizeof(text) - 1);
+  text[sizeof(text) - 1] = '\0';
+  cRosMessageSetFieldValueString(cRosMessageGetField(msg, "msg"), text);
+  cRosMessageGetField(msg, "line")->data.as_uint32 = (uint32_t)count;
+}
+
+static CallbackResponse callback_pub(cRosMessage *message, void *data_context)
+{
+  fillLogMessage(message, Pub_count++);
+  return 0; // 0=success
+}
+
+static CallbackResponse callback_sub(cRosMessage *message, void *data_context)
+{
+  SubscriberRun *run = (SubscriberRun *)data_context;
+
+  run->n_rcv_msgs++;
+  if(!cRosMessageFilterMatch(&run->check_filter, message))
+    run->n_not_matching++;
+  return 0; // 0=success
+}
+
+static void runSubscriber(void *run_ptr)
+{
+  SubscriberRun *run = (SubscriberRun *)run_ptr;
+  cRosNodeStart(run->node, CROS_INFINITE_TIMEOUT, &Exit_flag);
+}
+
+// Measure the filter evaluation and serialization times. Returns the size of the serialized message, or 0 on error
+static size_t measureFilterCost(const char *path)
+{
+  static const char *filter_exprs[] = {"level >= 8", "name == 'robot3'", "header.stamp.secs > 5"};
+  cRosMessage *msg;
+  cRosMessageField *level_field;
+  cRosMessageFilter filter;
+  DynBuffer buffer;
+  uint64_t start_time, elapsed_time;
+  size_t msg_size;
+  unsigned long n_matches;
+  int expr_ind, iter;
+
+  if(cRosMessageNewBuild(path, "rosgraph_msgs/Log", &msg) != CROS_SUCCESS_ERR_PACK)
+  {
+    printf("The message could not be created; did you run this program one directory above 'rosdb'?\n");
+    return 0;
+  }
+  fillLogMessage(msg, 3);
+  level_field = cRosMessageGetField(msg, "level");
+
+  dynBufferInit(&buffer);
+  start_time = cRosClockGetTimeStamp();
+  for(iter = 0; iter < N_SERIALIZE_ITERATIONS; iter++)
+  {
+    dynBufferClear(&buffer);
+    cRosMessageSerialize(msg, &buffer);
+  }
+  elapsed_time = cRosClockGetTimeStamp() - start_time;
+  msg_size = dynBufferGetSize(&buffer);
+  printf("  %-40s %7.1f ns/msg\n", "serialization (skipped when filtered):", (double)elapsed_time / N_SERIALIZE_ITERATIONS);
+
+  for(expr_ind = 0; expr_ind < (int)(sizeof(filter_exprs) / sizeof(filter_exprs[0])); expr_ind++)
+  {
+    char description[64];
+
+    cRosMessageFilterInit(&filter);
+    if(cRosMessageFilterCompile(&filter, filter_exprs[expr_ind], msg) != CROS_SUCCESS_ERR_PACK)
+    {
+      printf("  the filter '%s' could not be compiled\n", filter_exprs[expr_ind]);
+      msg_size = 0;
+      break;
+    }
+    n_matches = 0;
+    start_time = cRosClockGetTimeStamp();
+    for(iter = 0; iter < N_MATCH_ITERATIONS; iter++)
+    {
+      level_field->data.as_uint8 = Log_levels[iter % (sizeof(Log_levels) / sizeof(Log_levels[0]))];
+      n_matches += cRosMessageFilterMatch(&filter, msg);
+    }
+    elapsed_time = cRosClockGetTimeStamp() - start_time;
+    snprintf(description, sizeof(description), "filter '%s':", filter_exprs[expr_ind]);
+    printf("  %-40s %7.1f ns/msg (%lu matches)\n", description, (double)elapsed_time / N_MATCH_ITERATIONS, n_matches);
+    cRosMessageFilterRelease(&filter);
+  }
+
+  dynBufferRelease(&buffer);
+  cRosMessageFree(msg);
+  return msg_size;
+}
+
+// Returns 0 if the nodes could not be set up
+static int measureBandwidth(const char *path, size_t msg_size, unsigned long run_secs)
+{
+  CrosNode *pub_node;
+  SubscriberRun sub_runs[2];
+  cRosThread sub_threads[2];
+  int sub_started[2];
+  cRosErrCodePack err_cod;
+  unsigned long n_filtered;
+  char node_name[64];
+  int pubidx, subidx, ind, ok = 1;
+
+  pub_node = cRosNodeCreate("/filter_bench_pub", "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+  if(pub_node == NULL)
+    return 0;
+  err_cod = cRosApiRegisterPublisher(pub_node, "/filter_bench", "rosgraph_msgs/Log", PUB_PERIOD, callback_pub, NULL, NULL, &pubidx);
+  if(err_cod != CROS_SUCCESS_ERR_PACK)
+  {
+    cRosPrintErrCodePack(err_cod, "cRosApiRegisterPublisher() failed");
+    cRosNodeDestroy(pub_node);
+    return 0;
+  }
+  // Let the publisher register before the subscribers ask the master for it
+  cRosNodeStart(pub_node, 200, NULL);
+
+  Exit_flag = 0;
+  for(ind = 0; ind < 2; ind++)
+  {
+    SubscriberRun *run = &sub_runs[ind];
+
+    snprintf(node_name, sizeof(node_name), "/filter_bench_sub_%i", ind);
+    run->node = cRosNodeCreate(node_name, "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+    run->n_rcv_msgs = 0;
+    run->n_not_matching = 0;
+    cRosMessageFilterInit(&run->check_filter);
+    sub_started[ind] = 0;
+    if(run->node == NULL)
+      continue;
+    err_cod = cRosApiRegisterSubscriber(run->node, "/filter_bench", "rosgraph_msgs/Log", callback_sub, NULL, run, 0, &subidx);
+    if(ind == 1 && err_cod == CROS_SUCCESS_ERR_PACK)
+    {
+      cRosMessage *msg;
+
+      err_cod = cRosNodeSetSubscriberFilter(run->node, subidx, FILTER_EXPR);
+      if(err_cod == CROS_SUCCESS_ERR_PACK)
+        err_cod = cRosMessageNewBuild(path, "rosgraph_msgs/Log", &msg);
+      if(err_cod == CROS_SUCCESS_ERR_PACK)
+      {
+        err_cod = cRosMessageFilterCompile(&run->check_filter, FILTER_EXPR, msg);
+        cRosMessageFree(msg);
+      }
+    }
+    if(err_cod == CROS_SUCCESS_ERR_PACK)
+      sub_started[ind] = cRosThreadCreate(&sub_threads[ind], runSubscriber, run);
+    else
+      cRosPrintErrCodePack(err_cod, "A subscriber node could not be set up");
+  }
+
+  cRosNodeStart(pub_node, run_secs * 1000, NULL);
+
+  Exit_flag = 1;
+  for(ind = 0; ind < 2; ind++)
+  {
+    if(sub_started[ind])
+      cRosThreadJoin(&sub_threads[ind]);
+    else
+      ok = 0;
+  }
+  cRosNodeGetPublisherFilteredMsgs(pub_node, pubidx, &n_filtered);
+
+  if(ok)
+  {
+    printf("  %-40s %7lu msgs, %8.1f KB/s\n", "subscriber without filter:", sub_runs[0].n_rcv_msgs,
+           (double)sub_runs[0].n_rcv_msgs * msg_size / 1024.0 / run_secs);
+    printf("  %-40s %7lu msgs, %8.1f KB/s (%lu not matching)\n", "subscriber with filter '"FILTER_EXPR"':",
+           sub_runs[1].n_rcv_msgs, (double)sub_runs[1].n_rcv_msgs * msg_size / 1024.0 / run_secs, sub_runs[1].n_not_matching);
+    printf("  %-40s %7lu msgs, %8.1f KB/s saved\n", "skipped by the publisher:", n_filtered,
+           (double)n_filtered * msg_size / 1024.0 / run_secs);
+    if(sub_runs[1].n_not_matching != 0 || n_filtered == 0)
+    {
+      printf("The filtered subscriber received messages that do not satisfy its filter or nothing was filtered\n");
+      ok = 0;
+    }
+  }
+
+  for(ind = 0; ind < 2; ind++)
+  {
+    if(sub_runs[ind].node != NULL)
+      cRosNodeDestroy(sub_runs[ind].node);
+    cRosMessageFilterRelease(&sub_runs[ind].check_filter);
+  }
+  cRosNodeDestroy(pub_node);
+  return ok;
+}
+
+int main(int argc, char **argv)
+{
+  char path[4097];
+  unsigned long run_secs;
+  size_t msg_size;
+
+  run_secs = (argc > 1)? (unsigned long)atoi(argv[1]) : DEFAULT_RUN_SECS;
+  if(run_secs == 0)
+  {
+    printf("Usage: %s [run period in seconds]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  getRosdbPath(path, sizeof(path));
+
+  printf("Cost of the content filters on a rosgraph_msgs/Log message:\n");
+  msg_size = measureFilterCost(path);
+  if(msg_size == 0)
+    return EXIT_FAILURE;
+
+  printf("Bandwidth of a %lu-byte rosgraph_msgs/Log published every %i ms (%lu s):\n", (unsigned long)msg_size, PUB_PERIOD, run_secs);
+  if(!measureBandwidth(path, msg_size, run_secs))
+    return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+/*! \file data-network-test.c
+ *  \brief This file checks that a node with a separate data network (see cRosNodeSetDataHost()) serves its topics on
+ *         the data address, except the topics pinned to the control network (see cRosNodeSetPublisherNetwork()).
+ *
+ *  Two loopback aliases play the role of the two networks of the host: the publisher node uses CONTROL_HOST as node
+ *  host and DATA_HOST as data host. It publishes /data_net_cam on the data network and /data_net_cmd pinned to the
+ *  control network. A subscriber node, run by its own thread, subscribes to both topics. The test checks that both
+ *  topics are received, that the subscriber connected to the expected address for each topic, and, with getsockname(),
+ *  that the publisher side of each connection is bound to that address.
+ *  On Linux all the 127.x.x.x addresses are loopback addresses. On other systems the aliases may have to be created.
+ *  It needs the ROS master and the message definitions described in sample_utils.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+#else
+#  include <sys/socket.h>
+#  include <netinet/in.h>
+#  include <arpa/inet.h>
+#endif
+
+#include "cros.h"
+#include "cros_clock.h"
+#include "cros_thread.h"
+#include "sample_utils.h"
+
+#define CONTROL_HOST "127.0.0.2"   // Node host of the publisher (control network)
+#define DATA_HOST "127.0.0.3"      // Data host of the publisher (data network)
+#define PUB_PERIOD 20              // Publication period of both topics (in ms)
+#define RUN_PERIOD 2000            // Time (in ms) during which the topics are published
+
+static unsigned char Exit_flag;    // Set to 1 to stop the subscriber thread
+
+static CallbackResponse callback_pub(cRosMessage *message, void *data_context)
+{
+  cRosMessageSetFieldValueString(cRosMessageGetField(message, "data"), (const char *)data_context);
+  return 0; // 0=success
+}
+
+static CallbackResponse callback_sub(cRosMessage *message, void *data_context)
+{
+  (*(unsigned long *)data_context)++;
+  return 0; // 0=success
+}
+
+static void runSubscriber(void *node_ptr)
+{
+  cRosNodeStart((CrosNode *)node_ptr, CROS_INFINITE_TIMEOUT, &Exit_flag);
+}
+
+// Returns 1 if the publisher side of a connection of the topic pubidx is bound to local_host, 0 otherwise
+static int publisherConnectionBoundTo(CrosNode *pub_node, int pubidx, const char *local_host)
+{
+  struct sockaddr_in local_addr;
+  socklen_t addr_len;
+  int conn_ind;
+
+  for(conn_ind = 0; conn_ind < CN_MAX_TCPROS_SERVER_CONNECTIONS; conn_ind++)
+  {
+    TcprosProcess *server_proc = &pub_node->tcpros_server_proc[conn_ind];
+
+    if(server_proc->topic_idx != pubidx || !server_proc->socket.connected)
+      continue;
+    addr_len = sizeof(local_addr);
+    if(getsockname(tcpIpSocketGetFD(&server_proc->socket), (struct sockaddr *)&local_addr, &addr_len) != 0)
+      continue;
+    printf("  %s is served on the local address %s:%u\n", pub_node->pubs[pubidx].topic_name,
+           inet_ntoa(local_addr.sin_addr), (unsigned)ntohs(local_addr.sin_port));
+    return strcmp(inet_ntoa(local_addr.sin_addr), local_host) == 0;
+  }
+  return 0;
+}
+
+// Returns 1 if the subscription subidx is connected to a publisher on host, 0 otherwise
+static int subscriberConnectedTo(CrosNode *sub_node, int subidx, const char *host)
+{
+  int conn_ind;
+
+  for(conn_ind = 0; conn_ind < CN_MAX_TCPROS_CLIENT_CONNECTIONS; conn_ind++)
+  {
+    TcprosProcess *client_proc = &sub_node->tcpros_client_proc[conn_ind];
+
+    if(client_proc->topic_idx == subidx && client_proc->sub_tcpros_host != NULL)
+      return strcmp(client_proc->sub_tcpros_host, host) == 0;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  char path[4097];
+  CrosNode *pub_node, *sub_node;
+  cRosThread sub_thread;
+  cRosErrCodePack err_cod;
+  unsigned long n_rcv_cam = 0, n_rcv_cmd = 0;
+  int cam_pubidx, cmd_pubidx, cam_subidx, cmd_subidx;
+
+  getRosdbPath(path, sizeof(path));
+
+  pub_node = cRosNodeCreate("/data_net_test_pub", CONTROL_HOST, ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+  sub_node = cRosNodeCreate("/data_net_test_sub", "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+  if(pub_node == NULL || sub_node == NULL)
+    return EXIT_FAILURE;
+  err_cod = cRosNodeSetDataHost(pub_node, DATA_HOST);
+  if(err_cod != CROS_SUCCESS_ERR_PACK)
+  {
+    cRosPrintErrCodePack(err_cod, "cRosNodeSetDataHost() failed; is "DATA_HOST" a local address?");
+    return EXIT_FAILURE;
+  }
+  err_cod = cRosApiRegisterPublisher(pub_node, "/data_net_cam", "std_msgs/String", PUB_PERIOD, callback_pub, NULL, "frame", &cam_pubidx);
+  err_cod = cRosAddErrCodePackIfErr(err_cod, cRosApiRegisterPublisher(pub_node, "/data_net_cmd", "std_msgs/String", PUB_PERIOD, callback_pub, NULL, "stop", &cmd_pubidx));
+  if(err_cod == CROS_SUCCESS_ERR_PACK)
+    err_cod = cRosNodeSetPublisherNetwork(pub_node, cmd_pubidx, CROS_TOPIC_NETWORK_CONTROL);
+  if(err_cod != CROS_SUCCESS_ERR_PACK)
+  {
+    cRosPrintErrCodePack(err_cod, "The publishers could not be set up; did you run this program one directory above 'rosdb'?");
+    return EXIT_FAILURE;
+  }
+  // Let the publishers register before the subscribers ask the master for them
+  cRosNodeStart(pub_node, 200, NULL);
+  err_cod = cRosApiRegisterSubscriber(sub_node, "/data_net_cam", "std_msgs/String", callback_sub, NULL, &n_rcv_cam, 0, &cam_subidx);
+  err_cod = cRosAddErrCodePackIfErr(err_cod, cRosApiRegisterSubscriber(sub_node, "/data_net_cmd", "std_msgs/String", callback_sub, NULL, &n_rcv_cmd, 0, &cmd_subidx));
+  if(err_cod != CROS_SUCCESS_ERR_PACK)
+  {
+    cRosPrintErrCodePack(err_cod, "cRosApiRegisterSubscriber() failed");
+    return EXIT_FAILURE;
+  }
+  Exit_flag = 0;
+  if(!cRosThreadCreate(&sub_thread, runSubscriber, sub_node))
+    return EXIT_FAILURE;
+
+  printf("Publishing /data_net_cam on the data network (%s) and /data_net_cmd on the control network (%s) for %i ms:\n",
+         DATA_HOST, CONTROL_HOST, RUN_PERIOD);
+  cRosNodeStart(pub_node, RUN_PERIOD, NULL);
+  Exit_flag = 1;
+  cRosThreadJoin(&sub_thread);
+
+  printf("  received %lu messages of /data_net_cam and %lu of /data_net_cmd\n", n_rcv_cam, n_rcv_cmd);
+  check(n_rcv_cam > 0 && n_rcv_cmd > 0, "both topics are received");
+  check(subscriberConnectedTo(sub_node, cam_subidx, DATA_HOST), "the subscriber of /data_net_cam connects to the data host");
+  check(subscriberConnectedTo(sub_node, cmd_subidx, CONTROL_HOST), "the subscriber of /data_net_cmd connects to the control host");
+  check(publisherConnectionBoundTo(pub_node, cam_pubidx, DATA_HOST), "the publisher serves /data_net_cam from the data host");
+  check(publisherConnectionBoundTo(pub_node, cmd_pubidx, CONTROL_HOST), "the publisher serves /data_net_cmd from the control host");
+
+  cRosNodeDestroy(sub_node);
+  cRosNodeDestroy(pub_node);
+
+  return checksExitStatus();
+}
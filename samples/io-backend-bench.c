@@ -0,0 +1,301 @@
+/*! \file io-backend-bench.c
+ *  \brief This file compares the select() backend of the event loop with the io_uring backend (see tcpip_uring.h).
+ *
+ *  It opens a number of TCP connections on the loopback interface and measures with each backend:
+ *  - The cost of a wait: only one connection carries data. Its client writes one byte, the server side is waited for
+ *    together with the other (idle) server sockets, and the byte is read. With io_uring this is measured with the server
+ *    sockets polled and with them attached with TCPIP_URING_OP_RECV, so that the byte is received in advance into a
+ *    provided buffer. It is done with all the connections and then with the active connection only.
+ *  - The cost of a fan-out: a message of FANOUT_FRAMES TCPROS frames is written to each of FANOUT_CONNECTIONS connections
+ *    and read by their clients. With io_uring the server sockets are attached with TCPIP_URING_OP_SEND_FRAMES, so the
+ *    frames of all the connections are sent as chains of linked send requests in one system call.
+ *  - The cost of accepting a connection: a client connects, the listener is waited for and the connection is accepted
+ *    and closed. With io_uring the listener is attached with TCPIP_URING_OP_ACCEPT, so the connections are accepted by a
+ *    multishot accept request.
+ *  The mean time of a round is printed for each case. cROS must be built with the CMake option CROS_USE_IO_URING to measure
+ *  the io_uring backend.
+ *
+ *  Usage: io-backend-bench [number of connections] [number of rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tcpip_socket.h"
+#include "tcpip_uring.h"
+#include "cros_clock.h"
+
+#define DEFAULT_N_CONNECTIONS 400 // Each connection uses two file descriptors, which must be below FD_SETSIZE
+#define DEFAULT_N_ROUNDS 20000
+#define FANOUT_CONNECTIONS 32     // Connections written in each fan-out round
+#define FANOUT_FRAMES 16          // TCPROS frames of the message written to each connection
+#define FANOUT_FRAME_SIZE 256     // Size of the data of each frame (without its 4-byte length)
+#define ACCEPT_ROUNDS_DIVISOR 10  // The accept rounds are slower, so fewer are made
+
+static TcpIpSocket Client_sockets[FD_SETSIZE/2], Server_sockets[FD_SETSIZE/2];
+static TcpIpSocket Fanout_client_sockets[FANOUT_CONNECTIONS], Fanout_server_sockets[FANOUT_CONNECTIONS];
+
+static double elapsedUSec( uint64_t start_time )
+{
+  return cRosClockTimeStampToUSec( cRosClockGetTimeStamp() ) - cRosClockTimeStampToUSec( start_time );
+}
+
+// Open n_conns connections to the listener. Returns 0 on success
+static int openConnections( TcpIpSocket *listener, TcpIpSocket *clients, TcpIpSocket *servers, int n_conns )
+{
+  int conn;
+
+  for( conn = 0; conn < n_conns; conn++ )
+  {
+    tcpIpSocketInit( &clients[conn] );
+    tcpIpSocketInit( &servers[conn] );
+    if( !tcpIpSocketOpen( &clients[conn] ) ||
+        tcpIpSocketConnect( &clients[conn], "127.0.0.1", tcpIpSocketGetPort( listener ) ) != TCPIPSOCKET_DONE ||
+        tcpIpSocketAccept( listener, &servers[conn] ) != TCPIPSOCKET_DONE ||
+        !tcpIpSocketSetNonBlocking( &servers[conn] ) )
+    {
+      printf( "Connection %i could not be opened\n", conn );
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// Returns the mean time of a round in usec or a negative value on error
+static double measureWait( TcpIpUring *u, int n_conns, int n_rounds )
+{
+  DynBuffer out_buf, in_buf;
+  uint64_t start_time;
+  int round, conn, n_failed = 0;
+
+  dynBufferInit( &out_buf );
+  dynBufferInit( &in_buf );
+  start_time = cRosClockGetTimeStamp();
+  for( round = 0; round < n_rounds && n_failed == 0; round++ )
+  {
+    fd_set r_fds;
+    int nfds = 0, n_set;
+
+    dynBufferClear( &out_buf );
+    dynBufferPushBackUInt8( &out_buf, (uint8_t)round );
+    if( tcpIpSocketWriteBuffer( &Client_sockets[0], &out_buf ) != TCPIPSOCKET_DONE )
+      n_failed++;
+
+    FD_ZERO( &r_fds );
+    for( conn = 0; conn < n_conns; conn++ )
+    {
+      int fd = tcpIpSocketGetFD( &Server_sockets[conn] );
+      FD_SET( fd, &r_fds );
+      if( fd > nfds ) nfds = fd;
+    }
+    n_set = tcpIpUringSelect( u, nfds + 1, &r_fds, NULL, NULL, 1000 );
+    if( n_set != 1 || !FD_ISSET( tcpIpSocketGetFD( &Server_sockets[0] ), &r_fds ) )
+      n_failed++;
+
+    dynBufferClear( &in_buf );
+    if( tcpIpSocketReadBuffer( &Server_sockets[0], &in_buf ) != TCPIPSOCKET_DONE || dynBufferGetSize( &in_buf ) != 1 )
+      n_failed++;
+  }
+  dynBufferRelease( &out_buf );
+  dynBufferRelease( &in_buf );
+
+  if( n_failed > 0 )
+    return -1.0;
+  return elapsedUSec( start_time ) / n_rounds;
+}
+
+// Returns the mean time of a round in usec or a negative value on error. If u is not NULL, the server sockets must be
+// attached to it with TCPIP_URING_OP_SEND_FRAMES
+static double measureFanOut( TcpIpUring *u, int n_rounds )
+{
+  DynBuffer msg_bufs[FANOUT_CONNECTIONS], in_buf;
+  unsigned char frame[4 + FANOUT_FRAME_SIZE];
+  size_t msg_size = FANOUT_FRAMES * sizeof(frame);
+  uint64_t start_time;
+  int round, conn, i, n_failed = 0;
+
+  memset( frame, 'f', sizeof(frame) );
+  frame[0] = FANOUT_FRAME_SIZE & 0xFF; // Little-endian length of the frame data
+  frame[1] = (FANOUT_FRAME_SIZE >> 8) & 0xFF;
+  frame[2] = frame[3] = 0;
+  for( conn = 0; conn < FANOUT_CONNECTIONS; conn++ )
+  {
+    dynBufferInit( &msg_bufs[conn] );
+    for( i = 0; i < FANOUT_FRAMES; i++ )
+      dynBufferPushBackBuf( &msg_bufs[conn], frame, sizeof(frame) );
+  }
+  dynBufferInit( &in_buf );
+
+  start_time = cRosClockGetTimeStamp();
+  for( round = 0; round < n_rounds && n_failed == 0; round++ )
+  {
+    int n_pending = 0;
+
+    for( conn = 0; conn < FANOUT_CONNECTIONS; conn++ )
+    {
+      dynBufferRewindPoseIndicator( &msg_bufs[conn] );
+      if( tcpIpSocketWriteBuffer( &Fanout_server_sockets[conn], &msg_bufs[conn] ) == TCPIPSOCKET_IN_PROGRESS )
+        n_pending++; // Queued as a send chain
+    }
+    // All the queued chains are submitted together and the writes collect their results
+    while( n_pending > 0 && n_failed == 0 )
+    {
+      if( tcpIpUringFlushSends( u ) < 0 )
+        n_failed++;
+      n_pending = 0;
+      for( conn = 0; conn < FANOUT_CONNECTIONS; conn++ )
+      {
+        if( dynBufferGetRemainingDataSize( &msg_bufs[conn] ) > 0 &&
+            tcpIpSocketWriteBuffer( &Fanout_server_sockets[conn], &msg_bufs[conn] ) == TCPIPSOCKET_IN_PROGRESS )
+          n_pending++;
+      }
+    }
+
+    for( conn = 0; conn < FANOUT_CONNECTIONS && n_failed == 0; conn++ )
+    {
+      dynBufferClear( &in_buf );
+      while( dynBufferGetSize( &in_buf ) < msg_size && n_failed == 0 )
+      {
+        size_t n_reads;
+        if( tcpIpSocketReadBufferEx( &Fanout_client_sockets[conn], &in_buf, msg_size - dynBufferGetSize( &in_buf ), &n_reads ) != TCPIPSOCKET_DONE )
+          n_failed++;
+      }
+      if( memcmp( dynBufferGetData( &in_buf ), dynBufferGetData( &msg_bufs[conn] ), msg_size ) != 0 )
+        n_failed++;
+    }
+  }
+  for( conn = 0; conn < FANOUT_CONNECTIONS; conn++ )
+    dynBufferRelease( &msg_bufs[conn] );
+  dynBufferRelease( &in_buf );
+
+  if( n_failed > 0 )
+    return -1.0;
+  return elapsedUSec( start_time ) / n_rounds;
+}
+
+// Returns the mean time of a round in usec or a negative value on error
+static double measureAccept( TcpIpUring *u, int n_rounds )
+{
+  TcpIpSocket listener, client, server;
+  uint64_t start_time;
+  int round, n_failed = 0;
+
+  tcpIpSocketInit( &listener );
+  if( !tcpIpSocketOpen( &listener ) || !tcpIpSocketSetNonBlocking( &listener ) ||
+      !tcpIpSocketBindListen( &listener, "127.0.0.1", 0, 16 ) )
+  {
+    tcpIpSocketClose( &listener );
+    return -1.0;
+  }
+  if( u != NULL && (!tcpIpUringAttachSocket( u, &listener, TCPIP_URING_OP_ACCEPT ) || !(listener.uring_ops & TCPIP_URING_OP_ACCEPT)) )
+  {
+    printf( "  (multishot accept is not supported: the listener is polled)\n" );
+  }
+
+  start_time = cRosClockGetTimeStamp();
+  for( round = 0; round < n_rounds && n_failed == 0; round++ )
+  {
+    fd_set r_fds;
+    int listener_fd = tcpIpSocketGetFD( &listener );
+
+    tcpIpSocketInit( &client );
+    tcpIpSocketInit( &server );
+    if( !tcpIpSocketOpen( &client ) ||
+        tcpIpSocketConnect( &client, "127.0.0.1", tcpIpSocketGetPort( &listener ) ) != TCPIPSOCKET_DONE )
+      n_failed++;
+
+    FD_ZERO( &r_fds );
+    FD_SET( listener_fd, &r_fds );
+    if( tcpIpUringSelect( u, listener_fd + 1, &r_fds, NULL, NULL, 1000 ) != 1 ||
+        tcpIpSocketAccept( &listener, &server ) != TCPIPSOCKET_DONE )
+      n_failed++;
+
+    tcpIpSocketClose( &server );
+    tcpIpSocketClose( &client );
+  }
+  tcpIpSocketClose( &listener );
+
+  if( n_failed > 0 )
+    return -1.0;
+  return elapsedUSec( start_time ) / n_rounds;
+}
+
+int main( int argc, char **argv )
+{
+  TcpIpSocket listener;
+  TcpIpUring *u;
+  int n_conns, n_rounds, conn;
+
+  n_conns = (argc > 1)? atoi( argv[1] ) : DEFAULT_N_CONNECTIONS;
+  n_rounds = (argc > 2)? atoi( argv[2] ) : DEFAULT_N_ROUNDS;
+  if( n_conns < 1 || n_conns > FD_SETSIZE/2 - FANOUT_CONNECTIONS - 8 || n_rounds < ACCEPT_ROUNDS_DIVISOR )
+  {
+    printf( "Usage: %s [number of connections (1-%i)] [number of rounds (%i or more)]\n", argv[0],
+            FD_SETSIZE/2 - FANOUT_CONNECTIONS - 8, ACCEPT_ROUNDS_DIVISOR );
+    return EXIT_FAILURE;
+  }
+
+  tcpIpSocketStartUp();
+  tcpIpSocketInit( &listener );
+  if( !tcpIpSocketOpen( &listener ) || !tcpIpSocketBindListen( &listener, "127.0.0.1", 0, n_conns + FANOUT_CONNECTIONS ) )
+  {
+    printf( "The listener socket could not be opened\n" );
+    return EXIT_FAILURE;
+  }
+  if( openConnections( &listener, Client_sockets, Server_sockets, n_conns ) != 0 ||
+      openConnections( &listener, Fanout_client_sockets, Fanout_server_sockets, FANOUT_CONNECTIONS ) != 0 )
+    return EXIT_FAILURE;
+
+  u = tcpIpUringCreate();
+  printf( "Mean time of a round (write, wait and read one byte) over %i rounds:\n", n_rounds );
+  printf( "  %i connections, select():         %8.2f us\n", n_conns, measureWait( NULL, n_conns, n_rounds ) );
+  if( u != NULL )
+    printf( "  %i connections, io_uring polls:   %8.2f us\n", n_conns, measureWait( u, n_conns, n_rounds ) );
+  printf( "  1 connection, select():           %8.2f us\n", measureWait( NULL, 1, n_rounds ) );
+  if( u != NULL )
+  {
+    printf( "  1 connection, io_uring polls:     %8.2f us\n", measureWait( u, 1, n_rounds ) );
+    for( conn = 0; conn < n_conns; conn++ )
+      tcpIpUringAttachSocket( u, &Server_sockets[conn], TCPIP_URING_OP_RECV );
+    if( Server_sockets[0].uring_ops & TCPIP_URING_OP_RECV )
+    {
+      printf( "  %i connections, io_uring RECV:    %8.2f us\n", n_conns, measureWait( u, n_conns, n_rounds ) );
+      printf( "  1 connection, io_uring RECV:      %8.2f us\n", measureWait( u, 1, n_rounds ) );
+    }
+    else
+      printf( "  The kernel does not support provided buffer rings: RECV not measured\n" );
+  }
+
+  printf( "Mean time of a fan-out round (write %i frames of %i bytes to %i connections and read them) over %i rounds:\n",
+          FANOUT_FRAMES, FANOUT_FRAME_SIZE, FANOUT_CONNECTIONS, n_rounds );
+  printf( "  select() backend, one send() per connection:  %8.2f us\n", measureFanOut( NULL, n_rounds ) );
+  if( u != NULL )
+  {
+    for( conn = 0; conn < FANOUT_CONNECTIONS; conn++ )
+      tcpIpUringAttachSocket( u, &Fanout_server_sockets[conn], TCPIP_URING_OP_SEND_FRAMES );
+    printf( "  io_uring, linked send chains:                 %8.2f us\n", measureFanOut( u, n_rounds ) );
+  }
+
+  printf( "Mean time of an accept round (connect, wait, accept and close) over %i rounds:\n", n_rounds / ACCEPT_ROUNDS_DIVISOR );
+  printf( "  select(), accept():          %8.2f us\n", measureAccept( NULL, n_rounds / ACCEPT_ROUNDS_DIVISOR ) );
+  if( u != NULL )
+    printf( "  io_uring, multishot accept:  %8.2f us\n", measureAccept( u, n_rounds / ACCEPT_ROUNDS_DIVISOR ) );
+  else
+    printf( "io_uring is not available: build cROS with the CMake option CROS_USE_IO_URING on a Linux kernel that supports it\n" );
+
+  for( conn = 0; conn < n_conns; conn++ )
+  {
+    tcpIpSocketClose( &Client_sockets[conn] );
+    tcpIpSocketClose( &Server_sockets[conn] );
+  }
+  for( conn = 0; conn < FANOUT_CONNECTIONS; conn++ )
+  {
+    tcpIpSocketClose( &Fanout_client_sockets[conn] );
+    tcpIpSocketClose( &Fanout_server_sockets[conn] );
+  }
+  tcpIpUringDestroy( u );
+  tcpIpSocketClose( &listener );
+  tcpIpSocketCleanUp();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+/*! \file node-startup-bench.c
+ *  \brief This file measures the start-up time of a node with and without its built-in publisher and services
+ *         (see cRosNodeSetBuiltins()).
+ *
+ *  For each configuration it creates and destroys N_NODES nodes, one after the other. Each node registers a
+ *  publisher and runs its event loop until the master has answered all its registration calls. The mean time taken
+ *  by cRosNodeCreate() and the mean time from the creation of the node until the publisher is registered are printed.
+ *  It needs the ROS master and the message definitions described in sample_utils.h.
+ *
+ *  Usage: node-startup-bench [number of nodes per configuration]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cros.h"
+#include "cros_clock.h"
+#include "sample_utils.h"
+
+#define DEFAULT_N_NODES 20
+#define REGISTRATION_TIME_OUT 5000 // Max time (in ms) waited for the registration of a node
+
+static CallbackResponse callback_pub(cRosMessage *message, void *data_context)
+{
+  cRosMessageSetFieldValueString(cRosMessageGetField(message, "data"), "hello");
+  return 0; // 0=success
+}
+
+// Returns 1 when the node has no pending or running call to the master
+static int masterCallsDone(CrosNode *node)
+{
+  return isQueueEmpty(&node->master_api_queue) && node->xmlrpc_client_proc[0].state == XMLRPC_PROCESS_STATE_IDLE;
+}
+
+// Returns 1 on success, 0 if a node could not be created or registered
+static int measureStartUp(const char *path, const char *config_name, unsigned int builtins, int n_nodes)
+{
+  double create_time_sum = 0.0, registration_time_sum = 0.0;
+  int node_ind;
+
+  for(node_ind = 0; node_ind < n_nodes; node_ind++)
+  {
+    CrosNode *node;
+    uint64_t start_time, create_time, registration_time;
+    int pubidx;
+
+    start_time = cRosClockGetTimeStamp();
+    node = cRosNodeCreate("/startup_bench", "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+    create_time = cRosClockGetTimeStamp();
+    if(node == NULL)
+      return 0;
+    cRosNodeSetBuiltins(node, builtins);
+    if(cRosApiRegisterPublisher(node, "/startup_bench", "std_msgs/String", 100, callback_pub, NULL, NULL, &pubidx) != CROS_SUCCESS_ERR_PACK)
+    {
+      cRosNodeDestroy(node);
+      return 0;
+    }
+    do
+      cRosNodeDoEventsLoop(node, 10);
+    while(!masterCallsDone(node) && cRosClockTimeStampToUSec(cRosClockGetTimeStamp() - start_time) < REGISTRATION_TIME_OUT * 1000);
+    registration_time = cRosClockGetTimeStamp();
+    if(!masterCallsDone(node))
+    {
+      cRosNodeDestroy(node);
+      return 0;
+    }
+    create_time_sum += cRosClockTimeStampToUSec(create_time - start_time);
+    registration_time_sum += cRosClockTimeStampToUSec(registration_time - start_time);
+    cRosNodeDestroy(node);
+  }
+  printf("  %-24s cRosNodeCreate(): %7.0f us, creation to publisher registered: %7.0f us\n", config_name,
+         create_time_sum / n_nodes, registration_time_sum / n_nodes);
+  return 1;
+}
+
+int main(int argc, char **argv)
+{
+  char path[4097];
+  int n_nodes;
+
+  n_nodes = (argc > 1)? atoi(argv[1]) : DEFAULT_N_NODES;
+  if(n_nodes < 1)
+  {
+    printf("Usage: %s [number of nodes per configuration]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  getRosdbPath(path, sizeof(path));
+
+  printf("Mean start-up time of a node with one publisher (%i nodes per configuration):\n", n_nodes);
+  if(!measureStartUp(path, "all the built-ins:", CROS_BUILTIN_ALL, n_nodes) ||
+     !measureStartUp(path, "logger services only:", CROS_BUILTIN_LOGGER_SERVICES, n_nodes) ||
+     !measureStartUp(path, "no built-ins:", CROS_BUILTIN_NONE, n_nodes))
+  {
+    printf("A node could not be created or registered; is the master running?\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
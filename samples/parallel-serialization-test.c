@@ -0,0 +1,255 @@
+/*! \file parallel-serialization-test.c
+ *  \brief This file checks that the parallel (de)serialization of large arrays of messages (see
+ *         cRosMessageParallelismSet()) produces exactly the same bytes as the sequential one, and measures it.
+ *
+ *  Three messages are tested: a large trajectory_msgs/JointTrajectory, a large message of a custom type (defined in
+ *  this file) that mixes arrays of variable and fixed length, strings, time fields and nested messages, and a small
+ *  and an empty trajectory. For each number of threads (2, 4, 8 and 16) each message is serialized sequentially and in
+ *  parallel, the parallel output is deserialized in parallel and serialized again, and the three buffers are
+ *  compared byte by byte. The time taken by each (de)serialization is printed. The arrays are (de)serialized in
+ *  parallel whatever their size, so these times show whether CROS_MSG_DEFAULT_PARALLEL_MIN_SIZE suits the host.
+ *  No master is needed. The program must be run one directory above 'rosdb'.
+ *
+ *  Usage: parallel-serialization-test [number of trajectory points]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cros.h"
+#include "cros_clock.h"
+#include "sample_utils.h"
+
+#define DEFAULT_N_POINTS 50000
+#define MIN_PARALLEL_SIZE 1        // Min. serialized size (in bytes) of an array to (de)serialize it in parallel: all the arrays
+
+#define SECTION_SEPARATOR "================================================================================\n"
+
+// Full text of the custom message type: the main type followed by the types it depends on
+static const char Outer_full_text[] =
+  "string name\n"
+  "Inner[] items\n"
+  "int32 last\n"
+  SECTION_SEPARATOR
+  "MSG: partest/Inner\n"
+  "Header header\n"
+  "string label\n"
+  "float64[] values\n"
+  "time t\n"
+  "Leaf[] leaves\n"
+  "Leaf[2] pair\n"
+  "uint8[3] rgb\n"
+  "string[] notes\n"
+  SECTION_SEPARATOR
+  "MSG: std_msgs/Header\n"
+  "uint32 seq\n"
+  "time stamp\n"
+  "string frame_id\n"
+  SECTION_SEPARATOR
+  "MSG: partest/Leaf\n"
+  "uint32 id\n"
+  "string tag\n";
+
+static int getFieldIndex(cRosMessage *msg, const char *field_name)
+{
+  int field_ind;
+
+  for(field_ind = 0; field_ind < msg->n_fields; field_ind++)
+    if(strcmp(msg->fields[field_ind]->name, field_name) == 0)
+      return field_ind;
+  return -1;
+}
+
+static cRosMessage *newMessage(const char *path, const char *msg_type)
+{
+  cRosMessage *msg;
+  cRosErrCodePack err_cod;
+
+  if(path != NULL)
+    err_cod = cRosMessageNewBuild(path, msg_type, &msg);
+  else
+    err_cod = cRosMessageNewBuildFromText(msg_type, Outer_full_text, &msg);
+  if(err_cod != CROS_SUCCESS_ERR_PACK)
+  {
+    cRosPrintErrCodePack(err_cod, "The message could not be created; did you run this program one directory above 'rosdb'?");
+    return NULL;
+  }
+  return msg;
+}
+
+static cRosMessage *newTrajectory(const char *path, int n_points)
+{
+  cRosMessage *msg, *point;
+  char joint_name[16];
+  int point_ind, joint_ind;
+
+  msg = newMessage(path, "trajectory_msgs/JointTrajectory");
+  if(msg == NULL)
+    return NULL;
+  for(joint_ind = 0; joint_ind < 6; joint_ind++)
+  {
+    snprintf(joint_name, sizeof(joint_name), "joint_%i", joint_ind);
+    cRosMessageFieldArrayPushBackString(cRosMessageGetField(msg, "joint_names"), joint_name);
+  }
+  cRosMessageSetFieldValueString(cRosMessageGetField(cRosMessageGetField(msg, "header")->data.as_msg, "frame_id"), "base");
+  for(point_ind = 0; point_ind < n_points; point_ind++)
+  {
+    cRosMessageFieldArrayPushBackZero(msg, getFieldIndex(msg, "points"));
+    point = cRosMessageFieldArrayAtMsgGet(cRosMessageGetField(msg, "points"), point_ind);
+    for(joint_ind = 0; joint_ind < 6; joint_ind++)
+    {
+      cRosMessageFieldArrayPushBackFloat64(cRosMessageGetField(point, "positions"), point_ind * 0.1 + joint_ind);
+      cRosMessageFieldArrayPushBackFloat64(cRosMessageGetField(point, "velocities"), joint_ind * 0.5);
+      if(point_ind % 3 == 0) // Arrays of different lengths in each element
+        cRosMessageFieldArrayPushBackFloat64(cRosMessageGetField(point, "accelerations"), -joint_ind);
+    }
+    cRosMessageGetField(cRosMessageGetField(point, "time_from_start")->data.as_msg, "secs")->data.as_int32 = point_ind;
+  }
+  return msg;
+}
+
+static cRosMessage *newOuter(int n_items)
+{
+  cRosMessage *msg, *item, *leaf;
+  char label[64];
+  int item_ind, elem_ind;
+
+  msg = newMessage(NULL, "partest/Outer");
+  if(msg == NULL)
+    return NULL;
+  cRosMessageSetFieldValueString(cRosMessageGetField(msg, "name"), "outer");
+  cRosMessageGetField(msg, "last")->data.as_int32 = -7;
+  for(item_ind = 0; item_ind < n_items; item_ind++)
+  {
+    cRosMessageFieldArrayPushBackZero(msg, getFieldIndex(msg, "items"));
+    item = cRosMessageFieldArrayAtMsgGet(cRosMessageGetField(msg, "items"), item_ind);
+    snprintf(label, sizeof(label), "item %i %s", item_ind, (item_ind % 5)? "x" : "longer label here");
+    cRosMessageSetFieldValueString(cRosMessageGetField(item, "label"), label);
+    if(item_ind % 7)
+      cRosMessageSetFieldValueString(cRosMessageGetField(cRosMessageGetField(item, "header")->data.as_msg, "frame_id"), "f");
+    for(elem_ind = 0; elem_ind < item_ind % 4; elem_ind++)
+      cRosMessageFieldArrayPushBackFloat64(cRosMessageGetField(item, "values"), item_ind + elem_ind);
+    for(elem_ind = 0; elem_ind < item_ind % 3; elem_ind++)
+    {
+      cRosMessageFieldArrayPushBackZero(item, getFieldIndex(item, "leaves"));
+      leaf = cRosMessageFieldArrayAtMsgGet(cRosMessageGetField(item, "leaves"), elem_ind);
+      cRosMessageGetField(leaf, "id")->data.as_uint32 = elem_ind;
+      cRosMessageSetFieldValueString(cRosMessageGetField(leaf, "tag"), (elem_ind)? "t" : "");
+    }
+    cRosMessageSetFieldValueString(cRosMessageGetField(cRosMessageFieldArrayAtMsgGet(cRosMessageGetField(item, "pair"), 1), "tag"), "p");
+    *cRosMessageFieldArrayAtUInt8(cRosMessageGetField(item, "rgb"), item_ind % 3) = (uint8_t)item_ind;
+    if(item_ind % 2)
+      cRosMessageFieldArrayPushBackString(cRosMessageGetField(item, "notes"), "note");
+    cRosMessageGetField(cRosMessageGetField(item, "t")->data.as_msg, "nsecs")->data.as_uint32 = item_ind;
+  }
+  return msg;
+}
+
+static int sameContent(DynBuffer *buf_a, DynBuffer *buf_b)
+{
+  return buf_a->size == buf_b->size && memcmp(buf_a->data, buf_b->data, buf_a->size) == 0;
+}
+
+// Serialize msg sequentially and with n_threads, deserialize the parallel output in parallel, serialize it again and
+// compare the three outputs
+static void testMessage(const char *msg_name, cRosMessage *msg, const char *path, const char *msg_type, int n_threads, size_t min_size)
+{
+  DynBuffer seq_buf, par_buf, reser_buf;
+  cRosMessage *par_msg, *seq_msg;
+  cRosMessageParallelism par;
+  cRosErrCodePack err_cod;
+  uint64_t ser_seq_time, ser_par_time, deser_seq_time, deser_par_time, start_time;
+  char description[128];
+  int identical;
+
+  dynBufferInit(&seq_buf);
+  dynBufferInit(&par_buf);
+  dynBufferInit(&reser_buf);
+  par_msg = newMessage(path, msg_type);
+  seq_msg = newMessage(path, msg_type);
+  if(par_msg == NULL || seq_msg == NULL)
+  {
+    N_failed_checks++;
+    return;
+  }
+
+  start_time = cRosClockGetTimeStamp();
+  err_cod = cRosMessageSerialize(msg, &seq_buf);
+  ser_seq_time = cRosClockGetTimeStamp() - start_time;
+  // The first deserialization allocates the arrays, so only the second one (which reuses them) is measured
+  err_cod = cRosAddErrCodePackIfErr(err_cod, cRosMessageDeserialize(seq_msg, &seq_buf));
+  dynBufferRewindPoseIndicator(&seq_buf);
+  start_time = cRosClockGetTimeStamp();
+  err_cod = cRosAddErrCodePackIfErr(err_cod, cRosMessageDeserialize(seq_msg, &seq_buf));
+  deser_seq_time = cRosClockGetTimeStamp() - start_time;
+
+  cRosMessageParallelismInit(&par);
+  if(!cRosMessageParallelismSet(&par, n_threads, min_size))
+    err_cod = cRosAddErrCodePackIfErr(err_cod, CROS_SER_THREADS_ERR);
+  start_time = cRosClockGetTimeStamp();
+  err_cod = cRosAddErrCodePackIfErr(err_cod, cRosMessageSerializeParallel(msg, &par_buf, &par));
+  ser_par_time = cRosClockGetTimeStamp() - start_time;
+  err_cod = cRosAddErrCodePackIfErr(err_cod, cRosMessageDeserializeParallel(par_msg, &par_buf, &par));
+  dynBufferRewindPoseIndicator(&par_buf);
+  start_time = cRosClockGetTimeStamp();
+  err_cod = cRosAddErrCodePackIfErr(err_cod, cRosMessageDeserializeParallel(par_msg, &par_buf, &par));
+  deser_par_time = cRosClockGetTimeStamp() - start_time;
+  err_cod = cRosAddErrCodePackIfErr(err_cod, cRosMessageSerializeParallel(par_msg, &reser_buf, &par));
+  cRosMessageParallelismRelease(&par);
+
+  identical = err_cod == CROS_SUCCESS_ERR_PACK && sameContent(&seq_buf, &par_buf) && sameContent(&seq_buf, &reser_buf) &&
+              dynBufferGetRemainingDataSize(&par_buf) == 0;
+  snprintf(description, sizeof(description), "%-6s %2i threads %9lu bytes: ser. %7.2f / %7.2f ms, deser. %7.2f / %7.2f ms",
+           msg_name, n_threads, (unsigned long)seq_buf.size, ser_seq_time / 1e6, ser_par_time / 1e6,
+           deser_seq_time / 1e6, deser_par_time / 1e6);
+  printf("  %-90s %s\n", description, (identical)? "identical" : "MISMATCH");
+  if(!identical)
+    N_failed_checks++;
+
+  cRosMessageFree(par_msg);
+  cRosMessageFree(seq_msg);
+  dynBufferRelease(&seq_buf);
+  dynBufferRelease(&par_buf);
+  dynBufferRelease(&reser_buf);
+}
+
+int main(int argc, char **argv)
+{
+  char path[4097];
+  cRosMessage *large_traj, *outer, *small_traj, *empty_traj;
+  int n_points, n_threads;
+
+  n_points = (argc > 1)? atoi(argv[1]) : DEFAULT_N_POINTS;
+  if(n_points < 1)
+  {
+    printf("Usage: %s [number of trajectory points]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  getRosdbPath(path, sizeof(path));
+
+  large_traj = newTrajectory(path, n_points);
+  outer = newOuter(n_points / 5);
+  small_traj = newTrajectory(path, 3);
+  empty_traj = newTrajectory(path, 0);
+  if(large_traj == NULL || outer == NULL || small_traj == NULL || empty_traj == NULL)
+    return EXIT_FAILURE;
+
+  printf("Sequential / parallel serialization and deserialization times (%i trajectory points):\n", n_points);
+  for(n_threads = 2; n_threads <= 16; n_threads *= 2)
+  {
+    testMessage("traj", large_traj, path, "trajectory_msgs/JointTrajectory", n_threads, MIN_PARALLEL_SIZE);
+    testMessage("outer", outer, NULL, "partest/Outer", n_threads, MIN_PARALLEL_SIZE);
+    testMessage("small", small_traj, path, "trajectory_msgs/JointTrajectory", n_threads, MIN_PARALLEL_SIZE);
+    testMessage("empty", empty_traj, path, "trajectory_msgs/JointTrajectory", n_threads, MIN_PARALLEL_SIZE);
+  }
+
+  cRosMessageFree(large_traj);
+  cRosMessageFree(outer);
+  cRosMessageFree(small_traj);
+  cRosMessageFree(empty_traj);
+
+  printf("%s\n", (N_failed_checks == 0)? "All the outputs are identical" : "Some outputs are DIFFERENT");
+  return (N_failed_checks == 0)? EXIT_SUCCESS : EXIT_FAILURE;
+}
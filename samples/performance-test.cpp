@@ -479,6 +479,79 @@ cRosErrCodePack run_service_caller(void)
   return err_cod;
 }
 
+// Like run_service_caller() but the calls are made with cRosNodeServiceCallInPlace() and only the mean round trip of each message size is printed
+cRosErrCodePack run_service_caller_in_place(void)
+{
+  cRosErrCodePack err_cod;
+  cRosMessage *msg_req, *msg_res;
+  cRosMessageField *name_field;
+  int calleridx; // Index (identifier) of the service caller to be created
+
+
+  // Create a service caller named /bulk of type "controller_manager_msgs/LoadController.srv" and request that the associated callback
+  err_cod = cRosApiRegisterServiceCaller(node,"/bulk","controller_manager_msgs/LoadController", -1, NULL, NULL, NULL, 1, 1, &calleridx);
+  if(err_cod != CROS_SUCCESS_ERR_PACK)
+  {
+    cRosPrintErrCodePack(err_cod, "cRosApiRegisterServiceCaller() failed; did you run this program one directory above 'rosdb'?");
+    cRosNodeDestroy( node );
+    return err_cod;
+  }
+
+
+  msg_req = cRosApiCreateServiceCallerRequest(node, calleridx);
+  msg_res = cRosApiCreateServiceCallerResponse(node, calleridx);
+
+  name_field = cRosMessageGetField(msg_req, "name");
+  if (name_field != NULL)
+  {
+    static char buf[MAX_MSG_SIZE+1]={0};
+    int call_count = 0;
+
+    printf("Calling service in place...\n");
+
+    err_cod = cRosNodeStart( node, 200, &exit_flag );
+    for (call_count = 0; call_count < TOTAL_MEASURE_EXPERS && err_cod == CROS_SUCCESS_ERR_PACK && exit_flag == 0; call_count++)
+    {
+      int rep_count;
+      double start_time;
+      //snprintf(buf, sizeof(buf), "hello world %d", call_count);
+      memset(buf,' ',Msg_sizes[call_count]);
+
+      cRosMessageSetFieldValueString(name_field, buf);
+
+      start_time = cRosClockTimeStampToUSec(cRosClockGetTimeStamp());
+      for(rep_count=0;rep_count<Measure_reps[call_count] && err_cod == CROS_SUCCESS_ERR_PACK;rep_count++)
+      {
+        err_cod = cRosNodeServiceCallInPlace(node, calleridx, msg_req, msg_res, 5000);
+        if (err_cod != CROS_SUCCESS_ERR_PACK)
+          cRosPrintErrCodePack(err_cod, "cRosNodeServiceCallInPlace() failed: service call not made");
+      }
+      if(rep_count > 0)
+        printf("Called service %d with %lu bytes %i times: mean round trip %.2f us\n", call_count, Msg_sizes[call_count], rep_count,
+               (cRosClockTimeStampToUSec(cRosClockGetTimeStamp()) - start_time)/rep_count);
+    }
+
+  }
+  else
+    printf("Error accessing message fields\n");
+
+
+  cRosMessageFree(msg_req);
+  cRosMessageFree(msg_res);
+
+  printf("End of service call.\n");
+
+  // Run the main loop until exit_flag is 1
+  if (err_cod == CROS_SUCCESS_ERR_PACK)
+  {
+    err_cod = cRosNodeStart( node, 200, &exit_flag );
+    if(err_cod != CROS_SUCCESS_ERR_PACK)
+      cRosPrintErrCodePack(err_cod, "cRosNodeStart() returned an error code");
+  }
+
+  return err_cod;
+}
+
 
 int main(int argc, char **argv)
 {
@@ -498,7 +571,7 @@ int main(int argc, char **argv)
 
   printf("PATH ROSDB: %s\n", path);
 
-  printf("Press s for subscriber, p for publisher, r for service server or c for service client: ");
+  printf("Press s for subscriber, p for publisher, r for service server, c for service client or i for in-place service client: ");
   op_mode = getchar();
   if (op_mode == 's')
     node_name = "/node_sub";
@@ -506,7 +579,7 @@ int main(int argc, char **argv)
     node_name = "/node_server";
   else if (op_mode == 'p')
     node_name = "/node_pub";
-  else if (op_mode == 'c')
+  else if (op_mode == 'c' || op_mode == 'i')
     node_name = "/node_caller";
   else
   {
@@ -555,9 +628,9 @@ int main(int argc, char **argv)
   {
     err_cod = run_topic_publisher();
   }
-  else if (op_mode == 'c')
+  else if (op_mode == 'c' || op_mode == 'i')
   {
-    err_cod = run_service_caller();
+    err_cod = (op_mode == 'i')? run_service_caller_in_place() : run_service_caller();
   }
 
 
@@ -0,0 +1,241 @@
+/*! \file priority-latency-test.c
+ *  \brief This file measures the latency of a small command topic that shares its nodes with a bulk topic,
+ *         without and with topic priority classes (see cRosNodeSetPublisherPriority()).
+ *
+ *  A publisher node publishes a large std_msgs/String on /prio_map every MAP_PERIOD ms and a small one on /prio_cmd
+ *  every CMD_PERIOD ms. The command message carries its publication time. N_MAP_SUBSCRIBERS subscriber nodes, each
+ *  one run by its own thread, subscribe to /prio_map, and the first one also subscribes to /prio_cmd and records the
+ *  latency of each command. The test is run first with the default priorities and then with /prio_cmd as a
+ *  high-priority topic and /prio_map as a bulk topic on both sides, and the latency statistics of both runs are printed.
+ *  The test checks that, with priorities, the p99 and max latencies of the commands are below MAX_HIGH_PRIO_P99 and
+ *  MAX_HIGH_PRIO_LATENCY and below the ones of the run with the default priorities.
+ *  It needs the ROS master and the message definitions described in sample_utils.h.
+ *
+ *  Usage: priority-latency-test [map size in KB] [run period in seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cros.h"
+#include "cros_clock.h"
+#include "cros_thread.h"
+#include "sample_utils.h"
+
+#define N_MAP_SUBSCRIBERS 3
+#define MAP_PERIOD 50              // Publication period of /prio_map (in ms)
+#define CMD_PERIOD 10              // Publication period of /prio_cmd (in ms)
+#define WARM_UP_PERIOD 1000        // Time (in ms) given to the subscribers to connect before measuring
+#define MAX_LATENCY_SAMPLES 10000
+#define DEFAULT_MAP_SIZE_KB 4096
+#define DEFAULT_RUN_SECS 5
+#define MAX_HIGH_PRIO_P99 (CMD_PERIOD / 2.0)   // Bound of the p99 latency (in ms) of the high-priority commands
+#define MAX_HIGH_PRIO_LATENCY CMD_PERIOD       // Bound of the max latency (in ms): a command must arrive before the next one is published
+
+typedef struct LatencyStats LatencyStats;
+struct LatencyStats
+{
+  int n_latencies;                 // Num. of commands measured
+  double mean, p50, p99, max;      // Latencies (in ms)
+};
+
+typedef struct SubscriberRun SubscriberRun;
+struct SubscriberRun
+{
+  CrosNode *node;
+  uint64_t measure_start;          // Only the commands received after this time stamp (in ns) are measured
+  double *latencies;               // Latencies (in ms) of the received commands. NULL if this node does not subscribe to /prio_cmd
+  int n_latencies;
+};
+
+static char *Map_data;             // Content of the /prio_map messages
+static unsigned char Exit_flag;    // Set to 1 to stop the subscriber threads of the current run
+
+static CallbackResponse callback_pub_map(cRosMessage *message, void *data_context)
+{
+  cRosMessageSetFieldValueString(cRosMessageGetField(message, "data"), Map_data);
+  return 0; // 0=success
+}
+
+static CallbackResponse callback_pub_cmd(cRosMessage *message, void *data_context)
+{
+  char buf[32];
+
+  snprintf(buf, sizeof(buf), "%llu", (unsigned long long)cRosClockGetTimeStamp());
+  cRosMessageSetFieldValueString(cRosMessageGetField(message, "data"), buf);
+  return 0; // 0=success
+}
+
+static CallbackResponse callback_sub_map(cRosMessage *message, void *data_context)
+{
+  return 0; // 0=success
+}
+
+static CallbackResponse callback_sub_cmd(cRosMessage *message, void *data_context)
+{
+  SubscriberRun *run = (SubscriberRun *)data_context;
+  uint64_t pub_time = strtoull(cRosMessageGetField(message, "data")->data.as_string, NULL, 10);
+  uint64_t rcv_time = cRosClockGetTimeStamp();
+
+  if(pub_time >= run->measure_start && run->n_latencies < MAX_LATENCY_SAMPLES)
+    run->latencies[run->n_latencies++] = (double)(rcv_time - pub_time) / 1e6;
+  return 0; // 0=success
+}
+
+static void runSubscriber(void *run_ptr)
+{
+  SubscriberRun *run = (SubscriberRun *)run_ptr;
+  cRosNodeStart(run->node, CROS_INFINITE_TIMEOUT, &Exit_flag);
+}
+
+static int compareLatencies(const void *a, const void *b)
+{
+  double diff = *(const double *)a - *(const double *)b;
+  return (diff > 0.0) - (diff < 0.0);
+}
+
+// Compute and print the statistics of the command latencies
+static void computeLatencyStats(const char *run_name, double *latencies, int n_latencies, LatencyStats *stats)
+{
+  double sum = 0.0;
+  int ind;
+
+  memset(stats, 0, sizeof(LatencyStats));
+  if(n_latencies == 0)
+  {
+    printf("  %-18s no command received; is the master running?\n", run_name);
+    return;
+  }
+  qsort(latencies, n_latencies, sizeof(double), compareLatencies);
+  for(ind = 0; ind < n_latencies; ind++)
+    sum += latencies[ind];
+  stats->n_latencies = n_latencies;
+  stats->mean = sum / n_latencies;
+  stats->p50 = latencies[n_latencies / 2];
+  stats->p99 = latencies[(int)(n_latencies * 0.99)];
+  stats->max = latencies[n_latencies - 1];
+  printf("  %-18s %5i commands: mean %7.3f ms, p50 %7.3f ms, p99 %7.3f ms, max %7.3f ms\n", run_name, n_latencies,
+         stats->mean, stats->p50, stats->p99, stats->max);
+}
+
+// Run the nodes for run_secs seconds after the warm-up period and compute the command latencies
+static int runTest(const char *path, int use_priorities, unsigned long run_secs, LatencyStats *stats)
+{
+  CrosNode *pub_node;
+  SubscriberRun sub_runs[N_MAP_SUBSCRIBERS];
+  cRosThread sub_threads[N_MAP_SUBSCRIBERS];
+  int sub_started[N_MAP_SUBSCRIBERS];
+  char node_name[64];
+  cRosErrCodePack err_cod;
+  int map_pubidx, cmd_pubidx, subidx, ind;
+
+  snprintf(node_name, sizeof(node_name), "/prio_test_pub_%i", use_priorities);
+  pub_node = cRosNodeCreate(node_name, "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+  if(pub_node == NULL)
+    return 0;
+  err_cod = cRosApiRegisterPublisher(pub_node, "/prio_map", "std_msgs/String", MAP_PERIOD, callback_pub_map, NULL, NULL, &map_pubidx);
+  err_cod = cRosAddErrCodePackIfErr(err_cod, cRosApiRegisterPublisher(pub_node, "/prio_cmd", "std_msgs/String", CMD_PERIOD, callback_pub_cmd, NULL, NULL, &cmd_pubidx));
+  if(use_priorities && err_cod == CROS_SUCCESS_ERR_PACK)
+  {
+    err_cod = cRosNodeSetPublisherPriority(pub_node, map_pubidx, CROS_TOPIC_PRIORITY_BULK);
+    err_cod = cRosAddErrCodePackIfErr(err_cod, cRosNodeSetPublisherPriority(pub_node, cmd_pubidx, CROS_TOPIC_PRIORITY_HIGH));
+  }
+  if(err_cod != CROS_SUCCESS_ERR_PACK)
+  {
+    cRosPrintErrCodePack(err_cod, "The publisher node could not be set up");
+    cRosNodeDestroy(pub_node);
+    return 0;
+  }
+  // Let the publishers register before the subscribers ask the master for them
+  cRosNodeStart(pub_node, 200, NULL);
+
+  Exit_flag = 0;
+  for(ind = 0; ind < N_MAP_SUBSCRIBERS; ind++)
+  {
+    SubscriberRun *run = &sub_runs[ind];
+
+    snprintf(node_name, sizeof(node_name), "/prio_test_sub_%i_%i", use_priorities, ind);
+    run->node = cRosNodeCreate(node_name, "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+    run->measure_start = cRosClockGetTimeStamp() + (uint64_t)WARM_UP_PERIOD * 1000000;
+    run->latencies = (ind == 0)? (double *)malloc(MAX_LATENCY_SAMPLES * sizeof(double)) : NULL;
+    run->n_latencies = 0;
+    sub_started[ind] = 0;
+    if(run->node == NULL)
+      continue;
+    err_cod = cRosApiRegisterSubscriber(run->node, "/prio_map", "std_msgs/String", callback_sub_map, NULL, run, 0, &subidx);
+    if(use_priorities && err_cod == CROS_SUCCESS_ERR_PACK)
+      err_cod = cRosNodeSetSubscriberPriority(run->node, subidx, CROS_TOPIC_PRIORITY_BULK);
+    if(run->latencies != NULL && err_cod == CROS_SUCCESS_ERR_PACK)
+    {
+      err_cod = cRosApiRegisterSubscriber(run->node, "/prio_cmd", "std_msgs/String", callback_sub_cmd, NULL, run, 1, &subidx);
+      if(use_priorities && err_cod == CROS_SUCCESS_ERR_PACK)
+        err_cod = cRosNodeSetSubscriberPriority(run->node, subidx, CROS_TOPIC_PRIORITY_HIGH);
+    }
+    if(err_cod == CROS_SUCCESS_ERR_PACK)
+      sub_started[ind] = cRosThreadCreate(&sub_threads[ind], runSubscriber, run);
+    else
+      cRosPrintErrCodePack(err_cod, "A subscriber node could not be set up");
+  }
+
+  cRosNodeStart(pub_node, WARM_UP_PERIOD + run_secs * 1000, NULL);
+
+  Exit_flag = 1;
+  for(ind = 0; ind < N_MAP_SUBSCRIBERS; ind++)
+  {
+    if(sub_started[ind])
+      cRosThreadJoin(&sub_threads[ind]);
+    if(sub_runs[ind].node != NULL)
+      cRosNodeDestroy(sub_runs[ind].node);
+  }
+  cRosNodeDestroy(pub_node);
+
+  if(sub_runs[0].latencies == NULL)
+    return 0;
+  computeLatencyStats((use_priorities)? "with priorities:" : "default priorities:", sub_runs[0].latencies, sub_runs[0].n_latencies, stats);
+  free(sub_runs[0].latencies);
+  return 1;
+}
+
+int main(int argc, char **argv)
+{
+  char path[4097];
+  size_t map_size;
+  unsigned long run_secs;
+  LatencyStats default_stats, prio_stats;
+  char description[80];
+
+  map_size = (argc > 1)? (size_t)atoi(argv[1]) * 1024 : DEFAULT_MAP_SIZE_KB * 1024;
+  run_secs = (argc > 2)? (unsigned long)atoi(argv[2]) : DEFAULT_RUN_SECS;
+  if(map_size == 0 || run_secs == 0)
+  {
+    printf("Usage: %s [map size in KB] [run period in seconds]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  getRosdbPath(path, sizeof(path));
+
+  Map_data = (char *)malloc(map_size + 1);
+  if(Map_data == NULL)
+    return EXIT_FAILURE;
+  memset(Map_data, 'x', map_size);
+  Map_data[map_size] = '\0';
+
+  printf("Latency of /prio_cmd (every %i ms) with a %lu KB /prio_map (every %i ms) sent to %i subscribers:\n",
+         CMD_PERIOD, (unsigned long)(map_size / 1024), MAP_PERIOD, N_MAP_SUBSCRIBERS);
+  if(!runTest(path, 0, run_secs, &default_stats) || !runTest(path, 1, run_secs, &prio_stats))
+  {
+    free(Map_data);
+    return EXIT_FAILURE;
+  }
+  free(Map_data);
+
+  check(default_stats.n_latencies > 0 && prio_stats.n_latencies > 0, "commands are received in both runs");
+  snprintf(description, sizeof(description), "with priorities, the p99 latency is below %.1f ms", MAX_HIGH_PRIO_P99);
+  check(prio_stats.n_latencies > 0 && prio_stats.p99 < MAX_HIGH_PRIO_P99, description);
+  snprintf(description, sizeof(description), "with priorities, the max latency is below %i ms", MAX_HIGH_PRIO_LATENCY);
+  check(prio_stats.n_latencies > 0 && prio_stats.max < MAX_HIGH_PRIO_LATENCY, description);
+  check(prio_stats.n_latencies > 0 && prio_stats.p99 < default_stats.p99, "with priorities, the p99 latency is below the one with default priorities");
+  check(prio_stats.n_latencies > 0 && prio_stats.max < default_stats.max, "with priorities, the max latency is below the one with default priorities");
+  return checksExitStatus();
+}
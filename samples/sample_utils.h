@@ -0,0 +1,55 @@
+/*! \file sample_utils.h
+ *  \brief Definitions shared by the test and benchmark samples.
+ *
+ *  The samples that include it create their nodes with the ROS master at ROS_MASTER_ADDRESS:ROS_MASTER_PORT, so a roscore
+ *  (or a compatible master) must be running there, and they take the message definitions from the 'rosdb' directory,
+ *  so they must be run from the directory that contains it. The test samples report each check with check() and
+ *  return the exit status given by checksExitStatus().
+ */
+
+#ifndef _SAMPLE_UTILS_H_
+#define _SAMPLE_UTILS_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#  include <direct.h>
+
+#  define DIR_SEPARATOR_STR "\\"
+#else
+#  include <unistd.h>
+
+#  define DIR_SEPARATOR_STR "/"
+#endif
+
+#define ROS_MASTER_PORT 11311
+#define ROS_MASTER_ADDRESS "127.0.0.1"
+
+static int N_failed_checks = 0;
+
+// Print the result of a check. The failed checks are counted in N_failed_checks
+static void check(int condition, const char *description)
+{
+  printf("  %-74s %s\n", description, (condition)? "ok" : "FAILED");
+  if(!condition)
+    N_failed_checks++;
+}
+
+// Print whether all the checks passed and return the corresponding exit status of the sample
+static int checksExitStatus(void)
+{
+  printf("%s\n", (N_failed_checks == 0)? "All the checks passed" : "Some checks FAILED");
+  return (N_failed_checks == 0)? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Store in path (of path_size bytes) the path of the message definitions: the 'rosdb' directory under the current one
+static void getRosdbPath(char *path, size_t path_size)
+{
+  if(getcwd(path, path_size) == NULL)
+    path[0] = '\0';
+  strncat(path, DIR_SEPARATOR_STR"rosdb", path_size - strlen(path) - 1);
+}
+
+#endif
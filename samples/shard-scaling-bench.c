@@ -0,0 +1,217 @@
+/*! \file shard-scaling-bench.c
+ *  \brief This file measures how the topic throughput of a publisher node scales with the number of I/O shards
+ *         (see cRosNodeSetIoShards()).
+ *
+ *  For each number of shards (from 1 to CN_MAX_IO_SHARDS) it creates a publisher node and N_SUBSCRIBERS subscriber nodes
+ *  of the topic /shard_bench, each subscriber run by its own thread. The additional shards of the publisher are also run
+ *  by their own threads. After a warm-up period, in which the subscribers connect, the publisher queues a large
+ *  std_msgs/String message back to back (cRosNodeSendTopicMsg()) during the measurement period, so a new message is
+ *  published as soon as all the subscribers have received the previous one. The bytes received by all the subscribers
+ *  and the CPU time of the process are printed.
+ *  The shards serialize and write the messages in parallel, so the throughput can only scale if there are enough CPUs
+ *  for the shard threads and for the subscriber threads (the number of online CPUs is printed): on a single CPU the
+ *  shards just share it, and the throughput stays flat or drops slightly because each shard serializes the message.
+ *  It needs the ROS master and the message definitions described in sample_utils.h.
+ *
+ *  Usage: shard-scaling-bench [message size in KB] [measurement period in seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cros.h"
+#include "cros_clock.h"
+#include "cros_thread.h"
+#include "sample_utils.h"
+
+#define N_SUBSCRIBERS 8            // Subscriber nodes connected to the publisher: 2 per shard with CN_MAX_IO_SHARDS shards
+#define WARM_UP_PERIOD 1000        // Time (in ms) given to the subscribers to connect before measuring
+#define SEND_TIME_OUT 100          // Max time (in ms) waited for room in the publisher queue
+#define DEFAULT_MSG_SIZE_KB 256
+#define DEFAULT_MEASURE_SECS 3
+
+#if N_SUBSCRIBERS > CN_MAX_TCPROS_SERVER_CONNECTIONS
+#  error "The publisher node cannot accept N_SUBSCRIBERS connections"
+#endif
+
+typedef struct SubscriberRun SubscriberRun;
+struct SubscriberRun
+{
+  CrosNode *node;
+  uint64_t measure_start;          // Only the messages received in [measure_start, measure_end) (in ms) are counted
+  uint64_t measure_end;
+  uint64_t rcv_bytes;
+  unsigned long rcv_msgs;
+};
+
+static char *Msg_data;             // Content of the published message
+static size_t Msg_size;            // Length of Msg_data
+static unsigned char Exit_flag;    // Set to 1 to stop the threads of the current run
+
+static CallbackResponse callback_sub(cRosMessage *message, void *data_context)
+{
+  SubscriberRun *run = (SubscriberRun *)data_context;
+  uint64_t cur_time = cRosClockGetTimeMs();
+
+  if(cur_time >= run->measure_start && cur_time < run->measure_end)
+  {
+    run->rcv_bytes += Msg_size; // The subscriber does not walk through the message, so that it takes as little CPU as possible
+    run->rcv_msgs++;
+  }
+  return 0; // 0=success
+}
+
+static void runSubscriber(void *run_ptr)
+{
+  SubscriberRun *run = (SubscriberRun *)run_ptr;
+  cRosNodeStart(run->node, CROS_INFINITE_TIMEOUT, &Exit_flag);
+}
+
+typedef struct ShardRun ShardRun;
+struct ShardRun
+{
+  CrosNode *node;
+  int shard_idx;
+};
+
+static void runShard(void *run_ptr)
+{
+  ShardRun *run = (ShardRun *)run_ptr;
+  cRosNodeStartShard(run->node, run->shard_idx, CROS_INFINITE_TIMEOUT, &Exit_flag);
+}
+
+// Returns the throughput (in MB/s) received by all the subscribers, or a negative value on error. The CPU time of the
+// process during the measurement period (in % of a CPU) is stored in cpu_usage
+static double measureThroughput(const char *path, int n_shards, unsigned long measure_secs, unsigned long *rcv_msgs, double *cpu_usage)
+{
+  CrosNode *pub_node;
+  cRosMessage *msg;
+  SubscriberRun sub_runs[N_SUBSCRIBERS];
+  ShardRun shard_runs[CN_MAX_IO_SHARDS];
+  cRosThread sub_threads[N_SUBSCRIBERS], shard_threads[CN_MAX_IO_SHARDS];
+  int sub_started[N_SUBSCRIBERS], shard_started[CN_MAX_IO_SHARDS];
+  char node_name[64];
+  uint64_t rcv_bytes = 0, measure_start, measure_end;
+  clock_t start_cpu_time;
+  cRosErrCodePack err_cod;
+  int pubidx, subidx, ind;
+
+  snprintf(node_name, sizeof(node_name), "/shard_bench_pub_%i", n_shards);
+  pub_node = cRosNodeCreate(node_name, "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+  if(pub_node == NULL)
+    return -1.0;
+  err_cod = cRosNodeSetIoShards(pub_node, n_shards);
+  if(err_cod == CROS_SUCCESS_ERR_PACK) // The messages are only published when they are queued
+    err_cod = cRosApiRegisterPublisher(pub_node, "/shard_bench", "std_msgs/String", -1, NULL, NULL, NULL, &pubidx);
+  msg = (err_cod == CROS_SUCCESS_ERR_PACK)? cRosApiCreatePublisherMessage(pub_node, pubidx) : NULL;
+  if(msg == NULL || cRosMessageSetFieldValueString(cRosMessageGetField(msg, "data"), Msg_data) != 0)
+  {
+    cRosPrintErrCodePack(err_cod, "The publisher could not be set up");
+    cRosMessageFree(msg);
+    cRosNodeDestroy(pub_node);
+    return -1.0;
+  }
+  // Let the publisher register before the subscribers ask the master for it
+  cRosNodeStart(pub_node, 200, NULL);
+
+  Exit_flag = 0;
+  measure_start = cRosClockGetTimeMs() + WARM_UP_PERIOD;
+  measure_end = measure_start + measure_secs * 1000;
+  for(ind = 0; ind < N_SUBSCRIBERS; ind++)
+  {
+    snprintf(node_name, sizeof(node_name), "/shard_bench_sub_%i_%i", n_shards, ind);
+    sub_runs[ind].node = cRosNodeCreate(node_name, "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+    sub_runs[ind].measure_start = measure_start;
+    sub_runs[ind].measure_end = measure_end;
+    sub_runs[ind].rcv_bytes = 0;
+    sub_runs[ind].rcv_msgs = 0;
+    sub_started[ind] = 0;
+    if(sub_runs[ind].node != NULL &&
+       cRosApiRegisterSubscriber(sub_runs[ind].node, "/shard_bench", "std_msgs/String", callback_sub, NULL, &sub_runs[ind], 0, &subidx) == CROS_SUCCESS_ERR_PACK)
+      sub_started[ind] = cRosThreadCreate(&sub_threads[ind], runSubscriber, &sub_runs[ind]);
+  }
+  for(ind = 1; ind < n_shards; ind++)
+  {
+    shard_runs[ind].node = pub_node;
+    shard_runs[ind].shard_idx = ind;
+    shard_started[ind] = cRosThreadCreate(&shard_threads[ind], runShard, &shard_runs[ind]);
+  }
+
+  cRosNodeStart(pub_node, WARM_UP_PERIOD, NULL);
+
+  // Keep the publisher queue full: cRosNodeSendTopicMsg() runs the event loop until there is room for the message
+  start_cpu_time = clock();
+  while(cRosClockGetTimeMs() < measure_end && err_cod == CROS_SUCCESS_ERR_PACK)
+    err_cod = cRosNodeSendTopicMsg(pub_node, pubidx, msg, SEND_TIME_OUT);
+  *cpu_usage = (double)(clock() - start_cpu_time) / CLOCKS_PER_SEC * 100.0 / measure_secs;
+  if(err_cod != CROS_SUCCESS_ERR_PACK)
+    cRosPrintErrCodePack(err_cod, "The messages could not be published");
+
+  Exit_flag = 1;
+  for(ind = 1; ind < n_shards; ind++)
+    if(shard_started[ind])
+      cRosThreadJoin(&shard_threads[ind]);
+  // The publisher is destroyed while the subscribers are still connected, so it does not write to closed connections
+  cRosMessageFree(msg);
+  cRosNodeDestroy(pub_node);
+  *rcv_msgs = 0;
+  for(ind = 0; ind < N_SUBSCRIBERS; ind++)
+  {
+    if(sub_started[ind])
+      cRosThreadJoin(&sub_threads[ind]);
+    if(sub_runs[ind].node != NULL)
+      cRosNodeDestroy(sub_runs[ind].node);
+    rcv_bytes += sub_runs[ind].rcv_bytes;
+    *rcv_msgs += sub_runs[ind].rcv_msgs;
+  }
+
+  return (err_cod == CROS_SUCCESS_ERR_PACK)? (double)rcv_bytes / (1024.0 * 1024.0) / measure_secs : -1.0;
+}
+
+int main(int argc, char **argv)
+{
+  char path[4097];
+  unsigned long measure_secs, rcv_msgs;
+  double cpu_usage;
+  long n_cpus = -1;
+  int n_shards;
+
+  Msg_size = (argc > 1)? (size_t)atoi(argv[1]) * 1024 : DEFAULT_MSG_SIZE_KB * 1024;
+  measure_secs = (argc > 2)? (unsigned long)atoi(argv[2]) : DEFAULT_MEASURE_SECS;
+  if(Msg_size == 0 || measure_secs == 0)
+  {
+    printf("Usage: %s [message size in KB] [measurement period in seconds]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  getRosdbPath(path, sizeof(path));
+
+  Msg_data = (char *)malloc(Msg_size + 1);
+  if(Msg_data == NULL)
+    return EXIT_FAILURE;
+  memset(Msg_data, 'x', Msg_size);
+  Msg_data[Msg_size] = '\0';
+
+#ifdef _SC_NPROCESSORS_ONLN
+  n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  printf("Throughput of a %lu KB topic published back to back to %i subscribers (%lu s per run, %li online CPUs):\n",
+         (unsigned long)(Msg_size / 1024), N_SUBSCRIBERS, measure_secs, n_cpus);
+  for(n_shards = 1; n_shards <= CN_MAX_IO_SHARDS; n_shards++)
+  {
+    double throughput = measureThroughput(path, n_shards, measure_secs, &rcv_msgs, &cpu_usage);
+    if(throughput < 0.0)
+    {
+      printf("  %i shard(s): the run failed; is the master running?\n", n_shards);
+      free(Msg_data);
+      return EXIT_FAILURE;
+    }
+    printf("  %i shard(s): %8.1f MB/s (%lu messages), CPU time of the process: %6.1f %% of a CPU\n", n_shards, throughput,
+           rcv_msgs, cpu_usage);
+  }
+
+  free(Msg_data);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,257 @@
+/*! \file silent-peer-test.c
+ *  \brief This file checks that a publisher detects and evicts a subscriber that vanishes without closing its
+ *         connection (see cRosNodeSetPublisherTcpTuning() and cRosNodeSetDeadPeerHook()).
+ *
+ *  A publisher node publishes a large std_msgs/String on /silent_peer every PUB_PERIOD ms to two subscribers: a
+ *  healthy subscriber node, run by its own thread, and a silent peer. The silent peer is a plain socket with a small
+ *  receive buffer that sends the TCPROS subscription header and then never reads again, so, as a peer that lost power
+ *  or its link, it never closes the connection and the send buffer of the publisher fills up. The test is run twice:
+ *  - with a write timeout, the publisher must evict the peer with CROS_DEAD_PEER_WRITE_STALLED,
+ *  - with a TCP user timeout (on Linux), the kernel must close the connection and the publisher must evict the peer
+ *    with CROS_DEAD_PEER_TIMED_OUT.
+ *  In both runs the dead peer hook must be called once, within the timeout plus a margin, and the healthy subscriber
+ *  must keep receiving the topic after the eviction.
+ *  It needs the ROS master and the message definitions described in sample_utils.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cros.h"
+#include "cros_clock.h"
+#include "cros_thread.h"
+#include "sample_utils.h"
+
+#define PUB_PERIOD 20              // Publication period of /silent_peer (in ms)
+#define MSG_SIZE (64 * 1024)       // Size of the published string
+#define PEER_RCV_BUF_SIZE 4096     // Receive buffer of the silent peer
+#define WRITE_TIMEOUT 500          // Write timeout (in ms) of the first run
+#define USER_TIMEOUT 1000          // TCP user timeout (in ms) of the second run
+#define DETECTION_MARGIN 3000      // Max time (in ms) allowed to detect the dead peer after its timeout
+#define AFTER_EVICTION_PERIOD 1000 // Time (in ms) during which the topic is published after the eviction
+#define MAX_RCV_TIMES 2000
+
+typedef struct SubscriberRun SubscriberRun;
+struct SubscriberRun
+{
+  CrosNode *node;
+  uint64_t rcv_times[MAX_RCV_TIMES]; // Reception times (in ms) of the messages received by the healthy subscriber
+  int n_rcv_times;
+};
+
+typedef struct DeadPeerRecord DeadPeerRecord;
+struct DeadPeerRecord
+{
+  int n_calls;                     // Num. of calls to the dead peer hook
+  CrosDeadPeer dead_peer;          // Last dead peer reported
+  char peer[64];
+  uint64_t eviction_time;          // Time (in ms) of the last call to the hook
+};
+
+static char *Msg_data;             // Content of the published message
+static unsigned char Exit_flag;    // Set to 1 to stop the subscriber thread of the current run
+
+static CallbackResponse callback_pub(cRosMessage *message, void *data_context)
+{
+  cRosMessageSetFieldValueString(cRosMessageGetField(message, "data"), Msg_data);
+  return 0; // 0=success
+}
+
+static CallbackResponse callback_sub(cRosMessage *message, void *data_context)
+{
+  SubscriberRun *run = (SubscriberRun *)data_context;
+
+  if(run->n_rcv_times < MAX_RCV_TIMES)
+    run->rcv_times[run->n_rcv_times++] = cRosClockGetTimeMs();
+  return 0; // 0=success
+}
+
+static void deadPeerHook(const CrosDeadPeer *dead_peer, void *context)
+{
+  DeadPeerRecord *record = (DeadPeerRecord *)context;
+
+  record->n_calls++;
+  record->dead_peer = *dead_peer;
+  strncpy(record->peer, dead_peer->peer, sizeof(record->peer) - 1);
+  record->peer[sizeof(record->peer) - 1] = '\0';
+  record->dead_peer.peer = record->peer;
+  record->eviction_time = cRosClockGetTimeMs();
+  printf("  dead peer hook: %s on %s, reason %s, %lu bytes unsent\n", record->peer, dead_peer->topic_name,
+         (dead_peer->reason == CROS_DEAD_PEER_WRITE_STALLED)? "write stalled" : "timed out", (unsigned long)dead_peer->unsent_bytes);
+}
+
+static void runSubscriber(void *run_ptr)
+{
+  SubscriberRun *run = (SubscriberRun *)run_ptr;
+  cRosNodeStart(run->node, CROS_INFINITE_TIMEOUT, &Exit_flag);
+}
+
+static void pushBackHeaderField(DynBuffer *header, const char *field)
+{
+  dynBufferPushBackUInt32(header, (uint32_t)strlen(field));
+  dynBufferPushBackBuf(header, (const unsigned char *)field, strlen(field));
+}
+
+// Connect a socket to the publisher and subscribe to the topic. After that, the socket is never read
+static int connectSilentPeer(TcpIpSocket *peer, unsigned short port)
+{
+  DynBuffer fields, header;
+  int ok;
+
+  tcpIpSocketInit(peer);
+  if(!tcpIpSocketOpen(peer))
+    return 0;
+  tcpIpSocketSetBufferSizes(peer, 0, PEER_RCV_BUF_SIZE);
+  if(tcpIpSocketConnect(peer, "127.0.0.1", port) != TCPIPSOCKET_DONE)
+  {
+    tcpIpSocketClose(peer);
+    return 0;
+  }
+  dynBufferInit(&fields);
+  dynBufferInit(&header);
+  pushBackHeaderField(&fields, "callerid=/silent_peer");
+  pushBackHeaderField(&fields, "topic=/silent_peer");
+  pushBackHeaderField(&fields, "type=std_msgs/String");
+  pushBackHeaderField(&fields, "md5sum=*");
+  pushBackHeaderField(&fields, "tcp_nodelay=1");
+  dynBufferPushBackUInt32(&header, (uint32_t)dynBufferGetSize(&fields));
+  dynBufferPushBackBuf(&header, fields.data, dynBufferGetSize(&fields));
+  ok = (tcpIpSocketWriteBuffer(peer, &header) == TCPIPSOCKET_DONE);
+  dynBufferRelease(&fields);
+  dynBufferRelease(&header);
+  if(!ok)
+    tcpIpSocketClose(peer);
+  return ok;
+}
+
+// Returns 0 if the nodes could not be set up
+static int runTest(const char *path, const char *run_name, const CrosTcpTuning *tuning, CrosDeadPeerReason expected_reason, uint32_t timeout)
+{
+  CrosNode *pub_node;
+  SubscriberRun *sub_run;
+  cRosThread sub_thread;
+  TcpIpSocket peer;
+  DeadPeerRecord record;
+  cRosErrCodePack err_cod;
+  char node_name[64];
+  uint64_t peer_start_time, start_time;
+  int pubidx, subidx, n_rcv_after, ind;
+
+  printf("%s:\n", run_name);
+  memset(&record, 0, sizeof(record));
+  snprintf(node_name, sizeof(node_name), "/silent_peer_test_pub_%i", (int)expected_reason);
+  pub_node = cRosNodeCreate(node_name, "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+  if(pub_node == NULL)
+    return 0;
+  err_cod = cRosApiRegisterPublisher(pub_node, "/silent_peer", "std_msgs/String", PUB_PERIOD, callback_pub, NULL, NULL, &pubidx);
+  if(err_cod == CROS_SUCCESS_ERR_PACK)
+    err_cod = cRosNodeSetPublisherTcpTuning(pub_node, pubidx, tuning);
+  if(err_cod == CROS_SUCCESS_ERR_PACK)
+    err_cod = cRosNodeSetDeadPeerHook(pub_node, deadPeerHook, &record);
+  if(err_cod != CROS_SUCCESS_ERR_PACK)
+  {
+    cRosPrintErrCodePack(err_cod, "The publisher could not be set up; did you run this program one directory above 'rosdb'?");
+    cRosNodeDestroy(pub_node);
+    return 0;
+  }
+  // Let the publisher register before the subscriber asks the master for it
+  cRosNodeStart(pub_node, 200, NULL);
+
+  sub_run = (SubscriberRun *)calloc(1, sizeof(SubscriberRun));
+  snprintf(node_name, sizeof(node_name), "/silent_peer_test_sub_%i", (int)expected_reason);
+  if(sub_run != NULL)
+    sub_run->node = cRosNodeCreate(node_name, "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+  if(sub_run == NULL || sub_run->node == NULL ||
+     cRosApiRegisterSubscriber(sub_run->node, "/silent_peer", "std_msgs/String", callback_sub, NULL, sub_run, 0, &subidx) != CROS_SUCCESS_ERR_PACK)
+  {
+    if(sub_run != NULL && sub_run->node != NULL)
+      cRosNodeDestroy(sub_run->node);
+    free(sub_run);
+    cRosNodeDestroy(pub_node);
+    return 0;
+  }
+  Exit_flag = 0;
+  if(!cRosThreadCreate(&sub_thread, runSubscriber, sub_run))
+  {
+    cRosNodeDestroy(sub_run->node);
+    free(sub_run);
+    cRosNodeDestroy(pub_node);
+    return 0;
+  }
+  cRosNodeStart(pub_node, 500, NULL);
+
+  check(connectSilentPeer(&peer, pub_node->tcpros_port), "the silent peer subscribes to the topic");
+  peer_start_time = cRosClockGetTimeMs();
+  while(record.n_calls == 0 && cRosClockGetTimeMs() - peer_start_time < timeout + DETECTION_MARGIN)
+    cRosNodeDoEventsLoop(pub_node, 10);
+  start_time = cRosClockGetTimeMs();
+  while(cRosClockGetTimeMs() - start_time < AFTER_EVICTION_PERIOD)
+    cRosNodeDoEventsLoop(pub_node, 10);
+
+  Exit_flag = 1;
+  cRosThreadJoin(&sub_thread);
+  n_rcv_after = 0;
+  for(ind = 0; ind < sub_run->n_rcv_times; ind++)
+    if(record.n_calls > 0 && sub_run->rcv_times[ind] > record.eviction_time)
+      n_rcv_after++;
+  if(record.n_calls > 0)
+    printf("  peer evicted %lu ms after it stopped reading; the healthy subscriber received %i messages after the eviction\n",
+           (unsigned long)(record.eviction_time - peer_start_time), n_rcv_after);
+
+  check(record.n_calls == 1, "the dead peer hook is called once");
+  check(record.n_calls > 0 && record.dead_peer.is_publisher && strcmp(record.peer, "/silent_peer") == 0,
+        "the hook reports the silent subscriber of the publisher");
+  check(record.n_calls > 0 && record.dead_peer.reason == expected_reason, "the hook reports the expected reason");
+  check(record.n_calls > 0 && record.eviction_time - peer_start_time < timeout + DETECTION_MARGIN,
+        "the peer is evicted within the timeout plus the detection margin");
+  check(cRosNodeGetDeadPeerCount(pub_node) == 1, "the dead peer count of the node is 1");
+  check(cRosNodeGetPublisherSubscriberCount(pub_node, pubidx) == 1, "only the healthy subscriber remains connected");
+  check(n_rcv_after >= (AFTER_EVICTION_PERIOD / PUB_PERIOD) / 2, "the healthy subscriber keeps receiving after the eviction");
+
+  tcpIpSocketClose(&peer);
+  cRosNodeDestroy(sub_run->node);
+  free(sub_run);
+  cRosNodeDestroy(pub_node);
+  return 1;
+}
+
+int main(int argc, char **argv)
+{
+  char path[4097];
+  CrosTcpTuning tuning;
+
+  getRosdbPath(path, sizeof(path));
+
+  Msg_data = (char *)malloc(MSG_SIZE + 1);
+  if(Msg_data == NULL)
+    return EXIT_FAILURE;
+  memset(Msg_data, 'x', MSG_SIZE);
+  Msg_data[MSG_SIZE] = '\0';
+
+  memset(&tuning, 0, sizeof(tuning));
+  tuning.write_timeout = WRITE_TIMEOUT;
+  if(!runTest(path, "Write timeout of 500 ms", &tuning, CROS_DEAD_PEER_WRITE_STALLED, WRITE_TIMEOUT))
+  {
+    printf("The nodes could not be set up; is the master running?\n");
+    free(Msg_data);
+    return EXIT_FAILURE;
+  }
+
+#ifdef __linux__ // The kernel aborts the connection when its zero-window probes time out
+  memset(&tuning, 0, sizeof(tuning));
+  tuning.user_timeout = USER_TIMEOUT;
+  tuning.write_timeout = 60000; // Let the kernel detect the dead peer first
+  if(!runTest(path, "TCP user timeout of 1000 ms", &tuning, CROS_DEAD_PEER_TIMED_OUT, USER_TIMEOUT))
+  {
+    printf("The nodes could not be set up; is the master running?\n");
+    free(Msg_data);
+    return EXIT_FAILURE;
+  }
+#else
+  printf("TCP user timeout: only checked on Linux, skipped\n");
+#endif
+
+  free(Msg_data);
+  return checksExitStatus();
+}
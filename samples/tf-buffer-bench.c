@@ -0,0 +1,277 @@
+/*! \file tf-buffer-bench.c
+ *  \brief This file measures the transform buffer (see cRosTfBufferCreate()) at 10k transforms/s.
+ *
+ *  First, without master, it measures the time taken to insert a transform in a buffer and to look up a transform
+ *  between two frames at an interpolated time, both for a pair of frames whose path stays in the lookup cache and for
+ *  many pairs of sibling frames.
+ *  Then a publisher node, run by its own thread, publishes a tf2_msgs/TFMessage on /tf every PUB_PERIOD ms with
+ *  N_TRANSFORMS transforms (odom -> base_link and N_TRANSFORMS-1 sensor frames under base_link), that is, 10000
+ *  transforms/s. A subscriber node with a transform buffer looks up sensor42 in odom after each iteration of its event
+ *  loop. It prints the rate of inserted transforms, the lookups and the CPU time of the process, and checks the rate and
+ *  the value of the looked-up transform.
+ *  It needs the ROS master and the message definitions described in sample_utils.h.
+ *
+ *  Usage: tf-buffer-bench [run period in seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "cros.h"
+#include "cros_clock.h"
+#include "cros_thread.h"
+#include "cros_tf_buffer.h"
+#include "sample_utils.h"
+
+#define N_TRANSFORMS 100           // Transforms of each /tf message
+#define PUB_PERIOD 10              // Publication period of /tf (in ms)
+#define N_INSERT_ROUNDS 2000       // Num. of times that the N_TRANSFORMS transforms are inserted in the microbenchmark
+#define N_LOOKUPS 1000000          // Num. of lookups of each kind in the microbenchmark
+#define STAMP_PERIOD 10000000      // Period of the stamps (in ns) in the microbenchmark
+#define LOOKED_UP_FRAME "sensor42"
+#define DEFAULT_RUN_SECS 5
+
+static unsigned char Exit_flag;    // Set to 1 to stop the publisher thread
+static char Frame_names[N_TRANSFORMS][32];
+
+// Transform of the frame Frame_names[frame_ind]: base_link is at (1, 2, 0) in odom, rotated 90 degrees around z, and
+// the sensor i is at (0.1 * i, 0, 0) in base_link, not rotated. So sensor42 is at (1, 6.2, 0) in odom
+static void getFrameTransform(int frame_ind, CrosTransform *transform)
+{
+  memset(transform, 0, sizeof(CrosTransform));
+  if(frame_ind == 0)
+  {
+    transform->translation[0] = 1.0;
+    transform->translation[1] = 2.0;
+    transform->rotation[2] = sqrt(0.5);
+    transform->rotation[3] = sqrt(0.5);
+  }
+  else
+  {
+    transform->translation[0] = 0.1 * frame_ind;
+    transform->rotation[3] = 1.0;
+  }
+}
+
+static const char *getParentFrame(int frame_ind)
+{
+  return (frame_ind == 0)? "odom" : "base_link";
+}
+
+static void setVector(cRosMessage *msg, const double *values, int n_values)
+{
+  static const char *coordinates[] = {"x", "y", "z", "w"};
+  int coord_ind;
+
+  for(coord_ind = 0; coord_ind < n_values; coord_ind++)
+    cRosMessageGetField(msg, coordinates[coord_ind])->data.as_float64 = values[coord_ind];
+}
+
+static CallbackResponse callback_pub(cRosMessage *message, void *data_context)
+{
+  const char *path = (const char *)data_context;
+  cRosMessageField *transforms = cRosMessageGetField(message, "transforms");
+  uint64_t stamp = cRosClockGetTimeStamp();
+  int frame_ind;
+
+  if(transforms->array_size == 0) // First call: build the transforms, which do not change
+  {
+    for(frame_ind = 0; frame_ind < N_TRANSFORMS; frame_ind++)
+    {
+      cRosMessage *transform_stamped, *transform;
+      CrosTransform value;
+
+      if(cRosMessageNewBuild(path, "geometry_msgs/TransformStamped", &transform_stamped) != CROS_SUCCESS_ERR_PACK)
+        return 1;
+      cRosMessageSetFieldValueString(cRosMessageGetField(cRosMessageGetField(transform_stamped, "header")->data.as_msg, "frame_id"),
+                                     getParentFrame(frame_ind));
+      cRosMessageSetFieldValueString(cRosMessageGetField(transform_stamped, "child_frame_id"), Frame_names[frame_ind]);
+      transform = cRosMessageGetField(transform_stamped, "transform")->data.as_msg;
+      getFrameTransform(frame_ind, &value);
+      setVector(cRosMessageGetField(transform, "translation")->data.as_msg, value.translation, 3);
+      setVector(cRosMessageGetField(transform, "rotation")->data.as_msg, value.rotation, 4);
+      cRosMessageFieldArrayPushBackMsg(transforms, transform_stamped);
+    }
+  }
+  for(frame_ind = 0; frame_ind < transforms->array_size; frame_ind++)
+  {
+    cRosMessage *header = cRosMessageGetField(transforms->data.as_msg_array[frame_ind], "header")->data.as_msg;
+    cRosMessage *time = cRosMessageGetField(header, "stamp")->data.as_msg;
+
+    cRosMessageGetField(time, "secs")->data.as_uint32 = (uint32_t)(stamp / 1000000000);
+    cRosMessageGetField(time, "nsecs")->data.as_uint32 = (uint32_t)(stamp % 1000000000);
+  }
+  return 0; // 0=success
+}
+
+static void runPublisher(void *node_ptr)
+{
+  cRosNodeStart((CrosNode *)node_ptr, CROS_INFINITE_TIMEOUT, &Exit_flag);
+}
+
+// Returns 1 if transform places the origin of sensor42 at (1, 6.2, 0) in odom
+static int isExpectedTransform(const CrosTransform *transform)
+{
+  return fabs(transform->translation[0] - 1.0) < 1e-6 && fabs(transform->translation[1] - 6.2) < 1e-6 &&
+         fabs(transform->translation[2]) < 1e-6;
+}
+
+// Returns 0 if the buffer could not be created or a lookup failed
+static int measureBuffer(void)
+{
+  CrosTfBuffer *buf;
+  CrosTransform transform;
+  uint64_t start_time, elapsed_time;
+  int64_t first_stamp, stamp_span;
+  unsigned long lookup_ind, n_ok = 0;
+  int round_ind, frame_ind;
+
+  if(cRosTfBufferCreate(NULL, CROS_TF_BUFFER_DEFAULT_CAPACITY, &buf) != CROS_SUCCESS_ERR_PACK)
+    return 0;
+
+  start_time = cRosClockGetTimeStamp();
+  for(round_ind = 0; round_ind < N_INSERT_ROUNDS; round_ind++)
+    for(frame_ind = 0; frame_ind < N_TRANSFORMS; frame_ind++)
+    {
+      getFrameTransform(frame_ind, &transform);
+      cRosTfBufferSetTransform(buf, getParentFrame(frame_ind), Frame_names[frame_ind], (int64_t)(round_ind + 1) * STAMP_PERIOD, &transform, 0);
+    }
+  elapsed_time = cRosClockGetTimeStamp() - start_time;
+  printf("  %-60s %7.1f ns\n", "insertion of a transform:", (double)elapsed_time / (N_INSERT_ROUNDS * N_TRANSFORMS));
+
+  // Look up at times between the buffered transforms, so that they are interpolated
+  first_stamp = (int64_t)(N_INSERT_ROUNDS - CROS_TF_BUFFER_DEFAULT_CAPACITY + 1) * STAMP_PERIOD;
+  stamp_span = (int64_t)(CROS_TF_BUFFER_DEFAULT_CAPACITY - 1) * STAMP_PERIOD;
+  start_time = cRosClockGetTimeStamp();
+  for(lookup_ind = 0; lookup_ind < N_LOOKUPS; lookup_ind++)
+    n_ok += (cRosTfBufferLookup(buf, "odom", Frame_names[1 + lookup_ind % 8], first_stamp + (int64_t)(lookup_ind * 7919) % stamp_span, &transform) == CROS_SUCCESS_ERR_PACK);
+  elapsed_time = cRosClockGetTimeStamp() - start_time;
+  printf("  %-60s %7.1f ns\n", "lookup of sensor<i> in odom (8 frames, cached paths):", (double)elapsed_time / N_LOOKUPS);
+  start_time = cRosClockGetTimeStamp();
+  for(lookup_ind = 0; lookup_ind < N_LOOKUPS; lookup_ind++)
+    n_ok += (cRosTfBufferLookup(buf, Frame_names[1 + (lookup_ind * 13) % (N_TRANSFORMS - 1)], Frame_names[1 + lookup_ind % (N_TRANSFORMS - 1)],
+                                first_stamp + (int64_t)(lookup_ind * 7919) % stamp_span, &transform) == CROS_SUCCESS_ERR_PACK);
+  elapsed_time = cRosClockGetTimeStamp() - start_time;
+  printf("  %-60s %7.1f ns\n", "lookup of sensor<i> in sensor<j> (many pairs, cache misses):", (double)elapsed_time / N_LOOKUPS);
+
+  cRosTfBufferDestroy(buf);
+  if(n_ok != 2 * N_LOOKUPS)
+  {
+    printf("  %lu lookups failed\n", 2 * N_LOOKUPS - n_ok);
+    return 0;
+  }
+  return 1;
+}
+
+// Returns 0 if the nodes could not be set up or the checks failed
+static int measureTopic(char *path, unsigned long run_secs)
+{
+  CrosNode *pub_node, *sub_node;
+  CrosTfBuffer *buf;
+  CrosTransform transform;
+  cRosThread pub_thread;
+  cRosErrCodePack err_cod;
+  uint64_t start_time, elapsed_time;
+  unsigned long n_lookups_ok = 0, n_lookups_failed = 0, n_wrong = 0, n_transforms_start;
+  clock_t start_cpu_time;
+  double rate, cpu_time;
+  int pubidx;
+
+  pub_node = cRosNodeCreate("/tf_bench_pub", "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+  sub_node = cRosNodeCreate("/tf_bench_sub", "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+  if(pub_node == NULL || sub_node == NULL)
+    return 0;
+  err_cod = cRosApiRegisterPublisher(pub_node, "/tf", "tf2_msgs/TFMessage", PUB_PERIOD, callback_pub, NULL, path, &pubidx);
+  if(err_cod != CROS_SUCCESS_ERR_PACK)
+  {
+    cRosPrintErrCodePack(err_cod, "cRosApiRegisterPublisher() failed; did you run this program one directory above 'rosdb'?");
+    return 0;
+  }
+  // Let the publisher register before the subscribers ask the master for it
+  cRosNodeStart(pub_node, 200, NULL);
+  err_cod = cRosTfBufferCreate(sub_node, CROS_TF_BUFFER_DEFAULT_CAPACITY, &buf);
+  if(err_cod != CROS_SUCCESS_ERR_PACK)
+  {
+    cRosPrintErrCodePack(err_cod, "cRosTfBufferCreate() failed");
+    return 0;
+  }
+  Exit_flag = 0;
+  if(!cRosThreadCreate(&pub_thread, runPublisher, pub_node))
+    return 0;
+
+  // Wait for the first transforms before measuring
+  start_time = cRosClockGetTimeMs();
+  while(buf->n_transforms == 0 && cRosClockGetTimeMs() - start_time < 2000)
+    cRosNodeDoEventsLoop(sub_node, 10);
+
+  n_transforms_start = buf->n_transforms;
+  start_cpu_time = clock();
+  start_time = cRosClockGetTimeMs();
+  while(cRosClockGetTimeMs() - start_time < run_secs * 1000)
+  {
+    cRosNodeDoEventsLoop(sub_node, 10);
+    if(cRosTfBufferLookup(buf, "odom", LOOKED_UP_FRAME, 0, &transform) == CROS_SUCCESS_ERR_PACK)
+    {
+      n_lookups_ok++;
+      if(!isExpectedTransform(&transform))
+        n_wrong++;
+    }
+    else
+      n_lookups_failed++;
+  }
+  elapsed_time = cRosClockGetTimeMs() - start_time;
+  cpu_time = (double)(clock() - start_cpu_time) / CLOCKS_PER_SEC;
+  Exit_flag = 1;
+  cRosThreadJoin(&pub_thread);
+
+  rate = (double)(buf->n_transforms - n_transforms_start) * 1000.0 / elapsed_time;
+  printf("  %-60s %7.0f transforms/s (%i frames, %lu discarded)\n", "inserted by the subscriber:", rate, buf->n_frames,
+         buf->n_discarded_transforms);
+  printf("  %-60s %7lu ok, %lu failed, %lu wrong\n", "lookups of "LOOKED_UP_FRAME" in odom:", n_lookups_ok, n_lookups_failed, n_wrong);
+  printf("  %-60s %7.1f %% of a CPU\n", "CPU time of the process (publisher and subscriber):", cpu_time * 100.0 * 1000.0 / elapsed_time);
+
+  cRosTfBufferDestroy(buf);
+  cRosNodeDestroy(sub_node);
+  cRosNodeDestroy(pub_node);
+
+  // The publication period is a minimum, so at least 80% of the nominal rate is required
+  if(rate < 0.8 * N_TRANSFORMS * (1000.0 / PUB_PERIOD) || n_lookups_ok == 0 || n_wrong != 0)
+  {
+    printf("The transforms were not received at the published rate or a lookup returned a wrong transform\n");
+    return 0;
+  }
+  return 1;
+}
+
+int main(int argc, char **argv)
+{
+  char path[4097];
+  unsigned long run_secs;
+  int frame_ind;
+
+  run_secs = (argc > 1)? (unsigned long)atoi(argv[1]) : DEFAULT_RUN_SECS;
+  if(run_secs == 0)
+  {
+    printf("Usage: %s [run period in seconds]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  getRosdbPath(path, sizeof(path));
+
+  strcpy(Frame_names[0], "base_link");
+  for(frame_ind = 1; frame_ind < N_TRANSFORMS; frame_ind++)
+    snprintf(Frame_names[frame_ind], sizeof(Frame_names[frame_ind]), "sensor%i", frame_ind);
+
+  printf("Transform buffer with %i frames and %i transforms per frame:\n", N_TRANSFORMS, CROS_TF_BUFFER_DEFAULT_CAPACITY);
+  if(!measureBuffer())
+    return EXIT_FAILURE;
+
+  printf("/tf with %i transforms every %i ms (%i transforms/s) for %lu s:\n", N_TRANSFORMS, PUB_PERIOD,
+         N_TRANSFORMS * (1000 / PUB_PERIOD), run_secs);
+  if(!measureTopic(path, run_secs))
+    return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
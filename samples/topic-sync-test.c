@@ -0,0 +1,221 @@
+/*! \file topic-sync-test.c
+ *  \brief This file checks the exact and approximate-time topic synchronizer (see cRosTopicSyncCreate()) with
+ *         synthetic stamps.
+ *
+ *  A publisher node, run by its own thread, publishes a geometry_msgs/TransformStamped on /sync_a and /sync_b every
+ *  PERIOD_AB ms and on /sync_c every PERIOD_C ms. The stamps are not the publication times but synthetic values: the
+ *  n-th message of a topic is stamped with STAMP_ORIGIN + n * (topic period), so the stamps of /sync_c match one of each
+ *  two stamps of /sync_a and /sync_b. A synchronizer of the three topics is run by the main thread four times:
+ *  - exact policy, queue of 50: every set must have identical stamps,
+ *  - approximate policy with a max interval of 5 ms, queue of 50, and a jitter of +-3 ms added to the stamps of
+ *    /sync_b: every set must be within the max interval,
+ *  - exact policy, queue of 3, with the stamps of /sync_c LAG ms older than the ones of the other topics published at
+ *    the same time: the matching messages of /sync_a and /sync_b have already left their queues, so no set must be
+ *    matched and the queues must never hold more than 3 messages,
+ *  - the same with a queue of 50, which holds the messages long enough for them to be matched.
+ *  It needs the ROS master and the message definitions described in sample_utils.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cros.h"
+#include "cros_clock.h"
+#include "cros_thread.h"
+#include "cros_topic_sync.h"
+#include "sample_utils.h"
+
+#define N_TOPICS 3
+#define PERIOD_AB 10               // Publication period (and stamp period) of /sync_a and /sync_b (in ms)
+#define PERIOD_C 20                // Publication period (and stamp period) of /sync_c (in ms)
+#define STAMP_ORIGIN 1000000000LL  // Stamp of the first message of each topic (in ns)
+#define MAX_JITTER 3               // Max jitter (in ms) added to the stamps of /sync_b in the approximate run
+#define MAX_INTERVAL 5000000       // Max interval (in ns) of the approximate policy
+#define LAG 60                     // Delay (in ms) of the stamps of /sync_c in the last two runs
+#define RUN_PERIOD 3000            // Time (in ms) during which the topics are received in each run
+
+typedef struct PublisherTopic PublisherTopic;
+struct PublisherTopic
+{
+  unsigned long n_msgs;            // Num. of messages published
+  int64_t period;                  // Period of the stamps (in ns)
+  int jitter;                      // 1 if a random jitter must be added to the stamps
+  int64_t lag;                     // Value subtracted from the stamps (in ns)
+};
+
+typedef struct SyncRun SyncRun;
+struct SyncRun
+{
+  CrosTopicSync *sync;
+  CrosTopicSyncPolicy policy;
+  unsigned long n_sets;
+  unsigned long n_bad_sets;        // Sets that do not satisfy the policy
+  int64_t max_spread;              // Max difference between the stamps of a set (in ns)
+  int max_queue_len;               // Max num. of messages observed in a queue of the synchronizer
+};
+
+static unsigned char Exit_flag;    // Set to 1 to stop the publisher thread of the current run
+
+static void setStamp(cRosMessage *msg, int64_t stamp)
+{
+  cRosMessage *header = cRosMessageGetField(msg, "header")->data.as_msg;
+  cRosMessage *time = cRosMessageGetField(header, "stamp")->data.as_msg;
+
+  cRosMessageGetField(time, "secs")->data.as_uint32 = (uint32_t)(stamp / 1000000000);
+  cRosMessageGetField(time, "nsecs")->data.as_uint32 = (uint32_t)(stamp % 1000000000);
+}
+
+static int64_t getStamp(cRosMessage *msg)
+{
+  cRosMessage *header = cRosMessageGetField(msg, "header")->data.as_msg;
+  cRosMessage *time = cRosMessageGetField(header, "stamp")->data.as_msg;
+
+  return (int64_t)cRosMessageGetField(time, "secs")->data.as_uint32 * 1000000000 + cRosMessageGetField(time, "nsecs")->data.as_uint32;
+}
+
+static CallbackResponse callback_pub(cRosMessage *message, void *data_context)
+{
+  PublisherTopic *topic = (PublisherTopic *)data_context;
+  int64_t jitter = (topic->jitter)? (int64_t)(rand() % (2 * MAX_JITTER + 1) - MAX_JITTER) * 1000000 : 0;
+
+  setStamp(message, STAMP_ORIGIN + (int64_t)topic->n_msgs++ * topic->period + jitter - topic->lag);
+  return 0; // 0=success
+}
+
+static void callback_sync(cRosMessage **msgs, int n_topics, void *context)
+{
+  SyncRun *run = (SyncRun *)context;
+  int64_t min_stamp = getStamp(msgs[0]), max_stamp = min_stamp, stamp;
+  int topic_ind;
+
+  for(topic_ind = 1; topic_ind < n_topics; topic_ind++)
+  {
+    stamp = getStamp(msgs[topic_ind]);
+    if(stamp < min_stamp)
+      min_stamp = stamp;
+    if(stamp > max_stamp)
+      max_stamp = stamp;
+  }
+  run->n_sets++;
+  if(max_stamp - min_stamp > run->max_spread)
+    run->max_spread = max_stamp - min_stamp;
+  if((run->policy == CROS_TOPIC_SYNC_EXACT && max_stamp != min_stamp) ||
+     (run->policy == CROS_TOPIC_SYNC_APPROXIMATE && max_stamp - min_stamp > MAX_INTERVAL))
+    run->n_bad_sets++;
+}
+
+static void runPublisher(void *node_ptr)
+{
+  cRosNodeStart((CrosNode *)node_ptr, CROS_INFINITE_TIMEOUT, &Exit_flag);
+}
+
+// Returns 0 if the nodes could not be set up
+static int runTest(const char *path, int run_ind, CrosTopicSyncPolicy policy, int jitter, int lag, int queue_size, int sets_expected)
+{
+  static const char *topic_names[N_TOPICS] = {"/sync_a", "/sync_b", "/sync_c"};
+  static const char *topic_types[N_TOPICS] = {"geometry_msgs/TransformStamped", "geometry_msgs/TransformStamped", "geometry_msgs/TransformStamped"};
+  PublisherTopic pub_topics[N_TOPICS];
+  SyncRun run;
+  CrosNode *pub_node, *sub_node;
+  cRosThread pub_thread;
+  cRosErrCodePack err_cod;
+  char node_name[64];
+  uint64_t start_time;
+  int topic_ind, pubidx, expected_sets;
+
+  snprintf(node_name, sizeof(node_name), "/topic_sync_test_pub_%i", run_ind);
+  pub_node = cRosNodeCreate(node_name, "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+  snprintf(node_name, sizeof(node_name), "/topic_sync_test_sub_%i", run_ind);
+  sub_node = cRosNodeCreate(node_name, "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+  if(pub_node == NULL || sub_node == NULL)
+    return 0;
+  err_cod = CROS_SUCCESS_ERR_PACK;
+  for(topic_ind = 0; topic_ind < N_TOPICS; topic_ind++)
+  {
+    pub_topics[topic_ind].n_msgs = 0;
+    pub_topics[topic_ind].period = (int64_t)((topic_ind == 2)? PERIOD_C : PERIOD_AB) * 1000000;
+    pub_topics[topic_ind].jitter = (jitter && topic_ind == 1);
+    pub_topics[topic_ind].lag = (topic_ind == 2)? (int64_t)lag * 1000000 : 0;
+    err_cod = cRosAddErrCodePackIfErr(err_cod, cRosApiRegisterPublisher(pub_node, topic_names[topic_ind], topic_types[topic_ind],
+                                      (topic_ind == 2)? PERIOD_C : PERIOD_AB, callback_pub, NULL, &pub_topics[topic_ind], &pubidx));
+  }
+  if(err_cod != CROS_SUCCESS_ERR_PACK)
+  {
+    cRosPrintErrCodePack(err_cod, "cRosApiRegisterPublisher() failed; did you run this program one directory above 'rosdb'?");
+    cRosNodeDestroy(sub_node);
+    cRosNodeDestroy(pub_node);
+    return 0;
+  }
+  // Let the publishers register before the subscribers ask the master for them
+  cRosNodeStart(pub_node, 200, NULL);
+
+  memset(&run, 0, sizeof(run));
+  run.policy = policy;
+  err_cod = cRosTopicSyncCreate(sub_node, topic_names, topic_types, N_TOPICS, policy, MAX_INTERVAL, queue_size, callback_sync, &run, &run.sync);
+  if(err_cod != CROS_SUCCESS_ERR_PACK)
+  {
+    cRosPrintErrCodePack(err_cod, "cRosTopicSyncCreate() failed");
+    cRosNodeDestroy(sub_node);
+    cRosNodeDestroy(pub_node);
+    return 0;
+  }
+  Exit_flag = 0;
+  if(!cRosThreadCreate(&pub_thread, runPublisher, pub_node))
+  {
+    cRosTopicSyncDestroy(run.sync);
+    cRosNodeDestroy(sub_node);
+    cRosNodeDestroy(pub_node);
+    return 0;
+  }
+
+  start_time = cRosClockGetTimeMs();
+  while(cRosClockGetTimeMs() - start_time < RUN_PERIOD)
+  {
+    cRosNodeDoEventsLoop(sub_node, 10);
+    for(topic_ind = 0; topic_ind < N_TOPICS; topic_ind++)
+      if(run.sync->queues[topic_ind].n_msgs > run.max_queue_len)
+        run.max_queue_len = run.sync->queues[topic_ind].n_msgs;
+  }
+  Exit_flag = 1;
+  cRosThreadJoin(&pub_thread);
+
+  printf("  %lu sets, max stamp spread %.1f ms, %lu messages discarded, max queue length %i\n", run.n_sets,
+         run.max_spread / 1e6, run.sync->n_discarded_msgs, run.max_queue_len);
+  // The first set depends on when each subscriber connected, so at least half of the /sync_c messages must be matched
+  expected_sets = (RUN_PERIOD / PERIOD_C) / 2;
+  if(sets_expected)
+    check(run.n_sets >= (unsigned long)expected_sets, "sets are matched at the rate of the slowest topic");
+  else
+    check(run.n_sets == 0 && run.sync->n_discarded_msgs > 0, "no set is matched and the unmatched messages are discarded");
+  check(run.n_bad_sets == 0, (policy == CROS_TOPIC_SYNC_EXACT)? "every set has identical stamps" : "every set is within the max interval");
+  check(run.max_queue_len <= queue_size, "no queue holds more messages than its size");
+
+  cRosTopicSyncDestroy(run.sync);
+  cRosNodeDestroy(sub_node);
+  cRosNodeDestroy(pub_node);
+  return 1;
+}
+
+int main(int argc, char **argv)
+{
+  char path[4097];
+
+  getRosdbPath(path, sizeof(path));
+  srand(1);
+
+  printf("Exact policy, queue of 50:\n");
+  if(!runTest(path, 0, CROS_TOPIC_SYNC_EXACT, 0, 0, 50, 1))
+    return EXIT_FAILURE;
+  printf("Approximate policy (max interval of %i ms), queue of 50, jitter of +-%i ms on /sync_b:\n", MAX_INTERVAL / 1000000, MAX_JITTER);
+  if(!runTest(path, 1, CROS_TOPIC_SYNC_APPROXIMATE, 1, 0, 50, 1))
+    return EXIT_FAILURE;
+  printf("Exact policy, queue of 3, stamps of /sync_c delayed %i ms:\n", LAG);
+  if(!runTest(path, 2, CROS_TOPIC_SYNC_EXACT, 0, LAG, 3, 0))
+    return EXIT_FAILURE;
+  printf("Exact policy, queue of 50, stamps of /sync_c delayed %i ms:\n", LAG);
+  if(!runTest(path, 3, CROS_TOPIC_SYNC_EXACT, 0, LAG, 50, 1))
+    return EXIT_FAILURE;
+
+  return checksExitStatus();
+}
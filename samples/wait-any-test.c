@@ -0,0 +1,157 @@
+/*! \file wait-any-test.c
+ *  \brief This file is an integration test of cRosNodeWaitAnyTopicMsg(), which waits for a message on any of
+ *         several subscribers.
+ *
+ *  A publisher node, run by its own thread, publishes a sequence number and its publication time on /wait_a
+ *  every PERIOD_A ms and on /wait_b every PERIOD_B ms. A subscriber node subscribes to both topics without callbacks
+ *  and checks that:
+ *  - waiting on both subscribers returns every message of both topics, in order and without losses,
+ *  - when both subscribers have messages, the first one in the list is returned,
+ *  - the timeout is reported with CROS_RCV_TOP_TIMEOUT_ERR when no message arrives,
+ *  - an invalid subscriber index is rejected with CROS_BAD_PARAM_ERR.
+ *  It also prints the latency from the publication of each message to the return of the wait.
+ *  It needs the ROS master and the message definitions described in sample_utils.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cros.h"
+#include "cros_clock.h"
+#include "cros_thread.h"
+#include "sample_utils.h"
+
+#define PERIOD_A 37                // Publication period of /wait_a (in ms)
+#define PERIOD_B 53                // Publication period of /wait_b (in ms)
+#define RUN_PERIOD 3000            // Time (in ms) during which the messages are received
+#define WAIT_TIME_OUT 1000         // Timeout (in ms) of each wait while the topics are being published
+#define IDLE_TIME_OUT 300          // Timeout (in ms) of the wait checked when nothing is published
+
+static unsigned char Exit_flag;    // Set to 1 to stop the publisher thread
+
+static CallbackResponse callback_pub(cRosMessage *message, void *data_context)
+{
+  unsigned long *seq = (unsigned long *)data_context;
+  char buf[64];
+
+  snprintf(buf, sizeof(buf), "%lu %llu", (*seq)++, (unsigned long long)cRosClockGetTimeStamp());
+  cRosMessageSetFieldValueString(cRosMessageGetField(message, "data"), buf);
+  return 0; // 0=success
+}
+
+static void runPublisher(void *node_ptr)
+{
+  cRosNodeStart((CrosNode *)node_ptr, CROS_INFINITE_TIMEOUT, &Exit_flag);
+}
+
+int main(int argc, char **argv)
+{
+  char path[4097];
+  CrosNode *pub_node, *sub_node;
+  cRosMessage *msg;
+  cRosThread pub_thread;
+  cRosErrCodePack err_cod;
+  unsigned long pub_seq[2] = {0, 0}, next_seq[2] = {0, 0}, n_rcv[2] = {0, 0}, n_lost = 0, n_timeouts = 0;
+  double latency_sum = 0.0, max_latency = 0.0;
+  uint64_t start_time;
+  int pubidx, subidx[2], reversed_subidx[2], rcv_subidx, topic, ind;
+  unsigned char overflow;
+
+  getRosdbPath(path, sizeof(path));
+
+  pub_node = cRosNodeCreate("/wait_any_test_pub", "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+  sub_node = cRosNodeCreate("/wait_any_test_sub", "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+  if(pub_node == NULL || sub_node == NULL)
+    return EXIT_FAILURE;
+  err_cod = cRosApiRegisterPublisher(pub_node, "/wait_a", "std_msgs/String", PERIOD_A, callback_pub, NULL, &pub_seq[0], &pubidx);
+  err_cod = cRosAddErrCodePackIfErr(err_cod, cRosApiRegisterPublisher(pub_node, "/wait_b", "std_msgs/String", PERIOD_B, callback_pub, NULL, &pub_seq[1], &pubidx));
+  if(err_cod != CROS_SUCCESS_ERR_PACK)
+  {
+    cRosPrintErrCodePack(err_cod, "cRosApiRegisterPublisher() failed; did you run this program one directory above 'rosdb'?");
+    return EXIT_FAILURE;
+  }
+  // Let the publishers register before the subscribers ask the master for them
+  cRosNodeStart(pub_node, 200, NULL);
+  err_cod = cRosApiRegisterSubscriber(sub_node, "/wait_a", "std_msgs/String", NULL, NULL, NULL, 1, &subidx[0]);
+  err_cod = cRosAddErrCodePackIfErr(err_cod, cRosApiRegisterSubscriber(sub_node, "/wait_b", "std_msgs/String", NULL, NULL, NULL, 1, &subidx[1]));
+  if(err_cod != CROS_SUCCESS_ERR_PACK || cRosMessageNewBuild(path, "std_msgs/String", &msg) != CROS_SUCCESS_ERR_PACK)
+  {
+    cRosPrintErrCodePack(err_cod, "cRosApiRegisterSubscriber() failed");
+    return EXIT_FAILURE;
+  }
+  Exit_flag = 0;
+  if(!cRosThreadCreate(&pub_thread, runPublisher, pub_node))
+    return EXIT_FAILURE;
+
+  printf("Receiving /wait_a (every %i ms) and /wait_b (every %i ms) for %i ms:\n", PERIOD_A, PERIOD_B, RUN_PERIOD);
+  start_time = cRosClockGetTimeMs();
+  while(cRosClockGetTimeMs() - start_time < RUN_PERIOD)
+  {
+    unsigned long seq;
+    unsigned long long pub_time;
+    uint64_t wake_up_time;
+    double latency;
+
+    err_cod = cRosNodeWaitAnyTopicMsg(sub_node, subidx, 2, &rcv_subidx, WAIT_TIME_OUT);
+    if(err_cod != CROS_SUCCESS_ERR_PACK)
+    {
+      n_timeouts++;
+      continue;
+    }
+    wake_up_time = cRosClockGetTimeStamp();
+    topic = (rcv_subidx == subidx[0])? 0 : 1;
+    if(cRosNodeReceiveTopicMsg(sub_node, rcv_subidx, msg, &overflow, 0) != CROS_SUCCESS_ERR_PACK ||
+       sscanf(cRosMessageGetField(msg, "data")->data.as_string, "%lu %llu", &seq, &pub_time) != 2)
+    {
+      n_lost++;
+      continue;
+    }
+    latency = (double)(wake_up_time - pub_time) / 1e6;
+    latency_sum += latency;
+    if(latency > max_latency)
+      max_latency = latency;
+    if(n_rcv[topic] > 0 && seq != next_seq[topic]) // The first message received depends on when the connection was done
+      n_lost += seq - next_seq[topic];
+    if(overflow)
+      n_lost++;
+    next_seq[topic] = seq + 1;
+    n_rcv[topic]++;
+  }
+  printf("  received %lu messages of /wait_a and %lu of /wait_b; wake-up latency: mean %.3f ms, max %.3f ms\n",
+         n_rcv[0], n_rcv[1], (n_rcv[0] + n_rcv[1] > 0)? latency_sum / (n_rcv[0] + n_rcv[1]) : 0.0, max_latency);
+  check(n_rcv[0] >= (RUN_PERIOD / PERIOD_A) / 2 && n_rcv[1] >= (RUN_PERIOD / PERIOD_B) / 2, "both topics are received");
+  check(n_lost == 0, "no message of either topic is lost or reordered");
+  check(n_timeouts == 0, "no wait times out while the topics are published");
+
+  // Let both queues get messages: the first subscriber in the list must win in both orders
+  while(cRosMessageQueueUsage(&sub_node->subs[subidx[0]].msg_queue) == 0 || cRosMessageQueueUsage(&sub_node->subs[subidx[1]].msg_queue) == 0)
+    cRosNodeDoEventsLoop(sub_node, 10);
+  reversed_subidx[0] = subidx[1];
+  reversed_subidx[1] = subidx[0];
+  err_cod = cRosNodeWaitAnyTopicMsg(sub_node, reversed_subidx, 2, &rcv_subidx, 0);
+  check(err_cod == CROS_SUCCESS_ERR_PACK && rcv_subidx == subidx[1], "with messages on both, the first subscriber of the list is returned (b, a)");
+  err_cod = cRosNodeWaitAnyTopicMsg(sub_node, subidx, 2, &rcv_subidx, 0);
+  check(err_cod == CROS_SUCCESS_ERR_PACK && rcv_subidx == subidx[0], "with messages on both, the first subscriber of the list is returned (a, b)");
+
+  // Stop publishing and empty the queues: the wait must time out
+  Exit_flag = 1;
+  cRosThreadJoin(&pub_thread);
+  cRosNodeStart(sub_node, 100, NULL);
+  for(ind = 0; ind < 2; ind++)
+    while(cRosNodeReceiveTopicMsg(sub_node, subidx[ind], msg, NULL, 0) == CROS_SUCCESS_ERR_PACK);
+  start_time = cRosClockGetTimeMs();
+  err_cod = cRosNodeWaitAnyTopicMsg(sub_node, subidx, 2, &rcv_subidx, IDLE_TIME_OUT);
+  check(err_cod == CROS_RCV_TOP_TIMEOUT_ERR && rcv_subidx == -1 && cRosClockGetTimeMs() - start_time >= IDLE_TIME_OUT,
+        "without messages, the wait times out after the specified time");
+
+  reversed_subidx[1] = CN_MAX_SUBSCRIBED_TOPICS; // Invalid subscriber index
+  err_cod = cRosNodeWaitAnyTopicMsg(sub_node, reversed_subidx, 2, &rcv_subidx, 0);
+  check(err_cod == CROS_BAD_PARAM_ERR, "an invalid subscriber index is rejected");
+
+  cRosMessageFree(msg);
+  cRosNodeDestroy(sub_node);
+  cRosNodeDestroy(pub_node);
+
+  return checksExitStatus();
+}
@@ -0,0 +1,226 @@
+/*! \file zerocopy-bench.c
+ *  \brief This file measures the CPU time that a publisher spends per GB sent with and without zero-copy sends
+ *         (see cRosNodeSetPublisherZeroCopy()), for 1 to MAX_SUBSCRIBERS subscribers.
+ *
+ *  For each number of subscribers and each mode (copying sends and zero-copy sends of the messages of at least
+ *  ZEROCOPY_MIN_SIZE bytes), it creates a publisher node, run by the main thread, and the subscriber nodes of the topic
+ *  /zerocopy_bench, each one run by its own thread. After a warm-up period, in which the subscribers connect, the
+ *  publisher queues a large std_msgs/String message back to back (cRosNodeSendTopicMsg()) during the measurement period.
+ *  The CPU time of the publisher thread per GB received by all the subscribers and the number of zero-copy sends are
+ *  printed. Each message is filled with a different character, and the subscribers check that the messages have not been
+ *  modified while they were being sent.
+ *  On loopback the kernel reports that it had to copy the data of the zero-copy sends, so the connections fall back to
+ *  copying sends after the first ones, and only the copy of each message to the connection buffers is saved. The saving of
+ *  the zero-copy sends themselves needs a network device with scatter-gather DMA.
+ *  It needs the ROS master and the message definitions described in sample_utils.h.
+ *
+ *  Usage: zerocopy-bench [message size in KB] [measurement period in seconds]
+ */
+
+#ifdef __linux__
+#  ifndef _GNU_SOURCE
+#    define _GNU_SOURCE // RUSAGE_THREAD
+#  endif
+#  include <sys/resource.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cros.h"
+#include "cros_clock.h"
+#include "cros_thread.h"
+#include "sample_utils.h"
+
+#define MAX_SUBSCRIBERS 8          // Up to CN_MAX_TCPROS_SERVER_CONNECTIONS
+#define ZEROCOPY_MIN_SIZE (64 * 1024) // Writes of at least this size (in bytes) are sent with zero-copy in the zero-copy mode
+#define WARM_UP_PERIOD 1000        // Time (in ms) given to the subscribers to connect before measuring
+#define SEND_TIME_OUT 100          // Max time (in ms) waited for room in the publisher queue
+#define DEFAULT_MSG_SIZE_KB 1024
+#define DEFAULT_MEASURE_SECS 3
+
+#if MAX_SUBSCRIBERS > CN_MAX_TCPROS_SERVER_CONNECTIONS
+#  error "The publisher node cannot accept MAX_SUBSCRIBERS connections"
+#endif
+
+typedef struct SubscriberRun SubscriberRun;
+struct SubscriberRun
+{
+  CrosNode *node;
+  uint64_t measure_start;          // Only the messages received in [measure_start, measure_end) (in ms) are counted
+  uint64_t measure_end;
+  uint64_t rcv_bytes;
+  unsigned long bad_msgs;          // Messages whose size or content is not the published one
+};
+
+static size_t Msg_size;            // Length of the string of the published message
+static unsigned char Exit_flag;    // Set to 1 to stop the threads of the current run
+
+static CallbackResponse callback_sub(cRosMessage *message, void *data_context)
+{
+  SubscriberRun *run = (SubscriberRun *)data_context;
+  const char *data = cRosMessageGetField(message, "data")->data.as_string;
+  uint64_t cur_time = cRosClockGetTimeMs();
+
+  // All the characters of a message are equal: a message modified while it was being sent would have several ones
+  if(strlen(data) != Msg_size || data[0] != data[Msg_size / 2] || data[0] != data[Msg_size - 1])
+    run->bad_msgs++;
+  else if(cur_time >= run->measure_start && cur_time < run->measure_end)
+    run->rcv_bytes += Msg_size;
+  return 0; // 0=success
+}
+
+static void runSubscriber(void *run_ptr)
+{
+  SubscriberRun *run = (SubscriberRun *)run_ptr;
+  cRosNodeStart(run->node, CROS_INFINITE_TIMEOUT, &Exit_flag);
+}
+
+// CPU time (in s) consumed by the calling thread (by the whole process if the platform cannot measure threads)
+static double threadCpuTime(void)
+{
+#ifdef RUSAGE_THREAD
+  struct rusage usage;
+  if(getrusage(RUSAGE_THREAD, &usage) == 0)
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#endif
+  return (double)clock() / CLOCKS_PER_SEC;
+}
+
+// Returns the CPU time (in s) of the publisher thread per GB received by all the subscribers, or a negative value on error.
+// The number of zero-copy sends of the publisher and the number of bad messages are stored in zerocopy_sends and bad_msgs
+static double measureCpuPerGB(const char *path, int n_subs, size_t zerocopy_min_size, unsigned long measure_secs,
+                              unsigned long *zerocopy_sends, unsigned long *bad_msgs)
+{
+  CrosNode *pub_node;
+  cRosMessage *msg;
+  char *msg_data;
+  SubscriberRun sub_runs[MAX_SUBSCRIBERS];
+  cRosThread sub_threads[MAX_SUBSCRIBERS];
+  int sub_started[MAX_SUBSCRIBERS];
+  char node_name[64];
+  uint64_t rcv_bytes = 0, measure_start, measure_end;
+  double start_cpu_time, cpu_time;
+  unsigned long n_msgs = 0;
+  cRosErrCodePack err_cod;
+  int pubidx, subidx, ind;
+
+  snprintf(node_name, sizeof(node_name), "/zerocopy_bench_pub_%i_%lu", n_subs, (unsigned long)zerocopy_min_size);
+  pub_node = cRosNodeCreate(node_name, "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+  if(pub_node == NULL)
+    return -1.0;
+  // The messages are only published when they are queued
+  err_cod = cRosApiRegisterPublisher(pub_node, "/zerocopy_bench", "std_msgs/String", -1, NULL, NULL, NULL, &pubidx);
+  if(err_cod == CROS_SUCCESS_ERR_PACK && zerocopy_min_size > 0)
+    err_cod = cRosNodeSetPublisherZeroCopy(pub_node, pubidx, zerocopy_min_size);
+  msg = (err_cod == CROS_SUCCESS_ERR_PACK)? cRosApiCreatePublisherMessage(pub_node, pubidx) : NULL;
+  msg_data = (char *)malloc(Msg_size + 1);
+  if(msg == NULL || msg_data == NULL)
+  {
+    cRosPrintErrCodePack(err_cod, "The publisher could not be set up");
+    free(msg_data);
+    cRosMessageFree(msg);
+    cRosNodeDestroy(pub_node);
+    return -1.0;
+  }
+  // Let the publisher register before the subscribers ask the master for it
+  cRosNodeStart(pub_node, 200, NULL);
+
+  Exit_flag = 0;
+  measure_start = cRosClockGetTimeMs() + WARM_UP_PERIOD;
+  measure_end = measure_start + measure_secs * 1000;
+  for(ind = 0; ind < n_subs; ind++)
+  {
+    snprintf(node_name, sizeof(node_name), "/zerocopy_bench_sub_%i_%i", n_subs, ind);
+    sub_runs[ind].node = cRosNodeCreate(node_name, "127.0.0.1", ROS_MASTER_ADDRESS, ROS_MASTER_PORT, path);
+    sub_runs[ind].measure_start = measure_start;
+    sub_runs[ind].measure_end = measure_end;
+    sub_runs[ind].rcv_bytes = 0;
+    sub_runs[ind].bad_msgs = 0;
+    sub_started[ind] = 0;
+    if(sub_runs[ind].node != NULL &&
+       cRosApiRegisterSubscriber(sub_runs[ind].node, "/zerocopy_bench", "std_msgs/String", callback_sub, NULL, &sub_runs[ind], 0, &subidx) == CROS_SUCCESS_ERR_PACK)
+      sub_started[ind] = cRosThreadCreate(&sub_threads[ind], runSubscriber, &sub_runs[ind]);
+  }
+
+  cRosNodeStart(pub_node, WARM_UP_PERIOD, NULL);
+
+  // Keep the publisher queue full: cRosNodeSendTopicMsg() runs the event loop until there is room for the message
+  start_cpu_time = threadCpuTime();
+  while(cRosClockGetTimeMs() < measure_end && err_cod == CROS_SUCCESS_ERR_PACK)
+  {
+    memset(msg_data, 'a' + n_msgs++ % 26, Msg_size);
+    msg_data[Msg_size] = '\0';
+    // The message is copied to the publisher queue, so it can be changed as soon as the function returns
+    if(cRosMessageSetFieldValueString(cRosMessageGetField(msg, "data"), msg_data) != 0)
+      err_cod = CROS_MEM_ALLOC_ERR;
+    else
+      err_cod = cRosNodeSendTopicMsg(pub_node, pubidx, msg, SEND_TIME_OUT);
+  }
+  cpu_time = threadCpuTime() - start_cpu_time;
+  if(err_cod != CROS_SUCCESS_ERR_PACK)
+    cRosPrintErrCodePack(err_cod, "The messages could not be published");
+
+  *zerocopy_sends = 0;
+  for(ind = 0; ind < CN_MAX_TCPROS_SERVER_CONNECTIONS; ind++)
+    *zerocopy_sends += pub_node->tcpros_server_proc[ind].socket.zerocopy_sent;
+
+  // The publisher is destroyed while the subscribers are still connected, so it does not write to closed connections
+  free(msg_data);
+  cRosMessageFree(msg);
+  cRosNodeDestroy(pub_node);
+  Exit_flag = 1;
+  *bad_msgs = 0;
+  for(ind = 0; ind < n_subs; ind++)
+  {
+    if(sub_started[ind])
+      cRosThreadJoin(&sub_threads[ind]);
+    if(sub_runs[ind].node != NULL)
+      cRosNodeDestroy(sub_runs[ind].node);
+    rcv_bytes += sub_runs[ind].rcv_bytes;
+    *bad_msgs += sub_runs[ind].bad_msgs;
+  }
+
+  if(err_cod != CROS_SUCCESS_ERR_PACK || rcv_bytes == 0)
+    return -1.0;
+  return cpu_time / ((double)rcv_bytes / (1024.0 * 1024.0 * 1024.0));
+}
+
+int main(int argc, char **argv)
+{
+  static const int n_subs_list[] = {1, 2, 4, MAX_SUBSCRIBERS};
+  char path[4097];
+  unsigned long measure_secs, copy_zc_sends, zc_sends, copy_bad_msgs, zc_bad_msgs;
+  size_t ind;
+
+  Msg_size = (argc > 1)? (size_t)atoi(argv[1]) * 1024 : DEFAULT_MSG_SIZE_KB * 1024;
+  measure_secs = (argc > 2)? (unsigned long)atoi(argv[2]) : DEFAULT_MEASURE_SECS;
+  if(Msg_size == 0 || measure_secs == 0)
+  {
+    printf("Usage: %s [message size in KB] [measurement period in seconds]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  getRosdbPath(path, sizeof(path));
+
+  printf("CPU time of the publisher thread per GB of %lu KB messages published back to back (%lu s per run):\n",
+         (unsigned long)(Msg_size / 1024), measure_secs);
+  printf("  subscribers   copying sends (s/GB)   zero-copy sends from %lu KB (s/GB)   zero-copy sends made\n",
+         (unsigned long)(ZEROCOPY_MIN_SIZE / 1024));
+  for(ind = 0; ind < sizeof(n_subs_list) / sizeof(n_subs_list[0]); ind++)
+  {
+    double copy_cpu = measureCpuPerGB(path, n_subs_list[ind], 0, measure_secs, &copy_zc_sends, &copy_bad_msgs);
+    double zc_cpu = measureCpuPerGB(path, n_subs_list[ind], ZEROCOPY_MIN_SIZE, measure_secs, &zc_sends, &zc_bad_msgs);
+    if(copy_cpu < 0.0 || zc_cpu < 0.0)
+    {
+      printf("  %11i   the run failed; is the master running?\n", n_subs_list[ind]);
+      return EXIT_FAILURE;
+    }
+    printf("  %11i   %20.3f   %32.3f   %20lu\n", n_subs_list[ind], copy_cpu, zc_cpu, zc_sends);
+    check(copy_bad_msgs == 0 && zc_bad_msgs == 0, "the subscribers received the messages unmodified");
+  }
+
+  return checksExitStatus();
+}
@@ -75,6 +75,12 @@ typedef struct ProviderContext
   void *api_callback; //! The application-defined callback function called to generate outgoing data or to handle the received data
   NodeStatusApiCallback status_api_callback; //! The application-defined callback function called when the state of the role has chnaged
   cRosMessageQueue *msg_queue; //! It is just a reference to the queue declared in node. For the publisher: it is msgs to send. For the subscriber: it is msgs received. For the svc caller: it is first svc request and then svc response
+  cRosMessage **msg_pool; //! Subscriber: free messages that replace the incoming message when the callback retains it
+  int msg_pool_size; //! Capacity of msg_pool. 0 if the subscriber messages cannot be retained
+  int n_pool_msgs; //! Number of free messages currently in msg_pool
+  cRosMessageParallelism *parallelism; //! Parallel (de)serialization settings of the node of the provider
+  unsigned char any_type; //! Subscriber registered with the type CROS_ANY_MSG_TYPE: the type is taken from the publisher connection headers
+  char *msg_type; //! Subscriber of any type: type of the received messages. NULL until the first publisher connects
   void *context; //! Context parameter specified by the application and that will be passed to the application-defined callback functions
 } ProviderContext;
 
@@ -88,6 +94,12 @@ static void initProviderContext(ProviderContext *context)
   context->status_api_callback=NULL;
   context->api_callback=NULL;
   context->msg_queue=NULL;
+  context->msg_pool=NULL;
+  context->msg_pool_size=0;
+  context->n_pool_msgs=0;
+  context->parallelism=NULL;
+  context->any_type=0;
+  context->msg_type=NULL;
   context->context=NULL;
 }
 
@@ -95,10 +107,14 @@ static void freeProviderContext(ProviderContext *context)
 {
   if(context != NULL)
   {
+    while(context->n_pool_msgs > 0)
+      cRosMessageFree(context->msg_pool[--context->n_pool_msgs]);
+    free(context->msg_pool);
     cRosMessageFree(context->incoming);
     cRosMessageFree(context->outgoing);
     free(context->message_definition);
     free(context->md5sum);
+    free(context->msg_type);
     free(context);
   }
 }
@@ -140,7 +156,9 @@ static cRosErrCodePack newProviderContext(const char *provider_path, ProviderTyp
       if (ret_err == CROS_SUCCESS_ERR_PACK)
       {
         strcpy(context->md5sum, context->outgoing->md5sum);
-        context->message_definition = strdup(context->outgoing->msgDef->plain_text);
+        context->message_definition = cRosMessageDefGetFullText(context->outgoing->msgDef); // Include the custom types, so that subscribers of any type can build the definition
+        if (context->message_definition == NULL)
+          ret_err = CROS_MEM_ALLOC_ERR;
       }
       break;
     }
@@ -169,12 +187,36 @@ static cRosErrCodePack newProviderContext(const char *provider_path, ProviderTyp
   return ret_err;
 }
 
+// Create the context of a subscriber of any type. Its incoming message has no fields until the first publisher connects
+static cRosErrCodePack newAnyTypeSubscriberContext(ProviderContext **context_ptr)
+{
+  ProviderContext *context = (ProviderContext *)malloc(sizeof(ProviderContext));
+  if (context == NULL)
+    return CROS_MEM_ALLOC_ERR;
+
+  initProviderContext(context);
+  context->type = CROS_SUBSCRIBER;
+  context->any_type = 1;
+  context->md5sum = (char *)calloc(sizeof(char), 33);// 32 chars + '\0';
+  context->message_definition = strdup(CROS_ANY_MSG_TYPE);
+  context->incoming = cRosMessageNew();
+  if (context->md5sum == NULL || context->message_definition == NULL || context->incoming == NULL)
+  {
+    freeProviderContext(context);
+    return CROS_MEM_ALLOC_ERR;
+  }
+  strcpy(context->md5sum, CROS_ANY_MSG_TYPE);
+
+  *context_ptr = context;
+  return CROS_SUCCESS_ERR_PACK;
+}
+
 cRosErrCodePack cRosNodeSerializeOutgoingMessage(DynBuffer *buffer, void *context_)
 {
   cRosErrCodePack ret_err;
   ProviderContext *context = (ProviderContext *)context_;
 
-  ret_err = cRosMessageSerialize(context->outgoing, buffer);
+  ret_err = cRosMessageSerializeParallel(context->outgoing, buffer, context->parallelism);
   return(ret_err);
 }
 
@@ -183,10 +225,111 @@ cRosErrCodePack cRosNodeDeserializeIncomingPacket(DynBuffer *buffer, void *conte
   cRosErrCodePack ret_err;
   ProviderContext *context = (ProviderContext *)context_;
 
-  ret_err = cRosMessageDeserialize(context->incoming, buffer);
+  ret_err = cRosMessageDeserializeParallel(context->incoming, buffer, context->parallelism);
   return(ret_err);
 }
 
+cRosMessage *cRosNodeGetOutgoingMessage(void *context_)
+{
+  ProviderContext *context = (ProviderContext *)context_;
+  return context->outgoing;
+}
+
+cRosMessage *cRosNodeGetIncomingMessage(void *context_)
+{
+  ProviderContext *context = (ProviderContext *)context_;
+  return context->incoming;
+}
+
+int cRosNodeIsAnyTypeSubscriber(void *context_)
+{
+  ProviderContext *context = (ProviderContext *)context_;
+  return context->any_type;
+}
+
+cRosErrCodePack cRosNodeSetIncomingType(void *context_, const char *msg_type, const char *md5sum, const char *full_text, int can_change)
+{
+  cRosErrCodePack ret_err;
+  ProviderContext *context = (ProviderContext *)context_;
+  cRosMessage *new_incoming;
+  char *new_msg_type, *new_definition;
+  int i;
+
+  if (!context->any_type || strlen(md5sum) != 32)
+    return CROS_BAD_PARAM_ERR;
+
+  if (context->msg_type != NULL && strcmp(context->md5sum, md5sum) == 0)
+    return CROS_SUCCESS_ERR_PACK; // The definition of this type has already been built
+
+  if (context->msg_type != NULL && !can_change)
+  {
+    PRINT_ERROR ( "cRosNodeSetIncomingType() : The publisher type %s differs from the type %s of the other connected publishers\n", msg_type, context->msg_type);
+    return CROS_BAD_PARAM_ERR;
+  }
+
+  ret_err = cRosMessageNewBuildFromText(msg_type, full_text, &new_incoming);
+  if (ret_err != CROS_SUCCESS_ERR_PACK)
+  {
+    cRosPrintErrCodePack(ret_err, "cRosNodeSetIncomingType() failed building the definition of %s sent by the publisher", msg_type);
+    return ret_err;
+  }
+  if (strcmp(new_incoming->md5sum, md5sum) != 0)
+    PRINT_INFO ( "cRosNodeSetIncomingType() WARNING : The MD5 sum of the definition of %s (%s) differs from the one sent by the publisher (%s)\n",
+                 msg_type, new_incoming->md5sum, md5sum);
+
+  new_msg_type = strdup(msg_type);
+  new_definition = strdup(full_text);
+  if (new_msg_type == NULL || new_definition == NULL)
+  {
+    free(new_msg_type);
+    free(new_definition);
+    cRosMessageFree(new_incoming);
+    return CROS_MEM_ALLOC_ERR;
+  }
+
+  // The incoming message and the free messages of the pool have the previous type
+  cRosMessageFree(context->incoming);
+  context->incoming = new_incoming;
+  for (i = 0; i < context->n_pool_msgs; i++)
+  {
+    cRosMessageFree(context->msg_pool[i]);
+    context->msg_pool[i] = cRosMessageCopy(new_incoming);
+    if (context->msg_pool[i] == NULL)
+    {
+      int j;
+      for (j = i + 1; j < context->n_pool_msgs; j++)
+        cRosMessageFree(context->msg_pool[j]);
+      context->n_pool_msgs = i;
+    }
+  }
+
+  free(context->msg_type);
+  context->msg_type = new_msg_type;
+  free(context->message_definition);
+  context->message_definition = new_definition;
+  strcpy(context->md5sum, md5sum);
+
+  PRINT_INFO ( "cRosNodeSetIncomingType() : Subscriber of any type receiving messages of type %s\n", msg_type);
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+int cRosNodeGetIncomingHeader(void *context_, uint32_t *seq, uint32_t *stamp_secs, uint32_t *stamp_nsecs)
+{
+  ProviderContext *context = (ProviderContext *)context_;
+  cRosMessage *header, *stamp;
+
+  if(context->incoming == NULL || context->incoming->n_fields == 0 ||
+     context->incoming->fields[0]->type != CROS_STD_MSGS_HEADER || context->incoming->fields[0]->is_array)
+    return 0;
+
+  header = context->incoming->fields[0]->data.as_msg; // Fields: seq, stamp and frame_id
+  stamp = header->fields[1]->data.as_msg; // Fields: secs and nsecs
+  *seq = header->fields[0]->data.as_uint32;
+  *stamp_secs = stamp->fields[0]->data.as_uint32;
+  *stamp_nsecs = stamp->fields[1]->data.as_uint32;
+  return 1;
+}
+
 cRosErrCodePack cRosNodePublisherCallback(void *context_)
 {
   cRosErrCodePack ret_err;
@@ -223,7 +366,8 @@ cRosErrCodePack cRosNodeSubscriberCallback(void *context_)
 {
   cRosErrCodePack ret_err;
   ProviderContext *context = (ProviderContext *)context_;
-  cRosMessageQueueAdd(context->msg_queue, context->incoming);
+  if(context->msg_pool_size == 0) // Messages that can be retained by the callback are not copied to the queue
+    cRosMessageQueueAdd(context->msg_queue, context->incoming);
 
   // Cast to the appropriate public api callback and invoke it on the user context
   SubscriberApiCallback subs_user_callback_fn = (SubscriberApiCallback)context->api_callback;
@@ -302,6 +446,20 @@ cRosErrCodePack cRosNodeServiceCallerCallback(int call_resp_flag, void* contex_)
   return ret_err;
 }
 
+void cRosNodeServiceCallerSwapMessages(void *context_, cRosMessage **request, cRosMessage **response)
+{
+  ProviderContext *context = (ProviderContext *)context_;
+  cRosMessage *tmp_msg;
+
+  tmp_msg = context->outgoing;
+  context->outgoing = *request;
+  *request = tmp_msg;
+
+  tmp_msg = context->incoming;
+  context->incoming = *response;
+  *response = tmp_msg;
+}
+
 cRosErrCodePack cRosNodeServiceProviderCallback(void *context_)
 {
   cRosErrCodePack ret_err;
@@ -343,6 +501,7 @@ cRosErrCodePack cRosApiRegisterServiceCaller(CrosNode *node, const char *service
     nodeContext->api_callback = callback;
     nodeContext->status_api_callback = status_callback;
     nodeContext->context = context;
+    nodeContext->parallelism = &node->serialization_parallelism;
 
     // NB: Pass the private ProviderContext to the private api, not the user context
     svcidx = cRosNodeRegisterServiceCaller(node, nodeContext->message_definition, service_name, service_type, nodeContext->md5sum,
@@ -385,6 +544,7 @@ cRosErrCodePack cRosApiRegisterServiceProvider(CrosNode *node, const char *servi
     nodeContext->api_callback = callback;
     nodeContext->status_api_callback = status_callback;
     nodeContext->context = context;
+    nodeContext->parallelism = &node->serialization_parallelism;
 
     // NB: Pass the private ProviderContext to the private api, not the user context
     svcidx = cRosNodeRegisterServiceProvider(node, service_name, service_type, nodeContext->md5sum, nodeContext);
@@ -430,13 +590,19 @@ cRosErrCodePack cRosApiRegisterSubscriber(CrosNode *node, const char *topic_name
   ProviderContext *nodeContext = NULL;
   int subidx;
 
-  cRosGetMsgFilePath(node, path, OS_MAX_PATH, topic_type);
-  ret_err = newProviderContext(path, CROS_SUBSCRIBER, &nodeContext);
+  if (strcmp(topic_type, CROS_ANY_MSG_TYPE) == 0) // The type is taken from the publishers (see cRosNodeSetIncomingType())
+    ret_err = newAnyTypeSubscriberContext(&nodeContext);
+  else
+  {
+    cRosGetMsgFilePath(node, path, OS_MAX_PATH, topic_type);
+    ret_err = newProviderContext(path, CROS_SUBSCRIBER, &nodeContext);
+  }
   if (ret_err == CROS_SUCCESS_ERR_PACK)
   {
     nodeContext->api_callback = callback;
     nodeContext->status_api_callback = status_callback;
     nodeContext->context = context;
+    nodeContext->parallelism = &node->serialization_parallelism;
 
   // NB: Pass the private ProviderContext to the private api, not the user context
     subidx = cRosNodeRegisterSubscriber(node, nodeContext->message_definition, topic_name, topic_type,
@@ -476,6 +642,110 @@ void cRosApiReleaseSubscriber(CrosNode *node, int subidx)
   cRosNodeReleaseSubscriber(sub);
 }
 
+cRosErrCodePack cRosApiSetSubscriberMessagePool(CrosNode *node, int subidx, int pool_size)
+{
+  ProviderContext *context;
+  cRosMessage **new_pool;
+
+  if (node == NULL || subidx < 0 || subidx >= CN_MAX_SUBSCRIBED_TOPICS || pool_size < 0)
+    return CROS_BAD_PARAM_ERR;
+
+  if (node->subs[subidx].topic_name == NULL)
+    return CROS_TOPIC_SUB_IND_ERR;
+
+  context = (ProviderContext *)node->subs[subidx].context;
+
+  // Free the current pool: the messages retained now are freed when they are released
+  while(context->n_pool_msgs > 0)
+    cRosMessageFree(context->msg_pool[--context->n_pool_msgs]);
+  free(context->msg_pool);
+  context->msg_pool = NULL;
+  context->msg_pool_size = 0;
+
+  if (pool_size == 0) // Retention disabled
+    return CROS_SUCCESS_ERR_PACK;
+
+  new_pool = (cRosMessage **)calloc(pool_size, sizeof(cRosMessage *));
+  if (new_pool == NULL)
+    return CROS_MEM_ALLOC_ERR;
+  context->msg_pool = new_pool;
+  context->msg_pool_size = pool_size;
+
+  // The pool messages are allocated now, so that no memory is allocated when a message is retained
+  while(context->n_pool_msgs < pool_size)
+  {
+    cRosMessage *new_msg = cRosMessageCopy(context->incoming);
+    if (new_msg == NULL)
+      return CROS_MEM_ALLOC_ERR;
+    context->msg_pool[context->n_pool_msgs++] = new_msg;
+  }
+
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosMessage *cRosApiRetainSubscriberMessage(CrosNode *node, int subidx)
+{
+  ProviderContext *context;
+  cRosMessage *retained_msg;
+
+  if (node == NULL || subidx < 0 || subidx >= CN_MAX_SUBSCRIBED_TOPICS || node->subs[subidx].topic_name == NULL)
+    return NULL;
+
+  context = (ProviderContext *)node->subs[subidx].context;
+  if (context->n_pool_msgs == 0) // Retention disabled or all the pool messages are retained
+    return NULL;
+
+  // Swap buffers: the next message will be received in a free message of the pool
+  retained_msg = context->incoming;
+  context->incoming = context->msg_pool[--context->n_pool_msgs];
+
+  return retained_msg;
+}
+
+cRosErrCodePack cRosApiReleaseSubscriberMessage(CrosNode *node, int subidx, cRosMessage *msg)
+{
+  ProviderContext *context;
+
+  if (node == NULL || subidx < 0 || subidx >= CN_MAX_SUBSCRIBED_TOPICS || msg == NULL)
+    return CROS_BAD_PARAM_ERR;
+
+  if (node->subs[subidx].topic_name == NULL)
+  {
+    cRosMessageFree(msg); // The subscriber (and its pool) does not exist anymore
+    return CROS_TOPIC_SUB_IND_ERR;
+  }
+
+  context = (ProviderContext *)node->subs[subidx].context;
+  if (context->n_pool_msgs < context->msg_pool_size && strcmp(msg->md5sum, context->incoming->md5sum) == 0)
+    context->msg_pool[context->n_pool_msgs++] = msg;
+  else
+    cRosMessageFree(msg); // The pool has been shrunk or, for a subscriber of any type, the type has changed while the message was retained
+
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosErrCodePack cRosApiGetSubscriberMessageType(CrosNode *node, int subidx, const char **msg_type, const char **md5sum, const char **definition)
+{
+  ProviderContext *context;
+  SubscriberNode *sub;
+
+  if (node == NULL || subidx < 0 || subidx >= CN_MAX_SUBSCRIBED_TOPICS)
+    return CROS_BAD_PARAM_ERR;
+
+  sub = &node->subs[subidx];
+  if (sub->topic_name == NULL)
+    return CROS_TOPIC_SUB_IND_ERR;
+
+  context = (ProviderContext *)sub->context;
+  if (msg_type != NULL)
+    *msg_type = (context->any_type)? context->msg_type: sub->topic_type;
+  if (md5sum != NULL)
+    *md5sum = (context->any_type && context->msg_type == NULL)? NULL: context->md5sum;
+  if (definition != NULL)
+    *definition = (context->any_type && context->msg_type == NULL)? NULL: context->message_definition;
+  return CROS_SUCCESS_ERR_PACK;
+}
+
 cRosErrCodePack cRosApiRegisterPublisher(CrosNode *node, const char *topic_name, const char *topic_type, int loop_period,
                              PublisherApiCallback callback, NodeStatusApiCallback status_callback, void *context, int *pubidx_ptr)
 {
@@ -494,6 +764,7 @@ cRosErrCodePack cRosApiRegisterPublisher(CrosNode *node, const char *topic_name,
     nodeContext->api_callback = callback;
     nodeContext->status_api_callback = status_callback;
     nodeContext->context = context;
+    nodeContext->parallelism = &node->serialization_parallelism;
 
     // NB: Pass the private ProviderContext to the private api, not the user context
     pubidx = cRosNodeRegisterPublisher(node, nodeContext->message_definition, topic_name, topic_type,
@@ -534,13 +805,13 @@ void cRosApiReleasePublisher(CrosNode *node, int pubidx)
   cRosNodeReleasePublisher(pub);
 }
 
-cRosErrCodePack cRosApicRosApiLookupNode(CrosNode *node, const char *node_name, LookupNodeCallback callback, void *context, int *caller_id_ptr)
+cRosErrCodePack cRosApiLookupNode(CrosNode *node, const char *node_name, LookupNodeCallback callback, void *context, int *caller_id_ptr)
 {
   int caller_id;
   RosApiCall *call = newRosApiCall();
   if (call == NULL)
   {
-    PRINT_ERROR ( "cRosApicRosApiLookupNode() : Can't allocate memory\n");
+    PRINT_ERROR ( "cRosApiLookupNode() : Can't allocate memory\n");
     return CROS_MEM_ALLOC_ERR;
   }
 
@@ -1248,10 +1519,12 @@ GetSystemStateResult * fetchGetSystemStateResult(XmlrpcParamVector *response)
     return NULL;
   }
 
-  if (array->array_n_elem < 3)
+  // The system state is the third element of the response: [publishers, subscribers, services]
+  XmlrpcParam* system_state = xmlrpcParamArrayGetParamAt(array, 2);
+  if (system_state == NULL || system_state->type != XMLRPC_PARAM_ARRAY || system_state->array_n_elem < 1)
     return ret;
 
-  XmlrpcParam* publishers = xmlrpcParamArrayGetParamAt(array, 2);
+  XmlrpcParam* publishers = xmlrpcParamArrayGetParamAt(system_state, 0);
   ret->publishers = (struct ProviderState *)calloc(publishers->array_n_elem, sizeof(struct ProviderState));
   if (ret->publishers == NULL)
     goto clean;
@@ -1276,19 +1549,20 @@ GetSystemStateResult * fetchGetSystemStateResult(XmlrpcParamVector *response)
 
     for (it2 = 0; it2 < users_xml->array_n_elem; it2++)
     {
-      char *user = state->users[it2];
       XmlrpcParam* user_xml = xmlrpcParamArrayGetParamAt(users_xml, it2);
-      user = (char *)malloc(strlen(user_xml->data.as_string) + 1);
+      char *user = (char *)malloc(strlen(user_xml->data.as_string) + 1);
       if (user == NULL)
         goto clean;
       strcpy(user, user_xml->data.as_string);
+      state->users[it2] = user;
+      state->user_count++;
     }
   }
 
-  if (array->array_n_elem < 4)
+  if (system_state->array_n_elem < 2)
     return ret;
 
-  XmlrpcParam* subscribers = xmlrpcParamArrayGetParamAt(array, 3);
+  XmlrpcParam* subscribers = xmlrpcParamArrayGetParamAt(system_state, 1);
   ret->subscribers = (struct ProviderState *)calloc(subscribers->array_n_elem, sizeof(struct ProviderState));
   if (ret->subscribers == NULL)
     goto clean;
@@ -1313,19 +1587,20 @@ GetSystemStateResult * fetchGetSystemStateResult(XmlrpcParamVector *response)
 
     for (it2 = 0; it2 < users_xml->array_n_elem; it2++)
     {
-      char *user = state->users[it2];
       XmlrpcParam* user_xml = xmlrpcParamArrayGetParamAt(users_xml, it2);
-      user = (char *)malloc(strlen(user_xml->data.as_string) + 1);
+      char *user = (char *)malloc(strlen(user_xml->data.as_string) + 1);
       if (user == NULL)
         goto clean;
       strcpy(user, user_xml->data.as_string);
+      state->users[it2] = user;
+      state->user_count++;
     }
   }
 
-  if (array->array_n_elem < 5)
+  if (system_state->array_n_elem < 3)
     return ret;
 
-  XmlrpcParam* services = xmlrpcParamArrayGetParamAt(array, 4);
+  XmlrpcParam* services = xmlrpcParamArrayGetParamAt(system_state, 2);
   ret->service_providers = (struct ProviderState *)calloc(services->array_n_elem, sizeof(struct ProviderState));
   if (ret->service_providers == NULL)
     goto clean;
@@ -1350,12 +1625,13 @@ GetSystemStateResult * fetchGetSystemStateResult(XmlrpcParamVector *response)
 
     for (it2 = 0; it2 < users_xml->array_n_elem; it2++)
     {
-      char *user = state->users[it2];
       XmlrpcParam* user_xml = xmlrpcParamArrayGetParamAt(users_xml, it2);
-      user = (char *)malloc(strlen(user_xml->data.as_string) + 1);
+      char *user = (char *)malloc(strlen(user_xml->data.as_string) + 1);
       if (user == NULL)
         goto clean;
       strcpy(user, user_xml->data.as_string);
+      state->users[it2] = user;
+      state->user_count++;
     }
   }
 
@@ -2095,6 +2371,25 @@ cRosMessage *cRosApiCreateServiceCallerRequest(CrosNode *node, int svcidx)
   return new_msg;
 }
 
+cRosMessage *cRosApiCreateServiceCallerResponse(CrosNode *node, int svcidx)
+{
+  cRosMessage *new_msg;
+  ServiceCallerNode *svc_caller;
+  ProviderContext *caller_context;
+
+  if (svcidx < 0 || svcidx >= CN_MAX_SERVICE_CALLERS)
+    return NULL;
+
+  svc_caller = &node->service_callers[svcidx];
+  if (svc_caller->service_name == NULL)
+    return NULL;
+
+  caller_context = svc_caller->context;
+  new_msg = cRosMessageCopy(caller_context->incoming);
+
+  return new_msg;
+}
+
 
 void freeLookupNodeResult(LookupNodeResult *result)
 {
@@ -2136,7 +2431,7 @@ void freeGetSystemStateResult(GetSystemStateResult *result)
   size_t it1;
 
   free(result->status);
-  for (it1 = 0; it1 < result->sub_count; it1++)
+  for (it1 = 0; it1 < result->pub_count; it1++)
   {
     size_t it2;
 
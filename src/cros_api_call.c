@@ -10,6 +10,7 @@ RosApiCall * newRosApiCall(void)
   ret->id = -1;
   ret->user_call = 0;
   ret->provider_idx = -1;
+  ret->provider_context = NULL;
   ret->host = NULL;
   ret->port = -1;
   xmlrpcParamVectorInit(&ret->params);
@@ -11,6 +11,7 @@
 
 #include "cros_defs.h"
 #include "cros_clock.h"
+#include "cros_thread.h"
 
 struct timeval cRosClockGetTimeSecUsec( void )
 {
@@ -66,6 +67,59 @@ uint64_t cRosClockGetTimeMs( void )
   return(ms_since_epoch);
 }
 
+void cRosClockInit( CrosClock *clock )
+{
+  clock->type = CROS_CLOCK_SYSTEM;
+  clock->sim_time = 0;
+  clock->auto_advance = 0;
+  clock->lock = NULL;
+  clock->advance_hook = NULL;
+  clock->advance_hook_context = NULL;
+}
+
+void cRosClockInitSimulated( CrosClock *clock, uint64_t start_time, int auto_advance )
+{
+  clock->type = CROS_CLOCK_SIMULATED;
+  clock->sim_time = start_time;
+  clock->auto_advance = auto_advance;
+  clock->lock = NULL;
+  clock->advance_hook = NULL;
+  clock->advance_hook_context = NULL;
+}
+
+uint64_t cRosClockGetTime( const CrosClock *clock )
+{
+  uint64_t sim_time;
+
+  if( clock != NULL && clock->type == CROS_CLOCK_SIMULATED )
+  {
+    if( clock->lock == NULL )
+      return(clock->sim_time);
+
+    cRosMutexLock( clock->lock );
+    sim_time = clock->sim_time;
+    cRosMutexUnlock( clock->lock );
+    return(sim_time);
+  }
+
+  return(cRosClockGetTimeMs());
+}
+
+void cRosClockAdvance( CrosClock *clock, uint64_t msec )
+{
+  if( clock->type != CROS_CLOCK_SIMULATED )
+    return;
+
+  if( clock->lock != NULL )
+    cRosMutexLock( clock->lock );
+  clock->sim_time += msec;
+  if( clock->lock != NULL )
+    cRosMutexUnlock( clock->lock );
+
+  if( clock->advance_hook != NULL )
+    clock->advance_hook( clock->advance_hook_context );
+}
+
 struct timeval cRosClockGetTimeVal( uint64_t msec )
 {
   PRINT_VVDEBUG ( "cRosClockGetTimeVal() msec: %lu\n", msec );
@@ -0,0 +1,350 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "cros_graph_cache.h"
+#include "cros_api.h"
+#include "cros_defs.h"
+
+// FNV-1a hash of a string
+static uint32_t hashName( const char *name )
+{
+  uint32_t hash = 2166136261u;
+
+  for( ; *name != '\0'; name++ )
+  {
+    hash ^= (unsigned char)*name;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static char *copyName( const char *name )
+{
+  char *copy = (char *)malloc( strlen( name ) + 1 );
+  if( copy != NULL )
+    strcpy( copy, name );
+  return copy;
+}
+
+static void freeGraphEntry( CrosGraphEntry *entry )
+{
+  size_t i;
+
+  for( i = 0; i < entry->n_nodes; i++ )
+    free( entry->nodes[i] );
+  free( entry->nodes );
+  free( entry->name );
+  free( entry );
+}
+
+static void releaseGraphIndex( CrosGraphIndex *index )
+{
+  size_t i;
+
+  for( i = 0; i < index->n_buckets; i++ )
+  {
+    CrosGraphEntry *entry = index->buckets[i];
+    while( entry != NULL )
+    {
+      CrosGraphEntry *next = entry->next;
+      freeGraphEntry( entry );
+      entry = next;
+    }
+  }
+  free( index->buckets );
+  index->buckets = NULL;
+  index->n_buckets = 0;
+  index->n_entries = 0;
+}
+
+static CrosGraphEntry *findGraphEntry( const CrosGraphIndex *index, const char *name, uint32_t hash )
+{
+  CrosGraphEntry *entry;
+
+  if( index->n_buckets == 0 )
+    return NULL;
+
+  for( entry = index->buckets[hash & (index->n_buckets - 1)]; entry != NULL; entry = entry->next )
+  {
+    if( entry->hash == hash && strcmp( entry->name, name ) == 0 )
+      return entry;
+  }
+  return NULL;
+}
+
+// Double the number of buckets of the index (or allocate the initial ones). Return 0 if there is not enough memory
+static int growGraphIndex( CrosGraphIndex *index )
+{
+  size_t n_buckets = (index->n_buckets == 0)? CROS_GRAPH_CACHE_MIN_BUCKETS: index->n_buckets * 2;
+  CrosGraphEntry **buckets = (CrosGraphEntry **)calloc( n_buckets, sizeof(CrosGraphEntry *) );
+  size_t i;
+
+  if( buckets == NULL )
+    return 0;
+
+  for( i = 0; i < index->n_buckets; i++ )
+  {
+    CrosGraphEntry *entry = index->buckets[i];
+    while( entry != NULL )
+    {
+      CrosGraphEntry *next = entry->next;
+      size_t bucket = entry->hash & (n_buckets - 1);
+      entry->next = buckets[bucket];
+      buckets[bucket] = entry;
+      entry = next;
+    }
+  }
+  free( index->buckets );
+  index->buckets = buckets;
+  index->n_buckets = n_buckets;
+  return 1;
+}
+
+static CrosGraphEntry *addGraphEntry( CrosGraphIndex *index, const char *name, uint32_t hash )
+{
+  CrosGraphEntry *entry;
+  size_t bucket;
+
+  if( index->n_entries >= index->n_buckets && !growGraphIndex( index ) ) // Keep the load factor under 1
+    return NULL;
+
+  entry = (CrosGraphEntry *)calloc( 1, sizeof(CrosGraphEntry) );
+  if( entry == NULL )
+    return NULL;
+  entry->name = copyName( name );
+  if( entry->name == NULL )
+  {
+    free( entry );
+    return NULL;
+  }
+  entry->hash = hash;
+
+  bucket = hash & (index->n_buckets - 1);
+  entry->next = index->buckets[bucket];
+  index->buckets[bucket] = entry;
+  index->n_entries++;
+  return entry;
+}
+
+static int findNodeName( char **nodes, size_t n_nodes, const char *name, size_t *pos )
+{
+  size_t i;
+
+  for( i = 0; i < n_nodes; i++ )
+  {
+    if( nodes[i] != NULL && strcmp( nodes[i], name ) == 0 )
+    {
+      *pos = i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Replace the nodes of an entry with the users reported by the master. The names of the nodes that remain are moved to the new array.
+// The names of the new nodes are copied before changing the entry, so it is left as it was if there is not enough memory
+static long updateGraphEntry( CrosGraphEntry *entry, CrosGraphKind kind, char **users, size_t n_users,
+                              CrosGraphChangeCallback callback, void *context )
+{
+  char **nodes = NULL;
+  long n_changes = 0;
+  size_t i, j;
+
+  if( n_users > 0 )
+  {
+    nodes = (char **)calloc( n_users, sizeof(char *) );
+    if( nodes == NULL )
+      return -1;
+  }
+
+  for( i = 0; i < n_users; i++ )
+  {
+    if( findNodeName( entry->nodes, entry->n_nodes, users[i], &j ) && !findNodeName( users, i, users[i], &j ) )
+      continue; // The node remains: it is moved below (a repeated name is copied)
+
+    nodes[i] = copyName( users[i] );
+    if( nodes[i] == NULL )
+    {
+      for( j = 0; j < i; j++ )
+        free( nodes[j] );
+      free( nodes );
+      return -1;
+    }
+  }
+
+  for( i = 0; i < n_users; i++ )
+  {
+    if( nodes[i] == NULL )
+    {
+      findNodeName( entry->nodes, entry->n_nodes, users[i], &j );
+      nodes[i] = entry->nodes[j];
+      entry->nodes[j] = NULL;
+    }
+    else
+    {
+      n_changes++;
+      if( callback != NULL )
+        callback( kind, entry->name, nodes[i], 1, context );
+    }
+  }
+
+  for( j = 0; j < entry->n_nodes; j++ )
+  {
+    if( entry->nodes[j] != NULL )
+    {
+      n_changes++;
+      if( callback != NULL )
+        callback( kind, entry->name, entry->nodes[j], 0, context );
+      free( entry->nodes[j] );
+    }
+  }
+  free( entry->nodes );
+  entry->nodes = nodes;
+  entry->n_nodes = n_users;
+  return n_changes;
+}
+
+// Update the index of a kind with the providers reported by the master, and remove the entries that have not been reported
+static long applyGraphIndex( CrosGraphCache *cache, CrosGraphKind kind, const struct ProviderState *providers, size_t n_providers,
+                             CrosGraphChangeCallback callback, void *context )
+{
+  CrosGraphIndex *index = &cache->index[kind];
+  long n_changes = 0, n_entry_changes;
+  size_t i;
+
+  for( i = 0; i < n_providers; i++ )
+  {
+    uint32_t hash = hashName( providers[i].provider_name );
+    CrosGraphEntry *entry = findGraphEntry( index, providers[i].provider_name, hash );
+
+    if( entry == NULL )
+    {
+      if( providers[i].user_count == 0 )
+        continue;
+      entry = addGraphEntry( index, providers[i].provider_name, hash );
+      if( entry == NULL )
+        return -1;
+    }
+    entry->generation = cache->generation;
+
+    n_entry_changes = updateGraphEntry( entry, kind, providers[i].users, providers[i].user_count, callback, context );
+    if( n_entry_changes < 0 )
+      return -1;
+    n_changes += n_entry_changes;
+  }
+
+  for( i = 0; i < index->n_buckets; i++ )
+  {
+    CrosGraphEntry **link = &index->buckets[i];
+    while( *link != NULL )
+    {
+      CrosGraphEntry *entry = *link;
+      if( entry->generation != cache->generation || entry->n_nodes == 0 )
+      {
+        size_t j;
+        for( j = 0; j < entry->n_nodes; j++ )
+        {
+          n_changes++;
+          if( callback != NULL )
+            callback( kind, entry->name, entry->nodes[j], 0, context );
+        }
+        *link = entry->next;
+        freeGraphEntry( entry );
+        index->n_entries--;
+      }
+      else
+        link = &entry->next;
+    }
+  }
+
+  return n_changes;
+}
+
+void cRosGraphCacheInit( CrosGraphCache *cache )
+{
+  PRINT_VVDEBUG ( "cRosGraphCacheInit()\n" );
+
+  memset( cache, 0, sizeof(CrosGraphCache) );
+}
+
+void cRosGraphCacheRelease( CrosGraphCache *cache )
+{
+  int kind;
+
+  PRINT_VVDEBUG ( "cRosGraphCacheRelease()\n" );
+
+  for( kind = 0; kind < CROS_GRAPH_N_KINDS; kind++ )
+    releaseGraphIndex( &cache->index[kind] );
+}
+
+long cRosGraphCacheApply( CrosGraphCache *cache, const struct GetSystemStateResult *state, CrosGraphChangeCallback callback, void *context )
+{
+  long n_changes = 0, n_kind_changes;
+
+  PRINT_VVDEBUG ( "cRosGraphCacheApply()\n" );
+
+  cache->generation++;
+
+  n_kind_changes = applyGraphIndex( cache, CROS_GRAPH_PUBLISHER, state->publishers, state->pub_count, callback, context );
+  if( n_kind_changes < 0 )
+    return -1;
+  n_changes += n_kind_changes;
+
+  n_kind_changes = applyGraphIndex( cache, CROS_GRAPH_SUBSCRIBER, state->subscribers, state->sub_count, callback, context );
+  if( n_kind_changes < 0 )
+    return -1;
+  n_changes += n_kind_changes;
+
+  n_kind_changes = applyGraphIndex( cache, CROS_GRAPH_SERVICE, state->service_providers, state->svc_count, callback, context );
+  if( n_kind_changes < 0 )
+    return -1;
+  n_changes += n_kind_changes;
+
+  cache->n_changes += n_changes;
+  return n_changes;
+}
+
+const char *const *cRosGraphCacheGetNodes( const CrosGraphCache *cache, CrosGraphKind kind, const char *name, size_t *n_nodes )
+{
+  CrosGraphEntry *entry = NULL;
+
+  if( kind >= 0 && kind < CROS_GRAPH_N_KINDS )
+    entry = findGraphEntry( &cache->index[kind], name, hashName( name ) );
+
+  if( entry == NULL )
+  {
+    *n_nodes = 0;
+    return NULL;
+  }
+  *n_nodes = entry->n_nodes;
+  return (const char *const *)entry->nodes;
+}
+
+int cRosGraphCacheHasNode( const CrosGraphCache *cache, CrosGraphKind kind, const char *name, const char *node )
+{
+  size_t n_nodes, pos;
+  const char *const *nodes = cRosGraphCacheGetNodes( cache, kind, name, &n_nodes );
+
+  return findNodeName( (char **)nodes, n_nodes, node, &pos );
+}
+
+void cRosGraphCacheForEach( const CrosGraphCache *cache, CrosGraphKind kind,
+                            int (*visit)( const CrosGraphEntry *entry, void *context ), void *context )
+{
+  const CrosGraphIndex *index;
+  size_t i;
+
+  if( kind < 0 || kind >= CROS_GRAPH_N_KINDS )
+    return;
+
+  index = &cache->index[kind];
+  for( i = 0; i < index->n_buckets; i++ )
+  {
+    const CrosGraphEntry *entry;
+    for( entry = index->buckets[i]; entry != NULL; entry = entry->next )
+    {
+      if( visit( entry, context ) != 0 )
+        return;
+    }
+  }
+}
@@ -171,7 +171,8 @@ void cRosLogPrint(CrosNode* node,
     va_end(msg_str_args);
 
     // Only print the message in rosout if its priority level is equal or higher than the node's current log priority
-    if(node != NULL)
+    // (and the /rosout publisher is enabled: it is registered with the first message)
+    if(node != NULL && cRosNodeGetRosoutPublisher(node) != -1)
     {
       int pub_ind;
 
@@ -1,10 +1,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <math.h>
 
 #include "cros_message.h"
 #include "cros_message_internal.h"
 #include "cros_defs.h"
+#include "cros_thread.h"
 #include "md5.h"
 
 #ifdef _WIN32
@@ -19,10 +21,38 @@
 #  define DIR_SEPARATOR_STR "/"
 #endif
 
+// Range of elements of an array of messages which is (de)serialized by one thread
+typedef struct SerializationTask SerializationTask;
+struct SerializationTask
+{
+  cRosMessageField *field;  // Array field
+  int first_elem;           // Index of the first element of the range
+  int end_elem;             // Index of the element after the last one of the range
+  size_t offset;            // Position of the serialized range in the packet (relative to the first element)
+  size_t length;            // Length of the serialized range (in bytes)
+  DynBuffer range_buf;      // Fixed-size buffer covering exactly the serialized range in the packet
+  cRosErrCodePack ret_err;  // Result of the range (de)serialization
+};
+
+// Custom type whose definition is being built from the full text of a message definition (see buildMsgDefFromText()).
+// The types being built form a chain from the main type to the current one, which is used to reject recursive definitions
+typedef struct MsgTextBuild MsgTextBuild;
+struct MsgTextBuild
+{
+  const char *full_text;        // Full text of the message definition
+  const char *msg_type;         // Type being built
+  const MsgTextBuild *parent;   // Type that contains a field of msg_type. NULL for the main type
+  int depth;                    // Num. of types in the chain (1 for the main type)
+};
+
 
 static void *arrayFieldValueAt(cRosMessageField *field, int position, size_t element_size);
+static cRosErrCodePack messageSerialize(cRosMessage *message, DynBuffer* buffer, cRosMessageParallelism *par);
+static cRosErrCodePack messageDeserialize(cRosMessage *message, DynBuffer* buffer, cRosMessageParallelism *par);
 static const char *getMessageTypeDeclarationConst(msgConst *msgConst);
 static const char *getMessageTypeDeclarationField(msgFieldDef *fieldDef);
+static cRosErrCodePack loadFromStringMsgWithDeps(char* text, cRosMessageDef* msg, const MsgTextBuild *text_build);
+static cRosErrCodePack buildMsgDefFromText(cRosMessageDef **msg_def_ptr, const char *msg_type, const char *full_text, const MsgTextBuild *parent);
 
 char *base_msg_type(const char* type)
 {
@@ -681,6 +711,13 @@ void cRosMessageFieldInit(cRosMessageField *field)
 //  Load message specification from a string:
 //  types, names, constants
 cRosErrCodePack loadFromStringMsg(char* text, cRosMessageDef* msg)
+{
+    return loadFromStringMsgWithDeps(text, msg, NULL);
+}
+
+// Load a message definition from its text. The definitions of the custom types used by the message are taken from the full
+// text of a message definition (see computeFullTextMsg()) being built by text_build or, if it is NULL, from the message files under msg->root_dir
+static cRosErrCodePack loadFromStringMsgWithDeps(char* text, cRosMessageDef* msg, const MsgTextBuild *text_build)
 {
     char* new_line = NULL;
     char* new_line_saveptr = NULL;
@@ -837,7 +874,10 @@ cRosErrCodePack loadFromStringMsg(char* text, cRosMessageDef* msg)
                 entry_type = NULL; // Indicate that this buffer must not be freed later since it is used for the current msg def field
               }
               // Recursively load the msg definition of the custom type and store it into current->child_msg_def
-              ret_err = cRosMessageDefBuild(&current->child_msg_def, msg->root_dir, current->type_s);
+              if(text_build != NULL)
+                ret_err = buildMsgDefFromText(&current->child_msg_def, current->type_s, text_build->full_text, text_build);
+              else
+                ret_err = cRosMessageDefBuild(&current->child_msg_def, msg->root_dir, current->type_s);
               if(ret_err != CROS_SUCCESS_ERR_PACK)
               {
                   free(current->type_s);
@@ -1169,6 +1209,194 @@ cRosErrCodePack cRosMessageDefBuild(cRosMessageDef **msg_def_ptr, const char *ms
   return ret;
 }
 
+// Get a copy of the text of a type in the full text of a message definition (see computeFullTextMsg()): the text before
+// the first separator line for the main type (is_main=1), or the text after the "MSG: msg_type" line for an embedded type.
+// Return NULL if the type is not found or there is not enough memory
+static char *getFullTextSection(const char *full_text, const char *msg_type, int is_main)
+{
+  const char *line = full_text, *start = (is_main)? full_text: NULL, *end = NULL;
+  size_t type_len = strlen(msg_type);
+  char *section;
+
+  while(*line != '\0')
+  {
+    const char *next = strchr(line, '\n');
+    size_t len = (next != NULL)? (size_t)(next - line): strlen(line);
+
+    if(start != NULL)
+    {
+      if(*line == '=') // Separator line: end of the section
+      {
+        end = line;
+        break;
+      }
+    }
+    else
+    {
+      while(len > 0 && (line[len - 1] == '\r' || line[len - 1] == ' '))
+        len--;
+      if(len == 5 + type_len && strncmp(line, "MSG: ", 5) == 0 && strncmp(line + 5, msg_type, type_len) == 0)
+        start = (next != NULL)? next + 1: line + strlen(line);
+    }
+
+    if(next == NULL)
+      break;
+    line = next + 1;
+  }
+
+  if(start == NULL)
+    return NULL;
+  if(end == NULL)
+    end = start + strlen(start);
+
+  section = (char *)malloc(end - start + 1);
+  if(section != NULL)
+  {
+    memcpy(section, start, end - start);
+    section[end - start] = '\0';
+  }
+  return section;
+}
+
+// Build the definition of msg_type from the full text of a message definition. parent is the type that contains a field of
+// msg_type, or NULL if msg_type is the main type. The text comes from the connection header of a peer, so it may define
+// a type that contains itself (directly or through other types): these definitions are rejected instead of being built forever
+static cRosErrCodePack buildMsgDefFromText(cRosMessageDef **msg_def_ptr, const char *msg_type, const char *full_text, const MsgTextBuild *parent)
+{
+  cRosErrCodePack ret_err;
+  const char *type_sep = strchr(msg_type, '/');
+  const MsgTextBuild *ancestor;
+  MsgTextBuild text_build;
+  char *section;
+
+  if(type_sep == NULL)
+    return CROS_BAD_PARAM_ERR;
+
+  for(ancestor = parent; ancestor != NULL; ancestor = ancestor->parent)
+  {
+    if(strcmp(ancestor->msg_type, msg_type) == 0)
+    {
+      PRINT_ERROR("buildMsgDefFromText() : The definition of %s contains a field of type %s itself\n", parent->msg_type, msg_type);
+      return CROS_MSG_DEF_RECURSION_ERR;
+    }
+  }
+  if(parent != NULL && parent->depth >= CROS_MSG_MAX_DEF_DEPTH)
+  {
+    PRINT_ERROR("buildMsgDefFromText() : The definition of %s nests more than %i custom types\n", msg_type, CROS_MSG_MAX_DEF_DEPTH);
+    return CROS_MSG_DEF_RECURSION_ERR;
+  }
+  text_build.full_text = full_text;
+  text_build.msg_type = msg_type;
+  text_build.parent = parent;
+  text_build.depth = (parent != NULL)? parent->depth + 1 : 1;
+
+  section = getFullTextSection(full_text, msg_type, parent == NULL);
+  if(section == NULL)
+  {
+    PRINT_ERROR("buildMsgDefFromText() : The definition of %s is not included in the message definition text\n", msg_type);
+    return CROS_FILE_ENTRY_TYPE_ERR;
+  }
+
+  cRosMessageDef* msg_def = (cRosMessageDef *)malloc(sizeof(cRosMessageDef));
+  if(msg_def == NULL)
+  {
+    free(section);
+    return CROS_MEM_ALLOC_ERR;
+  }
+
+  ret_err = initCrosMsg(msg_def);
+  if(ret_err != CROS_SUCCESS_ERR_PACK)
+  {
+    free(msg_def);
+    free(section);
+    return ret_err;
+  }
+
+  msg_def->package = (char *)calloc(type_sep - msg_type + 1, sizeof(char));
+  msg_def->name = strdup(type_sep + 1);
+  if(msg_def->package != NULL && msg_def->name != NULL)
+  {
+    memcpy(msg_def->package, msg_type, type_sep - msg_type);
+    ret_err = loadFromStringMsgWithDeps(section, msg_def, &text_build);
+  }
+  else
+    ret_err = CROS_MEM_ALLOC_ERR;
+
+  if(ret_err == CROS_SUCCESS_ERR_PACK)
+    *msg_def_ptr = msg_def;
+  else
+    cRosMessageDefFree(msg_def);
+
+  free(section);
+  return ret_err;
+}
+
+// Append to full_text the text of each custom type used by msg_def (once), preceded by a separator line and a "MSG: package/Type" line
+static int appendFullTextDeps(cRosMessageDef *msg_def, DynString *full_text)
+{
+  msgFieldDef *field;
+  int ret = 0;
+
+  for(field = msg_def->first_field; field->next != NULL && ret >= 0; field = field->next)
+  {
+    const char *dep_type, *dep_text;
+    DynString dep_tag;
+
+    if(field->type == CROS_STD_MSGS_HEADER)
+    {
+      dep_type = "std_msgs/Header";
+      dep_text = HEADER_DEFAULT_TYPEDEF;
+    }
+    else if(field->type == CROS_CUSTOM_TYPE && field->child_msg_def != NULL)
+    {
+      dep_type = field->type_s;
+      dep_text = field->child_msg_def->plain_text;
+    }
+    else
+      continue;
+
+    dynStringInit(&dep_tag);
+    dynStringPushBackStr(&dep_tag, "\nMSG: ");
+    dynStringPushBackStr(&dep_tag, dep_type);
+    dynStringPushBackStr(&dep_tag, "\n");
+    if(strstr(dynStringGetData(full_text), dynStringGetData(&dep_tag)) == NULL) // Is not this type already included?
+    {
+      int i;
+      dynStringPushBackChar(full_text, '\n');
+      for(i = 0; i < 80; i++)
+        dynStringPushBackChar(full_text, '=');
+      dynStringPushBackStr(full_text, dynStringGetData(&dep_tag));
+      ret = dynStringPushBackStr(full_text, dep_text);
+      if(ret >= 0 && field->type == CROS_CUSTOM_TYPE)
+        ret = appendFullTextDeps(field->child_msg_def, full_text);
+    }
+    dynStringRelease(&dep_tag);
+  }
+  return ret;
+}
+
+char *cRosMessageDefGetFullText(cRosMessageDef *msg_def)
+{
+  DynString full_text;
+  char *ret;
+
+  dynStringInit(&full_text);
+  if(dynStringPushBackStr(&full_text, msg_def->plain_text) >= 0 && appendFullTextDeps(msg_def, &full_text) >= 0)
+    ret = strdup(dynStringGetData(&full_text));
+  else
+    ret = NULL;
+  dynStringRelease(&full_text);
+  return ret;
+}
+
+cRosErrCodePack cRosMessageDefBuildFromText(cRosMessageDef **msg_def_ptr, const char *msg_type, const char *full_text)
+{
+  if(msg_def_ptr == NULL || msg_type == NULL || full_text == NULL)
+    return CROS_BAD_PARAM_ERR;
+
+  return buildMsgDefFromText(msg_def_ptr, msg_type, full_text, NULL);
+}
+
 int cRosMessageFieldCopy(cRosMessageField* new_field, cRosMessageField* orig_field)
 {
   int ret;
@@ -1875,6 +2103,25 @@ cRosErrCodePack cRosMessageNewBuild(const char *msg_root_dir, const char *msg_ty
   return ret_err;
 }
 
+cRosErrCodePack cRosMessageNewBuildFromText(const char *msg_type, const char *full_text, cRosMessage **new_msg_ptr)
+{
+  cRosErrCodePack ret_err;
+
+  if(new_msg_ptr != NULL)
+  {
+    cRosMessageDef *msg_def;
+    ret_err = cRosMessageDefBuildFromText(&msg_def, msg_type, full_text);
+    if(ret_err == CROS_SUCCESS_ERR_PACK)
+    {
+      ret_err = cRosMessageBuildFromDef(new_msg_ptr, msg_def);
+      cRosMessageDefFree(msg_def);
+    }
+  }
+  else
+    ret_err = CROS_BAD_PARAM_ERR;
+  return ret_err;
+}
+
 cRosErrCodePack cRosMessageBuildFromDef(cRosMessage** message_ptr, cRosMessageDef* msg_def )
 {
   cRosErrCodePack ret;
@@ -2776,7 +3023,344 @@ size_t cRosMessageSize(cRosMessage* message)
     return ret;// + sizeof(uint32_t);
 }
 
+void cRosMessageParallelismInit(cRosMessageParallelism *par)
+{
+  par->n_threads = 1;
+  par->min_size = CROS_MSG_DEFAULT_PARALLEL_MIN_SIZE;
+}
+
+int cRosMessageParallelismSet(cRosMessageParallelism *par, int n_threads, size_t min_size)
+{
+  if(n_threads < 1)
+    n_threads = 1;
+  else if(n_threads > CROS_MSG_MAX_SERIALIZATION_THREADS)
+    n_threads = CROS_MSG_MAX_SERIALIZATION_THREADS;
+
+  cRosMessageParallelismRelease(par);
+  if(n_threads > 1 && !cRosThreadPoolCreate(&par->pool, n_threads - 1)) // The calling thread is the other one
+    return 0;
+  par->n_threads = n_threads;
+  par->min_size = (min_size > 0)? min_size : CROS_MSG_DEFAULT_PARALLEL_MIN_SIZE;
+  return 1;
+}
+
+void cRosMessageParallelismRelease(cRosMessageParallelism *par)
+{
+  if(par->n_threads > 1)
+    cRosThreadPoolDestroy(&par->pool);
+  cRosMessageParallelismInit(par);
+}
+
+// Compute the number of bytes that messageSerialize() appends to the packet for a message.
+// It must follow exactly the same rules as messageSerialize()
+static size_t messageSerializedLength(cRosMessage *message)
+{
+  size_t length = 0;
+  int field_ind;
+
+  for (field_ind = 0; field_ind < message->n_fields; field_ind++)
+  {
+    cRosMessageField *field = message->fields[field_ind];
+    int elem_ind;
+
+    if(field->is_array && !field->is_fixed_array)
+      length += sizeof(uint32_t);
+
+    switch (field->type)
+    {
+      case CROS_STD_MSGS_TIME:
+      case CROS_STD_MSGS_DURATION:
+      case CROS_STD_MSGS_HEADER:
+      case CROS_CUSTOM_TYPE:
+        if(field->is_array)
+        {
+          for(elem_ind = 0; elem_ind < field->array_size; elem_ind++)
+          {
+            cRosMessage *arr_elem_msg = cRosMessageFieldArrayAtMsgGet(field, elem_ind);
+            if(arr_elem_msg != NULL)
+              length += messageSerializedLength(arr_elem_msg);
+          }
+        }
+        else if(field->data.as_msg != NULL)
+          length += messageSerializedLength(field->data.as_msg);
+        break;
+      case CROS_STD_MSGS_STRING:
+        if(field->is_array)
+        {
+          for(elem_ind = 0; elem_ind < field->array_size; elem_ind++)
+          {
+            const char *arr_elem_str = cRosMessageFieldArrayAtStringGet(field, elem_ind);
+            length += sizeof(uint32_t) + ((arr_elem_str != NULL)? strlen(arr_elem_str) : 0);
+          }
+        }
+        else
+          length += sizeof(uint32_t) + ((field->data.as_string != NULL)? strlen(field->data.as_string) : 0);
+        break;
+      default:
+        length += getMessageTypeSizeOf(field->type) * ((field->is_array)? field->array_size : 1);
+        break;
+    }
+  }
+  return length;
+}
+
+size_t cRosMessageSerializedSize(cRosMessage *message)
+{
+  return messageSerializedLength(message);
+}
+
+// Compute the length of the serialized message found at the beginning of data, using message as template of its
+// structure (the content of message is not modified). Returns 0 if the data is incomplete or if the structure of
+// the serialized message cannot be determined from the template (e.g., a template array of messages is empty)
+static int serializedMessageLength(cRosMessage *message, const unsigned char *data, size_t data_size, size_t *length)
+{
+  size_t pos = 0;
+  int field_ind;
+
+  for (field_ind = 0; field_ind < message->n_fields; field_ind++)
+  {
+    cRosMessageField *field = message->fields[field_ind];
+    uint32_t n_elems = (field->is_array)? field->array_size : 1;
+    uint32_t elem_ind;
+
+    if(field->is_array && !field->is_fixed_array)
+    {
+      if(pos + sizeof(uint32_t) > data_size)
+        return 0;
+      memcpy(&n_elems, data + pos, sizeof(uint32_t));
+      pos += sizeof(uint32_t);
+    }
+
+    switch (field->type)
+    {
+      case CROS_STD_MSGS_TIME:
+      case CROS_STD_MSGS_DURATION:
+      case CROS_STD_MSGS_HEADER:
+      case CROS_CUSTOM_TYPE:
+      {
+        cRosMessage *template_msg = (field->is_array)? cRosMessageFieldArrayAtMsgGet(field, 0) : field->data.as_msg;
+        if(n_elems > 0 && template_msg == NULL)
+          return 0;
+        for(elem_ind = 0; elem_ind < n_elems; elem_ind++)
+        {
+          size_t elem_length;
+          if(!serializedMessageLength(template_msg, data + pos, data_size - pos, &elem_length))
+            return 0;
+          pos += elem_length;
+        }
+        break;
+      }
+      case CROS_STD_MSGS_STRING:
+        for(elem_ind = 0; elem_ind < n_elems; elem_ind++)
+        {
+          uint32_t str_len;
+          if(pos + sizeof(uint32_t) > data_size)
+            return 0;
+          memcpy(&str_len, data + pos, sizeof(uint32_t));
+          pos += sizeof(uint32_t) + str_len;
+        }
+        break;
+      default:
+        pos += getMessageTypeSizeOf(field->type) * n_elems;
+        break;
+    }
+    if(pos > data_size)
+      return 0;
+  }
+  *length = pos;
+  return 1;
+}
+
+static void measureElementRange(void *task_ptr)
+{
+  SerializationTask *task = (SerializationTask *)task_ptr;
+  int elem_ind;
+
+  task->length = 0;
+  for(elem_ind = task->first_elem; elem_ind < task->end_elem; elem_ind++)
+  {
+    cRosMessage *arr_elem_msg = cRosMessageFieldArrayAtMsgGet(task->field, elem_ind);
+    if(arr_elem_msg != NULL)
+      task->length += messageSerializedLength(arr_elem_msg);
+  }
+  task->ret_err = CROS_SUCCESS_ERR_PACK;
+}
+
+static void serializeElementRange(void *task_ptr)
+{
+  SerializationTask *task = (SerializationTask *)task_ptr;
+  int elem_ind;
+
+  task->ret_err = CROS_SUCCESS_ERR_PACK;
+  for(elem_ind = task->first_elem; elem_ind < task->end_elem && task->ret_err == CROS_SUCCESS_ERR_PACK; elem_ind++)
+  {
+    cRosMessage *arr_elem_msg = cRosMessageFieldArrayAtMsgGet(task->field, elem_ind);
+    if(arr_elem_msg != NULL)
+      task->ret_err = messageSerialize(arr_elem_msg, &task->range_buf, NULL);
+  }
+}
+
+static void deserializeElementRange(void *task_ptr)
+{
+  SerializationTask *task = (SerializationTask *)task_ptr;
+  int elem_ind;
+
+  task->ret_err = CROS_SUCCESS_ERR_PACK;
+  for(elem_ind = task->first_elem; elem_ind < task->end_elem && task->ret_err == CROS_SUCCESS_ERR_PACK; elem_ind++)
+    task->ret_err = messageDeserialize(cRosMessageFieldArrayAtMsgGet(task->field, elem_ind), &task->range_buf, NULL);
+  // Each range must consume exactly the bytes found by the offset pass
+  if(task->ret_err == CROS_SUCCESS_ERR_PACK && dynBufferGetRemainingDataSize(&task->range_buf) != 0)
+    task->ret_err = CROS_DEPACK_INSUFF_DAT_ERR;
+}
+
+// Split the elements of an array of messages into ranges with the same number of elements (one range for each thread)
+static int splitElementRanges(cRosMessageField *field, SerializationTask *tasks, cRosMessageParallelism *par)
+{
+  int n_tasks = (field->array_size < par->n_threads)? field->array_size : par->n_threads;
+  int task_ind;
+
+  for(task_ind = 0; task_ind < n_tasks; task_ind++)
+  {
+    tasks[task_ind].field = field;
+    tasks[task_ind].first_elem = (int)((int64_t)field->array_size * task_ind / n_tasks);
+    tasks[task_ind].end_elem = (int)((int64_t)field->array_size * (task_ind + 1) / n_tasks);
+    tasks[task_ind].offset = 0;
+    tasks[task_ind].length = 0;
+    tasks[task_ind].ret_err = CROS_SUCCESS_ERR_PACK;
+  }
+  return n_tasks;
+}
+
+// Run the tasks in the worker threads of the pool of par and in the calling thread
+static cRosErrCodePack runSerializationTasks(SerializationTask *tasks, int n_tasks, cRosThreadFunc task_func, cRosMessageParallelism *par)
+{
+  cRosErrCodePack ret_err = CROS_SUCCESS_ERR_PACK;
+  int task_ind;
+
+  cRosThreadPoolRun(&par->pool, task_func, tasks, sizeof(SerializationTask), n_tasks);
+  for(task_ind = 0; task_ind < n_tasks && ret_err == CROS_SUCCESS_ERR_PACK; task_ind++)
+    ret_err = tasks[task_ind].ret_err;
+  return ret_err;
+}
+
+// Serialize an array of messages. If it is large enough, the serialized length of each element range is computed
+// first, and then the ranges are serialized in parallel directly in their final position, so the result is identical
+static cRosErrCodePack serializeMessageArray(cRosMessageField *field, DynBuffer* buffer, cRosMessageParallelism *par)
+{
+  cRosErrCodePack ret_err = CROS_SUCCESS_ERR_PACK;
+  cRosMessage *first_msg = cRosMessageFieldArrayAtMsgGet(field, 0);
+  int elem_ind;
+
+  if(par != NULL && par->n_threads > 1 && field->array_size >= 2 && first_msg != NULL &&
+     messageSerializedLength(first_msg) * field->array_size >= par->min_size) // Estimated array size
+  {
+    SerializationTask tasks[CROS_MSG_MAX_SERIALIZATION_THREADS];
+    unsigned char *range_start;
+    size_t total_length = 0;
+    int n_tasks, task_ind;
+
+    n_tasks = splitElementRanges(field, tasks, par);
+    runSerializationTasks(tasks, n_tasks, measureElementRange, par);
+    for(task_ind = 0; task_ind < n_tasks; task_ind++)
+    {
+      tasks[task_ind].offset = total_length;
+      total_length += tasks[task_ind].length;
+    }
+
+    range_start = dynBufferReserve(buffer, total_length);
+    if(range_start == NULL)
+      return CROS_MEM_ALLOC_ERR;
+    // The range buffers cannot grow beyond the precomputed lengths: if messageSerializedLength() did not match
+    // messageSerialize(), a range fails instead of writing over the next one, and nothing is appended to the packet
+    for(task_ind = 0; task_ind < n_tasks; task_ind++)
+      dynBufferInitFixed(&tasks[task_ind].range_buf, range_start + tasks[task_ind].offset, 0, tasks[task_ind].length);
+    ret_err = runSerializationTasks(tasks, n_tasks, serializeElementRange, par);
+    for(task_ind = 0; task_ind < n_tasks; task_ind++)
+    {
+      if(dynBufferGetSize(&tasks[task_ind].range_buf) != tasks[task_ind].length)
+      {
+        PRINT_ERROR("serializeMessageArray() : The range %i of array %s was serialized in %lu bytes instead of the computed %lu bytes\n",
+                    task_ind, field->name, (unsigned long)dynBufferGetSize(&tasks[task_ind].range_buf), (unsigned long)tasks[task_ind].length);
+        ret_err = cRosAddErrCode(ret_err, CROS_SER_RANGE_LENGTH_ERR);
+      }
+    }
+    if(ret_err == CROS_SUCCESS_ERR_PACK)
+      dynBufferCommit(buffer, total_length);
+    return ret_err;
+  }
+
+  for(elem_ind = 0; elem_ind < field->array_size && ret_err == CROS_SUCCESS_ERR_PACK; elem_ind++)
+  {
+    cRosMessage *arr_elem_msg;
+    arr_elem_msg = cRosMessageFieldArrayAtMsgGet(field, elem_ind);
+    if(arr_elem_msg != NULL)
+      ret_err = messageSerialize(arr_elem_msg, buffer, par);
+  }
+  return ret_err;
+}
+
+// Deserialize an array of messages whose elements have been already created. If it is large enough, the offset of
+// each element range in the packet is found first, and then the ranges are deserialized in parallel
+static cRosErrCodePack deserializeMessageArray(cRosMessageField *field, DynBuffer* buffer, cRosMessageParallelism *par)
+{
+  cRosErrCodePack ret_err = CROS_SUCCESS_ERR_PACK;
+  int elem_ind;
+
+  if(par != NULL && par->n_threads > 1 && field->array_size >= 2 &&
+     dynBufferGetRemainingDataSize(buffer) >= par->min_size)
+  {
+    SerializationTask tasks[CROS_MSG_MAX_SERIALIZATION_THREADS];
+    const unsigned char *data = dynBufferGetCurrentData(buffer);
+    size_t data_size = dynBufferGetRemainingDataSize(buffer), total_length = 0;
+    cRosMessage *template_msg = cRosMessageFieldArrayAtMsgGet(field, 0);
+    int n_tasks, task_ind = 0;
+
+    // All the elements have the same structure, so the first one is used as template to skip them (it stays in cache).
+    // If its nested arrays of messages are empty, the element itself is tried, and if the offsets still cannot be
+    // found the array is deserialized sequentially
+    n_tasks = splitElementRanges(field, tasks, par);
+    for(elem_ind = 0; elem_ind < field->array_size; elem_ind++)
+    {
+      size_t elem_length;
+      if(task_ind < n_tasks && elem_ind == tasks[task_ind].first_elem)
+        tasks[task_ind++].offset = total_length;
+      if(!serializedMessageLength(template_msg, data + total_length, data_size - total_length, &elem_length) &&
+         !serializedMessageLength(cRosMessageFieldArrayAtMsgGet(field, elem_ind), data + total_length, data_size - total_length, &elem_length))
+        break;
+      total_length += elem_length;
+    }
+
+    if(elem_ind == field->array_size && total_length >= par->min_size)
+    {
+      for(task_ind = 0; task_ind < n_tasks; task_ind++)
+      {
+        tasks[task_ind].length = ((task_ind + 1 < n_tasks)? tasks[task_ind + 1].offset : total_length) - tasks[task_ind].offset;
+        dynBufferInitFixed(&tasks[task_ind].range_buf, (unsigned char *)data + tasks[task_ind].offset,
+                           tasks[task_ind].length, tasks[task_ind].length);
+      }
+      ret_err = runSerializationTasks(tasks, n_tasks, deserializeElementRange, par);
+      if(ret_err == CROS_SUCCESS_ERR_PACK)
+        dynBufferMovePoseIndicator(buffer, total_length);
+      return ret_err;
+    }
+  }
+
+  for(elem_ind = 0; elem_ind < field->array_size && ret_err == CROS_SUCCESS_ERR_PACK; elem_ind++)
+    ret_err = messageDeserialize(cRosMessageFieldArrayAtMsgGet(field, elem_ind), buffer, par);
+  return ret_err;
+}
+
 cRosErrCodePack cRosMessageSerialize(cRosMessage *message, DynBuffer* buffer)
+{
+  return messageSerialize(message, buffer, NULL);
+}
+
+cRosErrCodePack cRosMessageSerializeParallel(cRosMessage *message, DynBuffer* buffer, cRosMessageParallelism *par)
+{
+  return messageSerialize(message, buffer, par);
+}
+
+static cRosErrCodePack messageSerialize(cRosMessage *message, DynBuffer* buffer, cRosMessageParallelism *par)
 {
   cRosErrCodePack ret_err;
   int field_ind;
@@ -2818,20 +3402,11 @@ cRosErrCodePack cRosMessageSerialize(cRosMessage *message, DynBuffer* buffer)
       case CROS_CUSTOM_TYPE:
       {
         if(field->is_array)
-        {
-          int elem_ind;
-          for(elem_ind = 0; elem_ind < field->array_size && ret_err == CROS_SUCCESS_ERR_PACK; elem_ind++)
-          {
-            cRosMessage *arr_elem_msg;
-            arr_elem_msg = cRosMessageFieldArrayAtMsgGet(field, elem_ind);
-            if(arr_elem_msg != NULL)
-              ret_err = cRosMessageSerialize(arr_elem_msg, buffer);
-          }
-        }
+          ret_err = serializeMessageArray(field, buffer, par);
         else
         {
           if(field->data.as_msg != NULL)
-            ret_err = cRosMessageSerialize(field->data.as_msg, buffer);
+            ret_err = messageSerialize(field->data.as_msg, buffer, par);
         }
         break;
       }
@@ -2879,6 +3454,16 @@ cRosErrCodePack cRosMessageSerialize(cRosMessage *message, DynBuffer* buffer)
 // In this function we assume that the message is already build according to its definition.
 // Only when receiving a variable-length array, new elements if the message field may need to be created
 cRosErrCodePack cRosMessageDeserialize(cRosMessage *message, DynBuffer* buffer)
+{
+  return messageDeserialize(message, buffer, NULL);
+}
+
+cRosErrCodePack cRosMessageDeserializeParallel(cRosMessage *message, DynBuffer* buffer, cRosMessageParallelism *par)
+{
+  return messageDeserialize(message, buffer, par);
+}
+
+static cRosErrCodePack messageDeserialize(cRosMessage *message, DynBuffer* buffer, cRosMessageParallelism *par)
 {
   int field_ind;
   cRosErrCodePack ret_err;
@@ -3045,15 +3630,11 @@ cRosErrCodePack cRosMessageDeserialize(cRosMessage *message, DynBuffer* buffer)
               cRosMessageFree(cRosMessageFieldArrayRemoveLastMsg(field));
           }
 
-          for(msg_ind = 0;(int)msg_ind < field->array_size && ret_err == CROS_SUCCESS_ERR_PACK;msg_ind++)
-          {
-            cRosMessage *curr_msg;
-            curr_msg = cRosMessageFieldArrayAtMsgGet(field, msg_ind);
-            ret_err = cRosMessageDeserialize(curr_msg, buffer);
-          }
+          if(ret_err == CROS_SUCCESS_ERR_PACK)
+            ret_err = deserializeMessageArray(field, buffer, par);
         }
         else
-          ret_err = cRosMessageDeserialize(field->data.as_msg, buffer);
+          ret_err = messageDeserialize(field->data.as_msg, buffer, par);
         break;
       }
       default:
@@ -3278,3 +3859,298 @@ const char *getMessageTypeDeclaration(CrosMessageType type)
       return NULL;
   }
 }
+
+// Value of an element of a numeric field (or of the field itself if it is not an array) converted to double
+static double numericFieldElement(cRosMessageField *field, int elem_ind)
+{
+  const void *elem = (field->is_array)? (const unsigned char *)field->data.as_array + (size_t)elem_ind * field->size : (const void *)&field->data;
+  double value;
+
+  switch(field->type)
+  {
+    case CROS_STD_MSGS_INT8: value = *(const int8_t *)elem; break;
+    case CROS_STD_MSGS_INT16: value = *(const int16_t *)elem; break;
+    case CROS_STD_MSGS_UINT16: value = *(const uint16_t *)elem; break;
+    case CROS_STD_MSGS_INT32: value = *(const int32_t *)elem; break;
+    case CROS_STD_MSGS_UINT32: value = *(const uint32_t *)elem; break;
+    case CROS_STD_MSGS_INT64: value = (double)*(const int64_t *)elem; break;
+    case CROS_STD_MSGS_UINT64: value = (double)*(const uint64_t *)elem; break;
+    case CROS_STD_MSGS_FLOAT32: value = *(const float *)elem; break;
+    case CROS_STD_MSGS_FLOAT64: value = *(const double *)elem; break;
+    default: value = *(const uint8_t *)elem; break; // UINT8, BOOL, CHAR and BYTE
+  }
+  return value;
+}
+
+// Compare two messages. path contains the path of the fields of the messages (path_len characters) when there are deadbands
+static int messagesEqual(cRosMessage *m1, cRosMessage *m2, const cRosMessageDeadband *deadbands, int n_deadbands, char *path, size_t path_len)
+{
+  int field_ind, equal = 1;
+
+  if(m1 == m2)
+    return 1;
+  if(m1 == NULL || m2 == NULL || m1->n_fields != m2->n_fields)
+    return 0;
+
+  for(field_ind = 0; field_ind < m1->n_fields && equal; field_ind++)
+  {
+    cRosMessageField *f1 = m1->fields[field_ind], *f2 = m2->fields[field_ind];
+    int elem_ind, n_elems, field_n_deadbands = n_deadbands; // Num. of deadbands that can apply to this field and its subfields
+
+    if(f1->type != f2->type || f1->is_array != f2->is_array || (f1->is_array && f1->array_size != f2->array_size))
+      return 0;
+    if(f1->is_const)
+      continue;
+
+    n_elems = (f1->is_array)? f1->array_size : 1;
+    if(n_deadbands > 0) // Append the field name to the path
+    {
+      int name_len = snprintf(path + path_len, CROS_MSG_MAX_FIELD_PATH_LEN - path_len, (path_len > 0)? ".%s" : "%s", (f1->name != NULL)? f1->name : "");
+      if(name_len < 0 || path_len + name_len >= CROS_MSG_MAX_FIELD_PATH_LEN)
+      { // Path too long: no deadband can match this field or its subfields, so they are compared without deadbands
+        name_len = 0;
+        field_n_deadbands = 0;
+      }
+      path[path_len + name_len] = '\0';
+    }
+
+    switch(f1->type)
+    {
+      case CROS_STD_MSGS_STRING:
+        for(elem_ind = 0; elem_ind < n_elems && equal; elem_ind++)
+        {
+          const char *s1 = (f1->is_array)? f1->data.as_string_array[elem_ind] : f1->data.as_string;
+          const char *s2 = (f2->is_array)? f2->data.as_string_array[elem_ind] : f2->data.as_string;
+          equal = (s1 == s2) || (s1 != NULL && s2 != NULL && strcmp(s1, s2) == 0) ||
+                  (s1 == NULL && s2[0] == '\0') || (s2 == NULL && s1[0] == '\0'); // NULL is serialized as an empty string
+        }
+        break;
+      case CROS_STD_MSGS_TIME:
+      case CROS_STD_MSGS_DURATION:
+      case CROS_STD_MSGS_HEADER:
+      case CROS_CUSTOM_TYPE:
+        for(elem_ind = 0; elem_ind < n_elems && equal; elem_ind++)
+          equal = (f1->is_array)? messagesEqual(f1->data.as_msg_array[elem_ind], f2->data.as_msg_array[elem_ind], deadbands, field_n_deadbands, path, strlen(path)) :
+                                  messagesEqual(f1->data.as_msg, f2->data.as_msg, deadbands, field_n_deadbands, path, strlen(path));
+        break;
+      default: // Numeric field
+      {
+        int deadband_ind = field_n_deadbands;
+
+        if(field_n_deadbands > 0) // Look for the deadband of this field
+          for(deadband_ind = 0; deadband_ind < field_n_deadbands && strcmp(deadbands[deadband_ind].field_path, path) != 0; deadband_ind++);
+
+        if(deadband_ind == field_n_deadbands) // The values must be identical
+          equal = (f1->is_array)? memcmp(f1->data.as_array, f2->data.as_array, (size_t)n_elems * f1->size) == 0 :
+                                  memcmp(&f1->data, &f2->data, f1->size) == 0;
+        else
+          for(elem_ind = 0; elem_ind < n_elems && equal; elem_ind++)
+            equal = fabs(numericFieldElement(f1, elem_ind) - numericFieldElement(f2, elem_ind)) <= deadbands[deadband_ind].deadband;
+        break;
+      }
+    }
+    if(n_deadbands > 0)
+      path[path_len] = '\0'; // Remove the field name from the path
+  }
+
+  return equal;
+}
+
+int cRosMessageEqual(cRosMessage *m1, cRosMessage *m2, const cRosMessageDeadband *deadbands, int n_deadbands)
+{
+  char path[CROS_MSG_MAX_FIELD_PATH_LEN];
+
+  path[0] = '\0';
+  return messagesEqual(m1, m2, deadbands, (deadbands != NULL)? n_deadbands : 0, path, 0);
+}
+
+void cRosMessageFilterInit(cRosMessageFilter *filter)
+{
+  filter->depth = 0;
+  filter->op = CROS_MSG_FILTER_EQ;
+  filter->num_value = 0.0;
+  filter->str_value = NULL;
+}
+
+void cRosMessageFilterRelease(cRosMessageFilter *filter)
+{
+  free(filter->str_value);
+  cRosMessageFilterInit(filter);
+}
+
+// Find the index of a field of a message from its name (name_len characters). Return -1 if it does not exist
+static int findFieldIndex(cRosMessage *msg, const char *name, size_t name_len)
+{
+  int field_ind;
+
+  for(field_ind = 0; field_ind < msg->n_fields; field_ind++)
+  {
+    const char *field_name = msg->fields[field_ind]->name;
+    if(field_name != NULL && strlen(field_name) == name_len && strncmp(field_name, name, name_len) == 0)
+      return field_ind;
+  }
+  return -1;
+}
+
+// Resolve the field path of a filter expression (path_len characters) in the fields of msg, storing the field indices in filter.
+// Return the compared field, or NULL if the path is not valid
+static cRosMessageField *resolveFilterPath(cRosMessageFilter *filter, const char *path, size_t path_len, cRosMessage *msg)
+{
+  cRosMessageField *field = NULL;
+  const char *path_end = path + path_len;
+
+  filter->depth = 0;
+  while(path < path_end)
+  {
+    const char *name_end = memchr(path, '.', path_end - path);
+    int field_ind;
+
+    if(name_end == NULL)
+      name_end = path_end;
+    if(msg == NULL || filter->depth == CROS_MSG_FILTER_MAX_DEPTH)
+      return NULL;
+    field_ind = findFieldIndex(msg, path, name_end - path);
+    if(field_ind < 0)
+      return NULL;
+    filter->field_inds[filter->depth++] = field_ind;
+    field = msg->fields[field_ind];
+
+    msg = NULL; // Only a submessage that is not an array can be traversed
+    if(!field->is_array && (field->type == CROS_CUSTOM_TYPE || field->type == CROS_STD_MSGS_HEADER ||
+                            field->type == CROS_STD_MSGS_TIME || field->type == CROS_STD_MSGS_DURATION))
+      msg = field->data.as_msg;
+    path = name_end + 1;
+  }
+
+  if(field == NULL || field->type == CROS_CUSTOM_TYPE || field->type == CROS_STD_MSGS_HEADER ||
+     field->type == CROS_STD_MSGS_TIME || field->type == CROS_STD_MSGS_DURATION)
+    return NULL; // The compared field must be numeric, bool or string
+  return field;
+}
+
+cRosErrCodePack cRosMessageFilterCompile(cRosMessageFilter *filter, const char *expr, cRosMessage *msg)
+{
+  static const char *op_strs[] = { "==", "!=", "<", "<=", ">", ">=" };
+  const char *path, *value;
+  size_t path_len, value_len;
+  cRosMessageField *field;
+  char *value_end;
+  int op;
+
+  cRosMessageFilterRelease(filter);
+  if(expr == NULL)
+    return CROS_SUCCESS_ERR_PACK;
+
+  while(*expr == ' ' || *expr == '\t')
+    expr++;
+  if(*expr == '\0')
+    return CROS_SUCCESS_ERR_PACK;
+
+  path = expr;
+  path_len = strcspn(path, " \t=!<>");
+  expr = path + path_len;
+  while(*expr == ' ' || *expr == '\t')
+    expr++;
+
+  for(op = CROS_MSG_FILTER_GE; op >= CROS_MSG_FILTER_EQ; op--) // Two-character operators are checked before < and >
+    if(strncmp(expr, op_strs[op], strlen(op_strs[op])) == 0)
+      break;
+  if(op < CROS_MSG_FILTER_EQ || path_len == 0)
+  {
+    PRINT_ERROR("cRosMessageFilterCompile() : Invalid filter expression\n");
+    return CROS_BAD_PARAM_ERR;
+  }
+  value = expr + strlen(op_strs[op]);
+  while(*value == ' ' || *value == '\t')
+    value++;
+  value_len = strlen(value);
+  while(value_len > 0 && (value[value_len-1] == ' ' || value[value_len-1] == '\t'))
+    value_len--;
+  if(value_len >= 2 && (value[0] == '\'' || value[0] == '"') && value[value_len-1] == value[0])
+  {
+    value++;
+    value_len -= 2;
+  }
+
+  field = resolveFilterPath(filter, path, path_len, msg);
+  if(field == NULL)
+  {
+    PRINT_ERROR("cRosMessageFilterCompile() : The filter field %.*s is not a numeric or string field of the message\n", (int)path_len, path);
+    filter->depth = 0;
+    return CROS_BAD_PARAM_ERR;
+  }
+  filter->op = (CrosMessageFilterOp)op;
+
+  if(field->type == CROS_STD_MSGS_STRING)
+  {
+    filter->str_value = (char *)malloc(value_len + 1);
+    if(filter->str_value == NULL)
+    {
+      filter->depth = 0;
+      return CROS_MEM_ALLOC_ERR;
+    }
+    memcpy(filter->str_value, value, value_len);
+    filter->str_value[value_len] = '\0';
+  }
+  else if(field->type == CROS_STD_MSGS_BOOL && value_len == 4 && strncmp(value, "true", 4) == 0)
+    filter->num_value = 1.0;
+  else if(field->type == CROS_STD_MSGS_BOOL && value_len == 5 && strncmp(value, "false", 5) == 0)
+    filter->num_value = 0.0;
+  else
+  {
+    filter->num_value = strtod(value, &value_end);
+    if(value_len == 0 || value_end != value + value_len)
+    {
+      PRINT_ERROR("cRosMessageFilterCompile() : The filter constant is not a number\n");
+      filter->depth = 0;
+      return CROS_BAD_PARAM_ERR;
+    }
+  }
+
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+int cRosMessageFilterMatch(const cRosMessageFilter *filter, cRosMessage *msg)
+{
+  cRosMessageField *field = NULL;
+  int depth_ind, elem_ind, n_elems;
+
+  if(filter->depth == 0)
+    return 1;
+
+  for(depth_ind = 0; depth_ind < filter->depth; depth_ind++)
+  {
+    if(msg == NULL || filter->field_inds[depth_ind] >= msg->n_fields)
+      return 0;
+    field = msg->fields[filter->field_inds[depth_ind]];
+    msg = field->data.as_msg; // Only used if the field is a submessage
+  }
+
+  n_elems = (field->is_array)? field->array_size : 1;
+  for(elem_ind = 0; elem_ind < n_elems; elem_ind++)
+  {
+    int cmp;
+
+    if(filter->str_value != NULL)
+    {
+      const char *str = (field->is_array)? field->data.as_string_array[elem_ind] : field->data.as_string;
+      cmp = strcmp((str != NULL)? str : "", filter->str_value);
+    }
+    else
+    {
+      double value = numericFieldElement(field, elem_ind);
+      cmp = (value > filter->num_value) - (value < filter->num_value);
+    }
+
+    switch(filter->op)
+    {
+      case CROS_MSG_FILTER_EQ: if(cmp == 0) return 1; break;
+      case CROS_MSG_FILTER_NE: if(cmp != 0) return 1; break;
+      case CROS_MSG_FILTER_LT: if(cmp < 0) return 1; break;
+      case CROS_MSG_FILTER_LE: if(cmp <= 0) return 1; break;
+      case CROS_MSG_FILTER_GT: if(cmp > 0) return 1; break;
+      case CROS_MSG_FILTER_GE: if(cmp >= 0) return 1; break;
+    }
+  }
+  return 0;
+}
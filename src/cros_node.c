@@ -8,6 +8,8 @@
 #  include <windows.h>
 #else
 #  include <unistd.h>
+#  include <fcntl.h>
+#  include <errno.h>
 #endif
 
 #include "cros_node.h"
@@ -36,6 +38,7 @@ static void getIdleXmplrpcClients(CrosNode *node, int array[], size_t *count);
 static int enqueueSlaveApiCallInternal(CrosNode *node, RosApiCall *call);
 static int enqueueMasterApiCallInternal(CrosNode *node, RosApiCall *call);
 static void printNodeProcState( CrosNode *n );
+static void freeDeadbands( cRosMessageDeadband *deadbands, int n_deadbands );
 
 FILE *Msg_output = NULL; //! The pointer to file stream used to print local messages (except debug messages). If it is NULL (default value), stdout is used.
 
@@ -150,6 +153,145 @@ static int openTcprosListnerSocket( CrosNode *n )
   return(ret);
 }
 
+static int openTcprosDataListnerSocket( CrosNode *n )
+{
+  int ret;
+  if( !tcpIpSocketOpen( &(n->tcpros_data_listner_proc.socket) ) ||
+      !tcpIpSocketSetReuse( &(n->tcpros_data_listner_proc.socket) ) ||
+      !tcpIpSocketSetNonBlocking( &(n->tcpros_data_listner_proc.socket) ) ||
+      !tcpIpSocketBindListen( &(n->tcpros_data_listner_proc.socket), n->data_host, 0, CN_MAX_TCPROS_SERVER_CONNECTIONS ) )
+  {
+    PRINT_ERROR("openTcprosDataListnerSocket() failed");
+    tcpIpSocketClose( &(n->tcpros_data_listner_proc.socket) );
+    ret=-1;
+  }
+  else
+  {
+    n->data_tcpros_port = tcpIpSocketGetPort( &(n->tcpros_data_listner_proc.socket) );
+    PRINT_VDEBUG ( "openTcprosDataListnerSocket() : Accepting tcpros connections at %s:%d\n", n->data_host, n->data_tcpros_port );
+    ret=0; // success
+  }
+  return(ret);
+}
+
+static int openTcprosShardListnerSocket( CrosNode *n, int shard_idx )
+{
+  int ret;
+  CrosIoShard *shard = &n->io_shards[shard_idx-1];
+
+  // All the shard listeners are bound to the same port, so the kernel distributes the incoming connections among them
+  if( !tcpIpSocketOpen( &(shard->tcpros_listner_proc.socket) ) ||
+      !tcpIpSocketSetReuse( &(shard->tcpros_listner_proc.socket) ) ||
+      !tcpIpSocketSetReusePort( &(shard->tcpros_listner_proc.socket) ) ||
+      !tcpIpSocketSetNonBlocking( &(shard->tcpros_listner_proc.socket) ) ||
+      !tcpIpSocketBindListen( &(shard->tcpros_listner_proc.socket), n->host, n->tcpros_port, CN_MAX_TCPROS_SERVER_CONNECTIONS ) )
+  {
+    PRINT_ERROR("openTcprosShardListnerSocket() failed");
+    ret=-1;
+  }
+  else
+  {
+#ifdef _WIN32
+    ret=-1; // No SO_REUSEPORT support, so this point should not be reached
+#else
+    ret = pipe(shard->wake_up_fd);
+    if(ret == 0)
+    {
+      fcntl(shard->wake_up_fd[0], F_SETFL, O_NONBLOCK);
+      fcntl(shard->wake_up_fd[1], F_SETFL, O_NONBLOCK);
+      shard->io_uring = tcpIpUringCreate(); // If NULL, the shard loop uses select()
+      PRINT_VDEBUG ( "openTcprosShardListnerSocket() : Shard %d accepting tcpros connections at port %d\n", shard_idx, n->tcpros_port );
+    }
+    else
+      PRINT_ERROR("openTcprosShardListnerSocket() : pipe() failed");
+#endif
+  }
+  return(ret);
+}
+
+static void closeIoShard( CrosNode *n, int shard_idx )
+{
+  CrosIoShard *shard = &n->io_shards[shard_idx-1];
+
+  tcpIpSocketClose( &(shard->tcpros_listner_proc.socket) );
+#ifndef _WIN32
+  if( shard->wake_up_fd[0] != -1 )
+    close( shard->wake_up_fd[0] );
+  if( shard->wake_up_fd[1] != -1 )
+    close( shard->wake_up_fd[1] );
+#endif
+  shard->wake_up_fd[0] = shard->wake_up_fd[1] = -1;
+  tcpIpUringDestroy( shard->io_uring );
+  shard->io_uring = NULL;
+}
+
+static void wakeUpIoShard( CrosNode *n, int shard_idx )
+{
+#ifndef _WIN32
+  CrosIoShard *shard = &n->io_shards[shard_idx-1];
+  char wake_up_byte = 0;
+
+  if( shard->wake_up_fd[1] != -1 && write( shard->wake_up_fd[1], &wake_up_byte, 1 ) < 0 && errno != EAGAIN )
+    PRINT_ERROR ( "wakeUpIoShard() : Shard %d could not be woken up\n", shard_idx );
+#endif
+}
+
+// Accept a pending connection and close it at once. Used by a listener that shares the TCPROS port with other I/O shards when
+// all its TCPROS processes are busy: the kernel keeps routing new connections to it, which would wait in its backlog otherwise
+static void rejectTcprosConnection( TcpIpSocket *listner_socket )
+{
+  TcpIpSocket rejected_socket;
+
+  tcpIpSocketInit( &rejected_socket );
+  if( tcpIpSocketAccept( listner_socket, &rejected_socket ) == TCPIPSOCKET_DONE )
+  {
+    PRINT_INFO ( "rejectTcprosConnection() : No free TCPROS server process in this I/O shard: connection from port %hu closed\n",
+                 tcpIpSocketGetRemotePort( &rejected_socket ) );
+    tcpIpSocketClose( &rejected_socket );
+  }
+}
+
+// Create the pipe used to wake up the main loop from other threads, if it does not exist yet. Returns 0 on success
+static int openMainWakeUpPipe( CrosNode *n )
+{
+#ifdef _WIN32
+  return -1;
+#else
+  if( n->main_wake_up_fd[0] != -1 )
+    return 0;
+  if( pipe( n->main_wake_up_fd ) != 0 )
+  {
+    n->main_wake_up_fd[0] = n->main_wake_up_fd[1] = -1;
+    return -1;
+  }
+  fcntl( n->main_wake_up_fd[0], F_SETFL, O_NONBLOCK );
+  fcntl( n->main_wake_up_fd[1], F_SETFL, O_NONBLOCK );
+  return 0;
+#endif
+}
+
+static void wakeUpMainLoop( CrosNode *n )
+{
+#ifndef _WIN32
+  char wake_up_byte = 0;
+
+  if( n->main_wake_up_fd[1] != -1 && write( n->main_wake_up_fd[1], &wake_up_byte, 1 ) < 0 && errno != EAGAIN )
+    PRINT_ERROR ( "wakeUpMainLoop() : The main loop could not be woken up\n" );
+#endif
+}
+
+// Called when the simulated clock of the node is advanced (possibly from another thread): the main loop and the shard loops
+// wait for the sockets, so they must be woken up to handle the operations that are now due
+static void wakeUpNodeLoops( void *context )
+{
+  CrosNode *n = (CrosNode *)context;
+  int shard_idx;
+
+  wakeUpMainLoop( n );
+  for( shard_idx = 1; shard_idx < n->n_io_shards; shard_idx++ )
+    wakeUpIoShard( n, shard_idx );
+}
+
 static void closeTcprosProcess(TcprosProcess *process)
 {
   tcpIpSocketClose(&process->socket);
@@ -177,22 +319,32 @@ static void handleApiCallAttempt(CrosNode *node, RosApiCall *call)
   {
     case CROS_API_UNREGISTER_PUBLISHER:
     {
-      if (call->provider_idx == -1)
+      // The provider may have been released by a previous unregistration (e.g. the application unregistered it and then
+      // cRosNodeDestroy() did it again), and its slot may be used now by another provider
+      if (call->provider_idx == -1 || node->pubs[call->provider_idx].topic_name == NULL ||
+          node->pubs[call->provider_idx].context != call->provider_context)
         break;
 
       PublisherNode *pub = &node->pubs[call->provider_idx];
       status.state = CROS_STATUS_PUBLISHER_UNREGISTERED;
       cRosNodeStatusCallback(&status, pub->context); // calls the publisher application-defined callback function (if specified when creating the publisher)
 
-      // Finally release publisher
+      // Finally release publisher. The I/O shards may be looking up the publishers for a connecting subscriber, and the
+      // subscribers that connected after the unregistration was requested are still in the list
+      cRosMutexLock( &node->io_shard_lock );
+      int list_elem;
+      for(list_elem=0;pub->tcpros_id_list[list_elem]!=-1;list_elem++)
+        closeTcprosProcess(&node->tcpros_server_proc[pub->tcpros_id_list[list_elem]]);
       cRosApiReleasePublisher(node, call->provider_idx);
       initPublisherNode(pub);
+      cRosMutexUnlock( &node->io_shard_lock );
       call->provider_idx = -1;
       break;
     }
     case CROS_API_UNREGISTER_SUBSCRIBER:
     {
-      if (call->provider_idx == -1)
+      if (call->provider_idx == -1 || node->subs[call->provider_idx].topic_name == NULL ||
+          node->subs[call->provider_idx].context != call->provider_context)
         break;
 
       SubscriberNode *sub = &node->subs[call->provider_idx];
@@ -207,7 +359,8 @@ static void handleApiCallAttempt(CrosNode *node, RosApiCall *call)
     }
     case CROS_API_UNREGISTER_SERVICE:
     {
-      if (call->provider_idx == -1)
+      if (call->provider_idx == -1 || node->service_providers[call->provider_idx].service_name == NULL ||
+          node->service_providers[call->provider_idx].context != call->provider_context)
         break;
 
       ServiceProviderNode *service = &node->service_providers[call->provider_idx];
@@ -264,6 +417,10 @@ static void handleXmlrpcClientError(CrosNode *node, int i)
   XmlrpcProcess *proc = &node->xmlrpc_client_proc[i];
   RosApiCall *call = proc->current_call;
 
+  // The master may be restarting: whether it keeps the registrations of the node is checked when it answers again
+  if (call->method == CROS_API_GET_PID && node->master_unreachable_time == 0)
+    node->master_unreachable_time = cRosClockGetTime(&node->clock);
+
   switch (call->method)
   {
     case CROS_API_REGISTER_SERVICE:
@@ -292,9 +449,51 @@ static void handleXmlrpcClientError(CrosNode *node, int i)
   closeXmlrpcProcess(proc);
 }
 
+// Count and report a TCPROS connection of a publisher (is_publisher=1) or subscriber that is about to be closed because its peer vanished
+static void notifyDeadPeer(CrosNode *n, int is_publisher, int proc_idx, CrosDeadPeerReason reason)
+{
+  TcprosProcess *process = (is_publisher)? &n->tcpros_server_proc[proc_idx] : &n->tcpros_client_proc[proc_idx];
+  char peer_addr[MAX_HOST_NAME_LEN + 8];
+  CrosDeadPeer dead_peer;
+
+  dead_peer.is_publisher = is_publisher;
+  dead_peer.topic_idx = process->topic_idx;
+  dead_peer.reason = reason;
+  dead_peer.time = cRosClockGetTime(&n->clock);
+  if(is_publisher)
+  {
+    dead_peer.topic_name = n->pubs[process->topic_idx].topic_name;
+    dead_peer.peer = dynStringGetData(&process->caller_id);
+    if(process->state == TCPROS_PROCESS_STATE_WRITING)
+      dead_peer.unsent_bytes = dynBufferGetRemainingDataSize(tcprosProcessGetWritePacket(process));
+    else if(process->state == TCPROS_PROCESS_STATE_START_WRITING) // The connection could not even start to write the message
+      dead_peer.unsent_bytes = (process->filter.depth > 0)? dynBufferGetSize(&process->filtered_packet) : n->pubs[process->topic_idx].packet_size;
+    else
+      dead_peer.unsent_bytes = 0;
+  }
+  else
+  {
+    dead_peer.topic_name = n->subs[process->topic_idx].topic_name;
+    snprintf(peer_addr, sizeof(peer_addr), "%s:%i", (process->sub_tcpros_host != NULL)? process->sub_tcpros_host : "", process->sub_tcpros_port);
+    dead_peer.peer = peer_addr;
+    dead_peer.unsent_bytes = 0;
+  }
+
+  cRosMutexLock( &n->io_shard_lock ); // Dead peers may be detected by the main loop and by the I/O shards
+  n->n_dead_peers++;
+  cRosMutexUnlock( &n->io_shard_lock );
+
+  PRINT_INFO( "notifyDeadPeer() : Closing the connection of topic %s with %s: %s\n", dead_peer.topic_name, dead_peer.peer,
+              (reason == CROS_DEAD_PEER_WRITE_STALLED)? "the message write has stalled" : "the peer does not acknowledge the data" );
+  if(n->dead_peer_hook != NULL)
+    n->dead_peer_hook(&dead_peer, n->dead_peer_context);
+}
+
 static void handleTcprosClientError(CrosNode *n, int i)
 {
   TcprosProcess *process = &n->tcpros_client_proc[i];
+  if(process->topic_idx != -1 && tcpIpSocketTimedOut(&process->socket))
+    notifyDeadPeer(n, 0, i, CROS_DEAD_PEER_TIMED_OUT);
   closeTcprosProcess(process);
   // CHECK-ME Riaccoda register subscriber?
 }
@@ -305,29 +504,192 @@ static void handleXmlrpcServerError(CrosNode *n, int i)
   closeXmlrpcProcess(process);
 }
 
+// Number of subscribers connected to a publisher. If I/O shards are used, it must be called with n->io_shard_lock acquired
+static int countPublisherSubscribers(PublisherNode *pub)
+{
+  int list_elem;
+
+  for(list_elem=0;pub->tcpros_id_list[list_elem]!=-1;list_elem++);
+  return list_elem;
+}
+
+// Queue the connection or disconnection of the subscriber of a TCPROS server process. The publisher callback is called by the
+// main loop (see callSubscriberCallbacks()), since the process may be served by an I/O shard thread and the callback may use
+// the node API. It must be called with n->io_shard_lock acquired
+static void queueSubscriberEvent(CrosNode *n, int proc_idx, int connected)
+{
+  TcprosProcess *process = &n->tcpros_server_proc[proc_idx];
+  CrosSubscriberEvent *event;
+
+  if(n->n_subscriber_events == CN_MAX_SUBSCRIBER_EVENTS)
+  {
+    PRINT_ERROR("queueSubscriberEvent() : Too many subscriber events waiting for the main loop: the event of %s is lost\n",
+                dynStringGetData(&process->caller_id));
+    return;
+  }
+  event = &n->subscriber_events[(n->subscriber_events_head + n->n_subscriber_events) % CN_MAX_SUBSCRIBER_EVENTS];
+  event->topic_idx = process->topic_idx;
+  event->connected = (unsigned char)connected;
+  event->n_subscribers = countPublisherSubscribers(&n->pubs[process->topic_idx]);
+  dynStringReplaceWithStrN(&event->caller_id, dynStringGetData(&process->caller_id), dynStringGetLen(&process->caller_id));
+  n->n_subscriber_events++;
+  if(proc_idx % n->n_io_shards != 0) // Served by an I/O shard
+    wakeUpMainLoop(n);
+}
+
+// Call the publisher callbacks of the queued subscriber events. Called by the main loop
+static void callSubscriberCallbacks(CrosNode *n)
+{
+  DynString caller_id;
+
+  dynStringInit(&caller_id);
+  cRosMutexLock( &n->io_shard_lock );
+  while(n->n_subscriber_events > 0)
+  {
+    CrosSubscriberEvent *event = &n->subscriber_events[n->subscriber_events_head];
+    PublisherNode *pub = &n->pubs[event->topic_idx];
+    PublisherSubscriberApiCallback callback = (event->connected)? pub->subscriber_connect_callback : pub->subscriber_disconnect_callback;
+    int topic_idx = event->topic_idx, n_subscribers = event->n_subscribers;
+
+    dynStringReplaceWithStrN(&caller_id, dynStringGetData(&event->caller_id), dynStringGetLen(&event->caller_id));
+    n->subscriber_events_head = (n->subscriber_events_head + 1) % CN_MAX_SUBSCRIBER_EVENTS;
+    n->n_subscriber_events--;
+    cRosMutexUnlock( &n->io_shard_lock );
+
+    if(callback != NULL) // The callbacks may have been removed after the event was queued
+      callback(topic_idx, dynStringGetData(&caller_id), n_subscribers, pub->subscriber_callback_context);
+
+    cRosMutexLock( &n->io_shard_lock );
+  }
+  cRosMutexUnlock( &n->io_shard_lock );
+  dynStringRelease(&caller_id);
+}
+
 static void handleTcprosServerError(CrosNode *n, int proc_idx)
 {
   int list_elem;
   TcprosProcess *process = &n->tcpros_server_proc[proc_idx];
-  PublisherNode *pub = &n->pubs[process->topic_idx];
+  PublisherNode *pub = (process->topic_idx != -1)? &n->pubs[process->topic_idx] : NULL; // The header may have not been parsed yet
 
-  // Look for the tcpros_server_proc index (proc_idx) in the publisher tcpros_server_proc list (to remove it)
-  for(list_elem=0;pub->tcpros_id_list[list_elem]!=-1 && pub->tcpros_id_list[list_elem] != proc_idx;list_elem++);
-  if(pub->tcpros_id_list[list_elem] != proc_idx) // tcpros_server_proc index (proc_idx) found
+  if(pub != NULL && tcpIpSocketTimedOut(&process->socket))
+    notifyDeadPeer(n, 1, proc_idx, CROS_DEAD_PEER_TIMED_OUT);
+
+  if(pub != NULL)
   {
-    // Remove index
-    for(;pub->tcpros_id_list[list_elem]!=-1;list_elem++)
-      pub->tcpros_id_list[list_elem] = pub->tcpros_id_list[list_elem+1];
+    cRosMutexLock( &n->io_shard_lock ); // The publisher list may be accessed from the main loop and from I/O shards
+    // Look for the tcpros_server_proc index (proc_idx) in the publisher tcpros_server_proc list (to remove it)
+    for(list_elem=0;pub->tcpros_id_list[list_elem]!=-1 && pub->tcpros_id_list[list_elem] != proc_idx;list_elem++);
+    if(pub->tcpros_id_list[list_elem] == proc_idx) // tcpros_server_proc index (proc_idx) found
+    {
+      // Remove index
+      for(;pub->tcpros_id_list[list_elem]!=-1;list_elem++)
+        pub->tcpros_id_list[list_elem] = pub->tcpros_id_list[list_elem+1];
+      if(pub->subscriber_disconnect_callback != NULL)
+        queueSubscriberEvent(n, proc_idx, 0);
+    }
+    cRosMutexUnlock( &n->io_shard_lock );
   }
-  else
-    PRINT_ERROR("handleTcprosServerError() : TcprosProcess index %i has not been found in Publisher %i", proc_idx, process->topic_idx);
 
+  cRosMutexLock( &n->io_shard_lock );
   closeTcprosProcess(process);
+  cRosMutexUnlock( &n->io_shard_lock );
+}
+
+// Max time (in msec) that a TCPROS server process may remain in its current state without I/O progress
+static uint64_t tcprosServerIoTimeout(CrosNode *n, TcprosProcess *server_proc)
+{
+  if((server_proc->state == TCPROS_PROCESS_STATE_START_WRITING || server_proc->state == TCPROS_PROCESS_STATE_WRITING) &&
+     server_proc->topic_idx != -1 &&
+     n->pubs[server_proc->topic_idx].tcp_tuning.write_timeout > 0)
+    return n->pubs[server_proc->topic_idx].tcp_tuning.write_timeout;
+  return CN_IO_TIMEOUT;
+}
+
+// Time (in msec) left until the I/O timeout of a TCPROS server process expires. UINT64_MAX if the process is not waiting for I/O
+static uint64_t tcprosServerIoTimeoutWait(CrosNode *n, int i, uint64_t cur_time)
+{
+  TcprosProcess *server_proc = &n->tcpros_server_proc[i];
+  uint64_t deadline;
+
+  if(server_proc->state != TCPROS_PROCESS_STATE_READING_HEADER && server_proc->state != TCPROS_PROCESS_STATE_START_WRITING &&
+     server_proc->state != TCPROS_PROCESS_STATE_WRITING)
+    return UINT64_MAX;
+  deadline = server_proc->last_change_time + tcprosServerIoTimeout(n, server_proc);
+  return (deadline > cur_time)? deadline - cur_time : 0;
+}
+
+// Close the TCPROS server processes of an I/O shard whose I/O operations have timed out. The subscribers whose
+// message write has stalled (or cannot even start because the socket buffer is full) are considered dead: otherwise
+// they would stall the publication to all the subscribers
+static void checkTcprosServerIoTimeouts(CrosNode *n, int shard_idx, uint64_t cur_time)
+{
+  int timed_out[CN_MAX_TCPROS_SERVER_CONNECTIONS];
+  int n_timed_out = 0, i, k;
+
+  cRosMutexLock( &n->io_shard_lock ); // The main loop may start a publication (change the state) of a process of an I/O shard
+  for( i = shard_idx; i < CN_MAX_TCPROS_SERVER_CONNECTIONS; i += n->n_io_shards )
+  {
+    if( tcprosServerIoTimeoutWait( n, i, cur_time ) == 0 &&
+        cur_time > n->tcpros_server_proc[i].last_change_time ) // The process may have progressed after cur_time was obtained
+      timed_out[n_timed_out++] = i;
+  }
+  cRosMutexUnlock( &n->io_shard_lock );
+
+  for( k = 0; k < n_timed_out; k++ )
+  {
+    TcprosProcess *server_proc = &n->tcpros_server_proc[timed_out[k]];
+
+    // Timeout between I/O operations
+    PRINT_VDEBUG ( "checkTcprosServerIoTimeouts() : TCPROS server I/O timeout\n");
+    if( server_proc->state != TCPROS_PROCESS_STATE_READING_HEADER && server_proc->topic_idx != -1 )
+      notifyDeadPeer( n, 1, timed_out[k], CROS_DEAD_PEER_WRITE_STALLED );
+    handleTcprosServerError( n, timed_out[k] );
+  }
+}
+
+// Apply the socket options of a topic to one of its connections. The kernel buffer that holds the outgoing (is_sender=1)
+// or incoming messages is enlarged according to the largest message observed if auto-sizing is enabled
+static void applyTcpTuning(TcpIpSocket *socket, const CrosTcpTuning *tuning, size_t max_msg_size, int is_sender)
+{
+  size_t snd_buf_size = tuning->snd_buf_size, rcv_buf_size = tuning->rcv_buf_size;
+
+  if( tuning->keepalive_idle > 0 || tuning->keepalive_interval > 0 || tuning->keepalive_count > 0 )
+    tcpIpSocketSetKeepAlive( socket, (tuning->keepalive_idle > 0)? tuning->keepalive_idle : 60,
+                             (tuning->keepalive_interval > 0)? tuning->keepalive_interval : 10,
+                             (tuning->keepalive_count > 0)? tuning->keepalive_count : 9 );
+  if( tuning->user_timeout > 0 )
+    tcpIpSocketSetUserTimeout( socket, tuning->user_timeout );
+
+  if( tuning->auto_buf_size && is_sender && CN_TCP_AUTO_BUF_MSGS * max_msg_size > snd_buf_size )
+    snd_buf_size = CN_TCP_AUTO_BUF_MSGS * max_msg_size;
+  if( tuning->auto_buf_size && !is_sender && CN_TCP_AUTO_BUF_MSGS * max_msg_size > rcv_buf_size )
+    rcv_buf_size = CN_TCP_AUTO_BUF_MSGS * max_msg_size;
+  if( snd_buf_size > 0 || rcv_buf_size > 0 )
+    tcpIpSocketSetBufferSizes( socket, snd_buf_size, rcv_buf_size );
+}
+
+// The RPCROS connection of the client process i has been closed or renewed, so the response of the in-place call in progress will not arrive
+static void loseRpcrosClientInPlaceCall(CrosNode *n, int i)
+{
+  TcprosProcess *process = &n->rpcros_client_proc[i];
+  ServiceCallerNode *svc_caller;
+
+  if(process->service_idx < 0 || process->service_idx >= CN_MAX_SERVICE_CALLERS)
+    return;
+  svc_caller = &n->service_callers[process->service_idx];
+  if(svc_caller->in_place_call == CROS_IN_PLACE_CALL_SENT)
+  {
+    svc_caller->in_place_err = CROS_RPCROS_CLI_CONN_ERR;
+    svc_caller->in_place_call = CROS_IN_PLACE_CALL_FAILED;
+  }
+  else if(svc_caller->in_place_call == CROS_IN_PLACE_CALL_ABANDONED)
+    svc_caller->in_place_call = CROS_IN_PLACE_CALL_NONE;
 }
 
 static void handleRpcrosClientError(CrosNode *n, int i)
 {
   TcprosProcess *process = &n->rpcros_client_proc[i];
+  loseRpcrosClientInPlaceCall(n, i);
   closeTcprosProcess(process);
 }
 
@@ -337,6 +699,180 @@ static void handleRpcrosServerError(CrosNode *n, int i)
   closeTcprosProcess(process);
 }
 
+static CrosTopicPriority getTcprosProcPriority(CrosNode *n, int is_server, int i)
+{
+  int topic_idx;
+  CrosTopicPriority priority = CROS_TOPIC_PRIORITY_NORMAL; // Processes not associated to a topic yet have the default priority
+
+  if( is_server )
+  {
+    topic_idx = n->tcpros_server_proc[i].topic_idx;
+    if( topic_idx >= 0 && topic_idx < CN_MAX_PUBLISHED_TOPICS )
+      priority = n->pubs[topic_idx].priority;
+  }
+  else
+  {
+    topic_idx = n->tcpros_client_proc[i].topic_idx;
+    if( topic_idx >= 0 && topic_idx < CN_MAX_SUBSCRIBED_TOPICS )
+      priority = n->subs[topic_idx].priority;
+  }
+  return priority;
+}
+
+// Fill order[] with the indices first, first+step, ... of the TCPROS server (is_server=1) or client processes sorted
+// by the priority of their topics (highest first). Returns the number of indices and, in n_high, the number of
+// high-priority ones (placed at the beginning of the array)
+static int orderTcprosProcsByPriority(CrosNode *n, int is_server, int first, int step, int n_procs, int order[], int *n_high)
+{
+  int prio, i, n_order;
+
+  n_order = 0;
+  *n_high = 0;
+  for( prio = CROS_TOPIC_PRIORITY_HIGH; prio >= CROS_TOPIC_PRIORITY_BULK; prio-- )
+  {
+    for( i = first; i < n_procs; i += step )
+    {
+      if( getTcprosProcPriority( n, is_server, i ) == prio )
+        order[n_order++] = i;
+    }
+    if( prio == CROS_TOPIC_PRIORITY_HIGH )
+      *n_high = n_order;
+  }
+  return n_order;
+}
+
+static int setTcprosSocketPriority(TcpIpSocket *socket, CrosTopicPriority priority)
+{
+  int ret;
+
+  if( !socket->open )
+    return 1; // It will be set when the connection is established
+
+  switch( priority )
+  {
+    case CROS_TOPIC_PRIORITY_HIGH:
+      ret = tcpIpSocketSetPriority( socket, 6, 46 ); // Interactive priority and Expedited Forwarding (EF) DSCP
+      break;
+    case CROS_TOPIC_PRIORITY_BULK:
+      ret = tcpIpSocketSetPriority( socket, 1, 8 ); // Bulk priority and Class Selector 1 (CS1, lower effort) DSCP
+      break;
+    case CROS_TOPIC_PRIORITY_NORMAL:
+    default:
+      ret = tcpIpSocketSetPriority( socket, 0, 0 );
+      break;
+  }
+  return ret;
+}
+
+// Check whether a TCPROS server process in the writing state has already written its whole packet, so it is only waiting
+// for the completion notifications of its zero-copy sends (see cRosNodeSetPublisherZeroCopy()) before reusing the packet buffer
+static int tcprosServerWaitsForZeroCopy( TcprosProcess *server_proc )
+{
+  return ( server_proc->state == TCPROS_PROCESS_STATE_WRITING &&
+           dynBufferGetRemainingDataSize( tcprosProcessGetWritePacket( server_proc ) ) == 0 );
+}
+
+// Check whether the rate limit of a TCPROS server process (publisher connection) allows it to start writing the
+// triggered message. If it does not, the message is deferred or dropped for this connection according to the publisher policy
+static int tcprosServerShapingAllowsWriting(CrosNode *n, int i, uint64_t cur_time)
+{
+  TcprosProcess *server_proc = &n->tcpros_server_proc[i];
+  PublisherNode *pub;
+
+  if( server_proc->topic_idx < 0 || cRosTokenBucketReady( &server_proc->shaper, cur_time ) )
+    return 1;
+
+  pub = &n->pubs[server_proc->topic_idx];
+  cRosMutexLock( &n->io_shard_lock ); // The state and the publisher counters may be accessed from the main loop and from I/O shards
+  if( server_proc->state == TCPROS_PROCESS_STATE_START_WRITING )
+  {
+    if( pub->shaping_policy == CROS_SHAPING_DROP )
+    {
+      tcprosProcessChangeState( server_proc, TCPROS_PROCESS_STATE_WAIT_FOR_WRITING ); // Skip this message
+      pub->n_dropped_msgs++;
+    }
+    else
+    {
+      if( !server_proc->shaping_deferred )
+      {
+        server_proc->shaping_deferred = 1;
+        pub->n_shaped_msgs++;
+      }
+      server_proc->last_change_time = cur_time; // The I/O timeout only runs while the connection is allowed to write
+    }
+  }
+  cRosMutexUnlock( &n->io_shard_lock );
+  return 0;
+}
+
+// Check whether a TCPROS server process is waiting for its rate limit to start writing the triggered message (policy DEFER)
+static int tcprosServerShapingDeferred(TcprosProcess *server_proc)
+{
+  return( server_proc->state == TCPROS_PROCESS_STATE_START_WRITING && server_proc->shaping_deferred );
+}
+
+// Check whether all the processes of a publisher are ready to start writing a new message. The processes deferred by their
+// rate limit do not hold back the others: the new message replaces their deferred one. It must be called with
+// n->io_shard_lock acquired
+static int publisherProcsReady(CrosNode *n, PublisherNode *pub)
+{
+  int list_elem;
+
+  if(pub->tcpros_id_list[0] == -1)
+    return 0;
+  for(list_elem=0;pub->tcpros_id_list[list_elem]!=-1;list_elem++)
+  {
+    TcprosProcess *server_proc = &n->tcpros_server_proc[pub->tcpros_id_list[list_elem]];
+    if(server_proc->state != TCPROS_PROCESS_STATE_WAIT_FOR_WRITING && !tcprosServerShapingDeferred(server_proc))
+      return 0;
+  }
+  return 1;
+}
+
+// Take back the triggered message from the connections of a publisher that are deferred by their rate limit, so that the
+// next message replaces it (it is counted as dropped) instead of a slow connection holding back the whole topic.
+// The connections that send their own filtered frames keep them, since they do not read the publisher packet.
+// Must be called before the publisher packet is overwritten. Returns the number of processes stored in held_procs
+static int holdDeferredPublisherProcs(CrosNode *n, PublisherNode *pub, int held_procs[])
+{
+  int list_elem, n_held = 0;
+
+  cRosMutexLock( &n->io_shard_lock ); // A shard may be starting to write the deferred message right now
+  for(list_elem=0;pub->tcpros_id_list[list_elem]!=-1;list_elem++)
+  {
+    TcprosProcess *server_proc = &n->tcpros_server_proc[pub->tcpros_id_list[list_elem]];
+    if(tcprosServerShapingDeferred(server_proc) && server_proc->filter.depth == 0)
+    {
+      tcprosProcessChangeState( server_proc, TCPROS_PROCESS_STATE_WAIT_FOR_WRITING );
+      server_proc->shaping_deferred = 0; // The next message will be deferred (and counted) in turn
+      pub->n_dropped_msgs++;
+      held_procs[n_held++] = pub->tcpros_id_list[list_elem];
+    }
+  }
+  cRosMutexUnlock( &n->io_shard_lock );
+  return n_held;
+}
+
+// Give back the triggered message to the processes taken by holdDeferredPublisherProcs() when no new message replaced it
+static void resumeHeldPublisherProcs(CrosNode *n, PublisherNode *pub, const int held_procs[], int n_held, int shards_to_wake_up[])
+{
+  int k;
+
+  cRosMutexLock( &n->io_shard_lock );
+  for(k = 0; k < n_held; k++)
+  {
+    TcprosProcess *server_proc = &n->tcpros_server_proc[held_procs[k]];
+    if(server_proc->state == TCPROS_PROCESS_STATE_WAIT_FOR_WRITING) // A shard may have closed the connection meanwhile
+    {
+      tcprosProcessChangeState( server_proc, TCPROS_PROCESS_STATE_START_WRITING );
+      server_proc->shaping_deferred = 1;
+      pub->n_dropped_msgs--;
+      shards_to_wake_up[held_procs[k] % n->n_io_shards] = 1;
+    }
+  }
+  cRosMutexUnlock( &n->io_shard_lock );
+}
+
 static cRosErrCodePack xmlrpcClientConnect(CrosNode *n, int i)
 {
   cRosErrCodePack ret_err;
@@ -649,7 +1185,11 @@ static cRosErrCodePack tcprosClientConnect( CrosNode *n, int client_idx)
   TcprosProcess *client_proc = &(n->tcpros_client_proc[client_idx]);
 
   if(!client_proc->socket.open)
+  {
     openTcprosClientSocket(n, client_idx);
+    if(client_proc->topic_idx != -1) // The buffer sizes must be set before connecting to take effect on the TCP window
+      applyTcpTuning(&client_proc->socket, &n->subs[client_proc->topic_idx].tcp_tuning, n->subs[client_proc->topic_idx].max_msg_size, 0);
+  }
 
   tcprosProcessClear( client_proc ); // clear packet buffer and variable indicating bytes left to receive (left_to_recv)
   TcpIpSocketState conn_state = tcpIpSocketConnect( &(client_proc->socket),
@@ -693,7 +1233,7 @@ static cRosErrCodePack tcprosClientConnect( CrosNode *n, int client_idx)
 
 static cRosErrCodePack doWithTcprosClientSocket( CrosNode *n, int client_idx)
 {
-  cRosErrCodePack ret_err;
+  cRosErrCodePack ret_err, new_errors;
   PRINT_VVDEBUG ( "doWithTcprosClientSocket()\n" );
 
   ret_err = CROS_SUCCESS_ERR_PACK;
@@ -803,6 +1343,11 @@ static cRosErrCodePack doWithTcprosClientSocket( CrosNode *n, int client_idx)
       switch ( parser_state )
       {
         case TCPROS_PARSER_DONE:
+          if( getTcprosProcPriority( n, 0, client_idx ) != CROS_TOPIC_PRIORITY_NORMAL )
+            setTcprosSocketPriority( &(client_proc->socket), getTcprosProcPriority( n, 0, client_idx ) );
+          if( n->subs[client_proc->topic_idx].rx_timestamps )
+            tcpIpSocketSetRxTimestamps( &(client_proc->socket), 1 );
+          cRosTopicStatsInit( &(client_proc->stats), cRosClockGetTime(&n->clock) );
           tcprosProcessClear( client_proc );
           client_proc->left_to_recv = sizeof(uint32_t);
           tcprosProcessChangeState( client_proc, TCPROS_PROCESS_STATE_READING_SIZE );
@@ -817,28 +1362,84 @@ static cRosErrCodePack doWithTcprosClientSocket( CrosNode *n, int client_idx)
       break; // To avoid blocking ???
     }
     case TCPROS_PROCESS_STATE_READING_SIZE:
+    case TCPROS_PROCESS_STATE_READING:
     {
-      size_t n_reads;
+      // The packet buffer starts with the size field of the frame being read. Up to CN_TCPROS_READ_AHEAD_SIZE bytes
+      // of the following frames are read with the same recv() call, so that they can be parsed without more system calls
+      size_t n_reads, max_reads = client_proc->left_to_recv + CN_TCPROS_READ_AHEAD_SIZE;
+      int frame_starts = (dynBufferGetSize(&client_proc->packet) == 0); // The size field of a new frame starts in the read data
+      if( getTcprosProcPriority( n, 0, client_idx ) == CROS_TOPIC_PRIORITY_BULK && max_reads > CN_BULK_MAX_BYTES_PER_LOOP )
+        max_reads = CN_BULK_MAX_BYTES_PER_LOOP; // Let the other connections be served before reading the rest of the message
       TcpIpSocketState sock_state = tcpIpSocketReadBufferEx( &(client_proc->socket),
                                                           &(client_proc->packet),
-                                                          client_proc->left_to_recv,
+                                                          max_reads,
                                                           &n_reads);
 
       switch ( sock_state )
       {
         case TCPIPSOCKET_DONE:
-          client_proc->left_to_recv -= n_reads;
-          if (client_proc->left_to_recv == 0)
+        {
+          size_t frame_start = 0, frame_size;
+          uint32_t frame_size_field;
+
+          if (frame_starts)
+            client_proc->frame_rx_time_stamp = client_proc->socket.rx_time_stamp;
+
+          // Parse all the complete frames in the buffer
+          for(;;)
           {
-            const unsigned char *data = dynBufferGetCurrentData(&client_proc->packet);
-            uint32_t msg_size = 0;
-            msg_size = ROS_TO_HOST_UINT32(*(uint32_t *)data);
-            tcprosProcessClear( client_proc );
-            client_proc->left_to_recv = msg_size;
-            tcprosProcessChangeState( client_proc, TCPROS_PROCESS_STATE_READING);
-            goto read_msg;
+            size_t avail_bytes = dynBufferGetSize(&client_proc->packet) - frame_start;
+            if (avail_bytes < sizeof(uint32_t))
+            {
+              client_proc->left_to_recv = sizeof(uint32_t) - avail_bytes;
+              tcprosProcessChangeState( client_proc, TCPROS_PROCESS_STATE_READING_SIZE );
+              break;
+            }
+            memcpy(&frame_size_field, dynBufferGetData(&client_proc->packet) + frame_start, sizeof(uint32_t)); // The frame may be unaligned
+            frame_size = sizeof(uint32_t) + ROS_TO_HOST_UINT32(frame_size_field);
+            if (frame_size > n->subs[client_proc->topic_idx].max_msg_size)
+            {
+              SubscriberNode *sub = &n->subs[client_proc->topic_idx];
+              sub->max_msg_size = frame_size;
+              if (sub->tcp_tuning.auto_buf_size)
+                tcpIpSocketSetBufferSizes( &(client_proc->socket), 0, (sub->tcp_tuning.rcv_buf_size > CN_TCP_AUTO_BUF_MSGS * frame_size)?
+                                           sub->tcp_tuning.rcv_buf_size : CN_TCP_AUTO_BUF_MSGS * frame_size );
+            }
+            if (avail_bytes < frame_size)
+            {
+              client_proc->left_to_recv = frame_size - avail_bytes;
+              tcprosProcessChangeState( client_proc, TCPROS_PROCESS_STATE_READING );
+              break;
+            }
+
+            // The buffer is truncated at the end of the frame while it is parsed, so that the message cannot be decoded
+            // from the data of the next frames
+            size_t read_size = dynBufferGetSize(&client_proc->packet);
+            tcprosProcessChangeState( client_proc, TCPROS_PROCESS_STATE_READING );
+            dynBufferTruncate( &(client_proc->packet), frame_start + frame_size );
+            dynBufferSetPoseIndicator( &(client_proc->packet), frame_start + sizeof(uint32_t) );
+            new_errors = cRosMessageParsePublicationPacket(n, client_idx);
+            ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+            if (client_proc->state != TCPROS_PROCESS_STATE_READING) // The connection has been closed by the subscriber callback
+              break;
+            if (new_errors == CROS_SUCCESS_ERR_PACK && dynBufferGetPoseIndicatorOffset(&client_proc->packet) != frame_start + frame_size)
+            { // The definitions of the message used by the publisher and by this subscriber probably differ
+              PRINT_ERROR( "doWithTcprosClientSocket() : The message decoded from a frame of topic %s uses %lu bytes of the %lu bytes of the frame\n",
+                           n->subs[client_proc->topic_idx].topic_name,
+                           (unsigned long)(dynBufferGetPoseIndicatorOffset(&client_proc->packet) - frame_start - sizeof(uint32_t)),
+                           (unsigned long)(frame_size - sizeof(uint32_t)) );
+              ret_err = cRosAddErrCode(ret_err, CROS_DEPACK_FRAME_SIZE_ERR);
+            }
+            dynBufferCommit( &(client_proc->packet), read_size - (frame_start + frame_size) ); // Restore the data of the next frames
+
+            frame_start += frame_size;
+            if (frame_start < dynBufferGetSize(&client_proc->packet)) // The next frame starts in the data read by this call
+              client_proc->frame_rx_time_stamp = client_proc->socket.rx_time_stamp;
           }
+          if (client_proc->state == TCPROS_PROCESS_STATE_READING || client_proc->state == TCPROS_PROCESS_STATE_READING_SIZE)
+            dynBufferEraseFront( &(client_proc->packet), frame_start ); // Keep only the frame being read
           break;
+        }
         case TCPIPSOCKET_IN_PROGRESS:
           break;
         case TCPIPSOCKET_DISCONNECTED:
@@ -849,41 +1450,10 @@ static cRosErrCodePack doWithTcprosClientSocket( CrosNode *n, int client_idx)
       }
       break;
     }
-    read_msg:
-    case TCPROS_PROCESS_STATE_READING:
+    default:
     {
-      size_t n_reads;
-      TcpIpSocketState sock_state = tcpIpSocketReadBufferEx( &(client_proc->socket),
-                                                          &(client_proc->packet),
-                                                          client_proc->left_to_recv,
-                                                          &n_reads);
-
-      switch ( sock_state )
-      {
-        case TCPIPSOCKET_DONE:
-          client_proc->left_to_recv -= n_reads;
-          if (client_proc->left_to_recv == 0)
-          {
-              ret_err = cRosMessageParsePublicationPacket(n, client_idx);
-              tcprosProcessClear( client_proc );
-              client_proc->left_to_recv = sizeof(uint32_t);
-              tcprosProcessChangeState( client_proc, TCPROS_PROCESS_STATE_READING_SIZE );
-          }
-          break;
-        case TCPIPSOCKET_IN_PROGRESS:
-          break;
-        case TCPIPSOCKET_DISCONNECTED:
-        case TCPIPSOCKET_FAILED:
-        default:
-          handleTcprosClientError( n, client_idx );
-          break;
-      }
-      break;
-    }
-    default:
-    {
-      PRINT_ERROR( "doWithTcprosClientSocket() : Invalid TCPROS process state\n" );
-    }
+      PRINT_ERROR( "doWithTcprosClientSocket() : Invalid TCPROS process state\n" );
+    }
 
   }
   return ret_err;
@@ -928,9 +1498,22 @@ static cRosErrCodePack doWithTcprosServerSocket( CrosNode *n, int i )
       case TCPROS_PARSER_DONE:
 
         PRINT_VDEBUG ( "doWithTcprosServerSocket() : Done reading and parsing with no error\n" );
+        if( getTcprosProcPriority( n, 1, i ) != CROS_TOPIC_PRIORITY_NORMAL )
+          setTcprosSocketPriority( &(server_proc->socket), getTcprosProcPriority( n, 1, i ) );
+        cRosTokenBucketInit( &(server_proc->shaper), n->pubs[server_proc->topic_idx].conn_byte_rate,
+                             n->pubs[server_proc->topic_idx].conn_burst, cRosClockGetTime(&n->clock) );
+        if( n->pubs[server_proc->topic_idx].zerocopy_min_size > 0 )
+          tcpIpSocketSetZeroCopy( &(server_proc->socket), n->pubs[server_proc->topic_idx].zerocopy_min_size );
+        applyTcpTuning( &(server_proc->socket), &n->pubs[server_proc->topic_idx].tcp_tuning, n->pubs[server_proc->topic_idx].max_msg_size, 1 );
         tcprosProcessClear( server_proc );
         cRosMessagePreparePublicationHeader( n, i );
         tcprosProcessChangeState( server_proc, TCPROS_PROCESS_STATE_WRITING ); // Proceed to write the header
+        if( n->pubs[server_proc->topic_idx].subscriber_connect_callback != NULL )
+        {
+          cRosMutexLock( &n->io_shard_lock );
+          queueSubscriberEvent( n, i, 1 );
+          cRosMutexUnlock( &n->io_shard_lock );
+        }
         break;
       case TCPROS_PARSER_HEADER_INCOMPLETE:
         break;
@@ -948,22 +1531,58 @@ static cRosErrCodePack doWithTcprosServerSocket( CrosNode *n, int i )
     PRINT_VDEBUG ( "doWithTcprosServerSocket() : writing. Tcpros server index: %d \n", i );
     if( server_proc->state == TCPROS_PROCESS_STATE_START_WRITING ) // Start to publish a message
     {
+      // The main loop may take back a deferred message to replace it (see holdDeferredPublisherProcs()), so the state is
+      // checked again while the publisher packet is copied
+      PublisherNode *pub = &n->pubs[server_proc->topic_idx];
+      int shard_serialization;
+      cRosMutexLock( &n->io_shard_lock );
+      if( server_proc->state != TCPROS_PROCESS_STATE_START_WRITING )
+      {
+        cRosMutexUnlock( &n->io_shard_lock );
+        return ret_err;
+      }
       tcprosProcessClear( server_proc );
-      ret_err = cRosMessagePreparePublicationPacket( n, i );
+      shard_serialization = ( pub->shard_serialization && server_proc->filter.depth == 0 );
+      if( !shard_serialization )
+        ret_err = cRosMessagePreparePublicationPacket( n, i );
+      cRosTokenBucketConsume( &(server_proc->shaper), (shard_serialization)? pub->packet_size : dynBufferGetSize( tcprosProcessGetWritePacket( server_proc ) ) );
+      server_proc->shaping_deferred = 0;
       tcprosProcessChangeState( server_proc, TCPROS_PROCESS_STATE_WRITING );
+      cRosMutexUnlock( &n->io_shard_lock );
+      // Once the process is writing, the main loop does not change the message: it is serialized without blocking the
+      // main loop and the other shards
+      if( shard_serialization )
+        ret_err = cRosMessagePreparePublicationPacket( n, i );
     }
-    TcpIpSocketState sock_state =  tcpIpSocketWriteBuffer( &(server_proc->socket),
-                                                           &(server_proc->packet) );
+    DynBuffer *write_packet = tcprosProcessGetWritePacket( server_proc ); // The publisher buffer if it is sent with zero-copy
+    size_t n_writes, max_writes = dynBufferGetRemainingDataSize( write_packet );
+    if( getTcprosProcPriority( n, 1, i ) == CROS_TOPIC_PRIORITY_BULK && max_writes > CN_BULK_MAX_BYTES_PER_LOOP )
+      max_writes = CN_BULK_MAX_BYTES_PER_LOOP; // Let the other connections be served before writing the rest of the message
+    TcpIpSocketState sock_state =  tcpIpSocketWriteBufferEx( &(server_proc->socket), write_packet, max_writes, &n_writes );
 
     switch ( sock_state )
     {
       case TCPIPSOCKET_DONE:
+        if( tcpIpSocketZeroCopyPending( &(server_proc->socket) ) )
+        {
+          // The kernel may still be transmitting directly from the packet buffer: keep it untouched (and the publication
+          // of the next message waiting) until the completion notifications arrive
+          PRINT_VDEBUG ( "doWithTcprosServerSocket() : Waiting for zero-copy send completions. Tcpros server index: %d \n", i );
+          break;
+        }
         PRINT_VDEBUG ( "doWithTcprosServerSocket() : Done writing with no error\n" );
         tcprosProcessClear( server_proc );
+        cRosMutexLock( &n->io_shard_lock ); // This state is checked by the main loop when triggering a publication
         tcprosProcessChangeState( server_proc, TCPROS_PROCESS_STATE_WAIT_FOR_WRITING ); // Wait before publishing a new message
+        // The main loop may be waiting for the last process of the publisher to publish the next message (e.g. a queued one)
+        if( i % n->n_io_shards != 0 && publisherProcsReady( n, &n->pubs[server_proc->topic_idx] ) )
+          wakeUpMainLoop( n );
+        cRosMutexUnlock( &n->io_shard_lock );
         break;
 
       case TCPIPSOCKET_IN_PROGRESS:
+        if( n_writes > 0 ) // The I/O timeout only expires if the write makes no progress (a large message may take long to be sent)
+          server_proc->last_change_time = cRosClockGetTime( &n->clock );
         break;
 
       case TCPIPSOCKET_DISCONNECTED:
@@ -1147,6 +1766,7 @@ static cRosErrCodePack doWithRpcrosClientSocket(CrosNode *n, int client_idx)
       {
         case TCPROS_PARSER_DONE:
           tcprosProcessClear( client_proc );
+          loseRpcrosClientInPlaceCall(n, client_idx); // A new connection: no response is pending on it
           tcprosProcessChangeState( client_proc, TCPROS_PROCESS_STATE_WAIT_FOR_WRITING );
           break;
         case TCPROS_PARSER_HEADER_INCOMPLETE:
@@ -1753,6 +2373,8 @@ CrosNode *cRosNodeCreate (const char *node_name, const char *node_host, const ch
   }
 
   new_n->name = new_n->host = new_n->roscore_host = NULL;
+  new_n->data_host = NULL; // All the TCPROS connections use the node host until cRosNodeSetDataHost() is called
+  new_n->data_tcpros_port = 0;
 
   new_n->name = cRosNamespaceBuild(NULL, node_name);
   new_n->host = ( char * ) malloc ( ( strlen ( node_host ) + 1 ) *sizeof ( char ) );
@@ -1777,7 +2399,14 @@ CrosNode *cRosNodeCreate (const char *node_name, const char *node_host, const ch
   new_n->roscore_port = roscore_port;
   new_n->roscore_pid = -1;
 
+  // All the scheduling of the node (and the state-change times of its processes) follows the node clock
+  cRosClockInit( &new_n->clock );
+  cRosMutexInit( &new_n->clock_lock );
+  new_n->main_wake_up_fd[0] = new_n->main_wake_up_fd[1] = -1;
+  new_n->io_uring = NULL;
+
   xmlrpcProcessInit( &(new_n->xmlrpc_listner_proc) );
+  new_n->xmlrpc_listner_proc.clock = &new_n->clock;
 
   new_n->next_call_id = 0;
   initApiCallQueue(&new_n->master_api_queue);
@@ -1787,26 +2416,63 @@ CrosNode *cRosNodeCreate (const char *node_name, const char *node_host, const ch
 
   int i, fn_ret;
   for (i = 0 ; i < CN_MAX_XMLRPC_SERVER_CONNECTIONS; i++)
+  {
     xmlrpcProcessInit( &(new_n->xmlrpc_server_proc[i]) );
+    new_n->xmlrpc_server_proc[i].clock = &new_n->clock;
+  }
 
   for ( i = 0 ; i < CN_MAX_XMLRPC_CLIENT_CONNECTIONS; i++)
+  {
     xmlrpcProcessInit( &(new_n->xmlrpc_client_proc[i]) );
+    new_n->xmlrpc_client_proc[i].clock = &new_n->clock;
+  }
 
   tcprosProcessInit( &(new_n->tcpros_listner_proc) );
+  new_n->tcpros_listner_proc.clock = &new_n->clock;
+  tcprosProcessInit( &(new_n->tcpros_data_listner_proc) );
+  new_n->tcpros_data_listner_proc.clock = &new_n->clock;
 
   for ( i = 0; i < CN_MAX_TCPROS_SERVER_CONNECTIONS; i++)
+  {
     tcprosProcessInit( &(new_n->tcpros_server_proc[i]) );
+    new_n->tcpros_server_proc[i].clock = &new_n->clock;
+  }
+
+  new_n->n_io_shards = 1;
+  for ( i = 0; i < CN_MAX_IO_SHARDS-1; i++)
+  {
+    tcprosProcessInit( &(new_n->io_shards[i].tcpros_listner_proc) );
+    new_n->io_shards[i].tcpros_listner_proc.clock = &new_n->clock;
+    new_n->io_shards[i].wake_up_fd[0] = new_n->io_shards[i].wake_up_fd[1] = -1;
+    new_n->io_shards[i].io_uring = NULL;
+  }
+  cRosMutexInit( &new_n->io_shard_lock );
+  cRosMessageParallelismInit( &new_n->serialization_parallelism );
+  for ( i = 0; i < CN_MAX_SUBSCRIBER_EVENTS; i++)
+    dynStringInit( &(new_n->subscriber_events[i].caller_id) );
+  new_n->subscriber_events_head = 0;
+  new_n->n_subscriber_events = 0;
 
   for ( i = 0; i < CN_MAX_TCPROS_CLIENT_CONNECTIONS; i++)
+  {
     tcprosProcessInit( &(new_n->tcpros_client_proc[i]) );
+    new_n->tcpros_client_proc[i].clock = &new_n->clock;
+  }
 
   tcprosProcessInit( &(new_n->rpcros_listner_proc) );
+  new_n->rpcros_listner_proc.clock = &new_n->clock;
 
   for ( i = 0; i < CN_MAX_RPCROS_SERVER_CONNECTIONS; i++)
+  {
     tcprosProcessInit( &(new_n->rpcros_server_proc[i]) );
+    new_n->rpcros_server_proc[i].clock = &new_n->clock;
+  }
 
   for ( i = 0; i < CN_MAX_RPCROS_CLIENT_CONNECTIONS; i++)
+  {
     tcprosProcessInit( &(new_n->rpcros_client_proc[i]) );
+    new_n->rpcros_client_proc[i].clock = &new_n->clock;
+  }
 
   for ( i = 0; i < CN_MAX_PUBLISHED_TOPICS; i++)
     initPublisherNode(&new_n->pubs[i]);
@@ -1865,38 +2531,251 @@ CrosNode *cRosNodeCreate (const char *node_name, const char *node_host, const ch
 
   new_n-> log_last_id = 0;
 
-  /*
-   * Registering logging callback
-   */
+  // The built-in /rosout publisher and logger services are registered on demand (see cRosNodeSetBuiltins())
+  new_n->rosout_pub_idx = -1;
+  new_n->statistics_pub_idx = -1; // Registered by the first cRosNodeSetSubscriberStatistics() call
+
+  new_n->callback_overrun_hook = NULL;
+  new_n->callback_overrun_context = NULL;
+  new_n->callback_overrun_log_period = 0;
+  new_n->callback_overrun_last_log = 0;
+  new_n->n_unlogged_overruns = 0;
+  new_n->dead_peer_hook = NULL;
+  new_n->dead_peer_context = NULL;
+  new_n->n_dead_peers = 0;
+  new_n->master_unreachable_time = 0;
+  new_n->master_check_call_id = -1;
+  new_n->master_restart_time = 0;
+  new_n->reregistration_cursor = -1;
+  cRosTokenBucketInit( &new_n->reregistration_shaper, 0, 0, 0 );
+  new_n->n_master_restarts = 0;
+  new_n->last_recovery_time = 0;
+  cRosGraphCacheInit( &new_n->graph_cache );
+  new_n->graph_cache_enabled = 0;
+  new_n->graph_cache_valid = 0;
+  new_n->graph_cache_call_id = -1;
+  new_n->graph_cache_min_period = 0;
+  new_n->graph_cache_max_period = 0;
+  new_n->graph_cache_period = 0;
+  new_n->graph_cache_wake_up_time = 0;
+  new_n->graph_change_callback = NULL;
+  new_n->graph_change_context = NULL;
+  new_n->builtins = CROS_BUILTIN_ALL;
+  new_n->builtins_created = CROS_BUILTIN_NONE;
+  new_n->io_uring = tcpIpUringCreate(); // If NULL, the main loop uses select()
 
-  cRosErrCodePack ret_err;
+  return new_n;
+}
 
-  // Create a publisher of the topic /rosout of type "rosgraph_msgs/Log".
-  // The messages of this topic will not be periodically sent but on demand (loop_period = -1).
-  ret_err = cRosApiRegisterPublisher(new_n,"/rosout","rosgraph_msgs/Log", -1, NULL, NULL, new_n, &new_n->rosout_pub_idx);
-  if (ret_err != CROS_SUCCESS_ERR_PACK)
+cRosErrCodePack cRosNodeSetClock( CrosNode *n, const CrosClock *clock )
+{
+  PRINT_VVDEBUG ( "cRosNodeSetClock()\n" );
+
+  if(n == NULL || clock == NULL)
+    return CROS_BAD_PARAM_ERR;
+
+  n->clock = *clock;
+  if(n->clock.type == CROS_CLOCK_SIMULATED)
   {
-    PRINT_ERROR ( "cRosNodeCreate(): Error registering rosout.\n");
-    cRosPrintErrCodePack(ret_err, "cRosNodeCreate()");
+    // The shard loops read the simulated time and the application may advance it from another thread
+    n->clock.lock = &n->clock_lock;
+    n->clock.advance_hook = wakeUpNodeLoops;
+    n->clock.advance_hook_context = n;
+#ifndef _WIN32
+    if(openMainWakeUpPipe(n) != 0)
+      PRINT_ERROR("cRosNodeSetClock() : pipe() failed: the event loop will not be woken up when the clock is advanced\n");
+#endif
   }
+  return CROS_SUCCESS_ERR_PACK;
+}
 
-  ret_err = cRosApiRegisterServiceProvider(new_n,"~get_loggers","roscpp/GetLoggers",
-                                      callback_srv_get_loggers, NULL, (void *)new_n, NULL);
-  if (ret_err != CROS_SUCCESS_ERR_PACK)
+CrosClock *cRosNodeGetClock( CrosNode *n )
+{
+  return (n != NULL)? &n->clock : NULL;
+}
+
+cRosErrCodePack cRosNodeSetBuiltins( CrosNode *n, unsigned int builtins )
+{
+  PRINT_VVDEBUG ( "cRosNodeSetBuiltins()\n" );
+
+  if(n == NULL)
+    return CROS_BAD_PARAM_ERR;
+
+  n->builtins = builtins & CROS_BUILTIN_ALL;
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+int cRosNodeGetRosoutPublisher( CrosNode *n )
+{
+  if(n == NULL)
+    return -1;
+
+  if((n->builtins & CROS_BUILTIN_ROSOUT) && !(n->builtins_created & CROS_BUILTIN_ROSOUT))
+  {
+    cRosErrCodePack ret_err;
+
+    n->builtins_created |= CROS_BUILTIN_ROSOUT; // Registration is attempted only once
+    // Create a publisher of the topic /rosout of type "rosgraph_msgs/Log".
+    // The messages of this topic will not be periodically sent but on demand (loop_period = -1).
+    ret_err = cRosApiRegisterPublisher(n,"/rosout","rosgraph_msgs/Log", -1, NULL, NULL, n, &n->rosout_pub_idx);
+    if (ret_err != CROS_SUCCESS_ERR_PACK)
+    {
+      PRINT_ERROR ( "cRosNodeGetRosoutPublisher(): Error registering rosout.\n");
+      cRosPrintErrCodePack(ret_err, "cRosNodeGetRosoutPublisher()");
+      n->rosout_pub_idx = -1;
+    }
+  }
+
+  return n->rosout_pub_idx;
+}
+
+// Obtain the budgets and the name of the callback of a publisher, subscriber, service or parameter subscription. NULL if it is not in use
+static CrosCallbackBudget *getCallbackBudget( CrosNode *n, CrosCallbackKind kind, int idx, const char **name )
+{
+  CrosCallbackBudget *budget = NULL;
+
+  *name = NULL;
+  switch(kind)
+  {
+    case CROS_CALLBACK_PUBLISHER:
+      if(idx >= 0 && idx < CN_MAX_PUBLISHED_TOPICS)
+      {
+        *name = n->pubs[idx].topic_name;
+        budget = &n->pubs[idx].cb_budget;
+      }
+      break;
+    case CROS_CALLBACK_SUBSCRIBER:
+      if(idx >= 0 && idx < CN_MAX_SUBSCRIBED_TOPICS)
+      {
+        *name = n->subs[idx].topic_name;
+        budget = &n->subs[idx].cb_budget;
+      }
+      break;
+    case CROS_CALLBACK_SERVICE_PROVIDER:
+      if(idx >= 0 && idx < CN_MAX_SERVICE_PROVIDERS)
+      {
+        *name = n->service_providers[idx].service_name;
+        budget = &n->service_providers[idx].cb_budget;
+      }
+      break;
+    case CROS_CALLBACK_SERVICE_CALLER:
+      if(idx >= 0 && idx < CN_MAX_SERVICE_CALLERS)
+      {
+        *name = n->service_callers[idx].service_name;
+        budget = &n->service_callers[idx].cb_budget;
+      }
+      break;
+    case CROS_CALLBACK_PARAMETER:
+      if(idx >= 0 && idx < CN_MAX_PARAMETER_SUBSCRIPTIONS)
+      {
+        *name = n->paramsubs[idx].parameter_key;
+        budget = &n->paramsubs[idx].cb_budget;
+      }
+      break;
+  }
+
+  return (*name != NULL)? budget : NULL;
+}
+
+static void initCallbackBudget( CrosCallbackBudget *budget )
+{
+  budget->soft_budget = 0;
+  budget->hard_budget = 0;
+  budget->n_soft_overruns = 0;
+  budget->n_hard_overruns = 0;
+  budget->max_duration = 0.0;
+}
+
+int64_t cRosNodeCallbackStart( const CrosCallbackBudget *budget )
+{
+  if(budget->soft_budget == 0 && budget->hard_budget == 0)
+    return 0;
+
+  return cRosClockGetTimeStamp();
+}
+
+void cRosNodeCallbackEnd( CrosNode *n, CrosCallbackKind kind, int idx, int64_t start_time_stamp )
+{
+  static const char *kind_names[] = { "publisher", "subscriber", "service provider", "service caller", "parameter" };
+  CrosCallbackBudget *budget;
+  CrosCallbackOverrun overrun;
+
+  if(start_time_stamp == 0)
+    return;
+
+  overrun.duration = cRosClockTimeStampToUSec(cRosClockGetTimeStamp() - start_time_stamp);
+  budget = getCallbackBudget(n, kind, idx, &overrun.name);
+  if(budget == NULL) // The callback has released its owner
+    return;
+
+  if(overrun.duration > budget->max_duration)
+    budget->max_duration = overrun.duration;
+
+  if(budget->hard_budget != 0 && overrun.duration > budget->hard_budget)
+  {
+    budget->n_hard_overruns++;
+    overrun.budget = budget->hard_budget;
+    overrun.hard = 1;
+  }
+  else if(budget->soft_budget != 0 && overrun.duration > budget->soft_budget)
+  {
+    budget->n_soft_overruns++;
+    overrun.budget = budget->soft_budget;
+    overrun.hard = 0;
+  }
+  else
+    return;
+
+  overrun.kind = kind;
+  overrun.idx = idx;
+  overrun.time = cRosClockGetTime(&n->clock);
+
+  if(n->callback_overrun_hook != NULL)
+    n->callback_overrun_hook(&overrun, n->callback_overrun_context);
+
+  if(n->callback_overrun_log_period > 0)
   {
-    PRINT_ERROR ( "cRosNodeCreate(): Error registering loggers.\n");
-    cRosPrintErrCodePack(ret_err, "cRosNodeCreate()");
+    if(n->callback_overrun_last_log == 0 || overrun.time >= n->callback_overrun_last_log + n->callback_overrun_log_period)
+    {
+      ROS_WARN(n, "The %s callback of %s took %.0f us (%s budget: %u us). %lu overruns were not logged\n",
+               kind_names[kind], overrun.name, overrun.duration, (overrun.hard)? "hard": "soft", overrun.budget,
+               n->n_unlogged_overruns);
+      n->callback_overrun_last_log = overrun.time;
+      n->n_unlogged_overruns = 0;
+    }
+    else
+      n->n_unlogged_overruns++;
   }
+}
+
+// Register the logger services if they are enabled and they have not been registered yet. They are registered when the node
+// has no call to the master pending or running, so that the registrations requested by the application before the event
+// loop runs (its publishers, subscribers...) are not delayed by the loading of the service definitions and their calls
+static void createLoggerServices( CrosNode *n )
+{
+  cRosErrCodePack ret_err;
 
-  ret_err = cRosApiRegisterServiceProvider(new_n,"~set_logger_level","roscpp/SetLoggerLevel",
-                                      callback_srv_set_logger_level, NULL, (void *)new_n, NULL);
+  if(!(n->builtins & CROS_BUILTIN_LOGGER_SERVICES) || (n->builtins_created & CROS_BUILTIN_LOGGER_SERVICES))
+    return;
+  if(!isQueueEmpty(&n->master_api_queue) || n->xmlrpc_client_proc[0].state != XMLRPC_PROCESS_STATE_IDLE)
+    return;
+
+  n->builtins_created |= CROS_BUILTIN_LOGGER_SERVICES; // Registration is attempted only once
+  ret_err = cRosApiRegisterServiceProvider(n,"~get_loggers","roscpp/GetLoggers",
+                                      callback_srv_get_loggers, NULL, (void *)n, NULL);
   if (ret_err != CROS_SUCCESS_ERR_PACK)
   {
-    PRINT_ERROR ( "cRosNodeCreate(): Error registering loggers.\n");
-    cRosPrintErrCodePack(ret_err, "cRosNodeCreate()");
+    PRINT_ERROR ( "createLoggerServices(): Error registering loggers.\n");
+    cRosPrintErrCodePack(ret_err, "createLoggerServices()");
   }
 
-  return new_n;
+  ret_err = cRosApiRegisterServiceProvider(n,"~set_logger_level","roscpp/SetLoggerLevel",
+                                      callback_srv_set_logger_level, NULL, (void *)n, NULL);
+  if (ret_err != CROS_SUCCESS_ERR_PACK)
+  {
+    PRINT_ERROR ( "createLoggerServices(): Error registering loggers.\n");
+    cRosPrintErrCodePack(ret_err, "createLoggerServices()");
+  }
 }
 
 int cRosUnregistrationCompleted(CrosNode *n)
@@ -1948,8 +2827,8 @@ cRosErrCodePack cRosNodeWaitUntilFnRetTrue(CrosNode *n, int (*fn_to_check)(CrosN
   cRosErrCodePack ret_err = CROS_SUCCESS_ERR_PACK;
   uint64_t start_time, elapsed_time;
 
-  start_time = cRosClockGetTimeMs();
-  while( (unreg_incomp = !fn_to_check(n)) && (elapsed_time=cRosClockGetTimeMs()-start_time) <= CN_UNREGISTRATION_TIMEOUT && ret_err == CROS_SUCCESS_ERR_PACK)
+  start_time = cRosClockGetTime(&n->clock);
+  while( (unreg_incomp = !fn_to_check(n)) && (elapsed_time=cRosClockGetTime(&n->clock)-start_time) <= CN_UNREGISTRATION_TIMEOUT && ret_err == CROS_SUCCESS_ERR_PACK)
     ret_err=cRosNodeDoEventsLoop( n, CN_UNREGISTRATION_TIMEOUT - elapsed_time);
 
   if(ret_err == CROS_SUCCESS_ERR_PACK && unreg_incomp)
@@ -1998,12 +2877,22 @@ cRosErrCodePack cRosNodeUnregisterAll(CrosNode *n)
 cRosErrCodePack cRosNodeDestroy ( CrosNode *n )
 {
   cRosErrCodePack ret_err;
+  int i;
 
   PRINT_VVDEBUG ( "cRosNodeDestroy()\n" );
 
   if ( n == NULL )
     return CROS_BAD_PARAM_ERR;
 
+  // The built-ins that have not been created yet must not be registered by the event loops below (or by a log message)
+  // just to be unregistered
+  n->builtins &= n->builtins_created;
+
+  // The shard loops must have been stopped: from now on the main loop serves all the TCPROS connections
+  for ( i = 1; i < n->n_io_shards; i++)
+    closeIoShard( n, i );
+  n->n_io_shards = 1;
+
   cRosNodeWaitUntilFnRetTrue(n, cRosOutputQueuesEmpty); // Wait until all pendind topic messages and service call have been sent
 
   cRosNodePauseAllCallersPublishers(n);
@@ -2016,7 +2905,6 @@ cRosErrCodePack cRosNodeDestroy ( CrosNode *n )
   releaseApiCallQueue(&n->master_api_queue);
   releaseApiCallQueue(&n->slave_api_queue);
 
-  int i;
   for (i = 0; i < CN_MAX_XMLRPC_SERVER_CONNECTIONS; i++)
     xmlrpcProcessRelease( &(n->xmlrpc_server_proc[i]) );
 
@@ -2024,10 +2912,14 @@ cRosErrCodePack cRosNodeDestroy ( CrosNode *n )
     xmlrpcProcessRelease( &(n->xmlrpc_client_proc[i]) );
 
   tcprosProcessRelease( &(n->tcpros_listner_proc) );
+  tcprosProcessRelease( &(n->tcpros_data_listner_proc) );
 
   for ( i = 0; i < CN_MAX_TCPROS_SERVER_CONNECTIONS; i++)
     tcprosProcessRelease( &(n->tcpros_server_proc[i]) );
 
+  for ( i = 0; i < CN_MAX_IO_SHARDS-1; i++)
+    tcprosProcessRelease( &(n->io_shards[i].tcpros_listner_proc) );
+
   for ( i = 0; i < CN_MAX_TCPROS_CLIENT_CONNECTIONS; i++)
     tcprosProcessRelease( &(n->tcpros_client_proc[i]) );
 
@@ -2039,7 +2931,9 @@ cRosErrCodePack cRosNodeDestroy ( CrosNode *n )
 
   if ( n->name != NULL ) free ( n->name );
   if ( n->host != NULL ) free ( n->host );
+  if ( n->data_host != NULL ) free ( n->data_host );
   if ( n->roscore_host != NULL ) free ( n->roscore_host );
+  cRosGraphCacheRelease( &n->graph_cache );
 
   for ( i = 0; i < CN_MAX_PUBLISHED_TOPICS; i++)
     cRosApiReleasePublisher(n, i);
@@ -2056,6 +2950,20 @@ cRosErrCodePack cRosNodeDestroy ( CrosNode *n )
   for ( i = 0; i < CN_MAX_PARAMETER_SUBSCRIPTIONS; i++)
     cRosNodeReleaseParameterSubscrition(&n->paramsubs[i]);
 
+  cRosMutexRelease( &n->io_shard_lock );
+  cRosMessageParallelismRelease( &n->serialization_parallelism );
+  for ( i = 0; i < CN_MAX_SUBSCRIBER_EVENTS; i++)
+    dynStringRelease( &(n->subscriber_events[i].caller_id) );
+#ifndef _WIN32
+  if( n->main_wake_up_fd[0] != -1 )
+  {
+    close( n->main_wake_up_fd[0] );
+    close( n->main_wake_up_fd[1] );
+  }
+#endif
+  cRosMutexRelease( &n->clock_lock );
+  tcpIpUringDestroy( n->io_uring );
+
   tcpIpSocketCleanUp();
 
   return ret_err;
@@ -2093,6 +3001,9 @@ cRosErrCodePack cRosNodeDestroy ( CrosNode *n )
 
   int pubidx = -1;
   int it = 0;
+  // The I/O shards look up the publishers when a subscriber connects, and the publisher may be registered while they run
+  // (e.g. the /rosout and /statistics publishers are created on demand)
+  cRosMutexLock( &node->io_shard_lock );
   for (; it < CN_MAX_PUBLISHED_TOPICS; it++)
   {
     if (node->pubs[it].topic_name == NULL)
@@ -2114,6 +3025,7 @@ cRosErrCodePack cRosNodeDestroy ( CrosNode *n )
   cRosMessageQueueClear(&pub->msg_queue);
 
   node->n_pubs++;
+  cRosMutexUnlock( &node->io_shard_lock );
 
   int rc = enqueuePublisherAdvertise(node, pubidx);
   if (rc == -1)
@@ -2278,6 +3190,8 @@ int cRosNodeRegisterSubscriber(CrosNode *node, const char *message_definition, c
   sub->context = data_context;
   sub->tcp_nodelay = (unsigned char)tcp_nodelay;
   sub->msg_queue_overflow = 0;
+  sub->msg_rx_time_stamp = 0;
+  sub->msg_dequeue_time_stamp = 0;
   cRosMessageQueueClear(&sub->msg_queue);
 
   node->n_subs++;
@@ -2349,6 +3263,8 @@ int cRosNodeRegisterServiceCaller(CrosNode *node, const char *message_definition
   service->wake_up_time = 0; // cRosClockGetTimeMs() + 10;
   service->persistent = (unsigned char)persistent;
   service->tcp_nodelay = (unsigned char)tcp_nodelay;
+  service->in_place_call = CROS_IN_PLACE_CALL_NONE;
+  service->in_place_err = CROS_SUCCESS_ERR_PACK;
 
   int clientidx = serviceidx; // node->service_callers[0] is assigned node->rpcros_client_proc[0] and so on
   service->rpcros_id = clientidx;
@@ -2411,6 +3327,7 @@ int cRosNodeUnregisterSubscriber(CrosNode *node, int subidx)
 
   call->method = CROS_API_UNREGISTER_SUBSCRIBER;
   call->provider_idx = subidx;
+  call->provider_context = sub->context;
 
   xmlrpcParamVectorPushBackString( &call->params, node->name);
   xmlrpcParamVectorPushBackString( &call->params, sub->topic_name );
@@ -2443,11 +3360,16 @@ int cRosNodeUnregisterPublisher(CrosNode *node, int pubidx)
     return -1;
   }
 
+  // The connections are also removed from the publisher list: otherwise they would be still counted as subscribers (and
+  // written to) until the master confirms the unregistration, even when their processes are reused by other publishers
+  cRosMutexLock( &node->io_shard_lock );
   for(list_elem=0;pub->tcpros_id_list[list_elem]!=-1;list_elem++)
   {
     TcprosProcess *tcprosProc = &node->tcpros_server_proc[pub->tcpros_id_list[list_elem]];
     closeTcprosProcess(tcprosProc);
   }
+  pub->tcpros_id_list[0] = -1;
+  cRosMutexUnlock( &node->io_shard_lock );
 
   XmlrpcProcess *coreproc = &node->xmlrpc_client_proc[0];
   if (coreproc->current_call != NULL
@@ -2460,6 +3382,7 @@ int cRosNodeUnregisterPublisher(CrosNode *node, int pubidx)
 
   call->method = CROS_API_UNREGISTER_PUBLISHER;
   call->provider_idx = pubidx;
+  call->provider_context = pub->context;
 
   xmlrpcParamVectorPushBackString( &call->params, node->name);
   xmlrpcParamVectorPushBackString( &call->params, pub->topic_name );
@@ -2502,6 +3425,7 @@ int cRosNodeUnregisterServiceProvider(CrosNode *node, int serviceidx)
 
   call->method = CROS_API_UNREGISTER_SERVICE;
   call->provider_idx = serviceidx;
+  call->provider_context = svc->context;
   // 3 parameters are expected for this method
   xmlrpcParamVectorPushBackString( &call->params, node->name);
   xmlrpcParamVectorPushBackString( &call->params, svc->service_name);
@@ -2598,800 +3522,2318 @@ cRosErrCodePack cRosApiUnsubscribeParam(CrosNode *node, int paramsubidx)
   return (caller_id != -1)? CROS_SUCCESS_ERR_PACK:CROS_MEM_ALLOC_ERR;
 }
 
-cRosErrCodePack cRosNodeTriggerPublishersWriting( CrosNode *n, uint64_t cur_time )
+// Make all the processes of a publisher (waiting for a new message) start writing the content of its packet buffer
+static void startPublisherWriting( CrosNode *n, PublisherNode *pub, int shards_to_wake_up[] )
 {
-  cRosErrCodePack ret_err;
-  int pub_idx;
+  int list_elem, grow_buffers = 0;
 
-  ret_err = CROS_SUCCESS_ERR_PACK; // Default return value: success
-  // Check whether it is time to send a new topic message and trigger the corresponding TcprosProcesses
-  for(pub_idx = 0; pub_idx < CN_MAX_PUBLISHED_TOPICS; pub_idx++)
+  if(pub->packet_size > pub->max_msg_size)
   {
-    PublisherNode *cur_pub = &n->pubs[pub_idx];
-    if(cur_pub->topic_name != NULL) // Is this publisher active?
+    pub->max_msg_size = pub->packet_size;
+    grow_buffers = pub->tcp_tuning.auto_buf_size;
+  }
+
+  cRosMutexLock( &n->io_shard_lock );
+  for(list_elem=0;pub->tcpros_id_list[list_elem]!=-1;list_elem++)
+  {
+    int proc_idx = pub->tcpros_id_list[list_elem];
+    TcprosProcess *server_proc = &n->tcpros_server_proc[proc_idx];
+    if(grow_buffers) // Make room in the kernel for the largest message before it is written
+      applyTcpTuning( &(server_proc->socket), &pub->tcp_tuning, pub->max_msg_size, 1 );
+    if(server_proc->state == TCPROS_PROCESS_STATE_WAIT_FOR_WRITING) // A shard may have closed the connection meanwhile
     {
-      if((cur_pub->loop_period >= 0 && cur_pub->wake_up_time <= cur_time) || cRosMessageQueueUsage(&cur_pub->msg_queue) > 0) // Is it time to publish a message (periodic or immediate)?
+      if(server_proc->filter.depth > 0) // The process sends the frames that satisfy the filter of its subscriber instead of the packet
       {
-        int list_elem, all_procs_ready;
-        // Check whether all tcpProcess are ready to start writing a new message (or idle)
-        all_procs_ready = 1;
-        for(list_elem=0;cur_pub->tcpros_id_list[list_elem]!=-1;list_elem++)
-        {
-          TcprosProcess *server_proc = &n->tcpros_server_proc[cur_pub->tcpros_id_list[list_elem]];
-          if(server_proc->state != TCPROS_PROCESS_STATE_WAIT_FOR_WRITING) // server_proc->state != TCPROS_PROCESS_STATE_IDLE &&
-          {
-            all_procs_ready = 0;
-            break;
-          }
-        }
-        if(all_procs_ready && cur_pub->tcpros_id_list[0]!=-1) // All associated processes are ready to write and there is at least one associated process
-        {
-          if(cRosMessageQueueUsage(&cur_pub->msg_queue) == 0) // There is no immediate message waiting, so a periodic message must be sent
-            cur_pub->wake_up_time = cur_time + cur_pub->loop_period;
-
-          // The next function will store the next message to be sent in cur_pub->context->outgoing
-          ret_err = cRosNodePublisherCallback(cur_pub->context); // Calls the publisher application-defined callback
-
-          // Make all the waiting processes start writing
-          for(list_elem=0;cur_pub->tcpros_id_list[list_elem]!=-1;list_elem++)
-          {
-            TcprosProcess *server_proc = &n->tcpros_server_proc[cur_pub->tcpros_id_list[list_elem]];
-            // if(server_proc->state == TCPROS_PROCESS_STATE_WAIT_FOR_WRITING)
-              tcprosProcessChangeState( server_proc, TCPROS_PROCESS_STATE_START_WRITING );
-          }
-        }
+        DynBuffer filtered_frames;
+
+        if(dynBufferGetSize(&server_proc->filtered_batch) == 0) // No message for this subscriber
+          continue;
+        filtered_frames = server_proc->filtered_packet;
+        server_proc->filtered_packet = server_proc->filtered_batch;
+        server_proc->filtered_batch = filtered_frames;
+        dynBufferClear(&server_proc->filtered_batch);
       }
+      tcprosProcessChangeState( server_proc, TCPROS_PROCESS_STATE_START_WRITING );
+      shards_to_wake_up[proc_idx % n->n_io_shards] = 1;
     }
   }
-  return(ret_err);
+  cRosMutexUnlock( &n->io_shard_lock );
 }
 
-
-cRosErrCodePack cRosNodeTriggerServiceCallersWriting( CrosNode *n, uint64_t cur_time )
+// Check whether the I/O shards can serialize the next message of a publisher themselves (see PublisherNode::shard_serialization).
+// The main loop serializes it when the frame is compared with the last sent one or when a subscriber filters the messages
+static int shardsCanSerialize( CrosNode *n, PublisherNode *pub )
 {
-  cRosErrCodePack ret_err;
-  int caller_idx;
+  int list_elem, can_serialize = 1;
 
-  ret_err = CROS_SUCCESS_ERR_PACK; // Default return value: success
-  // Check whether it is time to make a service call, and if so, trigger the corresponding TcprosProcesses
-  for(caller_idx = 0; caller_idx < CN_MAX_SERVICE_CALLERS; caller_idx++)
+  if(n->n_io_shards < 2 || (pub->on_change && pub->n_deadbands == 0))
+    return 0;
+
+  cRosMutexLock( &n->io_shard_lock );
+  for(list_elem=0;pub->tcpros_id_list[list_elem]!=-1;list_elem++)
   {
-    ServiceCallerNode *cur_caller = &n->service_callers[caller_idx];
-    if(cur_caller->service_name != NULL) // Is this caller active?
+    if(n->tcpros_server_proc[pub->tcpros_id_list[list_elem]].filter.depth > 0)
     {
-      if((cur_caller->loop_period >= 0 && cur_caller->wake_up_time <= cur_time) || cRosMessageQueueUsage(&cur_caller->msg_queue) == 1) // Is it time to make a call (periodic or immediate)?
-      {
-        // Check whether the corresponding process is ready to start making a new call
-        TcprosProcess *caller_proc = &n->rpcros_client_proc[cur_caller->rpcros_id];
-        if(caller_proc->state == TCPROS_PROCESS_STATE_WAIT_FOR_WRITING) // caller_proc->state == TCPROS_PROCESS_STATE_IDLE ||
-        {
-          if(cRosMessageQueueUsage(&cur_caller->msg_queue) == 0) // There is no immediate call waiting, so a periodic call will be made
-            cur_caller->wake_up_time = cur_time + cur_caller->loop_period;
+      can_serialize = 0;
+      break;
+    }
+  }
+  cRosMutexUnlock( &n->io_shard_lock );
+  return can_serialize;
+}
 
-          // Now the service-call parameters are stored in cur_caller->context->outgoing
-          ret_err = cRosNodeServiceCallerCallback( 0, cur_caller->context); // calls the service-caller application-defined callback function to generate the service request
+// Evaluate the content filters requested by the subscribers of a publisher on its outgoing message, and append the message
+// (the TCPROS frame starting at frame_offset in frame) to the filtered batch of each process whose filter is satisfied
+static void filterPublisherMessage( CrosNode *n, PublisherNode *pub, DynBuffer *frame, size_t frame_offset )
+{
+  cRosMessage *outgoing = cRosNodeGetOutgoingMessage(pub->context);
+  const unsigned char *frame_data = dynBufferGetData(frame) + frame_offset;
+  size_t frame_size = dynBufferGetSize(frame) - frame_offset;
+  int list_elem;
 
-          //if(caller_proc->state == TCPROS_PROCESS_STATE_WAIT_FOR_WRITING)
-          {
-            tcprosProcessChangeState( caller_proc, TCPROS_PROCESS_STATE_START_WRITING );
-          }
-        }
-      }
-    }
+  cRosMutexLock( &n->io_shard_lock ); // The processes may be closed by the I/O shards
+  for(list_elem=0;pub->tcpros_id_list[list_elem]!=-1;list_elem++)
+  {
+    TcprosProcess *server_proc = &n->tcpros_server_proc[pub->tcpros_id_list[list_elem]];
+    if(server_proc->filter.depth == 0)
+      continue;
+    if(cRosMessageFilterMatch(&server_proc->filter, outgoing))
+      dynBufferPushBackBuf(&server_proc->filtered_batch, frame_data, frame_size);
+    else
+      pub->n_filtered_msgs++;
   }
-  return(ret_err);
+  cRosMutexUnlock( &n->io_shard_lock );
 }
 
-#define NODE_STATUS_STR_MAX_LEN (CN_MAX_XMLRPC_CLIENT_CONNECTIONS+CN_MAX_XMLRPC_SERVER_CONNECTIONS+CN_MAX_TCPROS_CLIENT_CONNECTIONS+CN_MAX_TCPROS_SERVER_CONNECTIONS+CN_MAX_RPCROS_CLIENT_CONNECTIONS+CN_MAX_RPCROS_SERVER_CONNECTIONS+6*3+3*4+2)
-void printNodeProcState( CrosNode *n )
+static void setTimeField( cRosMessage *msg, const char *field_name, uint64_t msec )
 {
-  static char prev_stat_str[NODE_STATUS_STR_MAX_LEN]="\0";
-  char stat_str[NODE_STATUS_STR_MAX_LEN];
-  int i;
+  cRosMessage *time_msg = cRosMessageGetField(msg, field_name)->data.as_msg;
+  cRosMessageGetField(time_msg, "secs")->data.as_uint32 = (uint32_t)(msec / 1000);
+  cRosMessageGetField(time_msg, "nsecs")->data.as_uint32 = (uint32_t)(msec % 1000) * 1000000;
+}
 
-  sprintf(stat_str, "XL%X XC",n->xmlrpc_listner_proc.state);
-  for(i = 0; i < CN_MAX_XMLRPC_CLIENT_CONNECTIONS; i++ )
-    sprintf(stat_str+strlen(stat_str), "%X",n->xmlrpc_client_proc[i].state);
+static void setDurationField( cRosMessage *msg, const char *field_name, double usec )
+{
+  cRosMessage *durat_msg = cRosMessageGetField(msg, field_name)->data.as_msg;
+  int64_t nsec = (int64_t)(usec * 1e3);
+  cRosMessageGetField(durat_msg, "secs")->data.as_int32 = (int32_t)(nsec / 1000000000);
+  cRosMessageGetField(durat_msg, "nsecs")->data.as_int32 = (int32_t)(nsec % 1000000000);
+}
 
-  sprintf(stat_str+strlen(stat_str), " XS");
-  for( i = 0; i < CN_MAX_XMLRPC_SERVER_CONNECTIONS; i++ )
-    sprintf(stat_str+strlen(stat_str), "%X",n->xmlrpc_server_proc[i].state);
+// Queue a rosgraph_msgs/TopicStatistics message with the statistics of the current window of a TCPROS client process
+static void publishConnectionStatistics( CrosNode *n, TcprosProcess *client_proc, uint64_t cur_time )
+{
+  CrosTopicStats *stats = &client_proc->stats;
+  cRosMessage *msg;
+  double mean, stddev, max;
+  cRosErrCodePack ret_err;
 
-  sprintf(stat_str+strlen(stat_str), " TL%X TC",n->tcpros_listner_proc.state);
-  for(i = 0; i < CN_MAX_TCPROS_CLIENT_CONNECTIONS; i++ )
-    sprintf(stat_str+strlen(stat_str), "%X",n->tcpros_client_proc[i].state);
+  msg = cRosApiCreatePublisherMessage(n, n->statistics_pub_idx);
+  if(msg == NULL)
+  {
+    PRINT_ERROR ( "publishConnectionStatistics() : A message of /statistics topic could not be created\n" );
+    return;
+  }
 
-  sprintf(stat_str+strlen(stat_str), " TS");
-  for( i = 0; i < CN_MAX_TCPROS_SERVER_CONNECTIONS; i++ )
-    sprintf(stat_str+strlen(stat_str), "%X",n->tcpros_server_proc[i].state);
+  cRosMessageSetFieldValueString(cRosMessageGetField(msg, "topic"), n->subs[client_proc->topic_idx].topic_name);
+  cRosMessageSetFieldValueString(cRosMessageGetField(msg, "node_pub"), dynStringGetData(&client_proc->caller_id));
+  cRosMessageSetFieldValueString(cRosMessageGetField(msg, "node_sub"), n->name);
+  setTimeField(msg, "window_start", stats->window_start);
+  setTimeField(msg, "window_stop", cur_time);
+  cRosMessageGetField(msg, "delivered_msgs")->data.as_int32 = (int32_t)stats->delivered_msgs;
+  cRosMessageGetField(msg, "dropped_msgs")->data.as_int32 = (int32_t)stats->dropped_msgs;
+  cRosMessageGetField(msg, "traffic")->data.as_int32 = (int32_t)stats->traffic;
+  cRosStatsMomentsGet(&stats->period, &mean, &stddev, &max);
+  setDurationField(msg, "period_mean", mean);
+  setDurationField(msg, "period_stddev", stddev);
+  setDurationField(msg, "period_max", max);
+  cRosStatsMomentsGet(&stats->stamp_age, &mean, &stddev, &max);
+  setDurationField(msg, "stamp_age_mean", mean);
+  setDurationField(msg, "stamp_age_stddev", stddev);
+  setDurationField(msg, "stamp_age_max", max);
+
+  ret_err = cRosNodeQueueTopicMsg(n, n->statistics_pub_idx, msg);
+  if(ret_err != CROS_SUCCESS_ERR_PACK)
+    PRINT_VDEBUG ( "publishConnectionStatistics() : The /statistics queue is full\n" );
+  cRosMessageFree(msg);
+}
 
-  sprintf(stat_str+strlen(stat_str), " RL%X RC",n->rpcros_listner_proc.state);
-  for(i = 0; i < CN_MAX_RPCROS_CLIENT_CONNECTIONS; i++ )
-    sprintf(stat_str+strlen(stat_str), "%X",n->rpcros_client_proc[i].state);
+// Publish the statistics of the subscriber connections whose window has finished and start their next window
+static void publishTopicStatistics( CrosNode *n, uint64_t cur_time )
+{
+  int i;
 
-  sprintf(stat_str+strlen(stat_str), " RS");
-  for( i = 0; i < CN_MAX_RPCROS_SERVER_CONNECTIONS; i++ )
-    sprintf(stat_str+strlen(stat_str), "%X",n->rpcros_server_proc[i].state);
+  if(n->statistics_pub_idx == -1)
+    return;
 
-  if (strcmp(prev_stat_str, stat_str) != 0) // If the node status has changed:
+  for( i = 0; i < CN_MAX_TCPROS_CLIENT_CONNECTIONS; i++ )
   {
-    // Print a compact string indicating the state of all the node processed for debug purposes
-    PRINT_DEBUG("Node status: %s\n", stat_str);
-    strcpy(prev_stat_str, stat_str);
+    TcprosProcess *client_proc = &n->tcpros_client_proc[i];
+    if( (client_proc->state == TCPROS_PROCESS_STATE_READING_SIZE || client_proc->state == TCPROS_PROCESS_STATE_READING) &&
+        n->subs[client_proc->topic_idx].stats_window > 0 &&
+        cur_time >= client_proc->stats.window_start + n->subs[client_proc->topic_idx].stats_window )
+    {
+      publishConnectionStatistics( n, client_proc, cur_time );
+      cRosTopicStatsStartWindow( &client_proc->stats, cur_time );
+    }
   }
 }
 
-uint64_t cRosNodeCalculateSelectTimeout(CrosNode *n, uint64_t max_timeout)
+// Apply the graph state returned by the master to the graph cache and schedule the next refresh
+static void graphCacheStateCallback( int callid, GetSystemStateResult *result, void *context )
 {
-  uint64_t wakeup_timeout, select_timeout, cur_time;
-  int pub_idx, svc_idx;
+  CrosNode *n = (CrosNode *)context;
+  uint64_t cur_time = cRosClockGetTime(&n->clock);
+  long n_changes;
 
-  select_timeout =  max_timeout;
-  cur_time = cRosClockGetTimeMs();
+  if( callid != n->graph_cache_call_id ) // The graph cache has been disabled or re-enabled after this call was made
+    return;
+  n->graph_cache_call_id = -1;
 
-  if( n->xmlrpc_master_wake_up_time > cur_time )
-    wakeup_timeout = n->xmlrpc_master_wake_up_time - cur_time;
+  if( result == NULL )
+  {
+    PRINT_ERROR ( "graphCacheStateCallback() : The graph state could not be obtained from the master\n" );
+    n->graph_cache_wake_up_time = cur_time + n->graph_cache_period;
+    return;
+  }
+
+  n_changes = cRosGraphCacheApply( &n->graph_cache, result, n->graph_change_callback, n->graph_change_context );
+  if( n_changes < 0 )
+  {
+    PRINT_ERROR ( "graphCacheStateCallback() : Can't allocate memory\n" );
+    n->graph_cache_period = n->graph_cache_min_period;
+  }
+  else if( n_changes > 0 || !n->graph_cache_valid )
+    n->graph_cache_period = n->graph_cache_min_period;
+  else if( n->graph_cache_period < n->graph_cache_max_period / CN_GRAPH_CACHE_BACKOFF )
+    n->graph_cache_period *= CN_GRAPH_CACHE_BACKOFF;
   else
-    wakeup_timeout = 0;
+    n->graph_cache_period = n->graph_cache_max_period;
 
-  if( wakeup_timeout < select_timeout )
-    select_timeout = wakeup_timeout;
+  if( n_changes >= 0 )
+    n->graph_cache_valid = 1;
+  n->graph_cache_wake_up_time = cur_time + n->graph_cache_period;
+  PRINT_VDEBUG ( "graphCacheStateCallback() : %ld changes found. Next refresh in %u ms\n", n_changes, n->graph_cache_period );
+}
 
-  for (pub_idx = 0;pub_idx < CN_MAX_PUBLISHED_TOPICS;pub_idx++) // < n_pubs?
-  {
-    PublisherNode *cur_pub = &n->pubs[pub_idx];
-    if(cur_pub->topic_name != NULL && cur_pub->loop_period >= 0) // Is this publisher active and automatically publishing messages?
-    {
-      if( cur_pub->wake_up_time > cur_time ) // Is not it time to publish a new message yet?
-        wakeup_timeout = cur_pub->wake_up_time - cur_time;
-      else
-        wakeup_timeout = 0;
-
-      if( wakeup_timeout < select_timeout )
-        select_timeout = wakeup_timeout;
-    }
-  }
-
-  for (svc_idx = 0;svc_idx < CN_MAX_SERVICE_CALLERS;svc_idx++) // <n_service_callers?
-  {
-    ServiceCallerNode *cur_svc_caller = &n->service_callers[svc_idx];
-    if(cur_svc_caller->service_name != NULL && cur_svc_caller->loop_period >= 0) // Is this service caller active and automatically publishing messages?
-    {
-      if( cur_svc_caller->wake_up_time > cur_time ) // Is not it time to make a service call yet?
-        wakeup_timeout = cur_svc_caller->wake_up_time - cur_time;
-      else
-        wakeup_timeout = 0;
+static void refreshGraphCache( CrosNode *n, uint64_t cur_time )
+{
+  int call_id;
 
-      if( wakeup_timeout < select_timeout )
-      {
-        //printf("[i:%i cur time: %lu wake:%lu new timeout: %lu prev timeout:%lu]", i, cur_time,  cur_svc_caller->wake_up_time, wakeup_timeout, select_timeout);
-        select_timeout = wakeup_timeout;
-      }
-    }
-  }
+  if( !n->graph_cache_enabled || n->graph_cache_call_id != -1 || cur_time < n->graph_cache_wake_up_time )
+    return;
 
-  return(select_timeout);
+  if( cRosApiGetSystemState( n, graphCacheStateCallback, n, &call_id ) == CROS_SUCCESS_ERR_PACK )
+    n->graph_cache_call_id = call_id;
+  else
+    n->graph_cache_wake_up_time = cur_time + n->graph_cache_period;
 }
 
-cRosErrCodePack cRosNodeDoEventsLoop( CrosNode *n, uint64_t max_timeout )
+// Report a master restart, or the recovery from it, to the status callbacks of all the publishers, subscribers, service providers and parameter subscriptions
+static void notifyMasterStatus( CrosNode *n, CrosNodeStatus state, uint64_t recovery_time )
 {
-  cRosErrCodePack ret_err, new_errors;
-  uint64_t cur_time, select_timeout;
-  int nfds = -1;
-  fd_set r_fds, w_fds, err_fds;
+  CrosNodeStatusUsr status;
   int i;
 
-  PRINT_VVDEBUG ( "cRosNodeDoEventsLoop ()\n" );
-
-  if(n == NULL)
-    return CROS_BAD_PARAM_ERR;
-
-  #if CROS_DEBUG_LEVEL >= 2
-  PRINT_DEBUG("*");
-  FLUSH_PRINT();
-  printNodeProcState( n );
-  #endif
+  initCrosNodeStatus( &status );
+  status.state = state;
+  status.recovery_time = recovery_time;
 
-  cur_time = cRosClockGetTimeMs();
+  for( i = 0; i < CN_MAX_PUBLISHED_TOPICS; i++ )
+  {
+    if( n->pubs[i].topic_name == NULL )
+      continue;
+    status.provider_idx = i;
+    cRosNodeStatusCallback( &status, n->pubs[i].context );
+  }
+  for( i = 0; i < CN_MAX_SUBSCRIBED_TOPICS; i++ )
+  {
+    if( n->subs[i].topic_name == NULL )
+      continue;
+    status.provider_idx = i;
+    cRosNodeStatusCallback( &status, n->subs[i].context );
+  }
+  for( i = 0; i < CN_MAX_SERVICE_PROVIDERS; i++ )
+  {
+    if( n->service_providers[i].service_name == NULL )
+      continue;
+    status.provider_idx = i;
+    cRosNodeStatusCallback( &status, n->service_providers[i].context );
+  }
+  for( i = 0; i < CN_MAX_PARAMETER_SUBSCRIPTIONS; i++ )
+  {
+    if( n->paramsubs[i].parameter_key == NULL || n->paramsubs[i].status_api_callback == NULL )
+      continue;
+    status.provider_idx = i;
+    status.parameter_key = n->paramsubs[i].parameter_key;
+    n->paramsubs[i].status_api_callback( &status, n->paramsubs[i].context );
+  }
+}
 
-  ret_err = cRosNodeTriggerPublishersWriting( n, cur_time );
+// Result of the lookupNode() call that checks whether the master still knows this node after an outage
+static void masterCheckLookupCallback( int callid, LookupNodeResult *result, void *context )
+{
+  CrosNode *n = (CrosNode *)context;
 
-  new_errors = cRosNodeTriggerServiceCallersWriting( n, cur_time );
-  ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+  if( callid != n->master_check_call_id )
+    return;
+  n->master_check_call_id = -1;
 
-  FD_ZERO( &r_fds );
-  FD_ZERO( &w_fds );
-  FD_ZERO( &err_fds );
+  if( result == NULL ) // The master does not know the node: it restarted (with the same PID, e.g. in a container)
+    restartAdversing( n );
+  else if( n->master_restart_time == 0 ) // The registrations survived the outage
+    n->master_unreachable_time = 0;
+}
 
-  int xmlrpc_listner_fd = tcpIpSocketGetFD( &(n->xmlrpc_listner_proc.socket) );
-  int tcpros_listner_fd = tcpIpSocketGetFD( &(n->tcpros_listner_proc.socket) );
-  int rpcros_listner_fd = tcpIpSocketGetFD( &(n->rpcros_listner_proc.socket) );
+void checkMasterRegistrations( CrosNode *n )
+{
+  int call_id, i, n_registrations = 0;
 
-  XmlrpcProcess *coreproc = &n->xmlrpc_client_proc[0];
-  if (coreproc->state == XMLRPC_PROCESS_STATE_IDLE && !isQueueEmpty(&n->master_api_queue))
-  {
-    RosApiCall *call = dequeueApiCall(&n->master_api_queue);
-    coreproc->current_call = call;
-    xmlrpcProcessChangeState( coreproc, XMLRPC_PROCESS_STATE_CONNECTING );
-  }
+  if( n->master_check_call_id != -1 || n->master_restart_time != 0 )
+    return;
 
-  size_t idle_client_count;
-  int idle_clients[CN_MAX_XMLRPC_CLIENT_CONNECTIONS];
-  getIdleXmplrpcClients(n, idle_clients, &idle_client_count);
+  for( i = 0; i < CN_MAX_PUBLISHED_TOPICS; i++ )
+    n_registrations += (n->pubs[i].topic_name != NULL);
+  for( i = 0; i < CN_MAX_SUBSCRIBED_TOPICS; i++ )
+    n_registrations += (n->subs[i].topic_name != NULL);
+  for( i = 0; i < CN_MAX_SERVICE_PROVIDERS; i++ )
+    n_registrations += (n->service_providers[i].service_name != NULL);
 
-  int next_idle_client_idx = 0;
-  while (!isQueueEmpty(&n->slave_api_queue) && next_idle_client_idx != idle_client_count)
+  if( n_registrations == 0 ) // The master only knows the nodes that have registered a publisher, subscriber or service
   {
-    int idle_client_idx = idle_clients[next_idle_client_idx];
-    RosApiCall *call = dequeueApiCall(&n->slave_api_queue);
-
-    XmlrpcProcess *proc =  &n->xmlrpc_client_proc[idle_client_idx];
-    proc->current_call = call;
-    xmlrpcProcessChangeState( proc, XMLRPC_PROCESS_STATE_CONNECTING );
-
-    next_idle_client_idx++;
+    n->master_unreachable_time = 0;
+    return;
   }
 
-  /* If active (not idle state), add to the tcpIpSocketSelect() the XMLRPC clients */
-  for(i = 0; i < CN_MAX_XMLRPC_CLIENT_CONNECTIONS; i++)
-  {
-    fd_set *fdset = NULL;
-    if( n->xmlrpc_client_proc[i].state == XMLRPC_PROCESS_STATE_CONNECTING )
-    {
-      new_errors =  xmlrpcClientConnect(n, i);
-      ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
-      fdset = &w_fds; // tcpIpSocketSelect() will acknowledge the socket connection completion in the file descriptors checked for writing
-    }
-    else if( n->xmlrpc_client_proc[i].state == XMLRPC_PROCESS_STATE_WRITING )
-      fdset = &w_fds;
-    else if( n->xmlrpc_client_proc[i].state == XMLRPC_PROCESS_STATE_READING )
-      fdset = &r_fds;
+  if( cRosApiLookupNode( n, n->name, masterCheckLookupCallback, n, &call_id ) == CROS_SUCCESS_ERR_PACK )
+    n->master_check_call_id = call_id;
+}
 
-    if (fdset != NULL)
-    {
-      int xmlrpc_client_fd = tcpIpSocketGetFD( &(n->xmlrpc_client_proc[i].socket) );
-      if(xmlrpc_client_fd != -1)
-      {
-        if( xmlrpc_client_fd > nfds )
-          nfds = xmlrpc_client_fd;
+// Enqueue the registration of the provider at position ind of the re-registration order. Return 1 if a call has been enqueued
+static int enqueueReregistration( CrosNode *n, int ind )
+{
+  if( ind < CN_MAX_PUBLISHED_TOPICS )
+    return n->pubs[ind].topic_name != NULL && enqueuePublisherAdvertise( n, ind ) != -1;
+  ind -= CN_MAX_PUBLISHED_TOPICS;
+  if( ind < CN_MAX_SUBSCRIBED_TOPICS )
+    return n->subs[ind].topic_name != NULL && enqueueSubscriberAdvertise( n, ind ) != -1;
+  ind -= CN_MAX_SUBSCRIBED_TOPICS;
+  if( ind < CN_MAX_SERVICE_PROVIDERS )
+    return n->service_providers[ind].service_name != NULL && enqueueServiceAdvertise( n, ind ) != -1;
+  ind -= CN_MAX_SERVICE_PROVIDERS;
+  return n->paramsubs[ind].parameter_key != NULL && enqueueParameterSubscription( n, ind ) != -1;
+}
 
-        FD_SET( xmlrpc_client_fd, fdset);
-        FD_SET( xmlrpc_client_fd, &err_fds);
-      }
-    }
-  }
+// Enqueue the re-registrations allowed by the shaper after a master restart, and report the recovery when the master has
+// answered all of them (the failed calls are enqueued again, so the recovery ends when the master queue becomes empty)
+static void continueReregistration( CrosNode *n, uint64_t cur_time )
+{
+  const int n_providers = CN_MAX_PUBLISHED_TOPICS + CN_MAX_SUBSCRIBED_TOPICS + CN_MAX_SERVICE_PROVIDERS + CN_MAX_PARAMETER_SUBSCRIPTIONS;
 
-  //printf("FD_SET COUNT. R: %d W: %d\n", r_count, w_count);
+  if( n->master_restart_time == 0 )
+    return;
 
-  /* Add to the tcpIpSocketSelect() the active XMLRPC servers */
-  int next_xmlrpc_server_i = -1;
-  for( i = 0; i < CN_MAX_XMLRPC_SERVER_CONNECTIONS; i++ )
+  while( n->reregistration_cursor != -1 && cRosTokenBucketReady( &n->reregistration_shaper, cur_time ) )
   {
-    int server_fd = tcpIpSocketGetFD( &(n->xmlrpc_server_proc[i].socket) );
+    int ind = n->reregistration_cursor;
 
-    if( next_xmlrpc_server_i < 0 &&
-        n->xmlrpc_server_proc[i].state == XMLRPC_PROCESS_STATE_IDLE )
-    {
-      next_xmlrpc_server_i = i;
-    }
-    else if( n->xmlrpc_server_proc[i].state == XMLRPC_PROCESS_STATE_READING )
-    {
-      FD_SET( server_fd, &r_fds);
-      FD_SET( server_fd, &err_fds);
-      if( server_fd > nfds ) nfds = server_fd;
-    }
-    else if( n->xmlrpc_server_proc[i].state == XMLRPC_PROCESS_STATE_WRITING )
-    {
-      FD_SET( server_fd, &w_fds);
-      FD_SET( server_fd, &err_fds);
-      if( server_fd > nfds ) nfds = server_fd;
-    }
+    n->reregistration_cursor = (ind + 1 < n_providers)? ind + 1 : -1;
+    if( enqueueReregistration( n, ind ) )
+      cRosTokenBucketConsume( &n->reregistration_shaper, 1 );
   }
 
-  /* If one XMLRPC server is active at least, add to the tcpIpSocketSelect() the listener socket */
-  if( next_xmlrpc_server_i >= 0)
+  if( n->reregistration_cursor == -1 && isQueueEmpty( &n->master_api_queue ) &&
+      n->xmlrpc_client_proc[0].state == XMLRPC_PROCESS_STATE_IDLE )
   {
-    if(xmlrpc_listner_fd != -1) // If the listener socket is still opened, add it to the tcpIpSocketSelect() file descriptors
+    n->last_recovery_time = cur_time - n->master_restart_time;
+    n->master_restart_time = 0;
+    n->master_unreachable_time = 0;
+    PRINT_INFO( "continueReregistration() : The node has been registered again in the ROS master (recovery time: %llu ms)\n",
+                (unsigned long long)n->last_recovery_time );
+    notifyMasterStatus( n, CROS_STATUS_MASTER_RECOVERED, n->last_recovery_time );
+
+    if( n->graph_cache_enabled ) // The graph of the new master is being rebuilt by the registrations of all the nodes
     {
-      FD_SET( xmlrpc_listner_fd, &r_fds);
-      FD_SET( xmlrpc_listner_fd, &err_fds);
-      if( xmlrpc_listner_fd > nfds ) nfds = xmlrpc_listner_fd;
+      n->graph_cache_period = n->graph_cache_min_period;
+      n->graph_cache_wake_up_time = cur_time;
     }
   }
+}
 
-  /*
-   *
-   * TCPROS PROCESSES tcpIpSocketSelect() MANAGEMENT
-   *
-   */
+// Check whether the message produced by a publisher must be sent (see cRosNodeSetPublisherOnChange()), and if so, keep it to compare the next ones.
+// With deadbands, the outgoing message of the publisher is compared (frame = NULL). Otherwise the serialized message is compared:
+// the TCPROS frame starting at frame_offset in frame
+static int publisherMessageChanged( CrosNode *n, PublisherNode *pub, DynBuffer *frame, size_t frame_offset, uint64_t cur_time )
+{
+  cRosMessage *outgoing = cRosNodeGetOutgoingMessage(pub->context);
+  int changed;
 
-  /* If active (not idle state), add to the tcpIpSocketSelect() the TCPROS clients */
-  int next_tcpros_client_i = -1; // Unused ???
-  for(i = 0; i < CN_MAX_TCPROS_CLIENT_CONNECTIONS; i++)
-  {
-    TcprosProcess *client_proc = &(n->tcpros_client_proc[i]);
-    int tcpros_client_fd;
+  cRosMutexLock( &n->io_shard_lock ); // on_change_resend is set when a subscriber connects
+  changed = pub->on_change_resend;
+  pub->on_change_resend = 0;
+  cRosMutexUnlock( &n->io_shard_lock );
 
-    if( next_tcpros_client_i < 0 &&
-        i != 0 && //the zero-index is reserved to the roscore communications
-        client_proc->state == TCPROS_PROCESS_STATE_IDLE )
-    {
-      next_tcpros_client_i = i;
-    }
-    else if(client_proc->state == TCPROS_PROCESS_STATE_CONNECTING)
-    {
-      new_errors =  tcprosClientConnect(n, i);
-      ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+  if(pub->heartbeat_period > 0 && cur_time >= pub->last_sent_time + pub->heartbeat_period)
+    changed = 1;
 
-      tcpros_client_fd = tcpIpSocketGetFD( &(client_proc->socket) );
-      FD_SET( tcpros_client_fd, &w_fds);
-      FD_SET( tcpros_client_fd, &err_fds);
-      if( tcpros_client_fd > nfds ) nfds = tcpros_client_fd;
-    }
-    else if(client_proc->state == TCPROS_PROCESS_STATE_WRITING_HEADER)
-    {
-      tcpros_client_fd = tcpIpSocketGetFD( &(client_proc->socket) );
-      FD_SET( tcpros_client_fd, &w_fds);
-      FD_SET( tcpros_client_fd, &err_fds);
-      if( tcpros_client_fd > nfds ) nfds = tcpros_client_fd;
-    }
-    else if(client_proc->state == TCPROS_PROCESS_STATE_READING_HEADER_SIZE ||
-            client_proc->state == TCPROS_PROCESS_STATE_READING_HEADER ||
-            client_proc->state == TCPROS_PROCESS_STATE_READING_SIZE ||
-            client_proc->state == TCPROS_PROCESS_STATE_READING)
+  if(frame == NULL)
+  {
+    if(changed || pub->last_sent_msg == NULL || !cRosMessageEqual(outgoing, pub->last_sent_msg, pub->deadbands, pub->n_deadbands))
     {
-      tcpros_client_fd = tcpIpSocketGetFD( &(client_proc->socket) );
-      FD_SET( tcpros_client_fd, &r_fds);
-      FD_SET( tcpros_client_fd, &err_fds);
-      if( tcpros_client_fd > nfds ) nfds = tcpros_client_fd;
+      changed = 1;
+      if(pub->last_sent_msg == NULL)
+        pub->last_sent_msg = cRosMessageCopyWithoutDef(outgoing);
+      else if(cRosMessageFieldsCopy(pub->last_sent_msg, outgoing) != 0)
+      {
+        cRosMessageFree(pub->last_sent_msg);
+        pub->last_sent_msg = NULL; // The next message will be sent
+      }
     }
   }
-
-  /* Add to the tcpIpSocketSelect() the active TCPROS servers */
-  int next_tcpros_server_i = -1; // Index of the first server that is idle (ready to be activated). -1 = no one is idle
-  for( i = 0; i < CN_MAX_TCPROS_SERVER_CONNECTIONS; i++ )
+  else
   {
-    int server_fd = tcpIpSocketGetFD( &(n->tcpros_server_proc[i].socket) );
+    const unsigned char *frame_data = dynBufferGetData(frame) + frame_offset;
+    size_t frame_size = dynBufferGetSize(frame) - frame_offset;
 
-    if( next_tcpros_server_i < 0 &&
-        n->tcpros_server_proc[i].state == TCPROS_PROCESS_STATE_IDLE )
-    {
-      next_tcpros_server_i = i;
-    }
-    else if( n->tcpros_server_proc[i].state == TCPROS_PROCESS_STATE_READING_HEADER )
+    if(changed || frame_size != dynBufferGetSize(&pub->last_sent_frame) ||
+       memcmp(frame_data, dynBufferGetData(&pub->last_sent_frame), frame_size) != 0)
     {
-      FD_SET( server_fd, &r_fds);
-      FD_SET( server_fd, &err_fds);
-      if( server_fd > nfds ) nfds = server_fd;
-    }
-    else if( n->tcpros_server_proc[i].state == TCPROS_PROCESS_STATE_START_WRITING ||
-             n->tcpros_server_proc[i].state == TCPROS_PROCESS_STATE_WRITING )
-    {
-      FD_SET( server_fd, &w_fds);
-      FD_SET( server_fd, &err_fds);
-      if( server_fd > nfds ) nfds = server_fd;
-    }
-    else if( n->tcpros_server_proc[i].state == TCPROS_PROCESS_STATE_WAIT_FOR_WRITING )
-    {
-      FD_SET( server_fd, &err_fds);
-      if( server_fd > nfds ) nfds = server_fd;
+      changed = 1;
+      if(dynBufferReplaceContent(&pub->last_sent_frame, frame_data, frame_size) < 0)
+        dynBufferClear(&pub->last_sent_frame); // The next message will be sent
     }
   }
 
-  /* If one TCPROS server is available at least, add to the tcpIpSocketSelect() the listener socket */
-  if( next_tcpros_server_i >= 0)
-  {
-    if(tcpros_listner_fd != -1) // If the listener socket is still opened
-    {
-      FD_SET( tcpros_listner_fd, &r_fds);
-      FD_SET( tcpros_listner_fd, &err_fds);
-      if( tcpros_listner_fd > nfds ) nfds = tcpros_listner_fd;
-    }
-  }
+  if(changed)
+    pub->last_sent_time = cur_time;
+  else
+    pub->n_unchanged_msgs++;
+  return changed;
+}
 
+cRosErrCodePack cRosNodeTriggerPublishersWriting( CrosNode *n, uint64_t cur_time )
+{
+  cRosErrCodePack ret_err, new_errors;
+  int pub_idx, shard_idx, prio;
+  int shards_to_wake_up[CN_MAX_IO_SHARDS];
+  int64_t cb_start;
 
-  /*
-   *
-   * RPCROS PROCESSES tcpIpSocketSelect() MANAGEMENT
-   *
-   */
+  for(shard_idx = 0; shard_idx < CN_MAX_IO_SHARDS; shard_idx++)
+    shards_to_wake_up[shard_idx] = 0;
 
-  /* If active (not idle state), add to the tcpIpSocketSelect() the TCPROS clients */
-  for(i = 0; i < CN_MAX_RPCROS_CLIENT_CONNECTIONS; i++)
+  ret_err = CROS_SUCCESS_ERR_PACK; // Default return value: success
+  // Check whether it is time to send a new topic message and trigger the corresponding TcprosProcesses
+  // The messages of high-priority publishers are prepared first, so that preparing bulk messages does not delay them
+  for(prio = CROS_TOPIC_PRIORITY_HIGH; prio >= CROS_TOPIC_PRIORITY_BULK; prio--)
   {
-    int rpcros_client_fd;
-
-    rpcros_client_fd = tcpIpSocketGetFD( &(n->rpcros_client_proc[i].socket) );
-    if(n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_CONNECTING)
+    for(pub_idx = 0; pub_idx < CN_MAX_PUBLISHED_TOPICS; pub_idx++)
     {
-      new_errors =  rpcrosClientConnect(n, i);
-      ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+      PublisherNode *cur_pub = &n->pubs[pub_idx];
+      if(cur_pub->topic_name != NULL && cur_pub->priority == prio) // Is this publisher active (and in the current priority class)?
+      {
+        int all_procs_ready, batching, n_held;
+        int held_procs[CN_MAX_TCPROS_SERVER_CONNECTIONS];
+        // Latency-critical publishers always send each message immediately
+        batching = (cur_pub->batch_window > 0 && cur_pub->priority != CROS_TOPIC_PRIORITY_HIGH);
 
-      rpcros_client_fd = tcpIpSocketGetFD( &(n->rpcros_client_proc[i].socket) ); // update file descriptor after connecting
-      FD_SET( rpcros_client_fd, &w_fds);
-      FD_SET( rpcros_client_fd, &err_fds);
-      if( rpcros_client_fd > nfds ) nfds = rpcros_client_fd;
-    }
-    else if(n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_WRITING_HEADER ||
-       n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_START_WRITING ||
-       n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_WRITING)
-    {
-      FD_SET( rpcros_client_fd, &w_fds);
-      FD_SET( rpcros_client_fd, &err_fds);
-      if( rpcros_client_fd > nfds ) nfds = rpcros_client_fd;
-    }
-    else if(n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_READING_HEADER_SIZE ||
-            n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_READING_HEADER ||
-            n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_READING_SIZE ||
-            n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_READING)
-    {
-      FD_SET( rpcros_client_fd, &r_fds);
-      FD_SET( rpcros_client_fd, &err_fds);
-      if( rpcros_client_fd > nfds ) nfds = rpcros_client_fd;
-    }
-    else if(n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_WAIT_FOR_WRITING)
-    {
-      FD_SET( rpcros_client_fd, &err_fds);
-      if( rpcros_client_fd > nfds ) nfds = rpcros_client_fd;
-    }
-  }
+        // Check whether all tcpProcess are ready to start writing a new message
+        cRosMutexLock( &n->io_shard_lock );
+        all_procs_ready = publisherProcsReady(n, cur_pub);
+        cRosMutexUnlock( &n->io_shard_lock );
 
+        while((cur_pub->loop_period >= 0 && cur_pub->wake_up_time <= cur_time) || cRosMessageQueueUsage(&cur_pub->msg_queue) > 0) // Is it time to publish a message (periodic or immediate)?
+        {
+          int accept_msg;
+          if(batching) // The message is appended to the batch while there is room for it
+            accept_msg = (cur_pub->tcpros_id_list[0] != -1 && dynBufferGetSize(&cur_pub->batch) < cur_pub->batch_max_bytes);
+          else // The previous message (or batch) must have been sent by all the processes
+            accept_msg = (all_procs_ready && dynBufferGetSize(&cur_pub->batch) == 0);
 
-  /* Add to the tcpIpSocketSelect() the active RPCROS servers */
-  int next_rpcros_server_i = -1;
+          if(accept_msg && !cRosTokenBucketReady(&cur_pub->shaper, cur_time)) // The publisher rate limit has been exceeded
+          {
+            accept_msg = 0;
+            cRosMutexLock( &n->io_shard_lock );
+            if(cur_pub->shaping_policy == CROS_SHAPING_DROP)
+            {
+              if(cRosMessageQueueUsage(&cur_pub->msg_queue) > 0) // Discard the immediate message or skip the periodic one
+                cRosMessageQueueRemove(&cur_pub->msg_queue);
+              else
+                cur_pub->wake_up_time = cur_time + cur_pub->loop_period;
+              cur_pub->n_dropped_msgs++;
+            }
+            else if(!cur_pub->shaping_deferred) // The message will be sent when the bucket is refilled (see cRosNodeCalculateSelectTimeout())
+            {
+              cur_pub->shaping_deferred = 1;
+              cur_pub->n_shaped_msgs++;
+            }
+            cRosMutexUnlock( &n->io_shard_lock );
+          }
 
-  for( i = 0; i < CN_MAX_RPCROS_SERVER_CONNECTIONS; i++ )
-  {
-    int server_fd = tcpIpSocketGetFD( &(n->rpcros_server_proc[i].socket) );
+          if(!accept_msg)
+            break;
 
-    if( next_rpcros_server_i < 0 &&
-        n->rpcros_server_proc[i].state == TCPROS_PROCESS_STATE_IDLE )
-    {
-    	next_rpcros_server_i = i;
-    }
-    else if (n->rpcros_server_proc[i].state == TCPROS_PROCESS_STATE_READING_HEADER_SIZE ||
-             n->rpcros_server_proc[i].state == TCPROS_PROCESS_STATE_READING_HEADER ||
-             n->rpcros_server_proc[i].state == TCPROS_PROCESS_STATE_READING_SIZE ||
-             n->rpcros_server_proc[i].state == TCPROS_PROCESS_STATE_READING)
-    {
-      FD_SET( server_fd, &r_fds);
-      FD_SET( server_fd, &err_fds);
-      if( server_fd > nfds ) nfds = server_fd;
-    }
-    else if( n->rpcros_server_proc[i].state == TCPROS_PROCESS_STATE_WRITING_HEADER ||
-             n->rpcros_server_proc[i].state == TCPROS_PROCESS_STATE_WRITING )
-    {
-      FD_SET( server_fd, &w_fds);
-      FD_SET( server_fd, &err_fds);
-      if( server_fd > nfds ) nfds = server_fd;
-    }
-  }
+          if(cRosMessageQueueUsage(&cur_pub->msg_queue) == 0) // There is no immediate message waiting, so a periodic message must be sent
+            cur_pub->wake_up_time = cur_time + cur_pub->loop_period;
 
-  /* If one RPCROS server is available at least, add to the tcpIpSocketSelect() the listner socket */
-  if( next_rpcros_server_i >= 0)
-  {
-    if(rpcros_listner_fd != -1) // If the listener socket is still opened
-    {
-      FD_SET( rpcros_listner_fd, &r_fds);
-      FD_SET( rpcros_listner_fd, &err_fds);
-      if( rpcros_listner_fd > nfds ) nfds = rpcros_listner_fd;
+          // The next function will store the next message to be sent in cur_pub->context->outgoing
+          cb_start = cRosNodeCallbackStart(&cur_pub->cb_budget);
+          new_errors = cRosNodePublisherCallback(cur_pub->context); // Calls the publisher application-defined callback
+          cRosNodeCallbackEnd(n, CROS_CALLBACK_PUBLISHER, pub_idx, cb_start);
+          if(cur_pub->on_change && cur_pub->n_deadbands > 0 && !publisherMessageChanged(n, cur_pub, NULL, 0, cur_time))
+          {
+            // The message has not changed (within the deadbands): it is not even serialized
+          }
+          else if(batching)
+          {
+            // The processes may still be sending the previous batch, so the message is serialized in the batch buffer
+            size_t prev_batch_size = dynBufferGetSize(&cur_pub->batch);
+            new_errors = cRosAddErrCodePackIfErr(new_errors, cRosMessagePreparePublicationData(n, pub_idx, &cur_pub->batch));
+            if(cur_pub->on_change && cur_pub->n_deadbands == 0 && !publisherMessageChanged(n, cur_pub, &cur_pub->batch, prev_batch_size, cur_time))
+              dynBufferTruncate(&cur_pub->batch, prev_batch_size); // Remove the unchanged message from the batch
+            else
+            {
+              if(prev_batch_size == 0) // First message of the batch
+                cur_pub->batch_flush_time = cur_time + cur_pub->batch_window;
+              cRosTokenBucketConsume(&cur_pub->shaper, dynBufferGetSize(&cur_pub->batch) - prev_batch_size);
+              filterPublisherMessage(n, cur_pub, &cur_pub->batch, prev_batch_size);
+            }
+          }
+          else if(shardsCanSerialize(n, cur_pub))
+          {
+            // Each I/O shard serializes the message once for its processes (see cRosMessagePreparePublicationPacket()), so the
+            // main loop only has to compute its size. The outgoing message is not changed until all the processes have sent it
+            holdDeferredPublisherProcs(n, cur_pub, held_procs);
+            dynBufferClear(&cur_pub->packet);
+            cur_pub->packet_size = sizeof(uint32_t) + cRosMessageSerializedSize(cRosNodeGetOutgoingMessage(cur_pub->context));
+            cur_pub->shard_serialization = 1;
+            cur_pub->packet_seq++;
+            cRosTokenBucketConsume(&cur_pub->shaper, cur_pub->packet_size);
+            startPublisherWriting(n, cur_pub, shards_to_wake_up);
+            all_procs_ready = 0;
+          }
+          else
+          {
+            // Serialize the message only once: all the processes (and shards) of this publisher will send the same packet
+            n_held = holdDeferredPublisherProcs(n, cur_pub, held_procs);
+            dynBufferClear(&cur_pub->packet);
+            cur_pub->shard_serialization = 0;
+            new_errors = cRosAddErrCodePackIfErr(new_errors, cRosMessagePreparePublicationData(n, pub_idx, &cur_pub->packet));
+            cur_pub->packet_size = dynBufferGetSize(&cur_pub->packet);
+            if(!cur_pub->on_change || cur_pub->n_deadbands > 0 || publisherMessageChanged(n, cur_pub, &cur_pub->packet, 0, cur_time))
+            {
+              cRosTokenBucketConsume(&cur_pub->shaper, dynBufferGetSize(&cur_pub->packet));
+              filterPublisherMessage(n, cur_pub, &cur_pub->packet, 0);
+              startPublisherWriting(n, cur_pub, shards_to_wake_up);
+              all_procs_ready = 0;
+            }
+            else // The packet is equal to the deferred message
+              resumeHeldPublisherProcs(n, cur_pub, held_procs, n_held, shards_to_wake_up);
+          }
+          ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+          cur_pub->shaping_deferred = 0;
+        }
+
+        if(dynBufferGetSize(&cur_pub->batch) > 0) // Some messages are waiting in the batch
+        {
+          if(cur_pub->tcpros_id_list[0] == -1) // All the subscribers have gone: nobody will receive the batch
+            dynBufferClear(&cur_pub->batch);
+          else if(all_procs_ready &&
+                  (!batching || cur_time >= cur_pub->batch_flush_time || dynBufferGetSize(&cur_pub->batch) >= cur_pub->batch_max_bytes))
+          {
+            // The processes send the packet buffer, so the batch (just concatenated TCPROS frames) becomes the packet.
+            // No process is reading the packet now, so the buffers can be swapped without copying
+            holdDeferredPublisherProcs(n, cur_pub, held_procs);
+            DynBuffer sent_packet = cur_pub->packet;
+            cur_pub->packet = cur_pub->batch;
+            cur_pub->batch = sent_packet;
+            dynBufferClear(&cur_pub->batch);
+            cur_pub->packet_size = dynBufferGetSize(&cur_pub->packet);
+            cur_pub->shard_serialization = 0;
+            startPublisherWriting(n, cur_pub, shards_to_wake_up);
+          }
+        }
+      }
     }
   }
 
-  if (nfds + 1 == 0)
-  {
-    PRINT_VDEBUG("cRosNodeDoEventsLoop() : Warning: tcpIpSocketSelect() is being called with no file descriptors to monitor.\n");
-  }
+  for(shard_idx = 1; shard_idx < n->n_io_shards; shard_idx++)
+    if(shards_to_wake_up[shard_idx])
+      wakeUpIoShard(n, shard_idx);
 
-  select_timeout = cRosNodeCalculateSelectTimeout(n, max_timeout);
+  return(ret_err);
+}
 
-  // The node waits here until the specified file descriptors become ready for the corresponding I/O operation or the timeout is up
-  // ------------------------------------------------------------------------------------------------------------------------------
-  int n_set = tcpIpSocketSelect(nfds + 1, &r_fds, &w_fds, &err_fds, select_timeout);
 
-  cur_time = cRosClockGetTimeMs(); // Update current time after select()
-  if (n_set == -1)
-  {
-    PRINT_ERROR("cRosNodeDoEventsLoop() : tcpIpSocketSelect() function failed.\n");
-    ret_err = CROS_SELECT_FD_ERR;
-  }
-  else if( n_set == 0 )
-  {
-    PRINT_VDEBUG ("cRosNodeDoEventsLoop() : tcpIpSocketSelect() finished due to timeout (parameter: %llu ms) or it was interrupted\n", (long long unsigned)select_timeout);
+cRosErrCodePack cRosNodeTriggerServiceCallersWriting( CrosNode *n, uint64_t cur_time )
+{
+  cRosErrCodePack ret_err;
+  int caller_idx;
 
-    XmlrpcProcess *rosproc = &n->xmlrpc_client_proc[0];
-    if(n->xmlrpc_master_wake_up_time <= cur_time ) // It's time to wakeup, ping master, and maybe look up in master for pending services
+  ret_err = CROS_SUCCESS_ERR_PACK; // Default return value: success
+  // Check whether it is time to make a service call, and if so, trigger the corresponding TcprosProcesses
+  for(caller_idx = 0; caller_idx < CN_MAX_SERVICE_CALLERS; caller_idx++)
+  {
+    ServiceCallerNode *cur_caller = &n->service_callers[caller_idx];
+    if(cur_caller->service_name != NULL) // Is this caller active?
     {
-      PRINT_VDEBUG("cRosNodeDoEventsLoop() : It is ime to wake up the Master XML RPC process. Current time: %lu Wake up time: %lu\n", cur_time, n->xmlrpc_master_wake_up_time);
-      if(rosproc->state == XMLRPC_PROCESS_STATE_IDLE)
+      if((cur_caller->loop_period >= 0 && cur_caller->wake_up_time <= cur_time) || cRosMessageQueueUsage(&cur_caller->msg_queue) == 1 ||
+         cur_caller->in_place_call == CROS_IN_PLACE_CALL_REQUESTED) // Is it time to make a call (periodic or immediate)?
       {
-        // Prepare to ping roscore ...
-        PRINT_VDEBUG("cRosNodeDoEventsLoop() : Sending ping to ROS Master\n");
-
-        RosApiCall *call = newRosApiCall();
-        if (call != NULL)
+        // Check whether the corresponding process is ready to start making a new call
+        TcprosProcess *caller_proc = &n->rpcros_client_proc[cur_caller->rpcros_id];
+        if(caller_proc->state == TCPROS_PROCESS_STATE_WAIT_FOR_WRITING) // caller_proc->state == TCPROS_PROCESS_STATE_IDLE ||
         {
-          call->method = CROS_API_GET_PID;
-          int rc = xmlrpcParamVectorPushBackString(&call->params, n->name);
-          if(rc >= 0)
-          {
-            rosproc->message_type = XMLRPC_MESSAGE_REQUEST;
-            generateXmlrpcMessage( n->roscore_host, n->roscore_port, rosproc->message_type,
-                                  getMethodName(call->method), &call->params, &rosproc->message );
-
-            rosproc->current_call = call;
-            xmlrpcProcessChangeState(rosproc, XMLRPC_PROCESS_STATE_CONNECTING );
-          }
+          if(cur_caller->in_place_call == CROS_IN_PLACE_CALL_REQUESTED) // The request message of the application is already in cur_caller->context->outgoing
+            cur_caller->in_place_call = CROS_IN_PLACE_CALL_SENT;
           else
           {
-            PRINT_ERROR ( "cRosNodeDoEventsLoop() : Can't allocate memory\n");
-            ret_err=CROS_MEM_ALLOC_ERR;
+            if(cRosMessageQueueUsage(&cur_caller->msg_queue) == 0) // There is no immediate call waiting, so a periodic call will be made
+              cur_caller->wake_up_time = cur_time + cur_caller->loop_period;
+
+            // Now the service-call parameters are stored in cur_caller->context->outgoing
+            int64_t cb_start = cRosNodeCallbackStart(&cur_caller->cb_budget);
+            ret_err = cRosNodeServiceCallerCallback( 0, cur_caller->context); // calls the service-caller application-defined callback function to generate the service request
+            cRosNodeCallbackEnd(n, CROS_CALLBACK_SERVICE_CALLER, caller_idx, cb_start);
           }
 
-          // The ROS master does not warn us when a new service is registered, so we have to
-          // continuously check for the required service
-          for(i = 0; i < CN_MAX_RPCROS_CLIENT_CONNECTIONS; i++ )
+          //if(caller_proc->state == TCPROS_PROCESS_STATE_WAIT_FOR_WRITING)
           {
-             TcprosProcess *client_proc = &(n->rpcros_client_proc[i]);
-             if( client_proc->state == TCPROS_PROCESS_STATE_WAIT_FOR_CONNECTING)
-             {
-               tcprosProcessChangeState(client_proc, TCPROS_PROCESS_STATE_IDLE);
-               enqueueServiceLookup(n, client_proc->service_idx);
-             }
+            tcprosProcessChangeState( caller_proc, TCPROS_PROCESS_STATE_START_WRITING );
           }
-          n->xmlrpc_master_wake_up_time = cur_time + CN_PING_LOOP_PERIOD; // The process completed doing what it should, so wake up again CN_PING_LOOP_PERIOD milliseconds later
-        }
-        else
-        {
-          PRINT_ERROR ( "cRosNodeDoEventsLoop() : Can't allocate memory\n");
-          ret_err=CROS_MEM_ALLOC_ERR;
         }
       }
-      else
-        n->xmlrpc_master_wake_up_time = cur_time + CN_PING_LOOP_PERIOD/50; // The process is busy, so try to wake up again soon (CN_PING_LOOP_PERIOD/50 milliseconds later) to do what is pending
-    }
-    if( rosproc->state != XMLRPC_PROCESS_STATE_IDLE && cRosClockGetTimeMs() - rosproc->last_change_time > CN_IO_TIMEOUT ) // last_change_time is updated when changing process state
-    {
-      // Timeout between I/O operations... close the socket and re-advertise
-      PRINT_VDEBUG ( "cRosNodeDoEventsLoop() : XMLRPC client I/O timeout\n");
-      handleXmlrpcClientError( n, 0 );
     }
+  }
+  return(ret_err);
+}
+
+#define NODE_STATUS_STR_MAX_LEN (CN_MAX_XMLRPC_CLIENT_CONNECTIONS+CN_MAX_XMLRPC_SERVER_CONNECTIONS+CN_MAX_TCPROS_CLIENT_CONNECTIONS+CN_MAX_TCPROS_SERVER_CONNECTIONS+CN_MAX_RPCROS_CLIENT_CONNECTIONS+CN_MAX_RPCROS_SERVER_CONNECTIONS+6*3+3*4+2)
+void printNodeProcState( CrosNode *n )
+{
+  static char prev_stat_str[NODE_STATUS_STR_MAX_LEN]="\0";
+  char stat_str[NODE_STATUS_STR_MAX_LEN];
+  int i;
+
+  sprintf(stat_str, "XL%X XC",n->xmlrpc_listner_proc.state);
+  for(i = 0; i < CN_MAX_XMLRPC_CLIENT_CONNECTIONS; i++ )
+    sprintf(stat_str+strlen(stat_str), "%X",n->xmlrpc_client_proc[i].state);
+
+  sprintf(stat_str+strlen(stat_str), " XS");
+  for( i = 0; i < CN_MAX_XMLRPC_SERVER_CONNECTIONS; i++ )
+    sprintf(stat_str+strlen(stat_str), "%X",n->xmlrpc_server_proc[i].state);
+
+  sprintf(stat_str+strlen(stat_str), " TL%X TC",n->tcpros_listner_proc.state);
+  for(i = 0; i < CN_MAX_TCPROS_CLIENT_CONNECTIONS; i++ )
+    sprintf(stat_str+strlen(stat_str), "%X",n->tcpros_client_proc[i].state);
+
+  sprintf(stat_str+strlen(stat_str), " TS");
+  for( i = 0; i < CN_MAX_TCPROS_SERVER_CONNECTIONS; i++ )
+    sprintf(stat_str+strlen(stat_str), "%X",n->tcpros_server_proc[i].state);
+
+  sprintf(stat_str+strlen(stat_str), " RL%X RC",n->rpcros_listner_proc.state);
+  for(i = 0; i < CN_MAX_RPCROS_CLIENT_CONNECTIONS; i++ )
+    sprintf(stat_str+strlen(stat_str), "%X",n->rpcros_client_proc[i].state);
+
+  sprintf(stat_str+strlen(stat_str), " RS");
+  for( i = 0; i < CN_MAX_RPCROS_SERVER_CONNECTIONS; i++ )
+    sprintf(stat_str+strlen(stat_str), "%X",n->rpcros_server_proc[i].state);
+
+  if (strcmp(prev_stat_str, stat_str) != 0) // If the node status has changed:
+  {
+    // Print a compact string indicating the state of all the node processed for debug purposes
+    PRINT_DEBUG("Node status: %s\n", stat_str);
+    strcpy(prev_stat_str, stat_str);
+  }
+}
+
+uint64_t cRosNodeCalculateSelectTimeout(CrosNode *n, uint64_t max_timeout)
+{
+  uint64_t wakeup_timeout, select_timeout, cur_time;
+  int pub_idx, svc_idx, i;
+
+  select_timeout =  max_timeout;
+  cur_time = cRosClockGetTime(&n->clock);
+
+  if( n->xmlrpc_master_wake_up_time > cur_time )
+    wakeup_timeout = n->xmlrpc_master_wake_up_time - cur_time;
+  else
+    wakeup_timeout = 0;
 
+  if( wakeup_timeout < select_timeout )
+    select_timeout = wakeup_timeout;
 
-    for( i = 0; i < CN_MAX_TCPROS_SERVER_CONNECTIONS && ret_err==CROS_SUCCESS_ERR_PACK; i++ )
+  for (pub_idx = 0;pub_idx < CN_MAX_PUBLISHED_TOPICS;pub_idx++) // < n_pubs?
+  {
+    PublisherNode *cur_pub = &n->pubs[pub_idx];
+    if(cur_pub->topic_name != NULL && cur_pub->loop_period >= 0) // Is this publisher active and automatically publishing messages?
     {
-      if( (n->tcpros_server_proc[i].state == TCPROS_PROCESS_STATE_READING_HEADER ||
-                n->tcpros_server_proc[i].state == TCPROS_PROCESS_STATE_WRITING ) &&
-               cur_time - n->tcpros_server_proc[i].last_change_time > CN_IO_TIMEOUT )
-      {
-        // Timeout between I/O operations
-        PRINT_VDEBUG ( "cRosNodeDoEventsLoop() : TCPROS server I/O timeout\n");
-        handleTcprosServerError( n, i );
-      }
+      if( cur_pub->wake_up_time > cur_time ) // Is not it time to publish a new message yet?
+        wakeup_timeout = cur_pub->wake_up_time - cur_time;
+      else
+        wakeup_timeout = cRosTokenBucketWaitTime( &cur_pub->shaper, cur_time ); // It is time to publish unless the rate limit has been exceeded
+
+      if( wakeup_timeout < select_timeout )
+        select_timeout = wakeup_timeout;
     }
 
-    for( i = 0; i < CN_MAX_RPCROS_CLIENT_CONNECTIONS && ret_err==CROS_SUCCESS_ERR_PACK; i++ )
+    if(cur_pub->topic_name != NULL && dynBufferGetSize(&cur_pub->batch) > 0) // Are there batched messages waiting to be sent?
     {
-      if( (n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_READING_HEADER || // Add more states to the condition???
-                n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_WRITING ) &&
-               cur_time - n->rpcros_client_proc[i].last_change_time > CN_IO_TIMEOUT )
-      {
-        // Timeout between I/O operations
-        PRINT_VDEBUG ( "cRosNodeDoEventsLoop() : TCPROS server I/O timeout\n");
-        handleTcprosServerError( n, i );
-      }
+      if( cur_pub->batch_flush_time > cur_time && dynBufferGetSize(&cur_pub->batch) < cur_pub->batch_max_bytes )
+        wakeup_timeout = cur_pub->batch_flush_time - cur_time;
+      else
+        wakeup_timeout = 0;
+
+      if( wakeup_timeout < select_timeout )
+        select_timeout = wakeup_timeout;
     }
   }
-  else
+
+  for( i = 0; i < CN_MAX_TCPROS_SERVER_CONNECTIONS; i += n->n_io_shards ) // Connections of the main loop (I/O shard 0)
   {
-    PRINT_VDEBUG ( "cRosNodeDoEventsLoop() : tcpIpSocketSelect() finished with num. fd set: %i (timeout parameter was: %llu ms)\n", n_set, (long long unsigned)select_timeout);
-    for(i = 0; i < CN_MAX_XMLRPC_CLIENT_CONNECTIONS; i++ )
+    TcprosProcess *server_proc = &n->tcpros_server_proc[i];
+    if( server_proc->state == TCPROS_PROCESS_STATE_START_WRITING ) // Is this connection waiting for its rate limit?
     {
-      XmlrpcProcess *client_proc;
-      int xmlrpc_client_fd;
-
+      wakeup_timeout = cRosTokenBucketWaitTime( &server_proc->shaper, cur_time );
+      if( wakeup_timeout < select_timeout )
+        select_timeout = wakeup_timeout;
+    }
+    wakeup_timeout = tcprosServerIoTimeoutWait( n, i, cur_time ); // Wake up to evict the connection if its I/O has stalled
+    if( wakeup_timeout < select_timeout )
+      select_timeout = wakeup_timeout;
+  }
+
+  for( i = 0; i < CN_MAX_TCPROS_CLIENT_CONNECTIONS && n->statistics_pub_idx != -1; i++ )
+  {
+    TcprosProcess *client_proc = &n->tcpros_client_proc[i];
+    if( (client_proc->state == TCPROS_PROCESS_STATE_READING_SIZE || client_proc->state == TCPROS_PROCESS_STATE_READING) &&
+        n->subs[client_proc->topic_idx].stats_window > 0 ) // Is this connection collecting statistics?
+    {
+      uint64_t window_stop = client_proc->stats.window_start + n->subs[client_proc->topic_idx].stats_window;
+      wakeup_timeout = (window_stop > cur_time)? window_stop - cur_time: 0;
+      if( wakeup_timeout < select_timeout )
+        select_timeout = wakeup_timeout;
+    }
+  }
+
+  if( n->reregistration_cursor != -1 ) // Wake up to send the next re-registrations
+  {
+    wakeup_timeout = cRosTokenBucketWaitTime( &n->reregistration_shaper, cur_time );
+    if( wakeup_timeout < select_timeout )
+      select_timeout = wakeup_timeout;
+  }
+
+  if( n->graph_cache_enabled && n->graph_cache_call_id == -1 ) // Wake up to refresh the graph cache
+  {
+    wakeup_timeout = (n->graph_cache_wake_up_time > cur_time)? n->graph_cache_wake_up_time - cur_time: 0;
+    if( wakeup_timeout < select_timeout )
+      select_timeout = wakeup_timeout;
+  }
+
+  for (svc_idx = 0;svc_idx < CN_MAX_SERVICE_CALLERS;svc_idx++) // <n_service_callers?
+  {
+    ServiceCallerNode *cur_svc_caller = &n->service_callers[svc_idx];
+    if(cur_svc_caller->service_name != NULL && cur_svc_caller->loop_period >= 0) // Is this service caller active and automatically publishing messages?
+    {
+      if( cur_svc_caller->wake_up_time > cur_time ) // Is not it time to make a service call yet?
+        wakeup_timeout = cur_svc_caller->wake_up_time - cur_time;
+      else
+        wakeup_timeout = 0;
+
+      if( wakeup_timeout < select_timeout )
+      {
+        //printf("[i:%i cur time: %lu wake:%lu new timeout: %lu prev timeout:%lu]", i, cur_time,  cur_svc_caller->wake_up_time, wakeup_timeout, select_timeout);
+        select_timeout = wakeup_timeout;
+      }
+    }
+  }
+
+  return(select_timeout);
+}
+
+// Start the operation requested for a TCPROS client process if tcpIpSocketSelect() unblocked its socket
+static cRosErrCodePack dispatchTcprosClientSocket( CrosNode *n, int i, fd_set *r_fds, fd_set *w_fds, fd_set *err_fds )
+{
+  cRosErrCodePack ret_err = CROS_SUCCESS_ERR_PACK;
+  TcprosProcess *client_proc = &(n->tcpros_client_proc[i]);
+  int tcpros_client_fd = tcpIpSocketGetFD( &(client_proc->socket) );
+
+  if( client_proc->state != TCPROS_PROCESS_STATE_IDLE && FD_ISSET(tcpros_client_fd, err_fds) )
+  {
+    PRINT_ERROR ( "cRosNodeDoEventsLoop() : XMLRPC client socket error\n" );
+    handleTcprosClientError( n, i );
+  }
+
+  if( (client_proc->state == TCPROS_PROCESS_STATE_CONNECTING && FD_ISSET(tcpros_client_fd, w_fds) ) || // tcpIpSocketSelect() indicates connection completion through write-fd
+      ( client_proc->state == TCPROS_PROCESS_STATE_WRITING_HEADER && FD_ISSET(tcpros_client_fd, w_fds) ) ||
+      ( client_proc->state == TCPROS_PROCESS_STATE_READING_SIZE && FD_ISSET(tcpros_client_fd, r_fds) ) ||
+      ( client_proc->state == TCPROS_PROCESS_STATE_READING && FD_ISSET(tcpros_client_fd, r_fds) ) ||
+      ( client_proc->state == TCPROS_PROCESS_STATE_READING_HEADER_SIZE && FD_ISSET(tcpros_client_fd, r_fds) ) ||
+      ( client_proc->state == TCPROS_PROCESS_STATE_READING_HEADER && FD_ISSET(tcpros_client_fd, r_fds) ) )
+  {
+    ret_err = doWithTcprosClientSocket( n, i );
+  }
+  return ret_err;
+}
+
+// Start the operation requested for a TCPROS server process if tcpIpSocketSelect() unblocked its socket
+static cRosErrCodePack dispatchTcprosServerSocket( CrosNode *n, int i, fd_set *r_fds, fd_set *w_fds, fd_set *err_fds )
+{
+  cRosErrCodePack ret_err = CROS_SUCCESS_ERR_PACK;
+  TcprosProcess *server_proc = &n->tcpros_server_proc[i];
+  int server_fd = tcpIpSocketGetFD( &server_proc->socket );
+
+  if( server_proc->state != TCPROS_PROCESS_STATE_IDLE && FD_ISSET(server_fd, err_fds) )
+  {
+    PRINT_ERROR ( "cRosNodeDoEventsLoop() : TCPROS server socket error\n" );
+    handleTcprosServerError( n, i );
+  }
+  else if( ( server_proc->state == TCPROS_PROCESS_STATE_READING_HEADER && FD_ISSET(server_fd, r_fds) ) ||
+    ( server_proc->state == TCPROS_PROCESS_STATE_START_WRITING && FD_ISSET(server_fd, w_fds) ) ||
+    ( server_proc->state == TCPROS_PROCESS_STATE_WRITING && FD_ISSET(server_fd, w_fds) ) ||
+    ( tcprosServerWaitsForZeroCopy( server_proc ) && FD_ISSET(server_fd, r_fds) ) )
+  {
+    ret_err = doWithTcprosServerSocket( n, i );
+  }
+  return ret_err;
+}
+
+// Submit the send chains queued by the writes of the TCPROS servers of an I/O shard in one system call, and let the
+// servers whose chain has completed continue writing, so that their next chain is submitted by the next wait
+static cRosErrCodePack flushTcprosServerSends( CrosNode *n, int shard_idx, TcpIpUring *u )
+{
+  cRosErrCodePack ret_err = CROS_SUCCESS_ERR_PACK, new_errors;
+  int i;
+
+  if( tcpIpUringFlushSends( u ) <= 0 )
+    return ret_err;
+
+  for( i = shard_idx; i < CN_MAX_TCPROS_SERVER_CONNECTIONS; i += n->n_io_shards )
+  {
+    if( n->tcpros_server_proc[i].state == TCPROS_PROCESS_STATE_WRITING && tcpIpUringSendDone( &(n->tcpros_server_proc[i].socket) ) )
+    {
+      new_errors = doWithTcprosServerSocket( n, i );
+      ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+    }
+  }
+  return ret_err;
+}
+
+cRosErrCodePack cRosNodeDoEventsLoop( CrosNode *n, uint64_t max_timeout )
+{
+  cRosErrCodePack ret_err, new_errors;
+  uint64_t cur_time, select_timeout;
+  int nfds = -1;
+  fd_set r_fds, w_fds, err_fds;
+  int i, k;
+  int client_order[CN_MAX_TCPROS_CLIENT_CONNECTIONS], n_client_order, n_high_clients;
+  int server_order[CN_MAX_TCPROS_SERVER_CONNECTIONS], n_server_order, n_high_servers;
+
+  PRINT_VVDEBUG ( "cRosNodeDoEventsLoop ()\n" );
+
+  if(n == NULL)
+    return CROS_BAD_PARAM_ERR;
+
+  #if CROS_DEBUG_LEVEL >= 2
+  PRINT_DEBUG("*");
+  FLUSH_PRINT();
+  printNodeProcState( n );
+  #endif
+
+  createLoggerServices( n );
+
+  cur_time = cRosClockGetTime(&n->clock);
+
+  publishTopicStatistics( n, cur_time );
+
+  refreshGraphCache( n, cur_time );
+
+  continueReregistration( n, cur_time );
+
+  ret_err = cRosNodeTriggerPublishersWriting( n, cur_time );
+
+  new_errors = cRosNodeTriggerServiceCallersWriting( n, cur_time );
+  ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+
+  FD_ZERO( &r_fds );
+  FD_ZERO( &w_fds );
+  FD_ZERO( &err_fds );
+
+  int xmlrpc_listner_fd = tcpIpSocketGetFD( &(n->xmlrpc_listner_proc.socket) );
+  int tcpros_listner_fd = tcpIpSocketGetFD( &(n->tcpros_listner_proc.socket) );
+  int tcpros_data_listner_fd = tcpIpSocketGetFD( &(n->tcpros_data_listner_proc.socket) );
+  int rpcros_listner_fd = tcpIpSocketGetFD( &(n->rpcros_listner_proc.socket) );
+
+  XmlrpcProcess *coreproc = &n->xmlrpc_client_proc[0];
+  if (coreproc->state == XMLRPC_PROCESS_STATE_IDLE && !isQueueEmpty(&n->master_api_queue))
+  {
+    RosApiCall *call = dequeueApiCall(&n->master_api_queue);
+    coreproc->current_call = call;
+    xmlrpcProcessChangeState( coreproc, XMLRPC_PROCESS_STATE_CONNECTING );
+  }
+
+  size_t idle_client_count;
+  int idle_clients[CN_MAX_XMLRPC_CLIENT_CONNECTIONS];
+  getIdleXmplrpcClients(n, idle_clients, &idle_client_count);
+
+  int next_idle_client_idx = 0;
+  while (!isQueueEmpty(&n->slave_api_queue) && next_idle_client_idx != idle_client_count)
+  {
+    int idle_client_idx = idle_clients[next_idle_client_idx];
+    RosApiCall *call = dequeueApiCall(&n->slave_api_queue);
+
+    XmlrpcProcess *proc =  &n->xmlrpc_client_proc[idle_client_idx];
+    proc->current_call = call;
+    xmlrpcProcessChangeState( proc, XMLRPC_PROCESS_STATE_CONNECTING );
+
+    next_idle_client_idx++;
+  }
+
+  /* If active (not idle state), add to the tcpIpSocketSelect() the XMLRPC clients */
+  for(i = 0; i < CN_MAX_XMLRPC_CLIENT_CONNECTIONS; i++)
+  {
+    fd_set *fdset = NULL;
+    if( n->xmlrpc_client_proc[i].state == XMLRPC_PROCESS_STATE_CONNECTING )
+    {
+      new_errors =  xmlrpcClientConnect(n, i);
+      ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+      fdset = &w_fds; // tcpIpSocketSelect() will acknowledge the socket connection completion in the file descriptors checked for writing
+    }
+    else if( n->xmlrpc_client_proc[i].state == XMLRPC_PROCESS_STATE_WRITING )
+      fdset = &w_fds;
+    else if( n->xmlrpc_client_proc[i].state == XMLRPC_PROCESS_STATE_READING )
+      fdset = &r_fds;
+
+    if (fdset != NULL)
+    {
+      int xmlrpc_client_fd = tcpIpSocketGetFD( &(n->xmlrpc_client_proc[i].socket) );
+      if(xmlrpc_client_fd != -1)
+      {
+        if( xmlrpc_client_fd > nfds )
+          nfds = xmlrpc_client_fd;
+
+        FD_SET( xmlrpc_client_fd, fdset);
+        FD_SET( xmlrpc_client_fd, &err_fds);
+      }
+    }
+  }
+
+  //printf("FD_SET COUNT. R: %d W: %d\n", r_count, w_count);
+
+  /* Add to the tcpIpSocketSelect() the active XMLRPC servers */
+  int next_xmlrpc_server_i = -1;
+  for( i = 0; i < CN_MAX_XMLRPC_SERVER_CONNECTIONS; i++ )
+  {
+    int server_fd = tcpIpSocketGetFD( &(n->xmlrpc_server_proc[i].socket) );
+
+    if( next_xmlrpc_server_i < 0 &&
+        n->xmlrpc_server_proc[i].state == XMLRPC_PROCESS_STATE_IDLE )
+    {
+      next_xmlrpc_server_i = i;
+    }
+    else if( n->xmlrpc_server_proc[i].state == XMLRPC_PROCESS_STATE_READING )
+    {
+      FD_SET( server_fd, &r_fds);
+      FD_SET( server_fd, &err_fds);
+      if( server_fd > nfds ) nfds = server_fd;
+    }
+    else if( n->xmlrpc_server_proc[i].state == XMLRPC_PROCESS_STATE_WRITING )
+    {
+      FD_SET( server_fd, &w_fds);
+      FD_SET( server_fd, &err_fds);
+      if( server_fd > nfds ) nfds = server_fd;
+    }
+  }
+
+  /* If one XMLRPC server is active at least, add to the tcpIpSocketSelect() the listener socket */
+  if( next_xmlrpc_server_i >= 0)
+  {
+    if(xmlrpc_listner_fd != -1) // If the listener socket is still opened, add it to the tcpIpSocketSelect() file descriptors
+    {
+      tcpIpUringAttachSocket( n->io_uring, &(n->xmlrpc_listner_proc.socket), TCPIP_URING_OP_ACCEPT );
+      FD_SET( xmlrpc_listner_fd, &r_fds);
+      FD_SET( xmlrpc_listner_fd, &err_fds);
+      if( xmlrpc_listner_fd > nfds ) nfds = xmlrpc_listner_fd;
+    }
+  }
+
+  /*
+   *
+   * TCPROS PROCESSES tcpIpSocketSelect() MANAGEMENT
+   *
+   */
+
+  /* If active (not idle state), add to the tcpIpSocketSelect() the TCPROS clients */
+  int next_tcpros_client_i = -1; // Unused ???
+  for(i = 0; i < CN_MAX_TCPROS_CLIENT_CONNECTIONS; i++)
+  {
+    TcprosProcess *client_proc = &(n->tcpros_client_proc[i]);
+    int tcpros_client_fd;
+
+    if( next_tcpros_client_i < 0 &&
+        i != 0 && //the zero-index is reserved to the roscore communications
+        client_proc->state == TCPROS_PROCESS_STATE_IDLE )
+    {
+      next_tcpros_client_i = i;
+    }
+    else if(client_proc->state == TCPROS_PROCESS_STATE_CONNECTING)
+    {
+      new_errors =  tcprosClientConnect(n, i);
+      ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+
+      tcpros_client_fd = tcpIpSocketGetFD( &(client_proc->socket) );
+      FD_SET( tcpros_client_fd, &w_fds);
+      FD_SET( tcpros_client_fd, &err_fds);
+      if( tcpros_client_fd > nfds ) nfds = tcpros_client_fd;
+    }
+    else if(client_proc->state == TCPROS_PROCESS_STATE_WRITING_HEADER)
+    {
+      tcpros_client_fd = tcpIpSocketGetFD( &(client_proc->socket) );
+      FD_SET( tcpros_client_fd, &w_fds);
+      FD_SET( tcpros_client_fd, &err_fds);
+      if( tcpros_client_fd > nfds ) nfds = tcpros_client_fd;
+    }
+    else if(client_proc->state == TCPROS_PROCESS_STATE_READING_HEADER_SIZE ||
+            client_proc->state == TCPROS_PROCESS_STATE_READING_HEADER ||
+            client_proc->state == TCPROS_PROCESS_STATE_READING_SIZE ||
+            client_proc->state == TCPROS_PROCESS_STATE_READING)
+    {
+      tcpIpUringAttachSocket( n->io_uring, &(client_proc->socket), TCPIP_URING_OP_RECV ); // The data is received in advance
+      tcpros_client_fd = tcpIpSocketGetFD( &(client_proc->socket) );
+      FD_SET( tcpros_client_fd, &r_fds);
+      FD_SET( tcpros_client_fd, &err_fds);
+      if( tcpros_client_fd > nfds ) nfds = tcpros_client_fd;
+    }
+  }
+
+  /* Add to the tcpIpSocketSelect() the active TCPROS servers */
+  int next_tcpros_server_i = -1; // Index of the first server that is idle (ready to be activated). -1 = no one is idle
+  for( i = 0; i < CN_MAX_TCPROS_SERVER_CONNECTIONS; i++ )
+  {
+    if( i % n->n_io_shards != 0 ) // This server is served by another I/O shard loop
+      continue;
+
+    int server_fd = tcpIpSocketGetFD( &(n->tcpros_server_proc[i].socket) );
+
+    if( next_tcpros_server_i < 0 &&
+        n->tcpros_server_proc[i].state == TCPROS_PROCESS_STATE_IDLE )
+    {
+      next_tcpros_server_i = i;
+    }
+    else if( n->tcpros_server_proc[i].state == TCPROS_PROCESS_STATE_READING_HEADER )
+    {
+      FD_SET( server_fd, &r_fds);
+      FD_SET( server_fd, &err_fds);
+      if( server_fd > nfds ) nfds = server_fd;
+    }
+    else if( tcprosServerWaitsForZeroCopy( &n->tcpros_server_proc[i] ) )
+    {
+      FD_SET( server_fd, &r_fds); // The zero-copy completion notifications (socket error queue) are reported as readability
+      FD_SET( server_fd, &err_fds);
+      if( server_fd > nfds ) nfds = server_fd;
+    }
+    else if( ( n->tcpros_server_proc[i].state == TCPROS_PROCESS_STATE_START_WRITING && tcprosServerShapingAllowsWriting( n, i, cur_time ) ) ||
+             n->tcpros_server_proc[i].state == TCPROS_PROCESS_STATE_WRITING )
+    {
+      tcpIpUringAttachSocket( n->io_uring, &(n->tcpros_server_proc[i].socket), TCPIP_URING_OP_SEND_FRAMES );
+      FD_SET( server_fd, &w_fds);
+      FD_SET( server_fd, &err_fds);
+      if( server_fd > nfds ) nfds = server_fd;
+    }
+    else if( n->tcpros_server_proc[i].state == TCPROS_PROCESS_STATE_WAIT_FOR_WRITING ||
+             n->tcpros_server_proc[i].state == TCPROS_PROCESS_STATE_START_WRITING ) // Waiting for the next message or for the rate limit
+    {
+      FD_SET( server_fd, &err_fds);
+      if( server_fd > nfds ) nfds = server_fd;
+    }
+  }
+
+  /* If one TCPROS server is available at least, add to the tcpIpSocketSelect() the listener socket.
+     If the port is shared with other I/O shards, the listener is always added so that the connections routed to it are rejected */
+  if( tcpros_listner_fd != -1 && (next_tcpros_server_i >= 0 || n->n_io_shards > 1) ) // If the listener socket is still opened
+  {
+    tcpIpUringAttachSocket( n->io_uring, &(n->tcpros_listner_proc.socket), TCPIP_URING_OP_ACCEPT );
+    FD_SET( tcpros_listner_fd, &r_fds);
+    FD_SET( tcpros_listner_fd, &err_fds);
+    if( tcpros_listner_fd > nfds ) nfds = tcpros_listner_fd;
+  }
+  if( next_tcpros_server_i >= 0)
+  {
+    if(tcpros_data_listner_fd != -1) // If a data host has been set
+    {
+      tcpIpUringAttachSocket( n->io_uring, &(n->tcpros_data_listner_proc.socket), TCPIP_URING_OP_ACCEPT );
+      FD_SET( tcpros_data_listner_fd, &r_fds);
+      FD_SET( tcpros_data_listner_fd, &err_fds);
+      if( tcpros_data_listner_fd > nfds ) nfds = tcpros_data_listner_fd;
+    }
+  }
+
+
+  /*
+   *
+   * RPCROS PROCESSES tcpIpSocketSelect() MANAGEMENT
+   *
+   */
+
+  /* If active (not idle state), add to the tcpIpSocketSelect() the TCPROS clients */
+  for(i = 0; i < CN_MAX_RPCROS_CLIENT_CONNECTIONS; i++)
+  {
+    int rpcros_client_fd;
+
+    rpcros_client_fd = tcpIpSocketGetFD( &(n->rpcros_client_proc[i].socket) );
+    if(n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_CONNECTING)
+    {
+      new_errors =  rpcrosClientConnect(n, i);
+      ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+
+      rpcros_client_fd = tcpIpSocketGetFD( &(n->rpcros_client_proc[i].socket) ); // update file descriptor after connecting
+      FD_SET( rpcros_client_fd, &w_fds);
+      FD_SET( rpcros_client_fd, &err_fds);
+      if( rpcros_client_fd > nfds ) nfds = rpcros_client_fd;
+    }
+    else if(n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_WRITING_HEADER ||
+       n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_START_WRITING ||
+       n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_WRITING)
+    {
+      FD_SET( rpcros_client_fd, &w_fds);
+      FD_SET( rpcros_client_fd, &err_fds);
+      if( rpcros_client_fd > nfds ) nfds = rpcros_client_fd;
+    }
+    else if(n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_READING_HEADER_SIZE ||
+            n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_READING_HEADER ||
+            n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_READING_SIZE ||
+            n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_READING)
+    {
+      FD_SET( rpcros_client_fd, &r_fds);
+      FD_SET( rpcros_client_fd, &err_fds);
+      if( rpcros_client_fd > nfds ) nfds = rpcros_client_fd;
+    }
+    else if(n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_WAIT_FOR_WRITING)
+    {
+      FD_SET( rpcros_client_fd, &err_fds);
+      if( rpcros_client_fd > nfds ) nfds = rpcros_client_fd;
+    }
+  }
+
+
+  /* Add to the tcpIpSocketSelect() the active RPCROS servers */
+  int next_rpcros_server_i = -1;
+
+  for( i = 0; i < CN_MAX_RPCROS_SERVER_CONNECTIONS; i++ )
+  {
+    int server_fd = tcpIpSocketGetFD( &(n->rpcros_server_proc[i].socket) );
+
+    if( next_rpcros_server_i < 0 &&
+        n->rpcros_server_proc[i].state == TCPROS_PROCESS_STATE_IDLE )
+    {
+    	next_rpcros_server_i = i;
+    }
+    else if (n->rpcros_server_proc[i].state == TCPROS_PROCESS_STATE_READING_HEADER_SIZE ||
+             n->rpcros_server_proc[i].state == TCPROS_PROCESS_STATE_READING_HEADER ||
+             n->rpcros_server_proc[i].state == TCPROS_PROCESS_STATE_READING_SIZE ||
+             n->rpcros_server_proc[i].state == TCPROS_PROCESS_STATE_READING)
+    {
+      FD_SET( server_fd, &r_fds);
+      FD_SET( server_fd, &err_fds);
+      if( server_fd > nfds ) nfds = server_fd;
+    }
+    else if( n->rpcros_server_proc[i].state == TCPROS_PROCESS_STATE_WRITING_HEADER ||
+             n->rpcros_server_proc[i].state == TCPROS_PROCESS_STATE_WRITING )
+    {
+      FD_SET( server_fd, &w_fds);
+      FD_SET( server_fd, &err_fds);
+      if( server_fd > nfds ) nfds = server_fd;
+    }
+  }
+
+  /* If one RPCROS server is available at least, add to the tcpIpSocketSelect() the listner socket */
+  if( next_rpcros_server_i >= 0)
+  {
+    if(rpcros_listner_fd != -1) // If the listener socket is still opened
+    {
+      tcpIpUringAttachSocket( n->io_uring, &(n->rpcros_listner_proc.socket), TCPIP_URING_OP_ACCEPT );
+      FD_SET( rpcros_listner_fd, &r_fds);
+      FD_SET( rpcros_listner_fd, &err_fds);
+      if( rpcros_listner_fd > nfds ) nfds = rpcros_listner_fd;
+    }
+  }
+
+  if (nfds + 1 == 0)
+  {
+    PRINT_VDEBUG("cRosNodeDoEventsLoop() : Warning: tcpIpSocketSelect() is being called with no file descriptors to monitor.\n");
+  }
+
+  // A simulated clock wakes up the loop when it is advanced, since the simulated timeout may expire before the real one.
+  // The I/O shards wake it up when they queue subscriber events
+  if( n->main_wake_up_fd[0] != -1 )
+  {
+    FD_SET( n->main_wake_up_fd[0], &r_fds);
+    if( n->main_wake_up_fd[0] > nfds ) nfds = n->main_wake_up_fd[0];
+  }
+
+  select_timeout = cRosNodeCalculateSelectTimeout(n, max_timeout);
+
+  // The node waits here until the specified file descriptors become ready for the corresponding I/O operation or the timeout is up
+  // With an auto-advancing simulated clock the sockets are just polled, since the time jumps to the next operation when the loop is idle
+  // ------------------------------------------------------------------------------------------------------------------------------
+  int n_set = tcpIpUringSelect(n->io_uring, nfds + 1, &r_fds, &w_fds, &err_fds, (n->clock.type == CROS_CLOCK_SIMULATED && n->clock.auto_advance)? 0 : select_timeout);
+#ifndef _WIN32
+  if( n_set > 0 && n->main_wake_up_fd[0] != -1 && FD_ISSET( n->main_wake_up_fd[0], &r_fds) )
+  {
+    char wake_up_bytes[16];
+    while( read( n->main_wake_up_fd[0], wake_up_bytes, sizeof(wake_up_bytes) ) > 0 ); // Empty the pipe
+    n_set--; // The clock has been advanced or there are subscriber events: handle the due operations as if the timeout were up
+  }
+#endif
+
+  // Nothing to do until the next scheduled operation: jump to it. The time advances at least 1 msec, as the real time would
+  // do, so that operations that are due but cannot be done yet (e.g. waiting for a subscriber) do not stop the clock
+  if( n_set == 0 && n->clock.type == CROS_CLOCK_SIMULATED && n->clock.auto_advance )
+    cRosClockAdvance( &n->clock, (select_timeout > 0)? select_timeout : 1 );
+
+  cur_time = cRosClockGetTime(&n->clock); // Update current time after select()
+  if (n_set == -1)
+  {
+    PRINT_ERROR("cRosNodeDoEventsLoop() : tcpIpSocketSelect() function failed.\n");
+    ret_err = CROS_SELECT_FD_ERR;
+  }
+  else if( n_set == 0 )
+  {
+    PRINT_VDEBUG ("cRosNodeDoEventsLoop() : tcpIpSocketSelect() finished due to timeout (parameter: %llu ms) or it was interrupted\n", (long long unsigned)select_timeout);
+
+    XmlrpcProcess *rosproc = &n->xmlrpc_client_proc[0];
+    if(n->xmlrpc_master_wake_up_time <= cur_time ) // It's time to wakeup, ping master, and maybe look up in master for pending services
+    {
+      PRINT_VDEBUG("cRosNodeDoEventsLoop() : It is ime to wake up the Master XML RPC process. Current time: %lu Wake up time: %lu\n", cur_time, n->xmlrpc_master_wake_up_time);
+      if(rosproc->state == XMLRPC_PROCESS_STATE_IDLE)
+      {
+        // Prepare to ping roscore ...
+        PRINT_VDEBUG("cRosNodeDoEventsLoop() : Sending ping to ROS Master\n");
+
+        RosApiCall *call = newRosApiCall();
+        if (call != NULL)
+        {
+          call->method = CROS_API_GET_PID;
+          int rc = xmlrpcParamVectorPushBackString(&call->params, n->name);
+          if(rc >= 0)
+          {
+            rosproc->message_type = XMLRPC_MESSAGE_REQUEST;
+            generateXmlrpcMessage( n->roscore_host, n->roscore_port, rosproc->message_type,
+                                  getMethodName(call->method), &call->params, &rosproc->message );
+
+            rosproc->current_call = call;
+            xmlrpcProcessChangeState(rosproc, XMLRPC_PROCESS_STATE_CONNECTING );
+          }
+          else
+          {
+            PRINT_ERROR ( "cRosNodeDoEventsLoop() : Can't allocate memory\n");
+            ret_err=CROS_MEM_ALLOC_ERR;
+          }
+
+          // The ROS master does not warn us when a new service is registered, so we have to
+          // continuously check for the required service
+          for(i = 0; i < CN_MAX_RPCROS_CLIENT_CONNECTIONS; i++ )
+          {
+             TcprosProcess *client_proc = &(n->rpcros_client_proc[i]);
+             if( client_proc->state == TCPROS_PROCESS_STATE_WAIT_FOR_CONNECTING)
+             {
+               tcprosProcessChangeState(client_proc, TCPROS_PROCESS_STATE_IDLE);
+               enqueueServiceLookup(n, client_proc->service_idx);
+             }
+          }
+          n->xmlrpc_master_wake_up_time = cur_time + CN_PING_LOOP_PERIOD; // The process completed doing what it should, so wake up again CN_PING_LOOP_PERIOD milliseconds later
+        }
+        else
+        {
+          PRINT_ERROR ( "cRosNodeDoEventsLoop() : Can't allocate memory\n");
+          ret_err=CROS_MEM_ALLOC_ERR;
+        }
+      }
+      else
+        n->xmlrpc_master_wake_up_time = cur_time + CN_PING_LOOP_PERIOD/50; // The process is busy, so try to wake up again soon (CN_PING_LOOP_PERIOD/50 milliseconds later) to do what is pending
+    }
+    if( rosproc->state != XMLRPC_PROCESS_STATE_IDLE && cRosClockGetTime(&n->clock) - rosproc->last_change_time > CN_IO_TIMEOUT ) // last_change_time is updated when changing process state
+    {
+      // Timeout between I/O operations... close the socket and re-advertise
+      PRINT_VDEBUG ( "cRosNodeDoEventsLoop() : XMLRPC client I/O timeout\n");
+      handleXmlrpcClientError( n, 0 );
+    }
+
+
+    for( i = 0; i < CN_MAX_RPCROS_CLIENT_CONNECTIONS && ret_err==CROS_SUCCESS_ERR_PACK; i++ )
+    {
+      if( (n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_READING_HEADER || // Add more states to the condition???
+                n->rpcros_client_proc[i].state == TCPROS_PROCESS_STATE_WRITING ) &&
+               cur_time - n->rpcros_client_proc[i].last_change_time > CN_IO_TIMEOUT )
+      {
+        // Timeout between I/O operations
+        PRINT_VDEBUG ( "cRosNodeDoEventsLoop() : TCPROS server I/O timeout\n");
+        handleTcprosServerError( n, i );
+      }
+    }
+  }
+  else
+  {
+    PRINT_VDEBUG ( "cRosNodeDoEventsLoop() : tcpIpSocketSelect() finished with num. fd set: %i (timeout parameter was: %llu ms)\n", n_set, (long long unsigned)select_timeout);
+
+    /* The TCPROS connections of high-priority topics are served first, then the other processes
+       and finally the remaining TCPROS connections in priority order */
+    n_client_order = orderTcprosProcsByPriority( n, 0, 0, 1, CN_MAX_TCPROS_CLIENT_CONNECTIONS, client_order, &n_high_clients );
+    n_server_order = orderTcprosProcsByPriority( n, 1, 0, n->n_io_shards, CN_MAX_TCPROS_SERVER_CONNECTIONS, server_order, &n_high_servers ); // Servers of other I/O shards are served by their own loop
+    for( k = 0; k < n_high_clients; k++ )
+    {
+      new_errors = dispatchTcprosClientSocket( n, client_order[k], &r_fds, &w_fds, &err_fds );
+      ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+    }
+    for( k = 0; k < n_high_servers; k++ )
+    {
+      new_errors = dispatchTcprosServerSocket( n, server_order[k], &r_fds, &w_fds, &err_fds );
+      ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+    }
+    if( n_high_servers > 0 ) // Send their frames before serving the other processes
+    {
+      new_errors = flushTcprosServerSends( n, 0, n->io_uring );
+      ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+    }
+
+    for(i = 0; i < CN_MAX_XMLRPC_CLIENT_CONNECTIONS; i++ )
+    {
+      XmlrpcProcess *client_proc;
+      int xmlrpc_client_fd;
+
       client_proc = &n->xmlrpc_client_proc[i];
       xmlrpc_client_fd = tcpIpSocketGetFD( &client_proc->socket );
       if( client_proc->state != XMLRPC_PROCESS_STATE_IDLE && FD_ISSET(xmlrpc_client_fd, &err_fds) )
       {
-        PRINT_ERROR ( "cRosNodeDoEventsLoop() : XMLRPC client socket error\n" );
-        handleXmlrpcClientError( n, i );
+        PRINT_ERROR ( "cRosNodeDoEventsLoop() : XMLRPC client socket error\n" );
+        handleXmlrpcClientError( n, i );
+      }
+      /* Check what is the socket unblocked by tcpIpSocketSelect(), and start the requested operations */
+      else if( ( client_proc->state == XMLRPC_PROCESS_STATE_CONNECTING && FD_ISSET(xmlrpc_client_fd, &w_fds) ) ||
+          ( client_proc->state == XMLRPC_PROCESS_STATE_WRITING && FD_ISSET(xmlrpc_client_fd, &w_fds) ) ||
+          ( client_proc->state == XMLRPC_PROCESS_STATE_READING && FD_ISSET(xmlrpc_client_fd, &r_fds) ) )
+      {
+        new_errors = doWithXmlrpcClientSocket( n, i );;
+        ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+      }
+    }
+
+    if ( next_xmlrpc_server_i >= 0 && xmlrpc_listner_fd != -1) // Check that there is an available free (idle) xmlrpx process and that the listener socket is still open
+    {
+      if( FD_ISSET( xmlrpc_listner_fd, &err_fds) )
+      {
+        PRINT_ERROR ( "cRosNodeDoEventsLoop() : XMLRPC server listener-socket error\n" );
+      }
+      else if( FD_ISSET( xmlrpc_listner_fd, &r_fds) )
+      {
+        PRINT_VDEBUG ( "cRosNodeDoEventsLoop() : XMLRPC server listener-socket ready\n" );
+        if( tcpIpSocketAccept( &(n->xmlrpc_listner_proc.socket),
+            &(n->xmlrpc_server_proc[next_xmlrpc_server_i].socket) ) == TCPIPSOCKET_DONE &&
+            tcpIpSocketSetReuse( &(n->xmlrpc_server_proc[next_xmlrpc_server_i].socket) ) &&
+            tcpIpSocketSetNonBlocking( &(n->xmlrpc_server_proc[next_xmlrpc_server_i].socket ) ) )
+
+          xmlrpcProcessChangeState( &(n->xmlrpc_server_proc[next_xmlrpc_server_i]), XMLRPC_PROCESS_STATE_READING );
+      }
+    }
+
+    for( i = 0; i < CN_MAX_XMLRPC_SERVER_CONNECTIONS; i++ )
+    {
+      XmlrpcProcess *server_proc;
+      int server_fd;
+
+      server_proc = &n->xmlrpc_server_proc[i];
+      server_fd = tcpIpSocketGetFD( &server_proc->socket );
+      if( server_proc->state != XMLRPC_PROCESS_STATE_IDLE && FD_ISSET(server_fd, &err_fds) )
+      {
+        PRINT_ERROR ( "cRosNodeDoEventsLoop() : XMLRPC server socket error\n" );
+        tcpIpSocketClose( &(n->xmlrpc_server_proc[i].socket) );
+        xmlrpcProcessChangeState( &(n->xmlrpc_server_proc[next_xmlrpc_server_i]), XMLRPC_PROCESS_STATE_IDLE ); // maybe server_proc instead of &(n->xmlrpc_server_proc[next_xmlrpc_server_i]) ???
+      }
+      else if( ( server_proc->state == XMLRPC_PROCESS_STATE_WRITING && FD_ISSET(server_fd, &w_fds) ) ||
+               ( server_proc->state == XMLRPC_PROCESS_STATE_READING && FD_ISSET(server_fd, &r_fds) ) )
+      {
+        new_errors = doWithXmlrpcServerSocket( n, i );
+        ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+      }
+    }
+
+    for( k = n_high_clients; k < n_client_order; k++ ) // The high-priority ones have been already served
+    {
+      new_errors = dispatchTcprosClientSocket( n, client_order[k], &r_fds, &w_fds, &err_fds );
+      ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+    }
+
+    if ( tcpros_listner_fd != -1 && (next_tcpros_server_i >= 0 || n->n_io_shards > 1) )
+    {
+      if( FD_ISSET( tcpros_listner_fd, &err_fds) )
+      {
+        PRINT_ERROR ( "cRosNodeDoEventsLoop() : TCPROS listener-socket error\n" );
+      }
+      else if( FD_ISSET( tcpros_listner_fd, &r_fds) && next_tcpros_server_i < 0 )
+      {
+        rejectTcprosConnection( &(n->tcpros_listner_proc.socket) );
+      }
+      else if( FD_ISSET( tcpros_listner_fd, &r_fds) )
+      {
+        PRINT_VDEBUG ( "cRosNodeDoEventsLoop() : TCPROS listener ready\n" );
+        if( tcpIpSocketAccept( &(n->tcpros_listner_proc.socket),
+            &(n->tcpros_server_proc[next_tcpros_server_i].socket) ) == TCPIPSOCKET_DONE &&
+            tcpIpSocketSetReuse( &(n->tcpros_server_proc[next_tcpros_server_i].socket) ) &&
+            tcpIpSocketSetNonBlocking( &(n->tcpros_server_proc[next_tcpros_server_i].socket ) ) &&
+            tcpIpSocketSetKeepAlive( &(n->tcpros_server_proc[next_tcpros_server_i].socket ), 60, 10, 9 ) )
+        {
+          tcprosProcessChangeState( &(n->tcpros_server_proc[next_tcpros_server_i]), TCPROS_PROCESS_STATE_READING_HEADER ); // A TCPROS process has been activated to attend the connection
+          next_tcpros_server_i = -1; // The free process has been used: the data listener must wait for the next loop pass
+        }
+      }
+    }
+
+    if ( next_tcpros_server_i >= 0 && tcpros_data_listner_fd != -1)
+    {
+      if( FD_ISSET( tcpros_data_listner_fd, &err_fds) )
+      {
+        PRINT_ERROR ( "cRosNodeDoEventsLoop() : TCPROS data listener-socket error\n" );
+      }
+      else if( FD_ISSET( tcpros_data_listner_fd, &r_fds) )
+      {
+        PRINT_VDEBUG ( "cRosNodeDoEventsLoop() : TCPROS data listener ready\n" );
+        if( tcpIpSocketAccept( &(n->tcpros_data_listner_proc.socket),
+            &(n->tcpros_server_proc[next_tcpros_server_i].socket) ) == TCPIPSOCKET_DONE &&
+            tcpIpSocketSetReuse( &(n->tcpros_server_proc[next_tcpros_server_i].socket) ) &&
+            tcpIpSocketSetNonBlocking( &(n->tcpros_server_proc[next_tcpros_server_i].socket ) ) &&
+            tcpIpSocketSetKeepAlive( &(n->tcpros_server_proc[next_tcpros_server_i].socket ), 60, 10, 9 ) )
+        {
+          tcprosProcessChangeState( &(n->tcpros_server_proc[next_tcpros_server_i]), TCPROS_PROCESS_STATE_READING_HEADER );
+        }
+      }
+    }
+
+    for( k = n_high_servers; k < n_server_order; k++ ) // The high-priority ones have been already served
+    {
+      new_errors = dispatchTcprosServerSocket( n, server_order[k], &r_fds, &w_fds, &err_fds );
+      ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+    }
+    new_errors = flushTcprosServerSends( n, 0, n->io_uring );
+    ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+
+    for(i = 0; i < CN_MAX_RPCROS_CLIENT_CONNECTIONS; i++ )
+    {
+      TcprosProcess *client_proc = &(n->rpcros_client_proc[i]);
+      int rpcros_client_fd = tcpIpSocketGetFD( &(client_proc->socket) );
+
+      if( client_proc->state != TCPROS_PROCESS_STATE_IDLE && FD_ISSET(rpcros_client_fd, &err_fds) )
+      {
+        PRINT_ERROR ( "cRosNodeDoEventsLoop() : RPCROS client socket error\n" );
+        handleRpcrosClientError( n, i );
+      }
+
+      if( ( client_proc->state == TCPROS_PROCESS_STATE_CONNECTING && FD_ISSET(rpcros_client_fd, &w_fds) ) ||
+          ( client_proc->state == TCPROS_PROCESS_STATE_WRITING_HEADER && FD_ISSET(rpcros_client_fd, &w_fds) ) ||
+          ( client_proc->state == TCPROS_PROCESS_STATE_READING_SIZE && FD_ISSET(rpcros_client_fd, &r_fds) ) ||
+          ( client_proc->state == TCPROS_PROCESS_STATE_READING && FD_ISSET(rpcros_client_fd, &r_fds) ) ||
+          ( client_proc->state == TCPROS_PROCESS_STATE_READING_HEADER_SIZE && FD_ISSET(rpcros_client_fd, &r_fds) ) ||
+          ( client_proc->state == TCPROS_PROCESS_STATE_READING_HEADER && FD_ISSET(rpcros_client_fd, &r_fds) ) ||
+          ( client_proc->state == TCPROS_PROCESS_STATE_START_WRITING && FD_ISSET(rpcros_client_fd, &w_fds) ) ||
+          ( client_proc->state == TCPROS_PROCESS_STATE_WRITING && FD_ISSET(rpcros_client_fd, &w_fds) ) )
+      {
+        new_errors = doWithRpcrosClientSocket( n, i );
+        ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+      }
+    }
+
+    if ( next_rpcros_server_i >= 0 && rpcros_listner_fd != -1)
+    {
+      if( FD_ISSET( rpcros_listner_fd, &err_fds) )
+      {
+        PRINT_ERROR ( "cRosNodeDoEventsLoop() : TCPROS listener-socket error\n" );
+      }
+      else if( next_rpcros_server_i >= 0 && FD_ISSET( rpcros_listner_fd, &r_fds) )
+      {
+        PRINT_VDEBUG ( "cRosNodeDoEventsLoop() : TCPROS listener ready\n" );
+        if( tcpIpSocketAccept( &(n->rpcros_listner_proc.socket),
+            &(n->rpcros_server_proc[next_rpcros_server_i].socket) ) == TCPIPSOCKET_DONE &&
+            tcpIpSocketSetReuse( &(n->rpcros_server_proc[next_rpcros_server_i].socket) ) &&
+            tcpIpSocketSetNonBlocking( &(n->rpcros_server_proc[next_rpcros_server_i].socket ) ) &&
+            tcpIpSocketSetKeepAlive( &(n->rpcros_server_proc[next_rpcros_server_i].socket ), 60, 10, 9 ) )
+        {
+          tcprosProcessChangeState( &(n->rpcros_server_proc[next_rpcros_server_i]), TCPROS_PROCESS_STATE_READING_HEADER_SIZE );
+        }
+      }
+    }
+
+    for( i = 0; i < CN_MAX_RPCROS_SERVER_CONNECTIONS; i++ )
+    {
+      TcprosProcess *server_proc = &(n->rpcros_server_proc[i]);
+      int server_fd = tcpIpSocketGetFD( &(server_proc->socket) );
+
+      if( server_proc->state != TCPROS_PROCESS_STATE_IDLE && FD_ISSET(server_fd, &err_fds) )
+      {
+        PRINT_ERROR ( "cRosNodeDoEventsLoop() : TCPROS server socket error\n" );
+        tcpIpSocketClose( &(server_proc->socket) );
+        tcprosProcessChangeState( &(n->rpcros_server_proc[next_rpcros_server_i]), TCPROS_PROCESS_STATE_IDLE );
+      }
+      else if( ( server_proc->state == TCPROS_PROCESS_STATE_READING_HEADER_SIZE && FD_ISSET(server_fd, &r_fds) ) ||
+        ( server_proc->state == TCPROS_PROCESS_STATE_READING_HEADER && FD_ISSET(server_fd, &r_fds) ) ||
+        ( server_proc->state == TCPROS_PROCESS_STATE_READING_SIZE && FD_ISSET(server_fd, &r_fds) ) ||
+        ( server_proc->state == TCPROS_PROCESS_STATE_READING && FD_ISSET(server_fd, &r_fds) ) ||
+        ( server_proc->state == TCPROS_PROCESS_STATE_WRITING_HEADER && FD_ISSET(server_fd, &w_fds) ) ||
+        ( server_proc->state == TCPROS_PROCESS_STATE_WRITING && FD_ISSET(server_fd, &w_fds) ) )
+      {
+        new_errors = doWithRpcrosServerSocket( n, i );
+        ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+      }
+    }
+  }
+
+  // Checked in every pass: a busy loop (select() never timing out) must also evict the stalled subscribers
+  checkTcprosServerIoTimeouts( n, 0, cRosClockGetTime(&n->clock) );
+
+  callSubscriberCallbacks( n );
+  return ret_err;
+}
+
+cRosErrCodePack cRosNodeStart( CrosNode *n, unsigned long time_out, unsigned char *exit_flag )
+{
+  uint64_t start_time, elapsed_time;
+  cRosErrCodePack ret_err;
+  PRINT_VVDEBUG ( "cRosNodeStart ()\n" );
+
+  start_time = cRosClockGetTime(&n->clock);
+  ret_err = CROS_SUCCESS_ERR_PACK;
+  while(ret_err == CROS_SUCCESS_ERR_PACK && (exit_flag==NULL || !(*exit_flag)) && (time_out == CROS_INFINITE_TIMEOUT || (elapsed_time=cRosClockGetTime(&n->clock)-start_time) <= time_out))
+    ret_err = cRosNodeDoEventsLoop( n, (time_out == CROS_INFINITE_TIMEOUT)? UINT64_MAX : time_out-elapsed_time);
+
+  return ret_err;
+}
+
+static int reopenTcprosListnerSocket( CrosNode *n, int reuse_port )
+{
+  int ret;
+  TcpIpSocket new_socket;
+  TcpIpSocket *listner_socket = &(n->tcpros_listner_proc.socket);
+
+  // The new socket is fully configured before closing the current listener, so that the port is only unbound during the bind
+  // call. The port is kept, since it may have been already advertised
+  tcpIpSocketInit( &new_socket );
+  if( !tcpIpSocketOpen( &new_socket ) ||
+      !tcpIpSocketSetReuse( &new_socket ) ||
+      (reuse_port && !tcpIpSocketSetReusePort( &new_socket )) ||
+      !tcpIpSocketSetNonBlocking( &new_socket ) )
+  {
+    PRINT_ERROR("reopenTcprosListnerSocket() : The new listener socket could not be configured: the current one is kept\n");
+    tcpIpSocketClose( &new_socket );
+    return(-1);
+  }
+
+  // A socket without SO_REUSEPORT cannot share the port, so the current listener must be closed before the new one is bound
+  tcpIpSocketClose( listner_socket );
+  if( !tcpIpSocketBindListen( &new_socket, n->host, n->tcpros_port, CN_MAX_TCPROS_SERVER_CONNECTIONS ) )
+  {
+    PRINT_ERROR("reopenTcprosListnerSocket() : The listener socket could not be bound again to port %d\n", n->tcpros_port);
+    tcpIpSocketClose( &new_socket );
+    ret=-1;
+  }
+  else
+  {
+    *listner_socket = new_socket;
+    ret=0;
+  }
+
+  return(ret);
+}
+
+cRosErrCodePack cRosNodeSetIoShards( CrosNode *n, int n_shards )
+{
+  cRosErrCodePack ret_err;
+  int i, fn_ret, prev_n_shards;
+  PRINT_VVDEBUG ( "cRosNodeSetIoShards ()\n" );
+
+  if( n == NULL || n_shards < 1 || n_shards > CN_MAX_IO_SHARDS )
+    return CROS_BAD_PARAM_ERR;
+
+  for( i = 0; i < CN_MAX_TCPROS_SERVER_CONNECTIONS; i++ )
+  {
+    if( n->tcpros_server_proc[i].state != TCPROS_PROCESS_STATE_IDLE )
+    {
+      PRINT_ERROR ( "cRosNodeSetIoShards() : The I/O shards cannot be changed while there are TCPROS connections\n" );
+      return CROS_BAD_PARAM_ERR;
+    }
+  }
+
+  prev_n_shards = n->n_io_shards;
+  for( i = 1; i < prev_n_shards; i++ )
+    closeIoShard( n, i );
+  n->n_io_shards = 1;
+
+  ret_err = CROS_SUCCESS_ERR_PACK;
+  if( n_shards > 1 )
+  {
+    // The main listener must be also bound with SO_REUSEPORT in order to share the port with the shard listeners
+    fn_ret = (prev_n_shards > 1)? 0 : reopenTcprosListnerSocket( n, 1 );
+    for( i = 1; i < n_shards && fn_ret == 0; i++ )
+    {
+      fn_ret = openTcprosShardListnerSocket( n, i );
+      if( fn_ret != 0 )
+        closeIoShard( n, i );
+    }
+
+    if( fn_ret == 0 && openMainWakeUpPipe( n ) != 0 ) // The shards wake up the main loop to call the subscriber callbacks
+      fn_ret = -1;
+    if( fn_ret == 0 )
+      n->n_io_shards = n_shards;
+    else
+    {
+      for( i--; i >= 1; i-- )
+        closeIoShard( n, i );
+      ret_err = CROS_IO_SHARD_OPEN_ERR;
+      if( reopenTcprosListnerSocket( n, 0 ) != 0 )
+        ret_err = cRosAddErrCodeIfErr( ret_err, CROS_TCPROS_LISTENER_OPEN_ERR );
+    }
+  }
+  else if( prev_n_shards > 1 )
+  {
+    // The port is no longer shared: bind the main listener without SO_REUSEPORT again
+    if( reopenTcprosListnerSocket( n, 0 ) != 0 )
+      ret_err = CROS_TCPROS_LISTENER_OPEN_ERR;
+  }
+
+  return ret_err;
+}
+
+cRosErrCodePack cRosNodeSetParallelSerialization( CrosNode *n, int n_threads, size_t min_size )
+{
+  PRINT_VVDEBUG ( "cRosNodeSetParallelSerialization ()\n" );
+
+  if( n == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  if( !cRosMessageParallelismSet( &n->serialization_parallelism, n_threads, min_size ) )
+  {
+    PRINT_ERROR ( "cRosNodeSetParallelSerialization() : The worker threads could not be started\n" );
+    return CROS_SER_THREADS_ERR;
+  }
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosErrCodePack cRosNodeDoShardEventsLoop( CrosNode *n, int shard_idx, uint64_t max_timeout )
+{
+  cRosErrCodePack ret_err, new_errors;
+  CrosIoShard *shard;
+  TcprosProcessState proc_states[CN_MAX_TCPROS_SERVER_CONNECTIONS];
+  fd_set r_fds, w_fds, err_fds;
+  int nfds = -1, i, k, n_set;
+  int server_order[CN_MAX_TCPROS_SERVER_CONNECTIONS], n_server_order, n_high_servers;
+  int tcpros_listner_fd, next_tcpros_server_i;
+  uint64_t cur_time, select_timeout, shaping_timeout;
+  PRINT_VVDEBUG ( "cRosNodeDoShardEventsLoop ()\n" );
+
+  if( n == NULL || shard_idx < 1 || shard_idx >= n->n_io_shards )
+    return CROS_BAD_PARAM_ERR;
+
+  shard = &n->io_shards[shard_idx-1];
+  ret_err = CROS_SUCCESS_ERR_PACK;
+  cur_time = cRosClockGetTime(&n->clock);
+  shaping_timeout = UINT64_MAX;
+
+  FD_ZERO( &r_fds );
+  FD_ZERO( &w_fds );
+  FD_ZERO( &err_fds );
+
+  // The main loop writes in this pipe when a publication has been triggered for a process of this shard
+  FD_SET( shard->wake_up_fd[0], &r_fds);
+  if( shard->wake_up_fd[0] > nfds ) nfds = shard->wake_up_fd[0];
+
+  // Wake up periodically at least to check the I/O timeouts
+  select_timeout = (max_timeout < CN_IO_TIMEOUT)? max_timeout : CN_IO_TIMEOUT;
+
+  // The main loop may change the process state (to start writing), so take a snapshot of them
+  cRosMutexLock( &n->io_shard_lock );
+  for( i = shard_idx; i < CN_MAX_TCPROS_SERVER_CONNECTIONS; i += n->n_io_shards )
+  {
+    proc_states[i] = n->tcpros_server_proc[i].state;
+    if( tcprosServerIoTimeoutWait( n, i, cur_time ) < select_timeout ) // Wake up to evict a connection whose I/O has stalled
+      select_timeout = tcprosServerIoTimeoutWait( n, i, cur_time );
+  }
+  cRosMutexUnlock( &n->io_shard_lock );
+
+  /* Add to the tcpIpSocketSelect() the active TCPROS servers of this shard */
+  next_tcpros_server_i = -1;
+  for( i = shard_idx; i < CN_MAX_TCPROS_SERVER_CONNECTIONS; i += n->n_io_shards )
+  {
+    int server_fd = tcpIpSocketGetFD( &(n->tcpros_server_proc[i].socket) );
+
+    if( next_tcpros_server_i < 0 && proc_states[i] == TCPROS_PROCESS_STATE_IDLE )
+    {
+      next_tcpros_server_i = i;
+    }
+    else if( proc_states[i] == TCPROS_PROCESS_STATE_READING_HEADER )
+    {
+      FD_SET( server_fd, &r_fds);
+      FD_SET( server_fd, &err_fds);
+      if( server_fd > nfds ) nfds = server_fd;
+    }
+    else if( proc_states[i] == TCPROS_PROCESS_STATE_WRITING && tcprosServerWaitsForZeroCopy( &n->tcpros_server_proc[i] ) )
+    {
+      FD_SET( server_fd, &r_fds); // The zero-copy completion notifications (socket error queue) are reported as readability
+      FD_SET( server_fd, &err_fds);
+      if( server_fd > nfds ) nfds = server_fd;
+    }
+    else if( ( proc_states[i] == TCPROS_PROCESS_STATE_START_WRITING && tcprosServerShapingAllowsWriting( n, i, cur_time ) ) ||
+             proc_states[i] == TCPROS_PROCESS_STATE_WRITING )
+    {
+      tcpIpUringAttachSocket( shard->io_uring, &(n->tcpros_server_proc[i].socket), TCPIP_URING_OP_SEND_FRAMES );
+      FD_SET( server_fd, &w_fds);
+      FD_SET( server_fd, &err_fds);
+      if( server_fd > nfds ) nfds = server_fd;
+    }
+    else if( proc_states[i] == TCPROS_PROCESS_STATE_WAIT_FOR_WRITING ||
+             proc_states[i] == TCPROS_PROCESS_STATE_START_WRITING ) // Waiting for the next message or for the rate limit
+    {
+      FD_SET( server_fd, &err_fds);
+      if( server_fd > nfds ) nfds = server_fd;
+      if( proc_states[i] == TCPROS_PROCESS_STATE_START_WRITING && cRosTokenBucketWaitTime( &(n->tcpros_server_proc[i].shaper), cur_time ) < shaping_timeout )
+        shaping_timeout = cRosTokenBucketWaitTime( &(n->tcpros_server_proc[i].shaper), cur_time );
+    }
+  }
+
+  /* Add to the tcpIpSocketSelect() the shard listener socket even if no TCPROS server of this shard is available, since
+     the kernel keeps routing connections to it: they are rejected so that the subscriber retries */
+  tcpros_listner_fd = tcpIpSocketGetFD( &(shard->tcpros_listner_proc.socket) );
+  if( tcpros_listner_fd != -1 )
+  {
+    tcpIpUringAttachSocket( shard->io_uring, &(shard->tcpros_listner_proc.socket), TCPIP_URING_OP_ACCEPT );
+    FD_SET( tcpros_listner_fd, &r_fds);
+    FD_SET( tcpros_listner_fd, &err_fds);
+    if( tcpros_listner_fd > nfds ) nfds = tcpros_listner_fd;
+  }
+
+  if( shaping_timeout < select_timeout ) // Wake up when the rate limit of a deferred connection allows it to write
+    select_timeout = shaping_timeout;
+
+  n_set = tcpIpUringSelect(n->io_shards[shard_idx-1].io_uring, nfds + 1, &r_fds, &w_fds, &err_fds, select_timeout);
+
+  cur_time = cRosClockGetTime(&n->clock);
+  if (n_set == -1)
+  {
+    PRINT_ERROR("cRosNodeDoShardEventsLoop() : tcpIpSocketSelect() function failed.\n");
+    ret_err = CROS_SELECT_FD_ERR;
+  }
+  else if( n_set > 0 )
+  {
+#ifndef _WIN32
+    if( FD_ISSET( shard->wake_up_fd[0], &r_fds) )
+    {
+      char wake_up_bytes[16];
+      while( read( shard->wake_up_fd[0], wake_up_bytes, sizeof(wake_up_bytes) ) > 0 ); // Empty the pipe
+    }
+#endif
+
+    if ( tcpros_listner_fd != -1 )
+    {
+      if( FD_ISSET( tcpros_listner_fd, &err_fds) )
+      {
+        PRINT_ERROR ( "cRosNodeDoShardEventsLoop() : TCPROS listener-socket error\n" );
       }
-      /* Check what is the socket unblocked by tcpIpSocketSelect(), and start the requested operations */
-      else if( ( client_proc->state == XMLRPC_PROCESS_STATE_CONNECTING && FD_ISSET(xmlrpc_client_fd, &w_fds) ) ||
-          ( client_proc->state == XMLRPC_PROCESS_STATE_WRITING && FD_ISSET(xmlrpc_client_fd, &w_fds) ) ||
-          ( client_proc->state == XMLRPC_PROCESS_STATE_READING && FD_ISSET(xmlrpc_client_fd, &r_fds) ) )
+      else if( FD_ISSET( tcpros_listner_fd, &r_fds) && next_tcpros_server_i < 0 )
       {
-        new_errors = doWithXmlrpcClientSocket( n, i );;
+        rejectTcprosConnection( &(shard->tcpros_listner_proc.socket) );
+      }
+      else if( FD_ISSET( tcpros_listner_fd, &r_fds) )
+      {
+        PRINT_VDEBUG ( "cRosNodeDoShardEventsLoop() : TCPROS listener of shard %d ready\n", shard_idx );
+        if( tcpIpSocketAccept( &(shard->tcpros_listner_proc.socket),
+            &(n->tcpros_server_proc[next_tcpros_server_i].socket) ) == TCPIPSOCKET_DONE &&
+            tcpIpSocketSetReuse( &(n->tcpros_server_proc[next_tcpros_server_i].socket) ) &&
+            tcpIpSocketSetNonBlocking( &(n->tcpros_server_proc[next_tcpros_server_i].socket ) ) &&
+            tcpIpSocketSetKeepAlive( &(n->tcpros_server_proc[next_tcpros_server_i].socket ), 60, 10, 9 ) )
+        {
+          tcprosProcessChangeState( &(n->tcpros_server_proc[next_tcpros_server_i]), TCPROS_PROCESS_STATE_READING_HEADER );
+        }
+      }
+    }
+
+    n_server_order = orderTcprosProcsByPriority( n, 1, shard_idx, n->n_io_shards, CN_MAX_TCPROS_SERVER_CONNECTIONS, server_order, &n_high_servers );
+    for( k = 0; k < n_server_order; k++ ) // Serve the connections in priority order
+    {
+      i = server_order[k];
+      TcprosProcess *server_proc = &n->tcpros_server_proc[i];
+      int server_fd = tcpIpSocketGetFD( &server_proc->socket );
+
+      if( proc_states[i] != TCPROS_PROCESS_STATE_IDLE && FD_ISSET(server_fd, &err_fds) )
+      {
+        PRINT_ERROR ( "cRosNodeDoShardEventsLoop() : TCPROS server socket error\n" );
+        handleTcprosServerError( n, i );
+      }
+      else if( ( proc_states[i] == TCPROS_PROCESS_STATE_READING_HEADER && FD_ISSET(server_fd, &r_fds) ) ||
+        ( proc_states[i] == TCPROS_PROCESS_STATE_START_WRITING && FD_ISSET(server_fd, &w_fds) ) ||
+        ( proc_states[i] == TCPROS_PROCESS_STATE_WRITING && FD_ISSET(server_fd, &w_fds) ) ||
+        ( proc_states[i] == TCPROS_PROCESS_STATE_WRITING && tcprosServerWaitsForZeroCopy( server_proc ) && FD_ISSET(server_fd, &r_fds) ) )
+      {
+        new_errors = doWithTcprosServerSocket( n, i );
         ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
       }
     }
+    new_errors = flushTcprosServerSends( n, shard_idx, shard->io_uring );
+    ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
+  }
+
+  checkTcprosServerIoTimeouts( n, shard_idx, cur_time );
+
+  return ret_err;
+}
+
+cRosErrCodePack cRosNodeStartShard( CrosNode *n, int shard_idx, unsigned long time_out, unsigned char *exit_flag )
+{
+  uint64_t start_time, elapsed_time;
+  cRosErrCodePack ret_err;
+  PRINT_VVDEBUG ( "cRosNodeStartShard ()\n" );
+
+  start_time = cRosClockGetTime(&n->clock);
+  ret_err = CROS_SUCCESS_ERR_PACK;
+  while(ret_err == CROS_SUCCESS_ERR_PACK && (exit_flag==NULL || !(*exit_flag)) && (time_out == CROS_INFINITE_TIMEOUT || (elapsed_time=cRosClockGetTime(&n->clock)-start_time) <= time_out))
+    ret_err = cRosNodeDoShardEventsLoop( n, shard_idx, (time_out == CROS_INFINITE_TIMEOUT)? UINT64_MAX : time_out-elapsed_time);
+
+  return ret_err;
+}
+
+cRosErrCodePack cRosNodeSetPublisherPriority( CrosNode *n, int pubidx, CrosTopicPriority priority )
+{
+  PublisherNode *pub;
+  int list_elem;
+  PRINT_VVDEBUG ( "cRosNodeSetPublisherPriority ()\n" );
+
+  if( n == NULL || pubidx < 0 || pubidx >= CN_MAX_PUBLISHED_TOPICS || n->pubs[pubidx].topic_name == NULL ||
+      priority < CROS_TOPIC_PRIORITY_BULK || priority > CROS_TOPIC_PRIORITY_HIGH )
+    return CROS_BAD_PARAM_ERR;
+
+  pub = &n->pubs[pubidx];
+  cRosMutexLock( &n->io_shard_lock ); // The publisher list may be accessed from I/O shards
+  pub->priority = priority;
+  // Tag the sockets of the subscribers that are already connected
+  for( list_elem = 0; pub->tcpros_id_list[list_elem] != -1; list_elem++ )
+    setTcprosSocketPriority( &(n->tcpros_server_proc[pub->tcpros_id_list[list_elem]].socket), priority );
+  cRosMutexUnlock( &n->io_shard_lock );
+
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosErrCodePack cRosNodeSetSubscriberPriority( CrosNode *n, int subidx, CrosTopicPriority priority )
+{
+  int clientidx;
+  PRINT_VVDEBUG ( "cRosNodeSetSubscriberPriority ()\n" );
+
+  if( n == NULL || subidx < 0 || subidx >= CN_MAX_SUBSCRIBED_TOPICS || n->subs[subidx].topic_name == NULL ||
+      priority < CROS_TOPIC_PRIORITY_BULK || priority > CROS_TOPIC_PRIORITY_HIGH )
+    return CROS_BAD_PARAM_ERR;
+
+  n->subs[subidx].priority = priority;
+  // Tag the sockets of the publishers that are already connected
+  for( clientidx = 0; clientidx < CN_MAX_TCPROS_CLIENT_CONNECTIONS; clientidx++ )
+  {
+    TcprosProcess *client_proc = &n->tcpros_client_proc[clientidx];
+    if( client_proc->topic_idx == subidx && client_proc->socket.connected )
+      setTcprosSocketPriority( &(client_proc->socket), priority );
+  }
+
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosErrCodePack cRosNodeSetSubscriberRxTimestamps( CrosNode *n, int subidx, int enable )
+{
+  cRosErrCodePack ret_err;
+  int clientidx;
+  PRINT_VVDEBUG ( "cRosNodeSetSubscriberRxTimestamps ()\n" );
+
+  if( n == NULL || subidx < 0 || subidx >= CN_MAX_SUBSCRIBED_TOPICS || n->subs[subidx].topic_name == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  ret_err = CROS_SUCCESS_ERR_PACK;
+  n->subs[subidx].rx_timestamps = (enable)? 1: 0;
+  n->subs[subidx].msg_rx_time_stamp = 0;
+  n->subs[subidx].msg_dequeue_time_stamp = 0;
+  // Configure the sockets of the publishers that are already connected
+  for( clientidx = 0; clientidx < CN_MAX_TCPROS_CLIENT_CONNECTIONS; clientidx++ )
+  {
+    TcprosProcess *client_proc = &n->tcpros_client_proc[clientidx];
+    if( client_proc->topic_idx == subidx && client_proc->socket.connected )
+    {
+      if( !tcpIpSocketSetRxTimestamps( &(client_proc->socket), enable ) )
+        ret_err = CROS_RX_TIMESTAMP_ERR;
+      client_proc->frame_rx_time_stamp = 0;
+    }
+  }
+
+  return ret_err;
+}
+
+cRosErrCodePack cRosNodeSetSubscriberStatistics( CrosNode *n, int subidx, uint32_t window )
+{
+  cRosErrCodePack ret_err;
+  uint64_t cur_time;
+  int clientidx;
+  PRINT_VVDEBUG ( "cRosNodeSetSubscriberStatistics ()\n" );
+
+  if( n == NULL || subidx < 0 || subidx >= CN_MAX_SUBSCRIBED_TOPICS || n->subs[subidx].topic_name == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  if( window > 0 && n->statistics_pub_idx == -1 )
+  {
+    // The messages of this topic are not periodically sent but when a window finishes (loop_period = -1)
+    ret_err = cRosApiRegisterPublisher(n, "/statistics", "rosgraph_msgs/TopicStatistics", -1, NULL, NULL, NULL, &n->statistics_pub_idx);
+    if( ret_err != CROS_SUCCESS_ERR_PACK )
+    {
+      cRosPrintErrCodePack(ret_err, "cRosNodeSetSubscriberStatistics() : Error registering the /statistics publisher");
+      n->statistics_pub_idx = -1;
+      return ret_err;
+    }
+  }
+
+  n->subs[subidx].stats_window = window;
+  // Start a new window in the publishers that are already connected
+  cur_time = cRosClockGetTime(&n->clock);
+  for( clientidx = 0; clientidx < CN_MAX_TCPROS_CLIENT_CONNECTIONS; clientidx++ )
+  {
+    TcprosProcess *client_proc = &n->tcpros_client_proc[clientidx];
+    if( client_proc->topic_idx == subidx )
+      cRosTopicStatsInit( &(client_proc->stats), cur_time );
+  }
+
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+static void freeDeadbands( cRosMessageDeadband *deadbands, int n_deadbands )
+{
+  int deadband_ind;
+
+  if(deadbands == NULL)
+    return;
+  for(deadband_ind = 0; deadband_ind < n_deadbands; deadband_ind++)
+    free((char *)deadbands[deadband_ind].field_path);
+  free(deadbands);
+}
+
+cRosErrCodePack cRosNodeSetPublisherOnChange( CrosNode *n, int pubidx, int enable, uint32_t heartbeat_period,
+                                              const cRosMessageDeadband *deadbands, int n_deadbands )
+{
+  PublisherNode *pub;
+  cRosMessageDeadband *new_deadbands = NULL;
+  int deadband_ind;
+  PRINT_VVDEBUG ( "cRosNodeSetPublisherOnChange ()\n" );
+
+  if( n == NULL || pubidx < 0 || pubidx >= CN_MAX_PUBLISHED_TOPICS || n->pubs[pubidx].topic_name == NULL ||
+      n_deadbands < 0 || (deadbands == NULL && n_deadbands > 0) )
+    return CROS_BAD_PARAM_ERR;
+
+  if( deadbands == NULL )
+    n_deadbands = 0;
+  if( n_deadbands > 0 )
+  {
+    new_deadbands = (cRosMessageDeadband *)calloc( n_deadbands, sizeof(cRosMessageDeadband) );
+    if( new_deadbands == NULL )
+      return CROS_MEM_ALLOC_ERR;
+    for( deadband_ind = 0; deadband_ind < n_deadbands; deadband_ind++ )
+    {
+      new_deadbands[deadband_ind].field_path = strdup( deadbands[deadband_ind].field_path );
+      new_deadbands[deadband_ind].deadband = deadbands[deadband_ind].deadband;
+      if( new_deadbands[deadband_ind].field_path == NULL )
+      {
+        freeDeadbands( new_deadbands, deadband_ind );
+        return CROS_MEM_ALLOC_ERR;
+      }
+    }
+  }
+
+  pub = &n->pubs[pubidx];
+  freeDeadbands( pub->deadbands, pub->n_deadbands );
+  pub->deadbands = new_deadbands;
+  pub->n_deadbands = n_deadbands;
+  pub->on_change = (enable)? 1: 0;
+  pub->heartbeat_period = heartbeat_period;
+  // The first message is always sent
+  cRosMessageFree( pub->last_sent_msg );
+  pub->last_sent_msg = NULL;
+  dynBufferClear( &pub->last_sent_frame );
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosErrCodePack cRosNodeGetPublisherUnchangedMsgs( CrosNode *n, int pubidx, unsigned long *n_unchanged )
+{
+  if( n == NULL || pubidx < 0 || pubidx >= CN_MAX_PUBLISHED_TOPICS || n->pubs[pubidx].topic_name == NULL || n_unchanged == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  *n_unchanged = n->pubs[pubidx].n_unchanged_msgs;
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosErrCodePack cRosNodeSetSubscriberFilter( CrosNode *n, int subidx, const char *filter_expr )
+{
+  SubscriberNode *sub;
+  cRosMessageFilter new_filter;
+  char *new_filter_expr = NULL;
+  cRosErrCodePack ret_err;
+  PRINT_VVDEBUG ( "cRosNodeSetSubscriberFilter ()\n" );
+
+  if( n == NULL || subidx < 0 || subidx >= CN_MAX_SUBSCRIBED_TOPICS || n->subs[subidx].topic_name == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  sub = &n->subs[subidx];
+  cRosMessageFilterInit( &new_filter );
+  if( filter_expr != NULL )
+  {
+    // The filter of a subscriber of any type is compiled when the type is known (see cRosMessageParsePublicationHeader())
+    if( !cRosNodeIsAnyTypeSubscriber( sub->context ) )
+    {
+      ret_err = cRosMessageFilterCompile( &new_filter, filter_expr, cRosNodeGetIncomingMessage( sub->context ) );
+      if( ret_err != CROS_SUCCESS_ERR_PACK )
+        return ret_err;
+    }
+    new_filter_expr = strdup( filter_expr );
+    if( new_filter_expr == NULL )
+    {
+      cRosMessageFilterRelease( &new_filter );
+      return CROS_MEM_ALLOC_ERR;
+    }
+  }
+
+  free( sub->filter_expr );
+  cRosMessageFilterRelease( &sub->filter );
+  sub->filter_expr = new_filter_expr;
+  sub->filter = new_filter;
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosErrCodePack cRosNodeGetPublisherFilteredMsgs( CrosNode *n, int pubidx, unsigned long *n_filtered )
+{
+  if( n == NULL || pubidx < 0 || pubidx >= CN_MAX_PUBLISHED_TOPICS || n->pubs[pubidx].topic_name == NULL || n_filtered == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  cRosMutexLock( &n->io_shard_lock ); // The counter is updated while the processes of the publisher are locked
+  *n_filtered = n->pubs[pubidx].n_filtered_msgs;
+  cRosMutexUnlock( &n->io_shard_lock );
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosErrCodePack cRosNodeSetDataHost( CrosNode *n, const char *data_host )
+{
+  char *new_data_host = NULL;
+  PRINT_VVDEBUG ( "cRosNodeSetDataHost ()\n" );
+
+  if( n == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  if( data_host != NULL )
+  {
+    new_data_host = strdup( data_host );
+    if( new_data_host == NULL )
+      return CROS_MEM_ALLOC_ERR;
+  }
+
+  // The accepted connections do not depend on the listener, so it can be replaced at any time
+  tcpIpSocketClose( &(n->tcpros_data_listner_proc.socket) );
+  free( n->data_host );
+  n->data_host = new_data_host;
+  n->data_tcpros_port = 0;
+
+  if( n->data_host != NULL && openTcprosDataListnerSocket( n ) != 0 )
+  {
+    free( n->data_host );
+    n->data_host = NULL;
+    return CROS_DATA_LISTENER_OPEN_ERR;
+  }
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosErrCodePack cRosNodeSetPublisherNetwork( CrosNode *n, int pubidx, CrosTopicNetwork network )
+{
+  if( n == NULL || pubidx < 0 || pubidx >= CN_MAX_PUBLISHED_TOPICS || n->pubs[pubidx].topic_name == NULL ||
+      (network != CROS_TOPIC_NETWORK_DATA && network != CROS_TOPIC_NETWORK_CONTROL) )
+    return CROS_BAD_PARAM_ERR;
+
+  n->pubs[pubidx].network = network;
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosErrCodePack cRosNodeSetPublisherTcpTuning( CrosNode *n, int pubidx, const CrosTcpTuning *tuning )
+{
+  PublisherNode *pub;
+  int list_elem;
+  PRINT_VVDEBUG ( "cRosNodeSetPublisherTcpTuning ()\n" );
+
+  if( n == NULL || pubidx < 0 || pubidx >= CN_MAX_PUBLISHED_TOPICS || n->pubs[pubidx].topic_name == NULL || tuning == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  pub = &n->pubs[pubidx];
+  pub->tcp_tuning = *tuning;
+  cRosMutexLock( &n->io_shard_lock );
+  for( list_elem = 0; pub->tcpros_id_list[list_elem] != -1; list_elem++ ) // Apply the options to the current connections
+    applyTcpTuning( &(n->tcpros_server_proc[pub->tcpros_id_list[list_elem]].socket), &pub->tcp_tuning, pub->max_msg_size, 1 );
+  cRosMutexUnlock( &n->io_shard_lock );
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosErrCodePack cRosNodeSetSubscriberTcpTuning( CrosNode *n, int subidx, const CrosTcpTuning *tuning )
+{
+  SubscriberNode *sub;
+  int i;
+  PRINT_VVDEBUG ( "cRosNodeSetSubscriberTcpTuning ()\n" );
+
+  if( n == NULL || subidx < 0 || subidx >= CN_MAX_SUBSCRIBED_TOPICS || n->subs[subidx].topic_name == NULL || tuning == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  sub = &n->subs[subidx];
+  sub->tcp_tuning = *tuning;
+  for( i = 0; i < CN_MAX_TCPROS_CLIENT_CONNECTIONS; i++ ) // Apply the options to the current connections
+  {
+    TcprosProcess *client_proc = &n->tcpros_client_proc[i];
+    if( client_proc->topic_idx == subidx && client_proc->socket.open )
+      applyTcpTuning( &(client_proc->socket), &sub->tcp_tuning, sub->max_msg_size, 0 );
+  }
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosErrCodePack cRosNodeSetDeadPeerHook( CrosNode *n, DeadPeerHook hook, void *context )
+{
+  if( n == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  n->dead_peer_hook = hook;
+  n->dead_peer_context = context;
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+unsigned long cRosNodeGetDeadPeerCount( CrosNode *n )
+{
+  unsigned long n_dead_peers;
+
+  cRosMutexLock( &n->io_shard_lock );
+  n_dead_peers = n->n_dead_peers;
+  cRosMutexUnlock( &n->io_shard_lock );
+  return n_dead_peers;
+}
+
+cRosErrCodePack cRosNodeEnableGraphCache( CrosNode *n, uint32_t min_period, uint32_t max_period,
+                                          CrosGraphChangeCallback callback, void *context )
+{
+  if( n == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  // A call in progress is ignored when it completes, since the cache is restarted
+  cRosGraphCacheRelease( &n->graph_cache );
+  n->graph_cache_valid = 0;
+  n->graph_cache_call_id = -1;
+
+  n->graph_cache_enabled = (min_period > 0);
+  n->graph_cache_min_period = min_period;
+  n->graph_cache_max_period = (max_period > min_period)? max_period: min_period;
+  n->graph_cache_period = min_period;
+  n->graph_cache_wake_up_time = 0;
+  n->graph_change_callback = callback;
+  n->graph_change_context = context;
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosErrCodePack cRosNodeRefreshGraphCache( CrosNode *n )
+{
+  if( n == NULL || !n->graph_cache_enabled )
+    return CROS_BAD_PARAM_ERR;
+
+  n->graph_cache_period = n->graph_cache_min_period;
+  if( n->graph_cache_call_id == -1 )
+    n->graph_cache_wake_up_time = 0;
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+const CrosGraphCache *cRosNodeGetGraphCache( CrosNode *n )
+{
+  if( n == NULL || !n->graph_cache_enabled || !n->graph_cache_valid )
+    return NULL;
+
+  return &n->graph_cache;
+}
+
+cRosErrCodePack cRosNodeSetPublisherSubscriberCallbacks( CrosNode *n, int pubidx, PublisherSubscriberApiCallback connect_callback,
+                                                         PublisherSubscriberApiCallback disconnect_callback, void *context )
+{
+  PublisherNode *pub;
+  PRINT_VVDEBUG ( "cRosNodeSetPublisherSubscriberCallbacks ()\n" );
+
+  if( n == NULL || pubidx < 0 || pubidx >= CN_MAX_PUBLISHED_TOPICS || n->pubs[pubidx].topic_name == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  pub = &n->pubs[pubidx];
+  cRosMutexLock( &n->io_shard_lock ); // The callbacks may be called from I/O shards
+  pub->subscriber_connect_callback = connect_callback;
+  pub->subscriber_disconnect_callback = disconnect_callback;
+  pub->subscriber_callback_context = context;
+  cRosMutexUnlock( &n->io_shard_lock );
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+int cRosNodeGetPublisherSubscriberCount( CrosNode *n, int pubidx )
+{
+  int n_subscribers;
+
+  if( n == NULL || pubidx < 0 || pubidx >= CN_MAX_PUBLISHED_TOPICS || n->pubs[pubidx].topic_name == NULL )
+    return -1;
+
+  cRosMutexLock( &n->io_shard_lock );
+  n_subscribers = countPublisherSubscribers( &n->pubs[pubidx] );
+  cRosMutexUnlock( &n->io_shard_lock );
+  return n_subscribers;
+}
+
+cRosErrCodePack cRosNodeSetCallbackBudget( CrosNode *n, CrosCallbackKind kind, int idx, uint32_t soft_budget, uint32_t hard_budget )
+{
+  CrosCallbackBudget *budget;
+  const char *name;
+  PRINT_VVDEBUG ( "cRosNodeSetCallbackBudget ()\n" );
+
+  if( n == NULL || (budget = getCallbackBudget( n, kind, idx, &name )) == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  budget->soft_budget = soft_budget;
+  budget->hard_budget = hard_budget;
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosErrCodePack cRosNodeGetCallbackOverruns( CrosNode *n, CrosCallbackKind kind, int idx, unsigned long *n_soft_overruns, unsigned long *n_hard_overruns, double *max_duration )
+{
+  CrosCallbackBudget *budget;
+  const char *name;
+
+  if( n == NULL || (budget = getCallbackBudget( n, kind, idx, &name )) == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  if( n_soft_overruns != NULL )
+    *n_soft_overruns = budget->n_soft_overruns;
+  if( n_hard_overruns != NULL )
+    *n_hard_overruns = budget->n_hard_overruns;
+  if( max_duration != NULL )
+    *max_duration = budget->max_duration;
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosErrCodePack cRosNodeSetCallbackOverrunHook( CrosNode *n, CallbackOverrunHook hook, void *context, uint32_t log_period )
+{
+  PRINT_VVDEBUG ( "cRosNodeSetCallbackOverrunHook ()\n" );
+
+  if( n == NULL )
+    return CROS_BAD_PARAM_ERR;
 
-    if ( next_xmlrpc_server_i >= 0 && xmlrpc_listner_fd != -1) // Check that there is an available free (idle) xmlrpx process and that the listener socket is still open
-    {
-      if( FD_ISSET( xmlrpc_listner_fd, &err_fds) )
-      {
-        PRINT_ERROR ( "cRosNodeDoEventsLoop() : XMLRPC server listener-socket error\n" );
-      }
-      else if( FD_ISSET( xmlrpc_listner_fd, &r_fds) )
-      {
-        PRINT_VDEBUG ( "cRosNodeDoEventsLoop() : XMLRPC server listener-socket ready\n" );
-        if( tcpIpSocketAccept( &(n->xmlrpc_listner_proc.socket),
-            &(n->xmlrpc_server_proc[next_xmlrpc_server_i].socket) ) == TCPIPSOCKET_DONE &&
-            tcpIpSocketSetReuse( &(n->xmlrpc_server_proc[next_xmlrpc_server_i].socket) ) &&
-            tcpIpSocketSetNonBlocking( &(n->xmlrpc_server_proc[next_xmlrpc_server_i].socket ) ) )
+  n->callback_overrun_hook = hook;
+  n->callback_overrun_context = context;
+  n->callback_overrun_log_period = log_period;
+  n->n_unlogged_overruns = 0;
+  return CROS_SUCCESS_ERR_PACK;
+}
 
-          xmlrpcProcessChangeState( &(n->xmlrpc_server_proc[next_xmlrpc_server_i]), XMLRPC_PROCESS_STATE_READING );
-      }
-    }
+cRosErrCodePack cRosNodeGetSubscriberMsgTimeStamps( CrosNode *n, int subidx, int64_t *rx_time_stamp, int64_t *dequeue_time_stamp )
+{
+  if( n == NULL || subidx < 0 || subidx >= CN_MAX_SUBSCRIBED_TOPICS || n->subs[subidx].topic_name == NULL )
+    return CROS_BAD_PARAM_ERR;
 
-    for( i = 0; i < CN_MAX_XMLRPC_SERVER_CONNECTIONS; i++ )
-    {
-      XmlrpcProcess *server_proc;
-      int server_fd;
+  if( rx_time_stamp != NULL )
+    *rx_time_stamp = n->subs[subidx].msg_rx_time_stamp;
+  if( dequeue_time_stamp != NULL )
+    *dequeue_time_stamp = n->subs[subidx].msg_dequeue_time_stamp;
 
-      server_proc = &n->xmlrpc_server_proc[i];
-      server_fd = tcpIpSocketGetFD( &server_proc->socket );
-      if( server_proc->state != XMLRPC_PROCESS_STATE_IDLE && FD_ISSET(server_fd, &err_fds) )
-      {
-        PRINT_ERROR ( "cRosNodeDoEventsLoop() : XMLRPC server socket error\n" );
-        tcpIpSocketClose( &(n->xmlrpc_server_proc[i].socket) );
-        xmlrpcProcessChangeState( &(n->xmlrpc_server_proc[next_xmlrpc_server_i]), XMLRPC_PROCESS_STATE_IDLE ); // maybe server_proc instead of &(n->xmlrpc_server_proc[next_xmlrpc_server_i]) ???
-      }
-      else if( ( server_proc->state == XMLRPC_PROCESS_STATE_WRITING && FD_ISSET(server_fd, &w_fds) ) ||
-               ( server_proc->state == XMLRPC_PROCESS_STATE_READING && FD_ISSET(server_fd, &r_fds) ) )
-      {
-        new_errors = doWithXmlrpcServerSocket( n, i );
-        ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
-      }
-    }
+  return CROS_SUCCESS_ERR_PACK;
+}
 
-    for(i = 0; i < CN_MAX_TCPROS_CLIENT_CONNECTIONS; i++ )
-    {
-      TcprosProcess *client_proc = &(n->tcpros_client_proc[i]);
-      int tcpros_client_fd = tcpIpSocketGetFD( &(client_proc->socket) );
+cRosErrCodePack cRosNodeSetPublisherRateLimit( CrosNode *n, int pubidx, uint32_t byte_rate, uint32_t burst, CrosShapingPolicy policy )
+{
+  PublisherNode *pub;
+  PRINT_VVDEBUG ( "cRosNodeSetPublisherRateLimit ()\n" );
 
-      if( client_proc->state != TCPROS_PROCESS_STATE_IDLE && FD_ISSET(tcpros_client_fd, &err_fds) )
-      {
-        PRINT_ERROR ( "cRosNodeDoEventsLoop() : XMLRPC client socket error\n" );
-        handleTcprosClientError( n, i );
-      }
+  if( n == NULL || pubidx < 0 || pubidx >= CN_MAX_PUBLISHED_TOPICS || n->pubs[pubidx].topic_name == NULL ||
+      (policy != CROS_SHAPING_DEFER && policy != CROS_SHAPING_DROP) )
+    return CROS_BAD_PARAM_ERR;
 
-      if( (client_proc->state == TCPROS_PROCESS_STATE_CONNECTING && FD_ISSET(tcpros_client_fd, &w_fds) ) || // tcpIpSocketSelect() indicates connection completion through write-fd
-          ( client_proc->state == TCPROS_PROCESS_STATE_WRITING_HEADER && FD_ISSET(tcpros_client_fd, &w_fds) ) ||
-          ( client_proc->state == TCPROS_PROCESS_STATE_READING_SIZE && FD_ISSET(tcpros_client_fd, &r_fds) ) ||
-          ( client_proc->state == TCPROS_PROCESS_STATE_READING && FD_ISSET(tcpros_client_fd, &r_fds) ) ||
-          ( client_proc->state == TCPROS_PROCESS_STATE_READING_HEADER_SIZE && FD_ISSET(tcpros_client_fd, &r_fds) ) ||
-          ( client_proc->state == TCPROS_PROCESS_STATE_READING_HEADER && FD_ISSET(tcpros_client_fd, &r_fds) ) )
-      {
-        new_errors = doWithTcprosClientSocket( n, i );
-        ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
-      }
-    }
+  pub = &n->pubs[pubidx];
+  cRosMutexLock( &n->io_shard_lock ); // The policy may be read from I/O shards
+  cRosTokenBucketInit( &pub->shaper, byte_rate, burst, cRosClockGetTime(&n->clock) );
+  pub->shaping_policy = policy;
+  pub->shaping_deferred = 0;
+  cRosMutexUnlock( &n->io_shard_lock );
 
-    if ( next_tcpros_server_i >= 0 && tcpros_listner_fd != -1)
-    {
-      if( FD_ISSET( tcpros_listner_fd, &err_fds) )
-      {
-        PRINT_ERROR ( "cRosNodeDoEventsLoop() : TCPROS listener-socket error\n" );
-      }
-      else if( FD_ISSET( tcpros_listner_fd, &r_fds) )
-      {
-        PRINT_VDEBUG ( "cRosNodeDoEventsLoop() : TCPROS listener ready\n" );
-        if( tcpIpSocketAccept( &(n->tcpros_listner_proc.socket),
-            &(n->tcpros_server_proc[next_tcpros_server_i].socket) ) == TCPIPSOCKET_DONE &&
-            tcpIpSocketSetReuse( &(n->tcpros_server_proc[next_tcpros_server_i].socket) ) &&
-            tcpIpSocketSetNonBlocking( &(n->tcpros_server_proc[next_tcpros_server_i].socket ) ) &&
-            tcpIpSocketSetKeepAlive( &(n->tcpros_server_proc[next_tcpros_server_i].socket ), 60, 10, 9 ) )
-        {
-          tcprosProcessChangeState( &(n->tcpros_server_proc[next_tcpros_server_i]), TCPROS_PROCESS_STATE_READING_HEADER ); // A TCPROS process has been activated to attend the connection
-        }
-      }
-    }
+  return CROS_SUCCESS_ERR_PACK;
+}
 
-    for( i = 0; i < CN_MAX_TCPROS_SERVER_CONNECTIONS; i++ )
-    {
-      TcprosProcess *server_proc;
-      int server_fd;
+cRosErrCodePack cRosNodeSetConnectionRateLimit( CrosNode *n, int pubidx, uint32_t byte_rate, uint32_t burst )
+{
+  PublisherNode *pub;
+  int list_elem;
+  PRINT_VVDEBUG ( "cRosNodeSetConnectionRateLimit ()\n" );
 
-      server_proc = &n->tcpros_server_proc[i];
-      server_fd = tcpIpSocketGetFD( &server_proc->socket );
-      if( server_proc->state != TCPROS_PROCESS_STATE_IDLE && FD_ISSET(server_fd, &err_fds) )
-      {
-        PRINT_ERROR ( "cRosNodeDoEventsLoop() : TCPROS server socket error\n" );
-        tcpIpSocketClose( &(server_proc->socket) );
-        tcprosProcessChangeState( &(n->tcpros_server_proc[next_tcpros_server_i]), TCPROS_PROCESS_STATE_IDLE );
-      }
-      else if( ( server_proc->state == TCPROS_PROCESS_STATE_READING_HEADER && FD_ISSET(server_fd, &r_fds) ) ||
-        ( server_proc->state == TCPROS_PROCESS_STATE_START_WRITING && FD_ISSET(server_fd, &w_fds) ) ||
-        ( server_proc->state == TCPROS_PROCESS_STATE_WRITING && FD_ISSET(server_fd, &w_fds) ) )
-      {
-        new_errors = doWithTcprosServerSocket( n, i );
-        ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
-      }
-    }
+  if( n == NULL || pubidx < 0 || pubidx >= CN_MAX_PUBLISHED_TOPICS || n->pubs[pubidx].topic_name == NULL )
+    return CROS_BAD_PARAM_ERR;
 
-    for(i = 0; i < CN_MAX_RPCROS_CLIENT_CONNECTIONS; i++ )
-    {
-      TcprosProcess *client_proc = &(n->rpcros_client_proc[i]);
-      int rpcros_client_fd = tcpIpSocketGetFD( &(client_proc->socket) );
+  pub = &n->pubs[pubidx];
+  cRosMutexLock( &n->io_shard_lock ); // The publisher list may be accessed from I/O shards
+  pub->conn_byte_rate = byte_rate;
+  pub->conn_burst = burst;
+  // Apply the new limit to the subscribers that are already connected
+  for( list_elem = 0; pub->tcpros_id_list[list_elem] != -1; list_elem++ )
+    cRosTokenBucketInit( &(n->tcpros_server_proc[pub->tcpros_id_list[list_elem]].shaper), byte_rate, burst, cRosClockGetTime(&n->clock) );
+  cRosMutexUnlock( &n->io_shard_lock );
 
-      if( client_proc->state != TCPROS_PROCESS_STATE_IDLE && FD_ISSET(rpcros_client_fd, &err_fds) )
-      {
-        PRINT_ERROR ( "cRosNodeDoEventsLoop() : RPCROS client socket error\n" );
-        handleRpcrosClientError( n, i );
-      }
+  return CROS_SUCCESS_ERR_PACK;
+}
 
-      if( ( client_proc->state == TCPROS_PROCESS_STATE_CONNECTING && FD_ISSET(rpcros_client_fd, &w_fds) ) ||
-          ( client_proc->state == TCPROS_PROCESS_STATE_WRITING_HEADER && FD_ISSET(rpcros_client_fd, &w_fds) ) ||
-          ( client_proc->state == TCPROS_PROCESS_STATE_READING_SIZE && FD_ISSET(rpcros_client_fd, &r_fds) ) ||
-          ( client_proc->state == TCPROS_PROCESS_STATE_READING && FD_ISSET(rpcros_client_fd, &r_fds) ) ||
-          ( client_proc->state == TCPROS_PROCESS_STATE_READING_HEADER_SIZE && FD_ISSET(rpcros_client_fd, &r_fds) ) ||
-          ( client_proc->state == TCPROS_PROCESS_STATE_READING_HEADER && FD_ISSET(rpcros_client_fd, &r_fds) ) ||
-          ( client_proc->state == TCPROS_PROCESS_STATE_START_WRITING && FD_ISSET(rpcros_client_fd, &w_fds) ) ||
-          ( client_proc->state == TCPROS_PROCESS_STATE_WRITING && FD_ISSET(rpcros_client_fd, &w_fds) ) )
-      {
-        new_errors = doWithRpcrosClientSocket( n, i );
-        ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
-      }
-    }
+cRosErrCodePack cRosNodeGetPublisherShapingStats( CrosNode *n, int pubidx, unsigned long *n_shaped, unsigned long *n_dropped )
+{
+  PRINT_VVDEBUG ( "cRosNodeGetPublisherShapingStats ()\n" );
 
-    if ( next_rpcros_server_i >= 0 && rpcros_listner_fd != -1)
-    {
-      if( FD_ISSET( rpcros_listner_fd, &err_fds) )
-      {
-        PRINT_ERROR ( "cRosNodeDoEventsLoop() : TCPROS listener-socket error\n" );
-      }
-      else if( next_rpcros_server_i >= 0 && FD_ISSET( rpcros_listner_fd, &r_fds) )
-      {
-        PRINT_VDEBUG ( "cRosNodeDoEventsLoop() : TCPROS listener ready\n" );
-        if( tcpIpSocketAccept( &(n->rpcros_listner_proc.socket),
-            &(n->rpcros_server_proc[next_rpcros_server_i].socket) ) == TCPIPSOCKET_DONE &&
-            tcpIpSocketSetReuse( &(n->rpcros_server_proc[next_rpcros_server_i].socket) ) &&
-            tcpIpSocketSetNonBlocking( &(n->rpcros_server_proc[next_rpcros_server_i].socket ) ) &&
-            tcpIpSocketSetKeepAlive( &(n->rpcros_server_proc[next_rpcros_server_i].socket ), 60, 10, 9 ) )
-        {
-          tcprosProcessChangeState( &(n->rpcros_server_proc[next_rpcros_server_i]), TCPROS_PROCESS_STATE_READING_HEADER_SIZE );
-        }
-      }
-    }
+  if( n == NULL || pubidx < 0 || pubidx >= CN_MAX_PUBLISHED_TOPICS || n->pubs[pubidx].topic_name == NULL )
+    return CROS_BAD_PARAM_ERR;
 
-    for( i = 0; i < CN_MAX_RPCROS_SERVER_CONNECTIONS; i++ )
-    {
-      TcprosProcess *server_proc = &(n->rpcros_server_proc[i]);
-      int server_fd = tcpIpSocketGetFD( &(server_proc->socket) );
+  cRosMutexLock( &n->io_shard_lock ); // The counters may be updated from I/O shards
+  if( n_shaped != NULL )
+    *n_shaped = n->pubs[pubidx].n_shaped_msgs;
+  if( n_dropped != NULL )
+    *n_dropped = n->pubs[pubidx].n_dropped_msgs;
+  cRosMutexUnlock( &n->io_shard_lock );
 
-      if( server_proc->state != TCPROS_PROCESS_STATE_IDLE && FD_ISSET(server_fd, &err_fds) )
-      {
-        PRINT_ERROR ( "cRosNodeDoEventsLoop() : TCPROS server socket error\n" );
-        tcpIpSocketClose( &(server_proc->socket) );
-        tcprosProcessChangeState( &(n->rpcros_server_proc[next_rpcros_server_i]), TCPROS_PROCESS_STATE_IDLE );
-      }
-      else if( ( server_proc->state == TCPROS_PROCESS_STATE_READING_HEADER_SIZE && FD_ISSET(server_fd, &r_fds) ) ||
-        ( server_proc->state == TCPROS_PROCESS_STATE_READING_HEADER && FD_ISSET(server_fd, &r_fds) ) ||
-        ( server_proc->state == TCPROS_PROCESS_STATE_READING_SIZE && FD_ISSET(server_fd, &r_fds) ) ||
-        ( server_proc->state == TCPROS_PROCESS_STATE_READING && FD_ISSET(server_fd, &r_fds) ) ||
-        ( server_proc->state == TCPROS_PROCESS_STATE_WRITING_HEADER && FD_ISSET(server_fd, &w_fds) ) ||
-        ( server_proc->state == TCPROS_PROCESS_STATE_WRITING && FD_ISSET(server_fd, &w_fds) ) )
-      {
-        new_errors = doWithRpcrosServerSocket( n, i );
-        ret_err = cRosAddErrCodePackIfErr(ret_err, new_errors);
-      }
-    }
-  }
-  return ret_err;
+  return CROS_SUCCESS_ERR_PACK;
 }
 
-cRosErrCodePack cRosNodeStart( CrosNode *n, unsigned long time_out, unsigned char *exit_flag )
+cRosErrCodePack cRosNodeSetPublisherBatching( CrosNode *n, int pubidx, uint32_t flush_window, uint32_t max_batch_bytes )
+{
+  PublisherNode *pub;
+  PRINT_VVDEBUG ( "cRosNodeSetPublisherBatching ()\n" );
+
+  if( n == NULL || pubidx < 0 || pubidx >= CN_MAX_PUBLISHED_TOPICS || n->pubs[pubidx].topic_name == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  pub = &n->pubs[pubidx];
+  // If batching is disabled, the messages already batched are sent as soon as the subscribers are ready
+  pub->batch_window = flush_window;
+  pub->batch_max_bytes = (max_batch_bytes > 0)? max_batch_bytes : CN_DEFAULT_BATCH_MAX_BYTES;
+
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+cRosErrCodePack cRosNodeSetPublisherZeroCopy( CrosNode *n, int pubidx, size_t min_size )
 {
-  uint64_t start_time, elapsed_time;
   cRosErrCodePack ret_err;
-  PRINT_VVDEBUG ( "cRosNodeStart ()\n" );
+  PublisherNode *pub;
+  int list_elem;
+  PRINT_VVDEBUG ( "cRosNodeSetPublisherZeroCopy ()\n" );
+
+  if( n == NULL || pubidx < 0 || pubidx >= CN_MAX_PUBLISHED_TOPICS || n->pubs[pubidx].topic_name == NULL )
+    return CROS_BAD_PARAM_ERR;
 
-  start_time = cRosClockGetTimeMs();
   ret_err = CROS_SUCCESS_ERR_PACK;
-  while(ret_err == CROS_SUCCESS_ERR_PACK && (exit_flag==NULL || !(*exit_flag)) && (time_out == CROS_INFINITE_TIMEOUT || (elapsed_time=cRosClockGetTimeMs()-start_time) <= time_out))
-    ret_err = cRosNodeDoEventsLoop( n, (time_out == CROS_INFINITE_TIMEOUT)? UINT64_MAX : time_out-elapsed_time);
+  pub = &n->pubs[pubidx];
+  cRosMutexLock( &n->io_shard_lock ); // The publisher list may be accessed from I/O shards
+  pub->zerocopy_min_size = min_size;
+  // Configure the sockets of the subscribers that are already connected
+  for( list_elem = 0; pub->tcpros_id_list[list_elem] != -1; list_elem++ )
+  {
+    TcpIpSocket *socket = &(n->tcpros_server_proc[pub->tcpros_id_list[list_elem]].socket);
+    if( socket->connected && !tcpIpSocketSetZeroCopy( socket, min_size ) )
+      ret_err = CROS_ZEROCOPY_ERR;
+  }
+  cRosMutexUnlock( &n->io_shard_lock );
 
   return ret_err;
 }
@@ -3414,10 +5856,10 @@ cRosErrCodePack cRosNodeReceiveTopicMsg( CrosNode *node, int subidx, cRosMessage
     *buff_overflow = subs_node->msg_queue_overflow;
   subs_node->msg_queue_overflow = 0; // Reset overflow flag
 
-  start_time = cRosClockGetTimeMs();
+  start_time = cRosClockGetTime(&node->clock);
   ret_err = CROS_SUCCESS_ERR_PACK; // default return value
   // While the buffer is empty and the timeout is not reached wait
-  while(cRosMessageQueueUsage(&subs_node->msg_queue) == 0 && ret_err == CROS_SUCCESS_ERR_PACK && (time_out == CROS_INFINITE_TIMEOUT || (elapsed_time=cRosClockGetTimeMs()-start_time) <= time_out))
+  while(cRosMessageQueueUsage(&subs_node->msg_queue) == 0 && ret_err == CROS_SUCCESS_ERR_PACK && (time_out == CROS_INFINITE_TIMEOUT || (elapsed_time=cRosClockGetTime(&node->clock)-start_time) <= time_out))
   {
     ret_err = cRosNodeDoEventsLoop ( node, time_out - elapsed_time);
   }
@@ -3431,6 +5873,45 @@ cRosErrCodePack cRosNodeReceiveTopicMsg( CrosNode *node, int subidx, cRosMessage
   return ret_err;
 }
 
+cRosErrCodePack cRosNodeWaitAnyTopicMsg( CrosNode *node, const int subidx_list[], int n_subs, int *rcv_subidx, unsigned long time_out )
+{
+  cRosErrCodePack ret_err;
+  uint64_t start_time, elapsed_time = 0; // Initialized just to avoid a compiler warning
+  int list_idx, ready_subidx;
+  PRINT_VVDEBUG ( "cRosNodeWaitAnyTopicMsg ()\n" );
+
+  if(node == NULL || subidx_list == NULL || n_subs <= 0)
+    return CROS_BAD_PARAM_ERR;
+
+  for(list_idx = 0; list_idx < n_subs; list_idx++)
+    if(subidx_list[list_idx] < 0 || subidx_list[list_idx] >= CN_MAX_SUBSCRIBED_TOPICS || node->subs[subidx_list[list_idx]].topic_name == NULL)
+      return CROS_BAD_PARAM_ERR;
+
+  start_time = cRosClockGetTime(&node->clock);
+  ret_err = CROS_SUCCESS_ERR_PACK; // default return value
+  ready_subidx = -1;
+  // Spin the event loop until a message arrives to any of the subscribers or the timeout is reached
+  while(ret_err == CROS_SUCCESS_ERR_PACK)
+  {
+    for(list_idx = 0; list_idx < n_subs && ready_subidx == -1; list_idx++)
+      if(cRosMessageQueueUsage(&node->subs[subidx_list[list_idx]].msg_queue) > 0)
+        ready_subidx = subidx_list[list_idx];
+
+    if(ready_subidx != -1 || (time_out != CROS_INFINITE_TIMEOUT && (elapsed_time=cRosClockGetTime(&node->clock)-start_time) > time_out))
+      break;
+
+    ret_err = cRosNodeDoEventsLoop ( node, time_out - elapsed_time);
+  }
+
+  if(rcv_subidx != NULL)
+    *rcv_subidx = ready_subidx;
+
+  if(ret_err == CROS_SUCCESS_ERR_PACK && ready_subidx == -1)
+    ret_err = CROS_RCV_TOP_TIMEOUT_ERR;
+
+  return ret_err;
+}
+
 cRosErrCodePack cRosNodeQueueTopicMsg( CrosNode *node, int pubidx, cRosMessage *msg )
 {
   cRosErrCodePack ret_err;
@@ -3465,10 +5946,10 @@ cRosErrCodePack cRosNodeSendTopicMsg( CrosNode *node, int pubidx, cRosMessage *m
   if(pub_node->topic_name == NULL)
     return CROS_BAD_PARAM_ERR;
 
-  start_time = cRosClockGetTimeMs();
+  start_time = cRosClockGetTime(&node->clock);
   ret_err = CROS_SUCCESS_ERR_PACK; // default return value
   // While the buffer is full and the timeout is not reached wait
-  while(cRosMessageQueueVacancies(&pub_node->msg_queue) == 0 && ret_err == CROS_SUCCESS_ERR_PACK && (time_out == CROS_INFINITE_TIMEOUT || (elapsed_time=cRosClockGetTimeMs()-start_time) <= time_out))
+  while(cRosMessageQueueVacancies(&pub_node->msg_queue) == 0 && ret_err == CROS_SUCCESS_ERR_PACK && (time_out == CROS_INFINITE_TIMEOUT || (elapsed_time=cRosClockGetTime(&node->clock)-start_time) <= time_out))
   {
     ret_err = cRosNodeDoEventsLoop ( node, time_out - elapsed_time);
   }
@@ -3497,10 +5978,10 @@ cRosErrCodePack cRosNodeServiceCall( CrosNode *node, int svcidx, cRosMessage *re
 
   svc_client_proc = &node->rpcros_client_proc[caller_node->rpcros_id];
 
-  start_time = cRosClockGetTimeMs();
+  start_time = cRosClockGetTime(&node->clock);
   // Wait until the RPCROS process has finished the current call and the timeout is not reached wait
   ret_err = CROS_SUCCESS_ERR_PACK;
-  while(svc_client_proc->state != TCPROS_PROCESS_STATE_WAIT_FOR_WRITING && ret_err == CROS_SUCCESS_ERR_PACK && (time_out == CROS_INFINITE_TIMEOUT || (elapsed_time=cRosClockGetTimeMs()-start_time) <= time_out))
+  while(svc_client_proc->state != TCPROS_PROCESS_STATE_WAIT_FOR_WRITING && ret_err == CROS_SUCCESS_ERR_PACK && (time_out == CROS_INFINITE_TIMEOUT || (elapsed_time=cRosClockGetTime(&node->clock)-start_time) <= time_out))
   {
     ret_err = cRosNodeDoEventsLoop ( node, time_out - elapsed_time);
   }
@@ -3520,7 +6001,7 @@ cRosErrCodePack cRosNodeServiceCall( CrosNode *node, int svcidx, cRosMessage *re
     ret_err = CROS_MEM_ALLOC_ERR;
 
   // Wait while the buffer is full and the timeout is not reached
-  while(cRosMessageQueueUsage(&caller_node->msg_queue) < 2 && ret_err == CROS_SUCCESS_ERR_PACK && (time_out == CROS_INFINITE_TIMEOUT || (elapsed_time=cRosClockGetTimeMs()-start_time) <= time_out))
+  while(cRosMessageQueueUsage(&caller_node->msg_queue) < 2 && ret_err == CROS_SUCCESS_ERR_PACK && (time_out == CROS_INFINITE_TIMEOUT || (elapsed_time=cRosClockGetTime(&node->clock)-start_time) <= time_out))
   {
     ret_err = cRosNodeDoEventsLoop ( node, time_out - elapsed_time);
   }
@@ -3549,6 +6030,72 @@ cRosErrCodePack cRosNodeServiceCall( CrosNode *node, int svcidx, cRosMessage *re
   return ret_err;
 }
 
+cRosErrCodePack cRosNodeServiceCallInPlace( CrosNode *node, int svcidx, cRosMessage *req_msg, cRosMessage *resp_msg, unsigned long time_out)
+{
+  cRosErrCodePack ret_err;
+  ServiceCallerNode *caller_node;
+  TcprosProcess *svc_client_proc;
+  uint64_t start_time, elapsed_time = 0; // Initialized just to avoid a compiler warning
+  PRINT_VVDEBUG ( "cRosNodeServiceCallInPlace ()\n" );
+
+  if(svcidx < 0 || svcidx >= CN_MAX_SERVICE_CALLERS || req_msg == NULL || resp_msg == NULL)
+    return CROS_BAD_PARAM_ERR;
+
+  caller_node = &node->service_callers[svcidx];
+  if(caller_node->service_name == NULL ||
+     (caller_node->in_place_call != CROS_IN_PLACE_CALL_NONE && caller_node->in_place_call != CROS_IN_PLACE_CALL_ABANDONED)) // Nested calls (e.g. from a callback) are not supported
+    return CROS_BAD_PARAM_ERR;
+
+  svc_client_proc = &node->rpcros_client_proc[caller_node->rpcros_id];
+
+  start_time = cRosClockGetTime(&node->clock);
+  // Wait until the RPCROS process has finished the current call and the timeout is not reached wait
+  ret_err = CROS_SUCCESS_ERR_PACK;
+  while(svc_client_proc->state != TCPROS_PROCESS_STATE_WAIT_FOR_WRITING && ret_err == CROS_SUCCESS_ERR_PACK && (time_out == CROS_INFINITE_TIMEOUT || (elapsed_time=cRosClockGetTime(&node->clock)-start_time) <= time_out))
+  {
+    ret_err = cRosNodeDoEventsLoop ( node, time_out - elapsed_time);
+  }
+
+  if(ret_err == CROS_SUCCESS_ERR_PACK && svc_client_proc->state != TCPROS_PROCESS_STATE_WAIT_FOR_WRITING)
+    ret_err = CROS_CALL_INI_TIMEOUT_ERR;
+  if(ret_err != CROS_SUCCESS_ERR_PACK)
+    return ret_err;
+
+  if(cRosMessageQueueUsage(&caller_node->msg_queue) > 0) // Unfinished service call?
+  {
+    PRINT_ERROR ( "cRosNodeServiceCallInPlace () : The service caller is not ready to make a new call. Overwriting previous state and trying anyway...\n" );
+    cRosMessageQueueClear(&caller_node->msg_queue);
+  }
+
+  // The caller serializes the request directly from req_msg and deserializes the response directly into resp_msg
+  cRosNodeServiceCallerSwapMessages(caller_node->context, &req_msg, &resp_msg);
+  caller_node->in_place_call = CROS_IN_PLACE_CALL_REQUESTED;
+
+  while(caller_node->in_place_call != CROS_IN_PLACE_CALL_DONE && caller_node->in_place_call != CROS_IN_PLACE_CALL_FAILED &&
+        ret_err == CROS_SUCCESS_ERR_PACK && (time_out == CROS_INFINITE_TIMEOUT || (elapsed_time=cRosClockGetTime(&node->clock)-start_time) <= time_out))
+  {
+    ret_err = cRosNodeDoEventsLoop ( node, time_out - elapsed_time);
+  }
+
+  if(ret_err == CROS_SUCCESS_ERR_PACK)
+  {
+    if(caller_node->in_place_call == CROS_IN_PLACE_CALL_FAILED)
+      ret_err = caller_node->in_place_err;
+    else if(caller_node->in_place_call != CROS_IN_PLACE_CALL_DONE)
+      ret_err = CROS_CALL_SVC_TIMEOUT_ERR;
+  }
+
+  // Give the caller its own messages back. If the request was sent but the response did not arrive, the late response is dropped
+  // when it arrives, so it is neither written into the application messages nor delivered to the callback as a regular response
+  if(caller_node->in_place_call == CROS_IN_PLACE_CALL_SENT)
+    caller_node->in_place_call = CROS_IN_PLACE_CALL_ABANDONED;
+  else
+    caller_node->in_place_call = CROS_IN_PLACE_CALL_NONE;
+  cRosNodeServiceCallerSwapMessages(caller_node->context, &req_msg, &resp_msg);
+
+  return ret_err;
+}
+
 int enqueueSubscriberAdvertise(CrosNode *node, int subidx)
 {
   RosApiCall *call = newRosApiCall();
@@ -3716,34 +6263,25 @@ int enqueueRequestTopic(CrosNode *node, int subidx, const char *host, int port)
 
 void restartAdversing(CrosNode* n)
 {
-  int it;
-  for(it = 0; it < n->n_pubs; it++)
-  {
-    if (n->pubs[it].topic_name == NULL)
-      continue;
+  uint64_t cur_time = cRosClockGetTime(&n->clock);
 
-    enqueuePublisherAdvertise(n, it);
-  }
-
-  for(it = 0; it < n->n_subs; it++)
+  if (n->master_restart_time == 0)
   {
-    if (n->subs[it].topic_name == NULL)
-      continue;
-
-    enqueueSubscriberAdvertise(n, it);
+    PRINT_INFO("restartAdversing() : The ROS master has lost the registrations of the node (has it restarted?). Registering them again\n");
+    n->master_restart_time = (n->master_unreachable_time != 0)? n->master_unreachable_time : cur_time;
+    n->n_master_restarts++;
+    notifyMasterStatus(n, CROS_STATUS_MASTER_RESTARTED, 0);
   }
 
-  for(it = 0; it < n->n_service_providers; it++)
-  {
-    if (n->service_providers[it].service_name == NULL)
-      continue;
-
-    enqueueServiceAdvertise(n, it);
-  }
+  // The registrations are enqueued by continueReregistration() at the rate allowed by the shaper
+  n->reregistration_cursor = 0;
+  cRosTokenBucketInit(&n->reregistration_shaper, CN_REREGISTRATION_RATE, CN_REREGISTRATION_BURST, cur_time);
 }
 
 void initPublisherNode(PublisherNode *pub)
 {
+  int shard_idx;
+
   pub->message_definition = NULL;
   pub->topic_name = NULL;
   pub->topic_type = NULL;
@@ -3752,7 +6290,46 @@ void initPublisherNode(PublisherNode *pub)
   pub->tcpros_id_list[0] = -1; // Empty list of TcprosProcess indices
   pub->loop_period = -1; // Publication paused
   pub->wake_up_time = 0;
+  pub->priority = CROS_TOPIC_PRIORITY_NORMAL;
+  cRosTokenBucketInit(&pub->shaper, 0, 0, 0); // No rate limit
+  pub->conn_byte_rate = 0;
+  pub->conn_burst = 0;
+  pub->zerocopy_min_size = 0; // Copying sends
+  pub->subscriber_connect_callback = NULL;
+  pub->subscriber_disconnect_callback = NULL;
+  pub->subscriber_callback_context = NULL;
+  pub->on_change = 0; // All the messages are sent
+  pub->heartbeat_period = 0;
+  pub->deadbands = NULL;
+  pub->n_deadbands = 0;
+  pub->last_sent_msg = NULL;
+  dynBufferInit(&pub->last_sent_frame);
+  pub->last_sent_time = 0;
+  pub->on_change_resend = 0;
+  pub->n_unchanged_msgs = 0;
+  memset(&pub->tcp_tuning, 0, sizeof(CrosTcpTuning)); // Default socket options
+  pub->max_msg_size = 0;
+  pub->network = CROS_TOPIC_NETWORK_DATA;
+  pub->shaping_policy = CROS_SHAPING_DEFER;
+  pub->shaping_deferred = 0;
+  pub->n_shaped_msgs = 0;
+  pub->n_dropped_msgs = 0;
   cRosMessageQueueInit(&pub->msg_queue);
+  dynBufferInit(&pub->packet);
+  pub->packet_size = 0;
+  pub->shard_serialization = 0;
+  pub->packet_seq = 0;
+  for(shard_idx = 0; shard_idx < CN_MAX_IO_SHARDS; shard_idx++)
+  {
+    dynBufferInit(&pub->shard_packets[shard_idx]);
+    pub->shard_packet_seqs[shard_idx] = 0;
+  }
+  pub->batch_window = 0; // No batching
+  pub->batch_max_bytes = CN_DEFAULT_BATCH_MAX_BYTES;
+  pub->batch_flush_time = 0;
+  dynBufferInit(&pub->batch);
+  initCallbackBudget(&pub->cb_budget);
+  pub->n_filtered_msgs = 0;
 }
 
 void initSubscriberNode(SubscriberNode *sub)
@@ -3764,7 +6341,17 @@ void initSubscriberNode(SubscriberNode *sub)
   sub->context = NULL;
   sub->tcp_nodelay = 0;
   sub->msg_queue_overflow = 0;
+  sub->priority = CROS_TOPIC_PRIORITY_NORMAL;
+  sub->rx_timestamps = 0;
+  sub->msg_rx_time_stamp = 0;
+  sub->msg_dequeue_time_stamp = 0;
+  sub->stats_window = 0;
+  memset(&sub->tcp_tuning, 0, sizeof(CrosTcpTuning)); // Default socket options
+  sub->max_msg_size = 0;
   cRosMessageQueueInit(&sub->msg_queue);
+  initCallbackBudget(&sub->cb_budget);
+  sub->filter_expr = NULL;
+  cRosMessageFilterInit(&sub->filter);
 }
 
 void initServiceProviderNode(ServiceProviderNode *srv_prov)
@@ -3775,6 +6362,7 @@ void initServiceProviderNode(ServiceProviderNode *srv_prov)
   srv_prov->context = NULL;
   srv_prov->servicerequest_type = NULL;
   srv_prov->serviceresponse_type = NULL;
+  initCallbackBudget(&srv_prov->cb_budget);
 }
 
 void initServiceCallerNode(ServiceCallerNode *srv_caller)
@@ -3794,6 +6382,9 @@ void initServiceCallerNode(ServiceCallerNode *srv_caller)
   srv_caller->loop_period = -1; // Calling paused
   srv_caller->wake_up_time = 0;
   cRosMessageQueueInit(&srv_caller->msg_queue);
+  srv_caller->in_place_call = CROS_IN_PLACE_CALL_NONE;
+  srv_caller->in_place_err = CROS_SUCCESS_ERR_PACK;
+  initCallbackBudget(&srv_caller->cb_budget);
 }
 
 void initParameterSubscrition(ParameterSubscription *subscription)
@@ -3802,15 +6393,25 @@ void initParameterSubscrition(ParameterSubscription *subscription)
   xmlrpcParamInit(&subscription->parameter_value);
   subscription->status_api_callback = NULL;
   subscription->context = NULL;
+  initCallbackBudget(&subscription->cb_budget);
 }
 
 void cRosNodeReleasePublisher(PublisherNode *node)
 {
+  int shard_idx;
+
   free(node->message_definition);
   free(node->topic_name);
   free(node->topic_type);
   free(node->md5sum);
   cRosMessageQueueRelease(&node->msg_queue);
+  dynBufferRelease(&node->packet);
+  for(shard_idx = 0; shard_idx < CN_MAX_IO_SHARDS; shard_idx++)
+    dynBufferRelease(&node->shard_packets[shard_idx]);
+  dynBufferRelease(&node->batch);
+  freeDeadbands(node->deadbands, node->n_deadbands);
+  cRosMessageFree(node->last_sent_msg);
+  dynBufferRelease(&node->last_sent_frame);
 }
 
 void cRosNodeReleaseSubscriber(SubscriberNode *node)
@@ -3820,6 +6421,8 @@ void cRosNodeReleaseSubscriber(SubscriberNode *node)
   free(node->topic_type);
   free(node->md5sum);
   cRosMessageQueueRelease(&node->msg_queue);
+  free(node->filter_expr);
+  cRosMessageFilterRelease(&node->filter);
 }
 
 void cRosNodeReleaseServiceProvider(ServiceProviderNode *node)
@@ -3850,6 +6453,7 @@ void initCrosNodeStatus(CrosNodeStatusUsr *status)
   status->provider_idx = -1;
   status->parameter_key = NULL;
   status->parameter_value = NULL;
+  status->recovery_time = 0;
 }
 
 void cRosNodeReleaseParameterSubscrition(ParameterSubscription *subscription)
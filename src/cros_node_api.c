@@ -359,7 +359,9 @@ int cRosApiParseResponse( CrosNode *n, int client_idx )
           status.provider_idx = paramsubidx;
           status.parameter_key = subscription->parameter_key;
           status.parameter_value = value;
+          int64_t cb_start = cRosNodeCallbackStart(&subscription->cb_budget);
           subscription->status_api_callback(&status, subscription->context); // calls the parameter-subscriber application-defined status callback function (if specified when creating the publisher).
+          cRosNodeCallbackEnd(n, CROS_CALLBACK_PARAMETER, paramsubidx, cb_start);
 
           ret = 0;
           xmlrpcParamRelease(&subscription->parameter_value);
@@ -381,14 +383,19 @@ int cRosApiParseResponse( CrosNode *n, int client_idx )
           if(n->roscore_pid == -1)
           {
             n->roscore_pid = roscore_pid_param->data.as_int;
+            n->master_unreachable_time = 0;
           }
           else if (n->roscore_pid != roscore_pid_param->data.as_int)
           {
             n->roscore_pid = roscore_pid_param->data.as_int;
             restartAdversing(n);
           }
+          else if (n->master_unreachable_time != 0)
+          {
+            checkMasterRegistrations(n);
+          }
         }
-        else
+        else if (n->master_restart_time == 0)
         {
           restartAdversing(n);
         }
@@ -760,6 +767,7 @@ int cRosApiParseRequestPrepareResponse( CrosNode *n, int server_idx )
         int array_size = xmlrpcParamArrayGetSize( protocols_param );
         XmlrpcParam *proto, *proto_name;
         int i = 0, topic_found = 0, protocol_found = 0;
+        PublisherNode *requested_pub = NULL;
 
         for( i = 0 ; i < n->n_pubs; i++)
         {
@@ -770,6 +778,7 @@ int cRosApiParseRequestPrepareResponse( CrosNode *n, int server_idx )
           if( strcmp( xmlrpcParamGetString( topic_param ), pub->topic_name ) == 0)
           {
             topic_found = 1;
+            requested_pub = pub;
             if (strlen(server_proc->host) != 0)
             {
               CrosNodeStatusUsr status;
@@ -805,8 +814,16 @@ int cRosApiParseRequestPrepareResponse( CrosNode *n, int server_idx )
           xmlrpcParamArrayPushBackString(array1, "");
           XmlrpcParam* array2 = xmlrpcParamArrayPushBackArray(array1);
           xmlrpcParamArrayPushBackString( array2, CROS_TRANSPORT_TCPROS_STRING );
-          xmlrpcParamArrayPushBackString( array2, n->host );
-          xmlrpcParamArrayPushBackInt( array2, n->tcpros_port );
+          if( n->data_host != NULL && requested_pub->network == CROS_TOPIC_NETWORK_DATA ) // The subscriber must connect through the data network
+          {
+            xmlrpcParamArrayPushBackString( array2, n->data_host );
+            xmlrpcParamArrayPushBackInt( array2, n->data_tcpros_port );
+          }
+          else
+          {
+            xmlrpcParamArrayPushBackString( array2, n->host );
+            xmlrpcParamArrayPushBackInt( array2, n->tcpros_port );
+          }
         }
         else
         {
@@ -971,7 +988,9 @@ int cRosApiParseRequestPrepareResponse( CrosNode *n, int server_idx )
         status.provider_idx = it;
         status.parameter_key = parameter_key;
         status.parameter_value = value_param;
+        int64_t cb_start = cRosNodeCallbackStart(&subscription->cb_budget);
         subscription->status_api_callback(&status, subscription->context); // calls the parameter-subscriber-status application-defined callback function (if specified when creating the subscriber).
+        cRosNodeCallbackEnd(n, CROS_CALLBACK_PARAMETER, it, cb_start);
 
         XmlrpcParam param;
         int rc = xmlrpcParamCopy(&param, value_param);
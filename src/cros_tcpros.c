@@ -156,6 +156,16 @@ static TcprosParserState readSubcriptionHeader( TcprosProcess *p, uint32_t *flag
         *flags |= TCPROS_TCP_NODELAY_FLAG;
         dynBufferMovePoseIndicator( packet, field_len );
       }
+      else if ( field_len > (uint32_t)TCPROS_FILTER_TAG.dim &&
+          strncmp ( field, TCPROS_FILTER_TAG.str, TCPROS_FILTER_TAG.dim ) == 0 )
+      {
+        field += TCPROS_FILTER_TAG.dim;
+
+        dynStringReplaceWithStrN( &(p->filter_expr), field,
+                               field_len - TCPROS_FILTER_TAG.dim );
+        *flags |= TCPROS_FILTER_FLAG;
+        dynBufferMovePoseIndicator( packet, field_len );
+      }
       else if ( field_len > (uint32_t)TCPROS_LATCHING_TAG.dim &&
           strncmp ( field, TCPROS_LATCHING_TAG.str, TCPROS_LATCHING_TAG.dim ) == 0 )
       {
@@ -210,6 +220,10 @@ static TcprosParserState readPublicationHeader( TcprosProcess *p, uint32_t *flag
       if ( field_len > (uint32_t)TCPROS_MESSAGE_DEFINITION_TAG.dim &&
           strncmp ( field, TCPROS_MESSAGE_DEFINITION_TAG.str, TCPROS_MESSAGE_DEFINITION_TAG.dim ) == 0 )
       {
+        field += TCPROS_MESSAGE_DEFINITION_TAG.dim;
+
+        dynStringReplaceWithStrN( &(p->message_definition), field,
+                               field_len - TCPROS_MESSAGE_DEFINITION_TAG.dim ); // Used by the subscribers of any type (see cRosApiRegisterSubscriber())
         *flags |= TCPROS_MESSAGE_DEFINITION_FLAG;
         dynBufferMovePoseIndicator( packet, field_len );
       } else if ( field_len > (uint32_t)TCPROS_CALLERID_TAG.dim &&
@@ -316,6 +330,8 @@ TcprosParserState cRosMessageParseSubcriptionHeader( CrosNode *n, int server_idx
   {
     int topic_found = 0;
     int i = 0;
+    // The publishers may be registered and released by the main loop while an I/O shard parses the header
+    cRosMutexLock( &n->io_shard_lock );
     for( i = 0 ; i < n->n_pubs; i++)
     {
       PublisherNode *pub = &n->pubs[i];
@@ -332,13 +348,24 @@ TcprosParserState cRosMessageParseSubcriptionHeader( CrosNode *n, int server_idx
 
         topic_found = 1;
         server_proc->topic_idx = i; // Assign a topic (publisher index) to the TCPROS process
-        // Add the TcprosProcess index to the Publisher
+        if( (header_flags & TCPROS_FILTER_FLAG) &&
+            cRosMessageFilterCompile( &(server_proc->filter), dynStringGetData(&(server_proc->filter_expr)),
+                                      cRosNodeGetOutgoingMessage(pub->context) ) != CROS_SUCCESS_ERR_PACK )
+        {
+          // The subscriber also applies its filter locally, so it will receive the right messages anyway
+          PRINT_ERROR("cRosMessageParseSubcriptionHeader() : The content filter '%s' of the subscriber %s cannot be applied to %s: "
+                      "all the messages will be sent\n", dynStringGetData(&(server_proc->filter_expr)),
+                      dynStringGetData(&(server_proc->caller_id)), pub->topic_type);
+        }
+        // Add the TcprosProcess index to the Publisher (the list is shared with the main loop if I/O shards are used)
         for(list_elem=0;pub->tcpros_id_list[list_elem]!=-1;list_elem++); // Locate the list end
         pub->tcpros_id_list[list_elem] = server_idx;
         pub->tcpros_id_list[list_elem+1] = -1; // Set a new list end (sentinel)
+        pub->on_change_resend = 1; // The new subscriber must receive the current message even if it has not changed
         break;
       }
     }
+    cRosMutexUnlock( &n->io_shard_lock );
 
     if( ! topic_found )
     {
@@ -386,7 +413,33 @@ TcprosParserState cRosMessageParsePublicationHeader( CrosNode *n, int client_idx
   {
     int subscriber_found = 0;
     int i = 0;
-    for( i = 0 ; i < n->n_subs; i++)
+    SubscriberNode *proc_sub = &n->subs[client_proc->topic_idx];
+    int any_type = ( proc_sub->topic_name != NULL && cRosNodeIsAnyTypeSubscriber(proc_sub->context) );
+
+    if( any_type )
+    {
+      // Subscriber of any type: take the type from the publisher. It can change only if no other publisher is connected
+      if( header_flags & TCPROS_MESSAGE_DEFINITION_FLAG )
+      {
+        int can_change = 1;
+        for( i = 0; i < CN_MAX_TCPROS_CLIENT_CONNECTIONS; i++ )
+        {
+          TcprosProcess *other_proc = &n->tcpros_client_proc[i];
+          if( i != client_idx && other_proc->topic_idx == client_proc->topic_idx &&
+              (other_proc->state == TCPROS_PROCESS_STATE_READING_SIZE || other_proc->state == TCPROS_PROCESS_STATE_READING) )
+            can_change = 0;
+        }
+        subscriber_found = ( cRosNodeSetIncomingType( proc_sub->context, dynStringGetData(&(client_proc->type)),
+                                                      dynStringGetData(&(client_proc->md5sum)),
+                                                      dynStringGetData(&(client_proc->message_definition)), can_change ) == CROS_SUCCESS_ERR_PACK );
+        if( subscriber_found && can_change && proc_sub->filter_expr != NULL ) // The type may have changed
+          cRosMessageFilterCompile( &(proc_sub->filter), proc_sub->filter_expr, cRosNodeGetIncomingMessage(proc_sub->context) );
+      }
+      else
+        PRINT_ERROR("cRosMessageParsePublicationHeader() : The publisher did not send the message definition required by a subscriber of any type\n");
+    }
+
+    for( i = 0 ; i < n->n_subs && !any_type; i++)
     {
       SubscriberNode *sub = &n->subs[i];
       if (sub->topic_name == NULL)
@@ -435,12 +488,25 @@ void cRosMessagePrepareSubcriptionHeader( CrosNode *n, int client_idx )
   header_len += pushBackField( packet, &TCPROS_TYPE_TAG, n->subs[sub_idx].topic_type );
   if(n->subs[sub_idx].tcp_nodelay)
     header_len += pushBackField( packet, &TCPROS_TCP_NODELAY_TAG, "1" );
+  if(n->subs[sub_idx].filter_expr != NULL)
+    header_len += pushBackField( packet, &TCPROS_FILTER_TAG, n->subs[sub_idx].filter_expr );
 
   header_out_len= HOST_TO_ROS_UINT32( header_len );
   uint32_t *header_len_p = (uint32_t *)dynBufferGetData( packet );
   *header_len_p = header_out_len;
 }
 
+// Current time of the node clock (in usec, since the Epoch), which is the time base of the header stamps
+static double nodeTimeUSec( CrosNode *n )
+{
+  if(n->clock.type == CROS_CLOCK_SYSTEM)
+  {
+    struct timeval cur_time = cRosClockGetTimeSecUsec();
+    return (double)cur_time.tv_sec * 1e6 + (double)cur_time.tv_usec;
+  }
+  return (double)cRosClockGetTime(&n->clock) * 1e3;
+}
+
 cRosErrCodePack cRosMessageParsePublicationPacket( CrosNode *n, int client_idx )
 {
   cRosErrCodePack ret_err;
@@ -448,6 +514,8 @@ cRosErrCodePack cRosMessageParsePublicationPacket( CrosNode *n, int client_idx )
   TcprosProcess *client_proc;
   DynBuffer *packet;
   void *data_context;
+  size_t msg_start;
+  int64_t arrival_time_stamp = 0, cb_start;
 
   client_proc = &(n->tcpros_client_proc[client_idx]);
   packet = &(client_proc->packet);
@@ -457,9 +525,35 @@ cRosErrCodePack cRosMessageParsePublicationPacket( CrosNode *n, int client_idx )
   if(cRosMessageQueueVacancies(&sub_node->msg_queue) == 0)
     sub_node->msg_queue_overflow = 1; // No space in the queue for the new message
 
+  if(sub_node->rx_timestamps)
+  {
+    sub_node->msg_rx_time_stamp = client_proc->frame_rx_time_stamp;
+    sub_node->msg_dequeue_time_stamp = cRosClockGetTimeStamp();
+  }
+
+  if(sub_node->stats_window > 0)
+    arrival_time_stamp = (client_proc->frame_rx_time_stamp != 0)? client_proc->frame_rx_time_stamp: cRosClockGetTimeStamp();
+  msg_start = dynBufferGetPoseIndicatorOffset(packet);
+
   ret_err = cRosNodeDeserializeIncomingPacket(packet, data_context);
   if(ret_err == CROS_SUCCESS_ERR_PACK)
-    ret_err = cRosNodeSubscriberCallback(data_context); // Calls the subscriber application-defined callback
+  {
+    if(sub_node->stats_window > 0)
+    {
+      uint32_t seq, stamp_secs, stamp_nsecs;
+
+      cRosTopicStatsAddMessage(&client_proc->stats, dynBufferGetPoseIndicatorOffset(packet) - msg_start, arrival_time_stamp);
+      if(cRosNodeGetIncomingHeader(data_context, &seq, &stamp_secs, &stamp_nsecs))
+        cRosTopicStatsAddHeader(&client_proc->stats, seq, nodeTimeUSec(n) - ((double)stamp_secs * 1e6 + (double)stamp_nsecs / 1e3));
+    }
+    // Publishers that do not support content filters send all the messages, so the filter is applied here too
+    if(cRosMessageFilterMatch(&sub_node->filter, cRosNodeGetIncomingMessage(data_context)))
+    {
+      cb_start = cRosNodeCallbackStart(&sub_node->cb_budget);
+      ret_err = cRosNodeSubscriberCallback(data_context); // Calls the subscriber application-defined callback
+      cRosNodeCallbackEnd(n, CROS_CALLBACK_SUBSCRIBER, client_proc->topic_idx, cb_start);
+    }
+  }
   else
     cRosPrintErrCodePack(ret_err, "cRosNodeSubscriberCallback() failed decoding the received packet");
 
@@ -491,29 +585,74 @@ void cRosMessagePreparePublicationHeader( CrosNode *n, int server_idx )
   *header_len_p = header_out_len;
 }
 
+cRosErrCodePack cRosMessagePreparePublicationData( CrosNode *node, int pub_idx, DynBuffer *packet )
+{
+  cRosErrCodePack ret_err;
+  PublisherNode *pub_node;
+  size_t frame_offset;
+  uint32_t packet_size;
+  PRINT_VVDEBUG("cRosMessagePreparePublicationData()\n");
+
+  pub_node = &node->pubs[pub_idx];
+  frame_offset = dynBufferGetSize( packet ); // The frame is appended after the messages already in the buffer (if any)
+  dynBufferPushBackUInt32( packet, 0 ); // Placeholder for packet size
+
+  ret_err = cRosNodeSerializeOutgoingMessage(packet, pub_node->context);
+
+  packet_size = (uint32_t)(dynBufferGetSize(packet) - frame_offset - sizeof(uint32_t));
+  memcpy( (unsigned char *)dynBufferGetData(packet) + frame_offset, &packet_size, sizeof(uint32_t) ); // The frame may be unaligned
+
+  return ret_err;
+}
+
 cRosErrCodePack cRosMessagePreparePublicationPacket( CrosNode *node, int server_idx )
 {
   cRosErrCodePack ret_err;
   PublisherNode *pub_node;
   TcprosProcess *server_proc;
-  int pub_idx;
-  DynBuffer *packet;
-  uint32_t *packet_data_size_ptr;
-  uint32_t packet_size;
+  DynBuffer *packet, *source;
   PRINT_VVDEBUG("cRosMessagePreparePublicationPacket()\n");
 
   server_proc = &(node->tcpros_server_proc[server_idx]);
-  pub_idx = server_proc->topic_idx;
   packet = &(server_proc->packet);
-  dynBufferPushBackUInt32( packet, 0 ); // Placeholder for packet size
+  pub_node = &node->pubs[server_proc->topic_idx];
+
+  // The message has usually been serialized by cRosMessagePreparePublicationData() when the publication was triggered.
+  // If the subscriber requested a content filter, only the frames that satisfy it have been collected for this process
+  ret_err = CROS_SUCCESS_ERR_PACK;
+  if( server_proc->filter.depth > 0 )
+    source = &server_proc->filtered_packet;
+  else if( pub_node->shard_serialization )
+  {
+    // The main loop has left the serialization to the I/O shards: the first process of each shard that writes the message
+    // serializes it in the shard packet, and the other processes of the shard copy it from there
+    int shard_idx = server_idx % node->n_io_shards;
 
-  pub_node = &node->pubs[pub_idx];
+    source = &pub_node->shard_packets[shard_idx];
+    if( pub_node->shard_packet_seqs[shard_idx] != pub_node->packet_seq )
+    {
+      dynBufferClear( source );
+      ret_err = cRosMessagePreparePublicationData( node, server_proc->topic_idx, source );
+      if( ret_err == CROS_SUCCESS_ERR_PACK )
+        pub_node->shard_packet_seqs[shard_idx] = pub_node->packet_seq;
+    }
+  }
+  else
+    source = &pub_node->packet;
 
-  ret_err = cRosNodeSerializeOutgoingMessage(packet, pub_node->context);
+  if( ret_err != CROS_SUCCESS_ERR_PACK )
+    return ret_err;
 
-  packet_size = (uint32_t)dynBufferGetSize(packet) - sizeof(uint32_t);
-  packet_data_size_ptr = (uint32_t *)dynBufferGetData(packet);
-  *packet_data_size_ptr = packet_size;
+  if( pub_node->zerocopy_min_size > 0 && dynBufferGetSize(source) >= pub_node->zerocopy_min_size )
+  {
+    // The frames are written directly from the source buffer, which stays pinned while the process is writing: the next
+    // message is not serialized (nor the source buffer swapped) until all the processes of the publisher wait for writing,
+    // and a process waits for the completion notifications of its zero-copy sends before doing it
+    dynBufferInitFixed( &(server_proc->shared_packet), (unsigned char *)dynBufferGetData(source), dynBufferGetSize(source),
+                        dynBufferGetSize(source) );
+  }
+  else if( dynBufferPushBackBuf( packet, dynBufferGetData(source), dynBufferGetSize(source) ) < 0 )
+    ret_err = CROS_MEM_ALLOC_ERR;
 
   return ret_err;
 }
@@ -948,19 +1087,43 @@ cRosErrCodePack cRosMessageParseServiceResponsePacket( CrosNode *n, int client_i
   cRosErrCodePack ret_err;
 
   TcprosProcess *client_proc = &(n->rpcros_client_proc[client_idx]);
+  ServiceCallerNode *svc_caller = &(n->service_callers[client_proc->service_idx]);
   DynBuffer *packet = &(client_proc->packet);
   if(client_proc->ok_byte == TCPROS_OK_BYTE_SUCCESS)
   {
-    int svc_idx = client_proc->service_idx;
-    void* data_context = n->service_callers[svc_idx].context;
+    void* data_context = svc_caller->context;
+
+    if(svc_caller->in_place_call == CROS_IN_PLACE_CALL_ABANDONED) // The in-place call timed out: nobody waits for this response
+    {
+      PRINT_INFO("cRosMessageParseServiceResponsePacket() : Dropping the late response of a timed-out call to service %s\n", svc_caller->service_name);
+      svc_caller->in_place_call = CROS_IN_PLACE_CALL_NONE;
+      return CROS_SUCCESS_ERR_PACK;
+    }
 
     ret_err = cRosNodeDeserializeIncomingPacket(packet, data_context); // Deserialize the message response
 
-    if(ret_err == CROS_SUCCESS_ERR_PACK)
+    if(svc_caller->in_place_call == CROS_IN_PLACE_CALL_SENT) // The response is already in the message of the application
+    {
+      svc_caller->in_place_err = ret_err;
+      svc_caller->in_place_call = (ret_err == CROS_SUCCESS_ERR_PACK)? CROS_IN_PLACE_CALL_DONE : CROS_IN_PLACE_CALL_FAILED;
+    }
+    else if(ret_err == CROS_SUCCESS_ERR_PACK)
+    {
+      int64_t cb_start = cRosNodeCallbackStart(&svc_caller->cb_budget);
       ret_err = cRosNodeServiceCallerCallback(1, data_context); // Call the service-caller application-defined callback function to process the service response
+      cRosNodeCallbackEnd(n, CROS_CALLBACK_SERVICE_CALLER, client_proc->service_idx, cb_start);
+    }
   }
   else
   {
+     if(svc_caller->in_place_call == CROS_IN_PLACE_CALL_SENT)
+     {
+       svc_caller->in_place_err = CROS_SVC_RES_OK_BYTE_ERR;
+       svc_caller->in_place_call = CROS_IN_PLACE_CALL_FAILED;
+     }
+     else if(svc_caller->in_place_call == CROS_IN_PLACE_CALL_ABANDONED)
+       svc_caller->in_place_call = CROS_IN_PLACE_CALL_NONE;
+
      size_t n_char;
      PRINT_ERROR("cRosMessageParseServiceResponsePacket() : Error in service call response. 'ok' byte=%i. Error message='",client_proc->ok_byte);
      for(n_char=0;n_char<dynBufferGetSize(packet);n_char++)
@@ -1016,7 +1179,11 @@ cRosErrCodePack cRosMessagePrepareServiceResponsePacket( CrosNode *n, int server
 
   ret_err = cRosNodeDeserializeIncomingPacket(packet, service_context); // prepare the context incoming message used by the user callback function
   if(ret_err == CROS_SUCCESS_ERR_PACK)
+  {
+    int64_t cb_start = cRosNodeCallbackStart(&n->service_providers[srv_idx].cb_budget);
     ret_err = cRosNodeServiceProviderCallback(service_context); // calls the service-provider application-defined callback function
+    cRosNodeCallbackEnd(n, CROS_CALLBACK_SERVICE_PROVIDER, srv_idx, cb_start);
+  }
   else
     cRosPrintErrCodePack(ret_err, "cRosMessagePrepareServiceResponsePacket() failed decoding the received packet");
 
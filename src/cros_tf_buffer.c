@@ -0,0 +1,632 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cros_tf_buffer.h"
+#include "cros_api.h"
+#include "cros_defs.h"
+
+#define TF_INITIAL_N_FRAMES 16
+#define TF_INITIAL_N_BUCKETS 64
+
+// FNV-1a hash of a string
+static uint32_t hashName( const char *name )
+{
+  uint32_t hash = 2166136261u;
+
+  while( *name != '\0' )
+  {
+    hash ^= (unsigned char)*name;
+    hash *= 16777619u;
+    name++;
+  }
+  return hash;
+}
+
+// The frame ids are compared without their leading '/' (as tf2 does)
+static const char *stripFrameId( const char *frame_id )
+{
+  while( *frame_id == '/' )
+    frame_id++;
+  return frame_id;
+}
+
+// Index of the frame with the specified (stripped) id, or -1 if it is unknown
+static int findFrame( const CrosTfBuffer *buf, const char *name, uint32_t hash )
+{
+  int ind;
+
+  for( ind = buf->buckets[hash & (buf->n_buckets - 1)]; ind != -1; ind = buf->frames[ind].next_in_bucket )
+    if( buf->frames[ind].hash == hash && strcmp( buf->frames[ind].name, name ) == 0 )
+      return ind;
+  return -1;
+}
+
+static int rehashFrames( CrosTfBuffer *buf, int n_buckets )
+{
+  int *buckets, ind;
+
+  buckets = (int *)malloc( n_buckets * sizeof(int) );
+  if( buckets == NULL )
+    return 0;
+
+  for( ind = 0; ind < n_buckets; ind++ )
+    buckets[ind] = -1;
+  for( ind = 0; ind < buf->n_frames; ind++ )
+  {
+    size_t bucket = buf->frames[ind].hash & (n_buckets - 1);
+    buf->frames[ind].next_in_bucket = buckets[bucket];
+    buckets[bucket] = ind;
+  }
+
+  free( buf->buckets );
+  buf->buckets = buckets;
+  buf->n_buckets = n_buckets;
+  return 1;
+}
+
+// Index of the frame with the specified id, which is added if it is unknown. Return -1 if there is not enough memory
+static int getFrame( CrosTfBuffer *buf, const char *frame_id )
+{
+  const char *name = stripFrameId( frame_id );
+  uint32_t hash = hashName( name );
+  CrosTfFrame *frame;
+  size_t bucket;
+  int ind;
+
+  ind = findFrame( buf, name, hash );
+  if( ind != -1 )
+    return ind;
+
+  if( buf->n_frames == buf->frames_size )
+  {
+    CrosTfFrame *frames = (CrosTfFrame *)realloc( buf->frames, 2 * buf->frames_size * sizeof(CrosTfFrame) );
+    if( frames == NULL )
+      return -1;
+    buf->frames = frames;
+    buf->frames_size *= 2;
+  }
+
+  if( buf->n_frames >= buf->n_buckets && !rehashFrames( buf, 2 * buf->n_buckets ) )
+    return -1;
+
+  frame = &buf->frames[buf->n_frames];
+  memset( frame, 0, sizeof(CrosTfFrame) );
+  frame->name = strdup( name );
+  if( frame->name == NULL )
+    return -1;
+  frame->hash = hash;
+  frame->parent = -1;
+
+  bucket = hash & (buf->n_buckets - 1);
+  frame->next_in_bucket = buf->buckets[bucket];
+  buf->buckets[bucket] = buf->n_frames;
+  return buf->n_frames++;
+}
+
+// Transform of a frame at the specified position of its ring buffer (0 = oldest)
+static CrosTfSample *frameSample( const CrosTfFrame *frame, int pos )
+{
+  int ind = frame->first_sample + pos; // pos < samples_size, so it wraps around at most once (cheaper than %)
+
+  if( ind >= frame->samples_size )
+    ind -= frame->samples_size;
+  return &frame->samples[ind];
+}
+
+// Position of the first transform of the frame whose stamp is not older than stamp (n_samples if there is none)
+static int findFirstNotOlder( const CrosTfFrame *frame, int64_t stamp )
+{
+  int low = 0, high = frame->n_samples;
+
+  while( low < high )
+  {
+    int mid = low + (high - low) / 2;
+    if( frameSample( frame, mid )->stamp < stamp )
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+// Insert a transform in the ring buffer of a frame. Return 0 if it is discarded because it is older than all the buffered ones
+static int insertSample( CrosTfFrame *frame, int64_t stamp, const CrosTransform *transform )
+{
+  CrosTfSample *sample;
+  int pos, ind;
+
+  if( frame->is_static ) // Only the last transform is kept
+  {
+    frame->samples[0].stamp = stamp;
+    frame->samples[0].transform = *transform;
+    frame->first_sample = 0;
+    frame->n_samples = 1;
+    return 1;
+  }
+
+  pos = findFirstNotOlder( frame, stamp );
+  if( pos < frame->n_samples && frameSample( frame, pos )->stamp == stamp )
+  {
+    frameSample( frame, pos )->transform = *transform;
+    return 1;
+  }
+
+  if( frame->n_samples == frame->samples_size )
+  {
+    if( pos == 0 )
+      return 0;
+    frame->first_sample = (frame->first_sample + 1) % frame->samples_size; // Discard the oldest transform
+    frame->n_samples--;
+    pos--;
+  }
+
+  // The transforms normally arrive in order, so usually there are no newer transforms to shift
+  for( ind = frame->n_samples; ind > pos; ind-- )
+    *frameSample( frame, ind ) = *frameSample( frame, ind - 1 );
+
+  sample = frameSample( frame, pos );
+  sample->stamp = stamp;
+  sample->transform = *transform;
+  frame->n_samples++;
+  return 1;
+}
+
+static cRosErrCodePack setFrameTransform( CrosTfBuffer *buf, const char *parent_frame, const char *child_frame,
+                                          int64_t stamp, const CrosTransform *transform, int is_static )
+{
+  CrosTransform normalized = *transform;
+  CrosTfFrame *frame;
+  double norm;
+  int parent, child, ind;
+
+  norm = sqrt( normalized.rotation[0] * normalized.rotation[0] + normalized.rotation[1] * normalized.rotation[1] +
+               normalized.rotation[2] * normalized.rotation[2] + normalized.rotation[3] * normalized.rotation[3] );
+  if( !(norm > 1e-6) ) // Also rejects NaN
+    return CROS_BAD_PARAM_ERR;
+  for( ind = 0; ind < 4; ind++ )
+    normalized.rotation[ind] /= norm;
+
+  child = getFrame( buf, child_frame );
+  parent = getFrame( buf, parent_frame );
+  if( child == -1 || parent == -1 )
+    return CROS_MEM_ALLOC_ERR;
+  if( child == parent )
+    return CROS_BAD_PARAM_ERR;
+
+  frame = &buf->frames[child];
+  is_static = (is_static != 0);
+  if( frame->parent != parent || frame->is_static != is_static )
+  {
+    // The buffered transforms of the frame are relative to another parent or have another validity: discard them
+    int samples_size = (is_static)? 1 : buf->capacity;
+
+    if( frame->samples_size != samples_size )
+    {
+      CrosTfSample *samples = (CrosTfSample *)realloc( frame->samples, samples_size * sizeof(CrosTfSample) );
+      if( samples == NULL )
+        return CROS_MEM_ALLOC_ERR;
+      frame->samples = samples;
+      frame->samples_size = samples_size;
+    }
+
+    if( frame->parent != parent )
+    {
+      frame->parent = parent;
+      buf->tree_version++;
+    }
+    frame->is_static = is_static;
+    frame->first_sample = 0;
+    frame->n_samples = 0;
+  }
+
+  if( insertSample( frame, stamp, &normalized ) )
+    buf->n_transforms++;
+  else
+    buf->n_discarded_transforms++;
+
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+// Decode the transforms of a tf2_msgs/TFMessage into the ring buffers. The fields are accessed by position, since their
+// order is fixed by the MD5 sum of the message types checked when the subscriber connects
+static void insertTfMessage( CrosTfBuffer *buf, cRosMessage *msg, int is_static )
+{
+  cRosMessageField *transforms_field;
+  int ind;
+
+  if( msg->n_fields != 1 || !msg->fields[0]->is_array )
+  {
+    buf->n_discarded_transforms++;
+    return;
+  }
+
+  transforms_field = msg->fields[0]; // transforms (geometry_msgs/TransformStamped[])
+  for( ind = 0; ind < transforms_field->array_size; ind++ )
+  {
+    cRosMessage *transform_msg = transforms_field->data.as_msg_array[ind];
+    cRosMessage *header, *time_msg, *translation, *rotation;
+    CrosTransform transform;
+    int64_t stamp;
+
+    if( transform_msg == NULL || transform_msg->n_fields != 3 ) // Fields: header, child_frame_id and transform
+    {
+      buf->n_discarded_transforms++;
+      continue;
+    }
+
+    header = transform_msg->fields[0]->data.as_msg; // Fields: seq, stamp and frame_id
+    time_msg = header->fields[1]->data.as_msg; // Fields: secs and nsecs
+    stamp = (int64_t)time_msg->fields[0]->data.as_uint32 * 1000000000 + time_msg->fields[1]->data.as_uint32;
+
+    translation = transform_msg->fields[2]->data.as_msg->fields[0]->data.as_msg; // Fields: x, y and z
+    rotation = transform_msg->fields[2]->data.as_msg->fields[1]->data.as_msg; // Fields: x, y, z and w
+    transform.translation[0] = translation->fields[0]->data.as_float64;
+    transform.translation[1] = translation->fields[1]->data.as_float64;
+    transform.translation[2] = translation->fields[2]->data.as_float64;
+    transform.rotation[0] = rotation->fields[0]->data.as_float64;
+    transform.rotation[1] = rotation->fields[1]->data.as_float64;
+    transform.rotation[2] = rotation->fields[2]->data.as_float64;
+    transform.rotation[3] = rotation->fields[3]->data.as_float64;
+
+    if( setFrameTransform( buf, header->fields[2]->data.as_string, transform_msg->fields[1]->data.as_string,
+                           stamp, &transform, is_static ) != CROS_SUCCESS_ERR_PACK )
+      buf->n_discarded_transforms++;
+  }
+}
+
+static CallbackResponse tfSubscriberCallback( cRosMessage *msg, void *context )
+{
+  insertTfMessage( (CrosTfBuffer *)context, msg, 0 );
+  return 0;
+}
+
+static CallbackResponse tfStaticSubscriberCallback( cRosMessage *msg, void *context )
+{
+  insertTfMessage( (CrosTfBuffer *)context, msg, 1 );
+  return 0;
+}
+
+// out = q * v * conj(q). out may be v
+static void rotateVector( const double q[4], const double v[3], double out[3] )
+{
+  double tx = 2.0 * (q[1] * v[2] - q[2] * v[1]);
+  double ty = 2.0 * (q[2] * v[0] - q[0] * v[2]);
+  double tz = 2.0 * (q[0] * v[1] - q[1] * v[0]);
+  double x = v[0] + q[3] * tx + (q[1] * tz - q[2] * ty);
+  double y = v[1] + q[3] * ty + (q[2] * tx - q[0] * tz);
+  double z = v[2] + q[3] * tz + (q[0] * ty - q[1] * tx);
+
+  out[0] = x;
+  out[1] = y;
+  out[2] = z;
+}
+
+// out = a * b: the transform that applies b and then a. out may be a or b
+static void composeTransforms( const CrosTransform *a, const CrosTransform *b, CrosTransform *out )
+{
+  const double *qa = a->rotation, *qb = b->rotation;
+  double rotation[4], translation[3];
+
+  rotation[0] = qa[3] * qb[0] + qa[0] * qb[3] + qa[1] * qb[2] - qa[2] * qb[1];
+  rotation[1] = qa[3] * qb[1] - qa[0] * qb[2] + qa[1] * qb[3] + qa[2] * qb[0];
+  rotation[2] = qa[3] * qb[2] + qa[0] * qb[1] - qa[1] * qb[0] + qa[2] * qb[3];
+  rotation[3] = qa[3] * qb[3] - qa[0] * qb[0] - qa[1] * qb[1] - qa[2] * qb[2];
+  rotateVector( qa, b->translation, translation );
+  translation[0] += a->translation[0];
+  translation[1] += a->translation[1];
+  translation[2] += a->translation[2];
+
+  memcpy( out->rotation, rotation, sizeof(rotation) );
+  memcpy( out->translation, translation, sizeof(translation) );
+}
+
+static void invertTransform( const CrosTransform *transform, CrosTransform *out )
+{
+  out->rotation[0] = -transform->rotation[0];
+  out->rotation[1] = -transform->rotation[1];
+  out->rotation[2] = -transform->rotation[2];
+  out->rotation[3] = transform->rotation[3];
+  rotateVector( out->rotation, transform->translation, out->translation );
+  out->translation[0] = -out->translation[0];
+  out->translation[1] = -out->translation[1];
+  out->translation[2] = -out->translation[2];
+}
+
+static void setIdentityTransform( CrosTransform *transform )
+{
+  memset( transform, 0, sizeof(CrosTransform) );
+  transform->rotation[3] = 1.0;
+}
+
+// Spherical linear interpolation between two unit quaternions
+static void slerpRotation( const double q0[4], const double q1[4], double ratio, double out[4] )
+{
+  double dot = q0[0] * q1[0] + q0[1] * q1[1] + q0[2] * q1[2] + q0[3] * q1[3];
+  double sign = 1.0, w0, w1;
+  int ind;
+
+  if( dot < 0.0 ) // q1 and -q1 are the same rotation: take the shortest arc
+  {
+    dot = -dot;
+    sign = -1.0;
+  }
+
+  if( dot > 0.9995 ) // Nearly equal rotations: linear interpolation (normalized below) avoids dividing by sin(~0)
+  {
+    w0 = 1.0 - ratio;
+    w1 = ratio;
+  }
+  else
+  {
+    double theta = acos( dot ), sin_theta = sin( theta );
+    w0 = sin( (1.0 - ratio) * theta ) / sin_theta;
+    w1 = sin( ratio * theta ) / sin_theta;
+  }
+
+  for( ind = 0; ind < 4; ind++ )
+    out[ind] = w0 * q0[ind] + sign * w1 * q1[ind];
+
+  if( dot > 0.9995 )
+  {
+    double norm = sqrt( out[0] * out[0] + out[1] * out[1] + out[2] * out[2] + out[3] * out[3] );
+    for( ind = 0; ind < 4; ind++ )
+      out[ind] /= norm;
+  }
+}
+
+// Transform of a frame to its parent at the specified time. Return 0 if time is out of the range of the buffered transforms
+static int interpolateFrameTransform( const CrosTfFrame *frame, int64_t time, CrosTransform *transform )
+{
+  const CrosTfSample *older, *newer;
+  double ratio;
+  int pos;
+
+  if( frame->is_static )
+  {
+    *transform = frame->samples[0].transform;
+    return 1;
+  }
+
+  pos = findFirstNotOlder( frame, time );
+  if( pos == frame->n_samples )
+    return 0;
+
+  newer = frameSample( frame, pos );
+  if( newer->stamp == time )
+  {
+    *transform = newer->transform;
+    return 1;
+  }
+  if( pos == 0 )
+    return 0;
+
+  older = frameSample( frame, pos - 1 );
+  ratio = (double)(time - older->stamp) / (double)(newer->stamp - older->stamp);
+  transform->translation[0] = older->transform.translation[0] + ratio * (newer->transform.translation[0] - older->transform.translation[0]);
+  transform->translation[1] = older->transform.translation[1] + ratio * (newer->transform.translation[1] - older->transform.translation[1]);
+  transform->translation[2] = older->transform.translation[2] + ratio * (newer->transform.translation[2] - older->transform.translation[2]);
+  slerpRotation( older->transform.rotation, newer->transform.rotation, ratio, transform->rotation );
+  return 1;
+}
+
+// Obtain the frames between source and target (from the cache if the transform tree has not changed since it was stored)
+static cRosErrCodePack getFramePath( CrosTfBuffer *buf, int source, int target, const CrosTfPath **path_ptr )
+{
+  CrosTfPath *path = &buf->path_cache[((unsigned)source * 31u + (unsigned)target) % CROS_TF_PATH_CACHE_SIZE];
+  int *source_frames = path->frames, *target_frames = path->frames + CROS_TF_MAX_TREE_DEPTH;
+  int n_source_frames = 0, n_target_frames = 0, frame_ind;
+
+  if( path->source == source && path->target == target && path->tree_version == buf->tree_version )
+  {
+    *path_ptr = path;
+    return CROS_SUCCESS_ERR_PACK;
+  }
+
+  path->source = -1; // The entry is overwritten
+
+  // Frames from source up to the root of its tree (included)
+  for( frame_ind = source; frame_ind != -1; frame_ind = buf->frames[frame_ind].parent )
+  {
+    if( n_source_frames == CROS_TF_MAX_TREE_DEPTH )
+    {
+      PRINT_ERROR( "getFramePath() : The transform tree of the frame %s is too deep or it has a loop\n", buf->frames[source].name );
+      return CROS_TF_CONNECTIVITY_ERR;
+    }
+    source_frames[n_source_frames++] = frame_ind;
+  }
+
+  // Frames from target up to the first one that is also an ancestor of source
+  for( frame_ind = target; frame_ind != -1; frame_ind = buf->frames[frame_ind].parent )
+  {
+    int ind;
+
+    for( ind = 0; ind < n_source_frames; ind++ )
+    {
+      if( source_frames[ind] == frame_ind )
+      {
+        path->source = source;
+        path->target = target;
+        path->tree_version = buf->tree_version;
+        path->n_source_frames = ind;
+        path->n_target_frames = n_target_frames;
+        *path_ptr = path;
+        return CROS_SUCCESS_ERR_PACK;
+      }
+    }
+
+    if( n_target_frames == CROS_TF_MAX_TREE_DEPTH )
+    {
+      PRINT_ERROR( "getFramePath() : The transform tree of the frame %s is too deep or it has a loop\n", buf->frames[target].name );
+      return CROS_TF_CONNECTIVITY_ERR;
+    }
+    target_frames[n_target_frames++] = frame_ind;
+  }
+
+  return CROS_TF_CONNECTIVITY_ERR;
+}
+
+// Latest time for which the transforms of all the (non-static) frames of the list are available (0 if all are static)
+static int64_t getLatestCommonTime( const CrosTfBuffer *buf, const int *frames, int n_frames, int64_t latest_time )
+{
+  int ind;
+
+  for( ind = 0; ind < n_frames; ind++ )
+  {
+    const CrosTfFrame *frame = &buf->frames[frames[ind]];
+    if( !frame->is_static )
+    {
+      int64_t newest_stamp = frameSample( frame, frame->n_samples - 1 )->stamp;
+      if( latest_time == 0 || newest_stamp < latest_time )
+        latest_time = newest_stamp;
+    }
+  }
+  return latest_time;
+}
+
+// Transform from the first frame of the list to the parent of the last one
+static int composeFrameTransforms( const CrosTfBuffer *buf, const int *frames, int n_frames, int64_t time, CrosTransform *transform )
+{
+  CrosTransform frame_transform;
+  int ind;
+
+  setIdentityTransform( transform );
+  for( ind = 0; ind < n_frames; ind++ )
+  {
+    if( !interpolateFrameTransform( &buf->frames[frames[ind]], time, &frame_transform ) )
+      return 0;
+    composeTransforms( &frame_transform, transform, transform );
+  }
+  return 1;
+}
+
+cRosErrCodePack cRosTfBufferCreate( CrosNode *node, int capacity, CrosTfBuffer **buf_ptr )
+{
+  CrosTfBuffer *buf;
+  cRosErrCodePack ret_err = CROS_SUCCESS_ERR_PACK;
+  int ind;
+
+  PRINT_VVDEBUG ( "cRosTfBufferCreate()\n" );
+
+  if( capacity < 1 || buf_ptr == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  buf = (CrosTfBuffer *)calloc( 1, sizeof(CrosTfBuffer) );
+  if( buf == NULL )
+    return CROS_MEM_ALLOC_ERR;
+
+  buf->node = node;
+  buf->tf_subidx = -1;
+  buf->tf_static_subidx = -1;
+  buf->capacity = capacity;
+  for( ind = 0; ind < CROS_TF_PATH_CACHE_SIZE; ind++ )
+    buf->path_cache[ind].source = -1;
+
+  buf->frames = (CrosTfFrame *)malloc( TF_INITIAL_N_FRAMES * sizeof(CrosTfFrame) );
+  buf->frames_size = TF_INITIAL_N_FRAMES;
+  if( buf->frames == NULL || !rehashFrames( buf, TF_INITIAL_N_BUCKETS ) )
+  {
+    cRosTfBufferDestroy( buf );
+    return CROS_MEM_ALLOC_ERR;
+  }
+
+  if( node != NULL )
+  {
+    ret_err = cRosApiRegisterSubscriber( node, "/tf", "tf2_msgs/TFMessage", tfSubscriberCallback, NULL, buf, 0,
+                                         &buf->tf_subidx );
+    if( ret_err == CROS_SUCCESS_ERR_PACK )
+      ret_err = cRosApiRegisterSubscriber( node, "/tf_static", "tf2_msgs/TFMessage", tfStaticSubscriberCallback, NULL,
+                                           buf, 0, &buf->tf_static_subidx );
+    if( ret_err != CROS_SUCCESS_ERR_PACK )
+    {
+      cRosPrintErrCodePack( ret_err, "cRosTfBufferCreate() : The subscribers of the transform buffer could not be created" );
+      cRosTfBufferDestroy( buf );
+      return ret_err;
+    }
+  }
+
+  *buf_ptr = buf;
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+void cRosTfBufferDestroy( CrosTfBuffer *buf )
+{
+  int ind;
+
+  PRINT_VVDEBUG ( "cRosTfBufferDestroy()\n" );
+
+  if( buf == NULL )
+    return;
+
+  if( buf->tf_subidx != -1 )
+    cRosApiUnregisterSubscriber( buf->node, buf->tf_subidx );
+  if( buf->tf_static_subidx != -1 )
+    cRosApiUnregisterSubscriber( buf->node, buf->tf_static_subidx );
+
+  for( ind = 0; ind < buf->n_frames; ind++ )
+  {
+    free( buf->frames[ind].name );
+    free( buf->frames[ind].samples );
+  }
+  free( buf->frames );
+  free( buf->buckets );
+  free( buf );
+}
+
+cRosErrCodePack cRosTfBufferSetTransform( CrosTfBuffer *buf, const char *parent_frame, const char *child_frame,
+                                          int64_t stamp, const CrosTransform *transform, int is_static )
+{
+  PRINT_VVDEBUG ( "cRosTfBufferSetTransform()\n" );
+
+  if( buf == NULL || parent_frame == NULL || child_frame == NULL || transform == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  return setFrameTransform( buf, parent_frame, child_frame, stamp, transform, is_static );
+}
+
+cRosErrCodePack cRosTfBufferLookup( CrosTfBuffer *buf, const char *target_frame, const char *source_frame, int64_t time,
+                                    CrosTransform *transform )
+{
+  CrosTransform source_transform, target_transform;
+  const CrosTfPath *path;
+  const char *name;
+  cRosErrCodePack ret_err;
+  int source, target;
+
+  PRINT_VVDEBUG ( "cRosTfBufferLookup()\n" );
+
+  if( buf == NULL || target_frame == NULL || source_frame == NULL || transform == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  name = stripFrameId( source_frame );
+  source = findFrame( buf, name, hashName( name ) );
+  name = stripFrameId( target_frame );
+  target = findFrame( buf, name, hashName( name ) );
+  if( source == -1 || target == -1 )
+    return CROS_TF_CONNECTIVITY_ERR;
+
+  if( source == target )
+  {
+    setIdentityTransform( transform );
+    return CROS_SUCCESS_ERR_PACK;
+  }
+
+  ret_err = getFramePath( buf, source, target, &path );
+  if( ret_err != CROS_SUCCESS_ERR_PACK )
+    return ret_err;
+
+  if( time == 0 )
+  {
+    time = getLatestCommonTime( buf, path->frames, path->n_source_frames, 0 );
+    time = getLatestCommonTime( buf, path->frames + CROS_TF_MAX_TREE_DEPTH, path->n_target_frames, time );
+  }
+
+  // Both transforms convert into the common ancestor of the frames
+  if( !composeFrameTransforms( buf, path->frames, path->n_source_frames, time, &source_transform ) ||
+      !composeFrameTransforms( buf, path->frames + CROS_TF_MAX_TREE_DEPTH, path->n_target_frames, time, &target_transform ) )
+    return CROS_TF_EXTRAPOLATION_ERR;
+
+  invertTransform( &target_transform, &target_transform );
+  composeTransforms( &target_transform, &source_transform, transform );
+  return CROS_SUCCESS_ERR_PACK;
+}
@@ -0,0 +1,251 @@
+#include "cros_thread.h"
+#include "cros_defs.h"
+
+int cRosMutexInit( cRosMutex *m )
+{
+  PRINT_VVDEBUG ( "cRosMutexInit()\n" );
+
+#ifdef _WIN32
+  InitializeCriticalSection( &(m->cs) );
+  return(1);
+#else
+  if( pthread_mutex_init( &(m->mtx), NULL ) != 0 )
+  {
+    PRINT_ERROR ( "cRosMutexInit() : pthread_mutex_init() failed\n" );
+    return(0);
+  }
+  return(1);
+#endif
+}
+
+void cRosMutexLock( cRosMutex *m )
+{
+#ifdef _WIN32
+  EnterCriticalSection( &(m->cs) );
+#else
+  pthread_mutex_lock( &(m->mtx) );
+#endif
+}
+
+void cRosMutexUnlock( cRosMutex *m )
+{
+#ifdef _WIN32
+  LeaveCriticalSection( &(m->cs) );
+#else
+  pthread_mutex_unlock( &(m->mtx) );
+#endif
+}
+
+#ifdef _WIN32
+static DWORD WINAPI threadStart( LPVOID t_ptr )
+{
+  cRosThread *t = (cRosThread *)t_ptr;
+  t->func( t->arg );
+  return 0;
+}
+#else
+static void *threadStart( void *t_ptr )
+{
+  cRosThread *t = (cRosThread *)t_ptr;
+  t->func( t->arg );
+  return NULL;
+}
+#endif
+
+void cRosMutexRelease( cRosMutex *m )
+{
+  PRINT_VVDEBUG ( "cRosMutexRelease()\n" );
+
+#ifdef _WIN32
+  DeleteCriticalSection( &(m->cs) );
+#else
+  pthread_mutex_destroy( &(m->mtx) );
+#endif
+}
+
+int cRosThreadCreate( cRosThread *t, cRosThreadFunc func, void *arg )
+{
+  PRINT_VVDEBUG ( "cRosThreadCreate()\n" );
+
+  t->func = func;
+  t->arg = arg;
+#ifdef _WIN32
+  t->handle = CreateThread( NULL, 0, threadStart, t, 0, NULL );
+  if( t->handle == NULL )
+  {
+    PRINT_ERROR ( "cRosThreadCreate() : CreateThread() failed\n" );
+    return(0);
+  }
+  return(1);
+#else
+  if( pthread_create( &(t->tid), NULL, threadStart, t ) != 0 )
+  {
+    PRINT_ERROR ( "cRosThreadCreate() : pthread_create() failed\n" );
+    return(0);
+  }
+  return(1);
+#endif
+}
+
+void cRosThreadJoin( cRosThread *t )
+{
+  PRINT_VVDEBUG ( "cRosThreadJoin()\n" );
+
+#ifdef _WIN32
+  WaitForSingleObject( t->handle, INFINITE );
+  CloseHandle( t->handle );
+#else
+  pthread_join( t->tid, NULL );
+#endif
+}
+
+int cRosConditionInit( cRosCondition *c )
+{
+  PRINT_VVDEBUG ( "cRosConditionInit()\n" );
+
+#ifdef _WIN32
+  InitializeConditionVariable( &(c->cv) );
+  return(1);
+#else
+  if( pthread_cond_init( &(c->cv), NULL ) != 0 )
+  {
+    PRINT_ERROR ( "cRosConditionInit() : pthread_cond_init() failed\n" );
+    return(0);
+  }
+  return(1);
+#endif
+}
+
+void cRosConditionWait( cRosCondition *c, cRosMutex *m )
+{
+#ifdef _WIN32
+  SleepConditionVariableCS( &(c->cv), &(m->cs), INFINITE );
+#else
+  pthread_cond_wait( &(c->cv), &(m->mtx) );
+#endif
+}
+
+void cRosConditionBroadcast( cRosCondition *c )
+{
+#ifdef _WIN32
+  WakeAllConditionVariable( &(c->cv) );
+#else
+  pthread_cond_broadcast( &(c->cv) );
+#endif
+}
+
+void cRosConditionRelease( cRosCondition *c )
+{
+  PRINT_VVDEBUG ( "cRosConditionRelease()\n" );
+
+#ifndef _WIN32 // Windows condition variables do not need to be deleted
+  pthread_cond_destroy( &(c->cv) );
+#endif
+}
+
+// Take the tasks of the current batch of the pool until all of them have been taken. The pool lock must be held
+static void runPoolTasks( cRosThreadPool *pool )
+{
+  while( pool->next_task < pool->n_tasks )
+  {
+    void *task = pool->tasks + pool->task_size * pool->next_task++;
+    cRosMutexUnlock( &(pool->lock) );
+    pool->func( task );
+    cRosMutexLock( &(pool->lock) );
+    if( --pool->n_pending == 0 )
+      cRosConditionBroadcast( &(pool->tasks_done) );
+  }
+}
+
+static void poolWorker( void *pool_ptr )
+{
+  cRosThreadPool *pool = (cRosThreadPool *)pool_ptr;
+
+  cRosMutexLock( &(pool->lock) );
+  while( !pool->stop )
+  {
+    if( pool->next_task < pool->n_tasks )
+      runPoolTasks( pool );
+    else
+      cRosConditionWait( &(pool->tasks_ready), &(pool->lock) );
+  }
+  cRosMutexUnlock( &(pool->lock) );
+}
+
+int cRosThreadPoolCreate( cRosThreadPool *pool, int n_threads )
+{
+  PRINT_VVDEBUG ( "cRosThreadPoolCreate()\n" );
+
+  if( n_threads > CROS_THREAD_POOL_MAX_THREADS )
+    n_threads = CROS_THREAD_POOL_MAX_THREADS;
+  pool->n_threads = 0;
+  pool->func = NULL;
+  pool->tasks = NULL;
+  pool->task_size = 0;
+  pool->n_tasks = 0;
+  pool->next_task = 0;
+  pool->n_pending = 0;
+  pool->busy = 0;
+  pool->stop = 0;
+  if( !cRosMutexInit( &(pool->lock) ) )
+    return(0);
+  if( !cRosConditionInit( &(pool->tasks_ready) ) )
+  {
+    cRosMutexRelease( &(pool->lock) );
+    return(0);
+  }
+  if( !cRosConditionInit( &(pool->tasks_done) ) )
+  {
+    cRosConditionRelease( &(pool->tasks_ready) );
+    cRosMutexRelease( &(pool->lock) );
+    return(0);
+  }
+  while( pool->n_threads < n_threads && cRosThreadCreate( &(pool->threads[pool->n_threads]), poolWorker, pool ) )
+    pool->n_threads++;
+  return(1);
+}
+
+void cRosThreadPoolRun( cRosThreadPool *pool, cRosThreadFunc func, void *tasks, size_t task_size, int n_tasks )
+{
+  int task_ind;
+
+  cRosMutexLock( &(pool->lock) );
+  if( pool->busy ) // Another thread is using the workers
+  {
+    cRosMutexUnlock( &(pool->lock) );
+    for( task_ind = 0; task_ind < n_tasks; task_ind++ )
+      func( (unsigned char *)tasks + task_size * task_ind );
+    return;
+  }
+  pool->busy = 1;
+  pool->func = func;
+  pool->tasks = (unsigned char *)tasks;
+  pool->task_size = task_size;
+  pool->n_tasks = n_tasks;
+  pool->next_task = 0;
+  pool->n_pending = n_tasks;
+  cRosConditionBroadcast( &(pool->tasks_ready) );
+  runPoolTasks( pool ); // The calling thread runs tasks too
+  while( pool->n_pending > 0 )
+    cRosConditionWait( &(pool->tasks_done), &(pool->lock) );
+  pool->busy = 0;
+  cRosMutexUnlock( &(pool->lock) );
+}
+
+void cRosThreadPoolDestroy( cRosThreadPool *pool )
+{
+  int thread_ind;
+
+  PRINT_VVDEBUG ( "cRosThreadPoolDestroy()\n" );
+
+  cRosMutexLock( &(pool->lock) );
+  pool->stop = 1;
+  cRosConditionBroadcast( &(pool->tasks_ready) );
+  cRosMutexUnlock( &(pool->lock) );
+  for( thread_ind = 0; thread_ind < pool->n_threads; thread_ind++ )
+    cRosThreadJoin( &(pool->threads[thread_ind]) );
+  pool->n_threads = 0;
+  cRosConditionRelease( &(pool->tasks_done) );
+  cRosConditionRelease( &(pool->tasks_ready) );
+  cRosMutexRelease( &(pool->lock) );
+}
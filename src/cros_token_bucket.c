@@ -0,0 +1,53 @@
+#include "cros_token_bucket.h"
+#include "cros_defs.h"
+
+static void refillTokenBucket( CrosTokenBucket *b, uint64_t cur_time )
+{
+  int64_t max_tokens = (int64_t)b->burst * 1000;
+
+  if( cur_time > b->last_update_time )
+  {
+    b->tokens += (int64_t)b->byte_rate * (int64_t)(cur_time - b->last_update_time); // bytes/s * ms = thousandths of byte
+    if( b->tokens > max_tokens )
+      b->tokens = max_tokens;
+  }
+  b->last_update_time = cur_time;
+}
+
+void cRosTokenBucketInit( CrosTokenBucket *b, uint32_t byte_rate, uint32_t burst, uint64_t cur_time )
+{
+  PRINT_VVDEBUG ( "cRosTokenBucketInit()\n" );
+
+  b->byte_rate = byte_rate;
+  b->burst = burst;
+  b->tokens = (int64_t)burst * 1000;
+  b->last_update_time = cur_time;
+}
+
+int cRosTokenBucketIsEnabled( CrosTokenBucket *b )
+{
+  return( b->byte_rate != 0 );
+}
+
+int cRosTokenBucketReady( CrosTokenBucket *b, uint64_t cur_time )
+{
+  if( b->byte_rate == 0 )
+    return(1);
+
+  refillTokenBucket( b, cur_time );
+  return( b->tokens >= 0 );
+}
+
+void cRosTokenBucketConsume( CrosTokenBucket *b, size_t n_bytes )
+{
+  if( b->byte_rate != 0 )
+    b->tokens -= (int64_t)n_bytes * 1000;
+}
+
+uint64_t cRosTokenBucketWaitTime( CrosTokenBucket *b, uint64_t cur_time )
+{
+  if( cRosTokenBucketReady( b, cur_time ) )
+    return(0);
+
+  return( (uint64_t)((-b->tokens + b->byte_rate - 1) / b->byte_rate) ); // Round up, so that the bucket is not in debt after waiting
+}
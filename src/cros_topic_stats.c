@@ -0,0 +1,74 @@
+#include <math.h>
+
+#include "cros_topic_stats.h"
+#include "cros_clock.h"
+#include "cros_defs.h"
+
+static void clearStatsMoments( CrosStatsMoments *m )
+{
+  m->n = 0;
+  m->mean = 0.0;
+  m->m2 = 0.0;
+  m->max = 0.0;
+}
+
+static void addStatsSample( CrosStatsMoments *m, double sample )
+{
+  double delta = sample - m->mean;
+
+  m->n++;
+  m->mean += delta / m->n;
+  m->m2 += delta * (sample - m->mean);
+  if( m->n == 1 || sample > m->max )
+    m->max = sample;
+}
+
+void cRosTopicStatsInit( CrosTopicStats *s, uint64_t cur_time )
+{
+  PRINT_VVDEBUG ( "cRosTopicStatsInit()\n" );
+
+  s->last_arrival = 0;
+  s->last_seq = 0;
+  s->last_seq_valid = 0;
+  cRosTopicStatsStartWindow( s, cur_time );
+}
+
+void cRosTopicStatsStartWindow( CrosTopicStats *s, uint64_t cur_time )
+{
+  s->window_start = cur_time;
+  s->delivered_msgs = 0;
+  s->dropped_msgs = 0;
+  s->traffic = 0;
+  clearStatsMoments( &s->period );
+  clearStatsMoments( &s->stamp_age );
+}
+
+void cRosTopicStatsAddMessage( CrosTopicStats *s, size_t n_bytes, int64_t arrival_time_stamp )
+{
+  s->delivered_msgs++;
+  s->traffic += n_bytes;
+  if( s->last_arrival != 0 )
+    addStatsSample( &s->period, cRosClockTimeStampToUSec( arrival_time_stamp - s->last_arrival ) );
+  s->last_arrival = arrival_time_stamp;
+}
+
+void cRosTopicStatsAddHeader( CrosTopicStats *s, uint32_t seq, double stamp_age )
+{
+  if( s->last_seq_valid )
+  {
+    int32_t gap = (int32_t)(seq - s->last_seq - 1);
+    if( gap > 0 ) // A negative gap means that the publisher has restarted its sequence
+      s->dropped_msgs += (uint32_t)gap;
+  }
+  s->last_seq = seq;
+  s->last_seq_valid = 1;
+
+  addStatsSample( &s->stamp_age, stamp_age );
+}
+
+void cRosStatsMomentsGet( const CrosStatsMoments *m, double *mean, double *stddev, double *max )
+{
+  *mean = m->mean;
+  *stddev = (m->n > 1)? sqrt( m->m2 / m->n ): 0.0;
+  *max = m->max;
+}
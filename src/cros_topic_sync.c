@@ -0,0 +1,241 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "cros_topic_sync.h"
+#include "cros_api.h"
+#include "cros_defs.h"
+
+// Obtain the stamp (in nsec) of a message that starts with a std_msgs/Header. Return 0 if it does not start with a header
+static int getMessageStamp( cRosMessage *msg, int64_t *stamp )
+{
+  cRosMessage *header, *time_msg;
+
+  if( msg == NULL || msg->n_fields == 0 || msg->fields[0]->type != CROS_STD_MSGS_HEADER || msg->fields[0]->is_array )
+    return 0;
+
+  header = msg->fields[0]->data.as_msg; // Fields: seq, stamp and frame_id
+  time_msg = header->fields[1]->data.as_msg; // Fields: secs and nsecs
+  *stamp = (int64_t)time_msg->fields[0]->data.as_uint32 * 1000000000 + time_msg->fields[1]->data.as_uint32;
+  return 1;
+}
+
+// Index of the first message of the queue whose stamp is not older than stamp (n_msgs if there is none)
+static int findFirstNotOlder( const CrosTopicSyncQueue *queue, int64_t stamp )
+{
+  int low = 0, high = queue->n_msgs;
+
+  while( low < high )
+  {
+    int mid = low + (high - low) / 2;
+    if( queue->stamps[mid] < stamp )
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+// Index of the message of the queue (which must not be empty) whose stamp is the nearest to stamp
+static int findNearest( const CrosTopicSyncQueue *queue, int64_t stamp )
+{
+  int ind = findFirstNotOlder( queue, stamp );
+
+  if( ind == queue->n_msgs || (ind > 0 && stamp - queue->stamps[ind-1] <= queue->stamps[ind] - stamp) )
+    ind--;
+  return ind;
+}
+
+// Give back to the subscriber the first n_msgs messages of a queue
+static void releaseOldestMessages( CrosTopicSync *sync, CrosTopicSyncQueue *queue, int n_msgs )
+{
+  int msg_ind;
+
+  for( msg_ind = 0; msg_ind < n_msgs; msg_ind++ )
+    cRosApiReleaseSubscriberMessage( sync->node, queue->subidx, queue->msgs[msg_ind] );
+
+  queue->n_msgs -= n_msgs;
+  memmove( queue->msgs, queue->msgs + n_msgs, queue->n_msgs * sizeof(cRosMessage *) );
+  memmove( queue->stamps, queue->stamps + n_msgs, queue->n_msgs * sizeof(int64_t) );
+}
+
+// Look for a set of messages that includes the message of the topic new_queue at position new_ind, and report it
+static void matchMessages( CrosTopicSync *sync, CrosTopicSyncQueue *new_queue, int new_ind )
+{
+  int64_t stamp = new_queue->stamps[new_ind], min_stamp = stamp, max_stamp = stamp;
+  int matched_inds[CROS_TOPIC_SYNC_MAX_TOPICS];
+  int topic_ind;
+
+  for( topic_ind = 0; topic_ind < sync->n_topics; topic_ind++ )
+  {
+    CrosTopicSyncQueue *queue = &sync->queues[topic_ind];
+    int ind;
+
+    if( queue == new_queue )
+    {
+      matched_inds[topic_ind] = new_ind;
+      continue;
+    }
+    if( queue->n_msgs == 0 )
+      return;
+
+    ind = findNearest( queue, stamp );
+    if( sync->policy == CROS_TOPIC_SYNC_EXACT && queue->stamps[ind] != stamp )
+      return;
+    if( queue->stamps[ind] < min_stamp )
+      min_stamp = queue->stamps[ind];
+    if( queue->stamps[ind] > max_stamp )
+      max_stamp = queue->stamps[ind];
+    matched_inds[topic_ind] = ind;
+  }
+
+  if( (uint64_t)(max_stamp - min_stamp) > sync->max_interval && sync->policy == CROS_TOPIC_SYNC_APPROXIMATE )
+    return;
+
+  for( topic_ind = 0; topic_ind < sync->n_topics; topic_ind++ )
+    sync->matched[topic_ind] = sync->queues[topic_ind].msgs[matched_inds[topic_ind]];
+  sync->n_sets++;
+  sync->callback( sync->matched, sync->n_topics, sync->context );
+
+  // The messages older than the matched ones cannot be part of a later set
+  for( topic_ind = 0; topic_ind < sync->n_topics; topic_ind++ )
+  {
+    CrosTopicSyncQueue *queue = &sync->queues[topic_ind];
+    queue->last_matched_stamp = queue->stamps[matched_inds[topic_ind]];
+    sync->n_discarded_msgs += matched_inds[topic_ind];
+    releaseOldestMessages( sync, queue, matched_inds[topic_ind] + 1 );
+  }
+}
+
+static CallbackResponse syncSubscriberCallback( cRosMessage *msg, void *context )
+{
+  CrosTopicSyncQueue *queue = (CrosTopicSyncQueue *)context;
+  CrosTopicSync *sync = queue->sync;
+  cRosMessage *retained_msg;
+  int64_t stamp;
+  int ind;
+
+  if( !getMessageStamp( msg, &stamp ) )
+  {
+    PRINT_ERROR( "syncSubscriberCallback() : The synchronized messages must start with a std_msgs/Header\n" );
+    sync->n_discarded_msgs++;
+    return 0;
+  }
+
+  if( stamp <= queue->last_matched_stamp ) // Too late: a newer message of this topic has been already matched
+  {
+    sync->n_discarded_msgs++;
+    return 0;
+  }
+
+  if( queue->n_msgs == sync->queue_size )
+  {
+    if( stamp < queue->stamps[0] ) // Older than all the waiting messages
+    {
+      sync->n_discarded_msgs++;
+      return 0;
+    }
+    releaseOldestMessages( sync, queue, 1 );
+    sync->n_discarded_msgs++;
+  }
+
+  retained_msg = cRosApiRetainSubscriberMessage( sync->node, queue->subidx );
+  if( retained_msg == NULL )
+  {
+    sync->n_discarded_msgs++;
+    return 0;
+  }
+
+  // Keep the queue sorted. The messages usually arrive in order, so the new one is normally inserted at the end
+  ind = findFirstNotOlder( queue, stamp + 1 );
+  memmove( queue->msgs + ind + 1, queue->msgs + ind, (queue->n_msgs - ind) * sizeof(cRosMessage *) );
+  memmove( queue->stamps + ind + 1, queue->stamps + ind, (queue->n_msgs - ind) * sizeof(int64_t) );
+  queue->msgs[ind] = retained_msg;
+  queue->stamps[ind] = stamp;
+  queue->n_msgs++;
+
+  matchMessages( sync, queue, ind );
+  return 0;
+}
+
+cRosErrCodePack cRosTopicSyncCreate( CrosNode *node, const char **topic_names, const char **topic_types, int n_topics,
+                                     CrosTopicSyncPolicy policy, uint64_t max_interval, int queue_size,
+                                     CrosTopicSyncCallback callback, void *context, CrosTopicSync **sync_ptr )
+{
+  CrosTopicSync *sync;
+  cRosErrCodePack ret_err = CROS_SUCCESS_ERR_PACK;
+  int topic_ind;
+
+  PRINT_VVDEBUG ( "cRosTopicSyncCreate()\n" );
+
+  if( node == NULL || topic_names == NULL || topic_types == NULL || n_topics < 2 || n_topics > CROS_TOPIC_SYNC_MAX_TOPICS ||
+      queue_size < 1 || callback == NULL || sync_ptr == NULL )
+    return CROS_BAD_PARAM_ERR;
+
+  sync = (CrosTopicSync *)calloc( 1, sizeof(CrosTopicSync) );
+  if( sync == NULL )
+    return CROS_MEM_ALLOC_ERR;
+
+  sync->node = node;
+  sync->policy = policy;
+  sync->max_interval = max_interval;
+  sync->queue_size = queue_size;
+  sync->callback = callback;
+  sync->context = context;
+
+  for( topic_ind = 0; topic_ind < n_topics && ret_err == CROS_SUCCESS_ERR_PACK; topic_ind++ )
+  {
+    CrosTopicSyncQueue *queue = &sync->queues[topic_ind];
+
+    queue->sync = sync;
+    queue->subidx = -1;
+    queue->last_matched_stamp = -1;
+    queue->msgs = (cRosMessage **)calloc( queue_size, sizeof(cRosMessage *) );
+    queue->stamps = (int64_t *)calloc( queue_size, sizeof(int64_t) );
+    sync->n_topics++;
+    if( queue->msgs == NULL || queue->stamps == NULL )
+    {
+      ret_err = CROS_MEM_ALLOC_ERR;
+      break;
+    }
+
+    ret_err = cRosApiRegisterSubscriber( node, topic_names[topic_ind], topic_types[topic_ind], syncSubscriberCallback, NULL,
+                                         queue, 0, &queue->subidx );
+    if( ret_err == CROS_SUCCESS_ERR_PACK ) // The received messages are retained until they are matched
+      ret_err = cRosApiSetSubscriberMessagePool( node, queue->subidx, queue_size );
+  }
+
+  if( ret_err != CROS_SUCCESS_ERR_PACK )
+  {
+    cRosPrintErrCodePack( ret_err, "cRosTopicSyncCreate() : The subscribers of the synchronizer could not be created" );
+    cRosTopicSyncDestroy( sync );
+    return ret_err;
+  }
+
+  *sync_ptr = sync;
+  return CROS_SUCCESS_ERR_PACK;
+}
+
+void cRosTopicSyncDestroy( CrosTopicSync *sync )
+{
+  int topic_ind;
+
+  PRINT_VVDEBUG ( "cRosTopicSyncDestroy()\n" );
+
+  if( sync == NULL )
+    return;
+
+  for( topic_ind = 0; topic_ind < sync->n_topics; topic_ind++ )
+  {
+    CrosTopicSyncQueue *queue = &sync->queues[topic_ind];
+
+    if( queue->subidx != -1 )
+    {
+      // The messages are released before the subscriber, which closes its connections immediately (no more callbacks)
+      releaseOldestMessages( sync, queue, queue->n_msgs );
+      cRosApiUnregisterSubscriber( sync->node, queue->subidx );
+    }
+    free( queue->msgs );
+    free( queue->stamps );
+  }
+  free( sync );
+}
@@ -15,13 +15,25 @@ void dynBufferInit ( DynBuffer *d_buf )
   d_buf->size = 0;
   d_buf->pos_offset = 0;
   d_buf->max = 0;
+  d_buf->fixed = 0;
+}
+
+void dynBufferInitFixed ( DynBuffer *d_buf, unsigned char *data, size_t size, size_t max )
+{
+  PRINT_VVDEBUG ( "dynBufferInitFixed()\n" );
+
+  d_buf->data = data;
+  d_buf->size = size;
+  d_buf->pos_offset = 0;
+  d_buf->max = max;
+  d_buf->fixed = 1;
 }
 
 void dynBufferRelease ( DynBuffer *d_buf )
 {
   PRINT_VVDEBUG ( "dynBufferRelease()\n" );
 
-  if ( d_buf->data != NULL )
+  if ( d_buf->data != NULL && !d_buf->fixed )
     free ( d_buf->data );
 
   d_buf->size = 0;
@@ -29,25 +41,29 @@ void dynBufferRelease ( DynBuffer *d_buf )
   d_buf->max = 0;
 }
 
-int dynBufferPushBackBuf ( DynBuffer *d_buf, const unsigned char *new_buf, size_t n )
+unsigned char *dynBufferReserve ( DynBuffer *d_buf, size_t n )
 {
-  PRINT_VVDEBUG ( "dynBufferPushBackBuf()\n" );
+  PRINT_VVDEBUG ( "dynBufferReserve()\n" );
 
-  if (new_buf == NULL && n > 0) // If n == 0, the function accepts NULL as new_buf since nothing have to be appended
+  if ( d_buf->fixed )
   {
-    PRINT_ERROR ( "dynBufferPushBackBuf() : Invalid function argument values: new buffer content must be different from NULL and no shorter than 0\n" );
-    return -1;
+    if ( d_buf->size + n > d_buf->max )
+    {
+      PRINT_ERROR ( "dynBufferReserve() : The fixed-size buffer has no room for %lu more bytes\n", (unsigned long)n );
+      return NULL;
+    }
+    return d_buf->data + d_buf->size;
   }
 
   if ( d_buf->data == NULL )
   {
-    PRINT_VVDEBUG ( "dynBufferPushBackBuf() : allocate memory for the first time\n" );
+    PRINT_VVDEBUG ( "dynBufferReserve() : allocate memory for the first time\n" );
     d_buf->data = ( unsigned char * ) malloc ( DYNBUFFER_INIT_SIZE * sizeof ( unsigned char ) );
 
     if ( d_buf->data == NULL )
     {
-      PRINT_ERROR ( "dynBufferPushBackBuf() : Can't allocate memory\n" );
-      return -1;
+      PRINT_ERROR ( "dynBufferReserve() : Can't allocate memory\n" );
+      return NULL;
     }
 
     d_buf->size = 0;
@@ -56,18 +72,65 @@ int dynBufferPushBackBuf ( DynBuffer *d_buf, const unsigned char *new_buf, size_
 
   while ( d_buf->size + n > d_buf->max )
   {
-    PRINT_VVDEBUG ( "dynBufferPushBackBuf() : reallocate memory\n" );
+    PRINT_VVDEBUG ( "dynBufferReserve() : reallocate memory\n" );
     unsigned char *new_d_buf = ( unsigned char * ) realloc ( d_buf->data, ( DYNBUFFER_GROW_RATE * d_buf->max ) *
                                                                              sizeof ( unsigned char ) );
     if ( new_d_buf == NULL )
     {
-      PRINT_ERROR ( "dynBufferPushBackBuf() : Can't allocate more memory\n" );
-      return -1;
+      PRINT_ERROR ( "dynBufferReserve() : Can't allocate more memory\n" );
+      return NULL;
     }
     d_buf->max *= DYNBUFFER_GROW_RATE;
     d_buf->data = new_d_buf;
   }
 
+  return d_buf->data + d_buf->size;
+}
+
+void dynBufferCommit ( DynBuffer *d_buf, size_t n )
+{
+  PRINT_VVDEBUG ( "dynBufferCommit()\n" );
+
+  d_buf->size += n;
+}
+
+void dynBufferTruncate ( DynBuffer *d_buf, size_t size )
+{
+  PRINT_VVDEBUG ( "dynBufferTruncate()\n" );
+
+  if ( size < d_buf->size )
+    d_buf->size = size;
+  if ( d_buf->pos_offset > d_buf->size )
+    d_buf->pos_offset = d_buf->size;
+}
+
+void dynBufferEraseFront ( DynBuffer *d_buf, size_t n )
+{
+  PRINT_VVDEBUG ( "dynBufferEraseFront()\n" );
+
+  if ( n >= d_buf->size )
+    d_buf->size = 0;
+  else if ( n > 0 )
+  {
+    memmove ( d_buf->data, d_buf->data + n, d_buf->size - n );
+    d_buf->size -= n;
+  }
+  d_buf->pos_offset = 0;
+}
+
+int dynBufferPushBackBuf ( DynBuffer *d_buf, const unsigned char *new_buf, size_t n )
+{
+  PRINT_VVDEBUG ( "dynBufferPushBackBuf()\n" );
+
+  if (new_buf == NULL && n > 0) // If n == 0, the function accepts NULL as new_buf since nothing have to be appended
+  {
+    PRINT_ERROR ( "dynBufferPushBackBuf() : Invalid function argument values: new buffer content must be different from NULL and no shorter than 0\n" );
+    return -1;
+  }
+
+  if ( dynBufferReserve ( d_buf, n ) == NULL )
+    return -1;
+
   if(n>0)
   {
     memcpy ( ( void * ) ( d_buf->data + d_buf->size ), ( void * ) new_buf, n );
@@ -1,8 +1,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #include "tcpip_socket.h"
+#include "tcpip_uring.h"
 #include "cros_defs.h"
 #include "cros_log.h"
 #include "cros_clock.h"
@@ -23,6 +25,7 @@
 #  define FN_ENOTCONN WSAENOTCONN
 #  define FN_ECONNRESET WSAECONNRESET
 #  define FN_EINTR WSAEINTR
+#  define FN_ETIMEDOUT WSAETIMEDOUT
 
 #  define FN_SHUT_RDWR SD_BOTH
 typedef int fn_socklen_t;
@@ -34,6 +37,9 @@ typedef int fn_socklen_t;
 #  include <netinet/tcp.h>
 #  include <arpa/inet.h>
 #  include <errno.h>
+#  ifdef __linux__
+#    include <linux/errqueue.h>
+#  endif
 #  define closesocket close
 
 // connect()/accept()/send()/recv()/select() error codes:
@@ -46,11 +52,17 @@ typedef int fn_socklen_t;
 #  define FN_ENOTCONN ENOTCONN
 #  define FN_ECONNRESET ECONNRESET
 #  define FN_EINTR EINTR
+#  define FN_ETIMEDOUT ETIMEDOUT
 // shutdown() how mode:
 #  define FN_SHUT_RDWR SHUT_RDWR
 typedef socklen_t fn_socklen_t;
 #endif
 
+// Zero-copy sends need the socket option, the send() flag and the completion notifications in the socket error queue
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#  define TCPIP_SOCKET_ZEROCOPY
+#endif
+
 #define TCPIP_SOCKET_READ_BUFFER_SIZE 2048
 // Definitions for debug messages only.
 // Console virtual-terminal color sequences (supported on Linux and on Windows 10 build 16257 and later):
@@ -73,6 +85,15 @@ void tcpIpSocketInit ( TcpIpSocket *s )
   s->connected = 0;
   s->listening = 0;
   s->is_nonblocking = 0;
+  s->rx_timestamps = 0;
+  s->rx_time_stamp = 0;
+  s->zerocopy_min_size = 0;
+  s->zerocopy_sent = 0;
+  s->zerocopy_done = 0;
+  s->last_error = 0;
+  s->uring = NULL;
+  s->uring_serial = 0;
+  s->uring_ops = 0;
 }
 
 int tcpIpSocketOpen ( TcpIpSocket *s )
@@ -93,6 +114,7 @@ int tcpIpSocketOpen ( TcpIpSocket *s )
   {
     PRINT_VDEBUG ( "tcpIpSocketOpen(): Created socket FD: %i\n", s->fd);
     s->open = 1;
+    s->last_error = 0;
     ret_success = 1;
   }
 
@@ -113,6 +135,7 @@ int tcpIpSocketClose ( TcpIpSocket *s )
     int close_ret_val;
 
     PRINT_VDEBUG ( "tcpIpSocketClose(): Closing socket FD: %i\n", s->fd);
+    tcpIpUringDetachSocket ( s ); // The io_uring requests of the socket must not outlive its file descriptor
     close_ret_val = closesocket( s->fd );
     ret_success = (close_ret_val != FN_SOCKET_ERROR);
   }
@@ -207,6 +230,160 @@ int tcpIpSocketSetReuse ( TcpIpSocket *s )
   return(1);
 }
 
+int tcpIpSocketSetReusePort ( TcpIpSocket *s )
+{
+  PRINT_VVDEBUG ( "tcpIpSocketSetReusePort()\n" );
+
+  if ( !s->open )
+  {
+    PRINT_ERROR ( "tcpIpSocketSetReusePort() : Socket not opened\n" );
+    return(0);
+  }
+
+#ifdef SO_REUSEPORT
+  int enable_reuse_port = 1;
+  if ( setsockopt ( s->fd, SOL_SOCKET, SO_REUSEPORT, (const char*)&enable_reuse_port, sizeof(enable_reuse_port) ) != 0 )
+  {
+    PRINT_ERROR ( "tcpIpSocketSetReusePort() : setsockopt() with SO_REUSEPORT option failed. System error code: %i \n", tcpIpSocketGetError());
+    return(0);
+  }
+  return(1);
+#else
+  PRINT_ERROR ( "tcpIpSocketSetReusePort() : SO_REUSEPORT option is not supported on this platform\n" );
+  return(0);
+#endif
+}
+
+int tcpIpSocketSetPriority ( TcpIpSocket *s, int priority, int dscp )
+{
+  PRINT_VVDEBUG ( "tcpIpSocketSetPriority()\n" );
+
+  if ( !s->open )
+  {
+    PRINT_ERROR ( "tcpIpSocketSetPriority() : Socket not opened\n" );
+    return(0);
+  }
+
+#ifdef SO_PRIORITY
+  if ( setsockopt ( s->fd, SOL_SOCKET, SO_PRIORITY, (const char*)&priority, sizeof(priority) ) != 0 )
+  {
+    PRINT_ERROR ( "tcpIpSocketSetPriority() : setsockopt() with SO_PRIORITY option failed. System error code: %i \n", tcpIpSocketGetError());
+    return(0);
+  }
+#endif
+
+  // The DSCP field occupies the 6 most significant bits of the (former) TOS byte
+  int tos = (dscp & 0x3F) << 2;
+  if ( setsockopt ( s->fd, IPPROTO_IP, IP_TOS, (const char*)&tos, sizeof(tos) ) != 0 )
+  {
+    PRINT_ERROR ( "tcpIpSocketSetPriority() : setsockopt() with IP_TOS option failed. System error code: %i \n", tcpIpSocketGetError());
+    return(0);
+  }
+  return(1);
+}
+
+int tcpIpSocketSetRxTimestamps ( TcpIpSocket *s, int enable )
+{
+  PRINT_VVDEBUG ( "tcpIpSocketSetRxTimestamps()\n" );
+
+  if ( !s->open )
+  {
+    PRINT_ERROR ( "tcpIpSocketSetRxTimestamps() : Socket not opened\n" );
+    return(0);
+  }
+
+#ifdef SO_TIMESTAMPNS
+  int sock_opt_val = (enable)? 1: 0;
+  if ( setsockopt ( s->fd, SOL_SOCKET, SO_TIMESTAMPNS, (const char *)&sock_opt_val, sizeof ( sock_opt_val ) ) != 0 )
+  {
+    PRINT_ERROR ( "tcpIpSocketSetRxTimestamps() : setsockopt() with SO_TIMESTAMPNS option failed. System error code: %i \n", tcpIpSocketGetError());
+    return(0);
+  }
+  s->rx_timestamps = (unsigned char)sock_opt_val;
+  s->rx_time_stamp = 0;
+  return(1);
+#else
+  if ( !enable )
+    return(1);
+  PRINT_ERROR ( "tcpIpSocketSetRxTimestamps() : Kernel reception time stamps are not supported by this platform\n" );
+  return(0);
+#endif
+}
+
+int tcpIpSocketSetZeroCopy ( TcpIpSocket *s, size_t min_size )
+{
+  PRINT_VVDEBUG ( "tcpIpSocketSetZeroCopy()\n" );
+
+  if ( !s->open )
+  {
+    PRINT_ERROR ( "tcpIpSocketSetZeroCopy() : Socket not opened\n" );
+    return(0);
+  }
+
+#ifdef TCPIP_SOCKET_ZEROCOPY
+  // The socket option cannot be cleared once set, so disabling only stops using the MSG_ZEROCOPY flag
+  if ( min_size > 0 )
+  {
+    int sock_opt_val = 1;
+    if ( setsockopt ( s->fd, SOL_SOCKET, SO_ZEROCOPY, (const char *)&sock_opt_val, sizeof ( sock_opt_val ) ) != 0 )
+    {
+      PRINT_ERROR ( "tcpIpSocketSetZeroCopy() : setsockopt() with SO_ZEROCOPY option failed. System error code: %i \n", tcpIpSocketGetError());
+      return(0);
+    }
+  }
+  s->zerocopy_min_size = min_size;
+  return(1);
+#else
+  if ( min_size == 0 )
+    return(1);
+  PRINT_ERROR ( "tcpIpSocketSetZeroCopy() : Zero-copy sends are not supported by this platform\n" );
+  return(0);
+#endif
+}
+
+int tcpIpSocketZeroCopyPending ( TcpIpSocket *s )
+{
+#ifdef TCPIP_SOCKET_ZEROCOPY
+  while ( s->zerocopy_done != s->zerocopy_sent )
+  {
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    char ctrl_buf[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in))];
+
+    memset ( &msg, 0, sizeof(msg) );
+    msg.msg_control = ctrl_buf;
+    msg.msg_controllen = sizeof(ctrl_buf);
+    if ( recvmsg ( s->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT ) < 0 )
+      break; // No more notifications available yet
+
+    for ( cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg) )
+    {
+      struct sock_extended_err ee;
+
+      if ( cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR )
+        continue;
+
+      memcpy ( &ee, CMSG_DATA(cmsg), sizeof(ee) );
+      if ( ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY || ee.ee_errno != 0 )
+        continue;
+
+      // Each notification reports the (inclusive) range of send ids [ee_info, ee_data] that have been completed
+      s->zerocopy_done += ee.ee_data - ee.ee_info + 1;
+      if ( ( ee.ee_code & SO_EE_CODE_ZEROCOPY_COPIED ) && s->zerocopy_min_size > 0 )
+      {
+        // The kernel had to copy the data anyway (e.g. loopback or a device without scatter-gather support):
+        // the following writes are sent with the regular copying send() to avoid the cost of the notifications
+        PRINT_VDEBUG ( "tcpIpSocketZeroCopyPending() : Zero-copy sends fell back to copying on socket FD: %i. Disabling them\n", s->fd );
+        s->zerocopy_min_size = 0;
+      }
+    }
+  }
+  return ( s->zerocopy_done != s->zerocopy_sent );
+#else
+  return(0);
+#endif
+}
+
 int tcpIpSocketSetKeepAlive ( TcpIpSocket *s, unsigned int idle, unsigned int interval, unsigned int count )
 {
   PRINT_VVDEBUG ( "tcpIpSocketSetKeepAlive()\n" );
@@ -259,6 +436,70 @@ int tcpIpSocketSetKeepAlive ( TcpIpSocket *s, unsigned int idle, unsigned int in
   return(1);
 }
 
+int tcpIpSocketSetUserTimeout ( TcpIpSocket *s, unsigned int timeout )
+{
+  PRINT_VVDEBUG ( "tcpIpSocketSetUserTimeout()\n" );
+
+  if ( !s->open )
+  {
+    PRINT_ERROR ( "tcpIpSocketSetUserTimeout() : Socket not opened\n" );
+    return(0);
+  }
+
+#ifdef TCP_USER_TIMEOUT
+  unsigned int sock_opt_val = timeout;
+  if ( setsockopt ( s->fd, IPPROTO_TCP, TCP_USER_TIMEOUT, (const char *)&sock_opt_val, sizeof ( sock_opt_val ) ) != 0 )
+  {
+    PRINT_ERROR ( "tcpIpSocketSetUserTimeout() : setsockopt() with TCP_USER_TIMEOUT option failed. System error code: %i \n", tcpIpSocketGetError());
+    return(0);
+  }
+  return(1);
+#else
+  PRINT_ERROR ( "tcpIpSocketSetUserTimeout() : TCP_USER_TIMEOUT option not supported by this platform\n" );
+  return(0);
+#endif
+}
+
+int tcpIpSocketSetBufferSizes ( TcpIpSocket *s, size_t snd_buf_size, size_t rcv_buf_size )
+{
+  int sock_opt_val;
+
+  PRINT_VVDEBUG ( "tcpIpSocketSetBufferSizes()\n" );
+
+  if ( !s->open )
+  {
+    PRINT_ERROR ( "tcpIpSocketSetBufferSizes() : Socket not opened\n" );
+    return(0);
+  }
+
+  if ( snd_buf_size > 0 )
+  {
+    sock_opt_val = (snd_buf_size < INT_MAX)? (int)snd_buf_size : INT_MAX;
+    if ( setsockopt ( s->fd, SOL_SOCKET, SO_SNDBUF, (const char *)&sock_opt_val, sizeof ( sock_opt_val ) ) != 0 )
+    {
+      PRINT_ERROR ( "tcpIpSocketSetBufferSizes() : setsockopt() with SO_SNDBUF option failed. System error code: %i \n", tcpIpSocketGetError());
+      return(0);
+    }
+  }
+
+  if ( rcv_buf_size > 0 )
+  {
+    sock_opt_val = (rcv_buf_size < INT_MAX)? (int)rcv_buf_size : INT_MAX;
+    if ( setsockopt ( s->fd, SOL_SOCKET, SO_RCVBUF, (const char *)&sock_opt_val, sizeof ( sock_opt_val ) ) != 0 )
+    {
+      PRINT_ERROR ( "tcpIpSocketSetBufferSizes() : setsockopt() with SO_RCVBUF option failed. System error code: %i \n", tcpIpSocketGetError());
+      return(0);
+    }
+  }
+
+  return(1);
+}
+
+int tcpIpSocketTimedOut ( TcpIpSocket *s )
+{
+  return ( s->last_error == FN_ETIMEDOUT );
+}
+
 TcpIpSocketState tcpIpSocketConnect ( TcpIpSocket *s, const char *host_addr, unsigned short host_port )
 {
   int connect_ret;
@@ -431,7 +672,11 @@ TcpIpSocketState tcpIpSocketAccept ( TcpIpSocket *s, TcpIpSocket *new_s )
   struct sockaddr_in new_adr;
   socklen_t new_adr_len = sizeof(struct sockaddr);
 
-  int new_fd = accept ( s->fd, ( struct sockaddr * ) &new_adr, &new_adr_len );
+  int new_fd;
+  if ( s->uring_ops & TCPIP_URING_OP_ACCEPT )
+    new_fd = tcpIpUringAccept ( s, &new_adr ); // The connection may have been accepted in advance by the io_uring instance
+  else
+    new_fd = accept ( s->fd, ( struct sockaddr * ) &new_adr, &new_adr_len );
 
   if ( new_fd == FN_INVALID_SOCKET )
   {
@@ -482,52 +727,87 @@ void printTransmissionBuffer(const char *buffer, const char *msg_info, char *msg
 
 TcpIpSocketState tcpIpSocketWriteBuffer ( TcpIpSocket *s, DynBuffer *d_buf )
 {
+  size_t n_writes;
+
   PRINT_VVDEBUG ( "tcpIpSocketWriteBuffer()\n" );
 
+  return tcpIpSocketWriteBufferEx ( s, d_buf, dynBufferGetRemainingDataSize ( d_buf ), &n_writes );
+}
+
+TcpIpSocketState tcpIpSocketWriteBufferEx ( TcpIpSocket *s, DynBuffer *d_buf, size_t max_size, size_t *n_writes )
+{
+  PRINT_VVDEBUG ( "tcpIpSocketWriteBufferEx()\n" );
+
   const char *data = (const char *)dynBufferGetCurrentData ( d_buf );
-  int data_size = dynBufferGetRemainingDataSize ( d_buf );
+  size_t remaining_size = dynBufferGetRemainingDataSize ( d_buf );
+  int data_size = (int)((remaining_size < max_size)? remaining_size : max_size);
 
+  *n_writes = 0;
   if ( !s->connected )
   {
-    PRINT_ERROR ( "tcpIpSocketWriteBuffer() : Socket not connected\n" );
+    PRINT_ERROR ( "tcpIpSocketWriteBufferEx() : Socket not connected\n" );
     return TCPIPSOCKET_FAILED;
   }
 
   #if CROS_DEBUG_LEVEL >= 2
-  printTransmissionBuffer(data, "tcpIpSocketWriteBuffer() : Buffer", ANSI_COLOR_MAGENTA, s->fd, data_size);
+  printTransmissionBuffer(data, "tcpIpSocketWriteBufferEx() : Buffer", ANSI_COLOR_MAGENTA, s->fd, data_size);
   #endif
   while ( data_size > 0 )
   {
     int n_written , fn_error_code;
+    int send_flags = 0;
 
-    n_written = send ( s->fd, data, data_size, 0 );
+#ifdef TCPIP_SOCKET_ZEROCOPY
+    if ( s->zerocopy_min_size > 0 && (size_t)data_size >= s->zerocopy_min_size && !(s->uring_ops & TCPIP_URING_OP_SEND_FRAMES) )
+      send_flags = MSG_ZEROCOPY;
+#endif
+    if ( s->uring_ops & TCPIP_URING_OP_SEND_FRAMES )
+      n_written = tcpIpUringSend ( s, data, data_size ); // The data is queued and sent by tcpIpUringFlushSends()
+    else
+      n_written = send ( s->fd, data, data_size, send_flags );
     fn_error_code = tcpIpSocketGetError();
+#ifdef TCPIP_SOCKET_ZEROCOPY
+    if ( send_flags != 0 )
+    {
+      if ( n_written < 0 && fn_error_code == ENOBUFS )
+      {
+        // Too many zero-copy sends are pending (limited by the socket option memory): send this chunk by copy
+        n_written = send ( s->fd, data, data_size, 0 );
+        fn_error_code = tcpIpSocketGetError();
+      }
+      else if ( n_written > 0 )
+        s->zerocopy_sent++;
+    }
+#endif
     if ( n_written > 0 )
     {
       dynBufferMovePoseIndicator ( d_buf, n_written );
       data = (const char *)dynBufferGetCurrentData ( d_buf );
-      data_size = dynBufferGetRemainingDataSize ( d_buf );
+      data_size -= n_written;
+      *n_writes += n_written;
     }
     else if ( s->is_nonblocking &&
               ( fn_error_code == FN_EWOULDBLOCK || fn_error_code == FN_EINPROGRESS || fn_error_code == FN_EAGAIN ) )
     {
-      PRINT_VDEBUG ( "tcpIpSocketWriteBuffer() : write in progress, %d remaining bytes\n", data_size );
+      PRINT_VDEBUG ( "tcpIpSocketWriteBufferEx() : write in progress, %d remaining bytes\n", data_size );
       return TCPIPSOCKET_IN_PROGRESS;
     }
     else if ( fn_error_code == FN_ENOTCONN || fn_error_code == FN_ECONNRESET )
     {
-      PRINT_VDEBUG ( "tcpIpSocketWriteBuffer() : socket disconnected\n" );
+      PRINT_VDEBUG ( "tcpIpSocketWriteBufferEx() : socket disconnected\n" );
       s->connected = 0;
+      s->last_error = fn_error_code;
       return  TCPIPSOCKET_DISCONNECTED;
     }
     else
     {
-      PRINT_ERROR ( "tcpIpSocketWriteBuffer() : Write failed. Error code: %i\n", fn_error_code);
+      PRINT_ERROR ( "tcpIpSocketWriteBufferEx() : Write failed. Error code: %i\n", fn_error_code);
+      s->last_error = fn_error_code;
       return TCPIPSOCKET_FAILED;
     }
   }
 
-  return TCPIPSOCKET_DONE;
+  return ( dynBufferGetRemainingDataSize ( d_buf ) == 0 )? TCPIPSOCKET_DONE : TCPIPSOCKET_IN_PROGRESS;
 }
 
 TcpIpSocketState tcpIpSocketWriteString ( TcpIpSocket *s, DynString *d_str )
@@ -585,6 +865,45 @@ TcpIpSocketState tcpIpSocketReadBuffer ( TcpIpSocket *s, DynBuffer *d_buf )
   return tcpIpSocketReadBufferEx(s, d_buf, TCPIP_SOCKET_READ_BUFFER_SIZE, &n_read);
 }
 
+#ifdef SO_TIMESTAMPNS
+// Read from the socket using recvmsg() in order to obtain the time at which the kernel received the data.
+// This time (CLOCK_REALTIME) is translated to the cRosClockGetTimeStamp() time base and stored in s->rx_time_stamp
+static int recvTimestamped( TcpIpSocket *s, char *read_buf, size_t max_size )
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  char ctrl_buf[CMSG_SPACE(sizeof(struct timespec))];
+  int recv_ret;
+
+  iov.iov_base = read_buf;
+  iov.iov_len = max_size;
+  memset ( &msg, 0, sizeof(msg) );
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl_buf;
+  msg.msg_controllen = sizeof(ctrl_buf);
+
+  recv_ret = recvmsg ( s->fd, &msg, 0 );
+  if ( recv_ret > 0 )
+  {
+    for ( cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg) )
+    {
+      if ( cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS )
+      {
+        struct timespec rx_time, real_time;
+        int64_t time_stamp = cRosClockGetTimeStamp();
+
+        memcpy ( &rx_time, CMSG_DATA(cmsg), sizeof(rx_time) );
+        clock_gettime ( CLOCK_REALTIME, &real_time );
+        s->rx_time_stamp = time_stamp - ((int64_t)(real_time.tv_sec - rx_time.tv_sec) * 1000000000LL + (real_time.tv_nsec - rx_time.tv_nsec));
+      }
+    }
+  }
+  return recv_ret;
+}
+#endif
+
 TcpIpSocketState tcpIpSocketReadBufferEx( TcpIpSocket *s, DynBuffer *d_buf, size_t max_size, size_t *n_reads)
 {
   int recv_ret, fn_error_code;
@@ -599,7 +918,7 @@ TcpIpSocketState tcpIpSocketReadBufferEx( TcpIpSocket *s, DynBuffer *d_buf, size
     return TCPIPSOCKET_FAILED;
   }
 
-  read_buf = (char *)malloc(max_size);
+  read_buf = (char *)dynBufferReserve(d_buf, max_size); // The data is received directly at the end of the buffer content
   if (read_buf == NULL)
   {
     PRINT_ERROR("tcpIpSocketReadBufferEx() : Out of memory allocating %lu bytes before reading from socket", (unsigned long)max_size);
@@ -607,7 +926,16 @@ TcpIpSocketState tcpIpSocketReadBufferEx( TcpIpSocket *s, DynBuffer *d_buf, size
   }
 
   TcpIpSocketState state = TCPIPSOCKET_UNKNOWN;
-  recv_ret = recv ( s->fd, read_buf, max_size, 0);
+  s->rx_time_stamp = 0;
+  if ( s->uring_ops & TCPIP_URING_OP_RECV )
+    recv_ret = tcpIpUringRecv ( s, read_buf, max_size ); // The data may have been received in advance by the io_uring instance
+  else
+#ifdef SO_TIMESTAMPNS
+  if ( s->rx_timestamps )
+    recv_ret = recvTimestamped ( s, read_buf, max_size );
+  else
+#endif
+    recv_ret = recv ( s->fd, read_buf, max_size, 0);
   fn_error_code = tcpIpSocketGetError();
   if ( recv_ret == 0 )
   {
@@ -622,7 +950,7 @@ TcpIpSocketState tcpIpSocketReadBufferEx( TcpIpSocket *s, DynBuffer *d_buf, size
     printTransmissionBuffer((const char *)read_buf, "tcpIpSocketReadBufferEx() : Buffer", ANSI_COLOR_CYAN, s->fd, recv_ret);
     #endif
 
-    dynBufferPushBackBuf ( d_buf, (const unsigned char *)read_buf, recv_ret );
+    dynBufferCommit ( d_buf, recv_ret );
     state = TCPIPSOCKET_DONE;
     *n_reads = recv_ret;
   }
@@ -636,16 +964,16 @@ TcpIpSocketState tcpIpSocketReadBufferEx( TcpIpSocket *s, DynBuffer *d_buf, size
   {
     PRINT_VDEBUG ( "tcpIpSocketReadBufferEx() : socket disconnectd\n" );
     s->connected = 0;
+    s->last_error = fn_error_code;
     state = TCPIPSOCKET_DISCONNECTED;
   }
   else
   {
     PRINT_ERROR ( "tcpIpSocketReadBufferEx() : Read through socket failed. Error code: %i\n", fn_error_code);
+    s->last_error = fn_error_code;
     state = TCPIPSOCKET_FAILED;
   }
 
-  free(read_buf);
-
   return state;
 }
 
@@ -0,0 +1,1388 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "tcpip_uring.h"
+#include "cros_defs.h"
+#include "cros_log.h"
+
+#if defined(CROS_USE_IO_URING) && defined(__linux__)
+
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "cros_clock.h"
+#include "cros_thread.h"
+
+#define TCPIP_URING_SQ_ENTRIES 256              // Max. num. of requests submitted in one io_uring_enter() call
+#define TCPIP_URING_CQ_ENTRIES 8192             // Room for the completions of one wait: 3 poll requests per socket and their removals
+// Kinds of request, stored in the lowest bits of their user_data
+#define TCPIP_URING_POLL_IN 0                   // Poll request of a file descriptor waited for reading
+#define TCPIP_URING_POLL_OUT 1                  // Poll request of a file descriptor waited for writing
+#define TCPIP_URING_POLL_PRI 2                  // Poll request of a file descriptor waited for exceptional conditions (urgent data)
+#define TCPIP_URING_N_POLL_DIRS 3
+#define TCPIP_URING_RECV 3                      // Reception into a provided buffer (TCPIP_URING_OP_RECV)
+#define TCPIP_URING_ACCEPT 4                    // Multishot accept (TCPIP_URING_OP_ACCEPT)
+#define TCPIP_URING_SEND 5                      // Link of a send chain (TCPIP_URING_OP_SEND_FRAMES)
+#define TCPIP_URING_KIND_BITS 3
+#define TCPIP_URING_IGNORED_REQUEST UINT64_MAX  // user_data of the requests whose completion is not needed (removals and cancellations)
+// States of the RECV request and of the send chain of a socket
+#define TCPIP_URING_IDLE 0                      // No request
+#define TCPIP_URING_QUEUED 1                    // Queued in the submission queue but not submitted yet (send chains only)
+#define TCPIP_URING_ARMED 2                     // Submitted and not completed yet
+#define TCPIP_URING_DONE 3                      // Completed: its result is waiting for the next read or write of the socket
+#define TCPIP_URING_RECV_RETRY INT32_MIN        // RECV result when no provided buffer was free: the data is read with recv()
+#define TCPIP_URING_RECV_BUFFERS 64             // Num. of provided reception buffers of an instance (a power of 2)
+#define TCPIP_URING_RECV_BUFFER_SIZE 16384      // Size of each provided reception buffer
+#define TCPIP_URING_RECV_GROUP 0                // ID of the group of provided reception buffers
+#define TCPIP_URING_MAX_LISTENERS 8             // Max. num. of listening sockets attached to an instance
+#define TCPIP_URING_ACCEPT_QUEUE 16             // The multishot accept request of a listening socket is stopped when this num. of connections wait
+#define TCPIP_URING_SEND_LINK_SIZE 65536        // The frames are grouped in send requests of up to this size (larger frames are split)
+#define TCPIP_URING_MAX_SEND_LINKS 16           // Max. num. of send requests of a chain. The last one sends the rest of the data
+#define TCPIP_URING_DESTROY_TIME_OUT 1000       // Max. time (in ms) waited for the cancellation of the requests when an instance is freed
+#define TCPIP_URING_WORD_BITS (8 * (int)sizeof(unsigned long))
+#define TCPIP_URING_N_WORDS (FD_SETSIZE / TCPIP_URING_WORD_BITS)
+
+// On Linux an fd_set is a bit map of unsigned long words, so the waited file descriptors are compared a word at a time
+typedef char TcpIpUringFdSetCheck[(sizeof(fd_set) == TCPIP_URING_N_WORDS * sizeof(unsigned long))? 1 : -1];
+
+// Connections accepted in advance for a listening socket
+typedef struct TcpIpUringListener TcpIpUringListener;
+struct TcpIpUringListener
+{
+  int in_use;
+  uint32_t accept_gen;                // Generation of the multishot accept request armed (0 if none)
+  uint32_t stopped_gen;               // Generation of the request canceled because the queue was nearly full. Its last connections are still queued
+  int accept_error;                   // Error code of the last accept that failed, returned by the next tcpIpUringAccept(). 0 if none
+  int *fds;                           // File descriptors of the accepted connections, from fds[first_fd] (allocated on demand)
+  unsigned first_fd, n_fds, fds_size;
+};
+
+// Socket attached to an instance. Its members are changed with the instance lock held, since the thread that closes the
+// socket detaches it. The send members are also read with the lock held, since they are updated by any submission
+typedef struct TcpIpUringSlot TcpIpUringSlot;
+struct TcpIpUringSlot
+{
+  uint32_t serial;                    // Serial number of the attachment (TcpIpSocket::uring_serial). 0 if no socket is attached
+  unsigned ops;                       // TCPIP_URING_OP_* operations performed through the instance
+  // TCPIP_URING_OP_RECV
+  unsigned char recv_state;           // TCPIP_URING_IDLE, TCPIP_URING_ARMED or TCPIP_URING_DONE
+  uint32_t recv_gen;                  // Generation of the RECV request
+  int recv_res;                       // Result of the completed RECV: num. of bytes received, 0 on end of file, -errno or TCPIP_URING_RECV_RETRY
+  unsigned recv_buf;                  // ID of the provided buffer that holds the received data
+  unsigned recv_off;                  // Offset of the received data that has not been read yet
+  // TCPIP_URING_OP_ACCEPT
+  int listener;                       // Index of the listener in TcpIpUring::listeners (-1 if none)
+  // TCPIP_URING_OP_SEND_FRAMES
+  unsigned char send_state;           // TCPIP_URING_IDLE, TCPIP_URING_QUEUED, TCPIP_URING_ARMED or TCPIP_URING_DONE
+  uint32_t send_gen;                  // Generation of the send chain
+  const char *send_data;              // Data sent by the chain
+  unsigned sq_first;                  // Submission queue tail of the first link while the chain is queued
+  int n_links, n_links_left;          // Num. of links of the chain and num. of links not completed yet
+  size_t send_bytes;                  // Num. of bytes sent by the completed links
+  int send_error;                     // Error code of the first link that failed (0 if none)
+  size_t frame_left;                  // Bytes of the TCPROS frame being sent that have not been sent yet (0 at the start of a frame)
+};
+
+struct TcpIpUring
+{
+  int ring_fd;                        // File descriptor of the io_uring instance
+  unsigned char *rings;               // Submission and completion rings, mapped together (IORING_FEAT_SINGLE_MMAP)
+  size_t rings_size;
+  struct io_uring_sqe *sqes;          // Submission queue entries
+  size_t sqes_size;
+  unsigned *sq_head, *sq_tail, *sq_mask, *sq_entries, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_cqe *cqes;
+  cRosMutex lock;                     // Protects the submission queue, the requests and the slots
+  TcpIpUring *next;                   // Next instance in the list of instances (see uring_list)
+  uint32_t poll_gen[FD_SETSIZE][TCPIP_URING_N_POLL_DIRS]; // Generation of the poll request armed for each fd and direction (0 if none)
+  uint32_t last_gen;                  // Generation of the last request armed
+  unsigned long armed[TCPIP_URING_N_POLL_DIRS][TCPIP_URING_N_WORDS]; // Bit map of the file descriptors with a poll request armed
+  unsigned long ready[TCPIP_URING_N_POLL_DIRS][TCPIP_URING_N_WORDS]; // Bit map of the completed poll requests not reported yet
+  int revents[FD_SETSIZE][TCPIP_URING_N_POLL_DIRS]; // Events of the completed poll requests
+  unsigned long read_attached[TCPIP_URING_N_WORDS]; // Bit map of the file descriptors read through RECV or ACCEPT requests instead of polled
+  unsigned long read_ready[TCPIP_URING_N_WORDS]; // Bit map of the attached file descriptors whose data or connection has been received
+  unsigned long read_armed[TCPIP_URING_N_WORDS]; // Bit map of the attached file descriptors with a RECV or ACCEPT request armed
+  TcpIpUringSlot slots[FD_SETSIZE];   // Attached sockets, indexed by file descriptor
+  TcpIpUringListener listeners[TCPIP_URING_MAX_LISTENERS];
+  int n_pending;                      // Num. of RECV and ACCEPT requests that will complete again (including the canceled ones)
+  int queued_sends[TCPIP_URING_SQ_ENTRIES]; // File descriptors of the sockets with a queued send chain
+  int n_queued_sends;
+  int n_sends_in_flight;              // Num. of links queued or submitted whose completion has not been collected
+  int recv_buffers_state;             // 1 if the provided buffers are registered, -1 if they are not supported, 0 if not tried yet
+  struct io_uring_buf_ring *recv_ring;
+  size_t recv_ring_size;
+  char *recv_buffers;
+  unsigned short recv_ring_tail;
+};
+
+// The instances are listed so that the requests of a socket closed by any thread are removed from all of them
+static cRosMutex uring_list_lock = { PTHREAD_MUTEX_INITIALIZER };
+static TcpIpUring *uring_list = NULL;
+static uint32_t last_serial = 0;       // Serial number of the last attachment of a socket (to any instance)
+
+static int enterRing( TcpIpUring *u, unsigned min_complete, unsigned flags, void *arg, size_t arg_size )
+{
+  // Another thread may submit the requests first when it closes a socket: the kernel only submits the ones left
+  unsigned to_submit = __atomic_load_n( u->sq_tail, __ATOMIC_ACQUIRE ) - __atomic_load_n( u->sq_head, __ATOMIC_ACQUIRE );
+  return (int)syscall( __NR_io_uring_enter, u->ring_fd, to_submit, min_complete, flags, arg, arg_size );
+}
+
+static uint32_t nextGen( TcpIpUring *u )
+{
+  if( ++u->last_gen == 0 ) // 0 means that no request is armed
+    u->last_gen = 1;
+  return u->last_gen;
+}
+
+static uint64_t requestData( uint32_t gen, int fd, int kind )
+{
+  return ((uint64_t)gen << 32) | ((uint64_t)fd << TCPIP_URING_KIND_BITS) | (uint64_t)kind;
+}
+
+static void setFdBit( unsigned long *words, int fd )
+{
+  words[fd / TCPIP_URING_WORD_BITS] |= 1UL << (fd % TCPIP_URING_WORD_BITS);
+}
+
+static void clearFdBit( unsigned long *words, int fd )
+{
+  words[fd / TCPIP_URING_WORD_BITS] &= ~(1UL << (fd % TCPIP_URING_WORD_BITS));
+}
+
+static void recycleRecvBuffer( TcpIpUring *u, unsigned buf_id )
+{
+#ifdef IORING_ACCEPT_MULTISHOT
+  struct io_uring_buf *buf = &u->recv_ring->bufs[u->recv_ring_tail & (TCPIP_URING_RECV_BUFFERS - 1)];
+
+  buf->addr = (uint64_t)(uintptr_t)(u->recv_buffers + (size_t)buf_id * TCPIP_URING_RECV_BUFFER_SIZE);
+  buf->len = TCPIP_URING_RECV_BUFFER_SIZE;
+  buf->bid = (unsigned short)buf_id;
+  u->recv_ring_tail++;
+  __atomic_store_n( &u->recv_ring->tail, u->recv_ring_tail, __ATOMIC_RELEASE );
+#endif
+}
+
+// Register the provided reception buffers the first time that a socket is attached with TCPIP_URING_OP_RECV.
+// Returns 1 if they are available
+static int setUpRecvBuffers( TcpIpUring *u )
+{
+#ifdef IORING_ACCEPT_MULTISHOT // linux/io_uring.h of Linux 5.19 or later: provided buffer rings and multishot accept
+  struct io_uring_buf_reg reg;
+  unsigned buf_id;
+
+  if( u->recv_buffers_state != 0 )
+    return( u->recv_buffers_state > 0 );
+
+  u->recv_buffers_state = -1;
+  u->recv_ring_size = TCPIP_URING_RECV_BUFFERS * sizeof(struct io_uring_buf); // The ring must be page-aligned
+  u->recv_ring = (struct io_uring_buf_ring *)mmap( NULL, u->recv_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  u->recv_buffers = (char *)malloc( (size_t)TCPIP_URING_RECV_BUFFERS * TCPIP_URING_RECV_BUFFER_SIZE );
+  if( u->recv_ring == MAP_FAILED || u->recv_buffers == NULL )
+  {
+    PRINT_ERROR ( "setUpRecvBuffers() : Not enough memory for the reception buffers. The sockets are read with recv()\n" );
+    if( u->recv_ring != MAP_FAILED )
+      munmap( u->recv_ring, u->recv_ring_size );
+    u->recv_ring = NULL;
+    free( u->recv_buffers );
+    u->recv_buffers = NULL;
+    return 0;
+  }
+
+  memset( &reg, 0, sizeof(reg) );
+  reg.ring_addr = (uint64_t)(uintptr_t)u->recv_ring;
+  reg.ring_entries = TCPIP_URING_RECV_BUFFERS;
+  reg.bgid = TCPIP_URING_RECV_GROUP;
+  if( syscall( __NR_io_uring_register, u->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1 ) != 0 )
+  {
+    PRINT_INFO ( "setUpRecvBuffers() : The kernel does not support provided buffer rings (error code: %i). The sockets are read with recv()\n", errno );
+    munmap( u->recv_ring, u->recv_ring_size );
+    u->recv_ring = NULL;
+    free( u->recv_buffers );
+    u->recv_buffers = NULL;
+    return 0;
+  }
+
+  u->recv_ring_tail = 0;
+  for( buf_id = 0; buf_id < TCPIP_URING_RECV_BUFFERS; buf_id++ )
+    recycleRecvBuffer( u, buf_id );
+  u->recv_buffers_state = 1;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+static void handleCompletion( TcpIpUring *u, uint64_t user_data, int res, unsigned flags );
+
+// Collect the completions of the requests. Called with the lock held
+static void reapCompletions( TcpIpUring *u )
+{
+  unsigned cq_head, cq_tail;
+
+  cq_head = *u->cq_head;
+  cq_tail = __atomic_load_n( u->cq_tail, __ATOMIC_ACQUIRE );
+  for( ; cq_head != cq_tail; cq_head++ )
+  {
+    struct io_uring_cqe *cqe = &u->cqes[cq_head & *u->cq_mask];
+    handleCompletion( u, cqe->user_data, cqe->res, cqe->flags );
+  }
+  __atomic_store_n( u->cq_head, cq_head, __ATOMIC_RELEASE );
+}
+
+// Submit the queued requests. The links of the send chains never wait for room in the sockets (MSG_DONTWAIT), so they
+// complete during the submission and their results are collected before returning. Called with the lock held
+static int submitRequests( TcpIpUring *u )
+{
+  int i;
+
+  for( i = 0; i < u->n_queued_sends; i++ )
+    u->slots[u->queued_sends[i]].send_state = TCPIP_URING_ARMED;
+  u->n_queued_sends = 0;
+
+  if( enterRing( u, 0, 0, NULL, 0 ) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY )
+  {
+    PRINT_ERROR ( "submitRequests() : The io_uring requests could not be submitted. Error code: %i\n", errno );
+    return 0;
+  }
+  reapCompletions( u );
+  while( u->n_sends_in_flight > 0 )
+  {
+    if( enterRing( u, 1, IORING_ENTER_GETEVENTS, NULL, 0 ) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY )
+    {
+      PRINT_ERROR ( "submitRequests() : The completion of the send requests could not be waited for. Error code: %i\n", errno );
+      return 0;
+    }
+    reapCompletions( u );
+  }
+  return 1;
+}
+
+// Return a cleared submission queue entry, which is queued by commitSqe(). NULL if the queue is full and cannot be submitted
+static struct io_uring_sqe *getSqe( TcpIpUring *u )
+{
+  struct io_uring_sqe *sqe;
+
+  if( *u->sq_tail - __atomic_load_n( u->sq_head, __ATOMIC_ACQUIRE ) >= *u->sq_entries )
+  {
+    // The submission queue is full: submit its requests now
+    if( !submitRequests( u ) || *u->sq_tail - __atomic_load_n( u->sq_head, __ATOMIC_ACQUIRE ) >= *u->sq_entries )
+    {
+      PRINT_ERROR ( "getSqe() : The io_uring requests could not be submitted. Error code: %i\n", errno );
+      return NULL;
+    }
+  }
+  sqe = &u->sqes[*u->sq_tail & *u->sq_mask];
+  memset( sqe, 0, sizeof(struct io_uring_sqe) );
+  return sqe;
+}
+
+static void commitSqe( TcpIpUring *u )
+{
+  unsigned tail = *u->sq_tail;
+
+  u->sq_array[tail & *u->sq_mask] = tail & *u->sq_mask;
+  __atomic_store_n( u->sq_tail, tail + 1, __ATOMIC_RELEASE );
+}
+
+static int armPollRequest( TcpIpUring *u, int fd, int dir )
+{
+  struct io_uring_sqe *sqe;
+  uint32_t poll_mask;
+
+  sqe = getSqe( u );
+  if( sqe == NULL )
+    return 0;
+
+  poll_mask = (dir == TCPIP_URING_POLL_IN)? POLLIN : (dir == TCPIP_URING_POLL_OUT)? POLLOUT : POLLPRI;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  poll_mask = (poll_mask << 16) | (poll_mask >> 16); // The kernel expects the 16-bit halves swapped on big-endian machines
+#endif
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = poll_mask;
+  u->poll_gen[fd][dir] = nextGen( u );
+  sqe->user_data = requestData( u->poll_gen[fd][dir], fd, dir );
+  commitSqe( u );
+  setFdBit( u->armed[dir], fd );
+  return 1;
+}
+
+// Remove the poll request armed for a file descriptor and direction. It is found by its user_data
+static int removePollRequest( TcpIpUring *u, int fd, int dir )
+{
+  struct io_uring_sqe *sqe;
+
+  sqe = getSqe( u );
+  if( sqe == NULL )
+    return 0;
+
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = requestData( u->poll_gen[fd][dir], fd, dir );
+  sqe->user_data = TCPIP_URING_IGNORED_REQUEST;
+  commitSqe( u );
+  u->poll_gen[fd][dir] = 0; // The completion of the removed request will be ignored
+  clearFdBit( u->armed[dir], fd );
+  return 1;
+}
+
+// Cancel a RECV or ACCEPT request. It is found by its user_data
+static int cancelRequest( TcpIpUring *u, uint64_t user_data )
+{
+  struct io_uring_sqe *sqe;
+
+  sqe = getSqe( u );
+  if( sqe == NULL )
+    return 0;
+
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = user_data;
+  sqe->user_data = TCPIP_URING_IGNORED_REQUEST;
+  commitSqe( u );
+  return 1;
+}
+
+// Update the bits of a socket read through RECV or ACCEPT requests after its state has changed, so that the waits check the
+// sockets a word at a time
+static void updateReadBits( TcpIpUring *u, int fd )
+{
+  TcpIpUringSlot *slot = &u->slots[fd];
+  int ready = 0, armed = 0;
+
+  if( slot->ops & TCPIP_URING_OP_RECV )
+  {
+    ready = ( slot->recv_state == TCPIP_URING_DONE );
+    armed = ( slot->recv_state == TCPIP_URING_ARMED );
+  }
+  else if( slot->ops & TCPIP_URING_OP_ACCEPT )
+  {
+    ready = ( u->listeners[slot->listener].n_fds > 0 || u->listeners[slot->listener].accept_error != 0 );
+    armed = ( u->listeners[slot->listener].accept_gen != 0 );
+  }
+  if( ready ) setFdBit( u->read_ready, fd ); else clearFdBit( u->read_ready, fd );
+  if( armed ) setFdBit( u->read_armed, fd ); else clearFdBit( u->read_armed, fd );
+}
+
+static int armRecvRequest( TcpIpUring *u, int fd )
+{
+  TcpIpUringSlot *slot = &u->slots[fd];
+  struct io_uring_sqe *sqe;
+
+  sqe = getSqe( u );
+  if( sqe == NULL )
+    return 0;
+
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->len = TCPIP_URING_RECV_BUFFER_SIZE;
+  sqe->flags = IOSQE_BUFFER_SELECT; // The kernel picks a free provided buffer when the data arrives
+  sqe->buf_group = TCPIP_URING_RECV_GROUP;
+  slot->recv_gen = nextGen( u );
+  sqe->user_data = requestData( slot->recv_gen, fd, TCPIP_URING_RECV );
+  commitSqe( u );
+  slot->recv_state = TCPIP_URING_ARMED;
+  setFdBit( u->read_armed, fd );
+  u->n_pending++;
+  return 1;
+}
+
+static int armAcceptRequest( TcpIpUring *u, int fd )
+{
+#ifdef IORING_ACCEPT_MULTISHOT
+  TcpIpUringListener *listener = &u->listeners[u->slots[fd].listener];
+  struct io_uring_sqe *sqe;
+
+  sqe = getSqe( u );
+  if( sqe == NULL )
+    return 0;
+
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT; // The request stays armed and completes once for each connection
+  listener->accept_gen = nextGen( u );
+  sqe->user_data = requestData( listener->accept_gen, fd, TCPIP_URING_ACCEPT );
+  commitSqe( u );
+  setFdBit( u->read_armed, fd );
+  u->n_pending++;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+// Turn the links of a queued send chain into no-ops, since the socket is being closed
+static void dropSendChain( TcpIpUring *u, int fd )
+{
+  TcpIpUringSlot *slot = &u->slots[fd];
+  int link, i;
+
+  for( link = 0; link < slot->n_links; link++ )
+  {
+    struct io_uring_sqe *sqe = &u->sqes[(slot->sq_first + link) & *u->sq_mask];
+    memset( sqe, 0, sizeof(struct io_uring_sqe) );
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = TCPIP_URING_IGNORED_REQUEST;
+  }
+  u->n_sends_in_flight -= slot->n_links;
+  for( i = 0; i < u->n_queued_sends; i++ )
+  {
+    if( u->queued_sends[i] == fd )
+    {
+      u->queued_sends[i] = u->queued_sends[--u->n_queued_sends];
+      break;
+    }
+  }
+  slot->send_state = TCPIP_URING_IDLE;
+}
+
+// Release the requests and the resources of the socket attached to a slot. Called with the lock held
+static void detachSlot( TcpIpUring *u, int fd )
+{
+  TcpIpUringSlot *slot = &u->slots[fd];
+
+  if( slot->recv_state == TCPIP_URING_ARMED )
+    cancelRequest( u, requestData( slot->recv_gen, fd, TCPIP_URING_RECV ) ); // Its completion is ignored
+  else if( slot->recv_state == TCPIP_URING_DONE && slot->recv_res > 0 )
+    recycleRecvBuffer( u, slot->recv_buf );
+
+  if( slot->listener >= 0 )
+  {
+    TcpIpUringListener *listener = &u->listeners[slot->listener];
+    if( listener->accept_gen != 0 )
+      cancelRequest( u, requestData( listener->accept_gen, fd, TCPIP_URING_ACCEPT ) );
+    for( ; listener->n_fds > 0; listener->n_fds-- ) // Nobody will take the connections accepted in advance
+      close( listener->fds[listener->first_fd++] );
+    free( listener->fds );
+    memset( listener, 0, sizeof(TcpIpUringListener) );
+  }
+
+  if( slot->send_state == TCPIP_URING_QUEUED )
+    dropSendChain( u, fd );
+
+  clearFdBit( u->read_attached, fd );
+  clearFdBit( u->read_ready, fd );
+  clearFdBit( u->read_armed, fd );
+  memset( slot, 0, sizeof(TcpIpUringSlot) );
+  slot->listener = -1;
+}
+
+// Queue a connection accepted in advance. Returns 0 if there is not enough memory
+static int pushAcceptedFd( TcpIpUringListener *listener, int fd )
+{
+  if( listener->first_fd + listener->n_fds == listener->fds_size )
+  {
+    if( listener->first_fd > 0 ) // Move the queue to the start of the array
+    {
+      memmove( listener->fds, listener->fds + listener->first_fd, listener->n_fds * sizeof(int) );
+      listener->first_fd = 0;
+    }
+    else
+    {
+      unsigned new_size = (listener->fds_size > 0)? 2 * listener->fds_size : TCPIP_URING_ACCEPT_QUEUE;
+      int *new_fds = (int *)realloc( listener->fds, new_size * sizeof(int) );
+      if( new_fds == NULL )
+        return 0;
+      listener->fds = new_fds;
+      listener->fds_size = new_size;
+    }
+  }
+  listener->fds[listener->first_fd + listener->n_fds++] = fd;
+  return 1;
+}
+
+static void handleCompletion( TcpIpUring *u, uint64_t user_data, int res, unsigned flags )
+{
+  TcpIpUringSlot *slot;
+  uint32_t gen;
+  int fd, kind;
+
+  if( user_data == TCPIP_URING_IGNORED_REQUEST )
+    return;
+  gen = (uint32_t)(user_data >> 32);
+  fd = (int)((user_data & 0xFFFFFFFF) >> TCPIP_URING_KIND_BITS);
+  kind = (int)(user_data & ((1 << TCPIP_URING_KIND_BITS) - 1));
+  if( fd >= FD_SETSIZE )
+    return;
+  slot = &u->slots[fd];
+
+  switch( kind )
+  {
+    case TCPIP_URING_POLL_IN:
+    case TCPIP_URING_POLL_OUT:
+    case TCPIP_URING_POLL_PRI:
+      if( u->poll_gen[fd][kind] != gen ) // Completion of a removed poll request
+        break;
+      u->poll_gen[fd][kind] = 0; // Poll requests complete only once: it is armed again in the next wait if needed
+      clearFdBit( u->armed[kind], fd );
+      setFdBit( u->ready[kind], fd );
+      u->revents[fd][kind] = (res < 0)? POLLERR : res;
+      break;
+
+    case TCPIP_URING_RECV:
+      u->n_pending--;
+      if( slot->recv_state != TCPIP_URING_ARMED || slot->recv_gen != gen )
+      {
+        // Data of a detached socket
+        if( flags & IORING_CQE_F_BUFFER )
+          recycleRecvBuffer( u, flags >> IORING_CQE_BUFFER_SHIFT );
+        break;
+      }
+      slot->recv_state = TCPIP_URING_DONE;
+      slot->recv_off = 0;
+      if( res > 0 )
+      {
+        slot->recv_res = res;
+        slot->recv_buf = flags >> IORING_CQE_BUFFER_SHIFT;
+      }
+      else
+      {
+        if( flags & IORING_CQE_F_BUFFER )
+          recycleRecvBuffer( u, flags >> IORING_CQE_BUFFER_SHIFT );
+        if( res == -ENOBUFS ) // All the provided buffers hold data: the socket is read with recv()
+          slot->recv_res = TCPIP_URING_RECV_RETRY;
+        else if( res == -EINVAL ) // The kernel does not support provided buffers for RECV: the socket is polled
+        {
+          slot->recv_res = TCPIP_URING_RECV_RETRY;
+          slot->ops &= ~TCPIP_URING_OP_RECV;
+          clearFdBit( u->read_attached, fd );
+        }
+        else
+          slot->recv_res = res;
+      }
+      updateReadBits( u, fd );
+      break;
+
+    case TCPIP_URING_ACCEPT:
+    {
+      TcpIpUringListener *listener = (slot->listener >= 0)? &u->listeners[slot->listener] : NULL;
+
+      if( !(flags & IORING_CQE_F_MORE) )
+        u->n_pending--;
+      if( listener == NULL || (listener->accept_gen != gen && listener->stopped_gen != gen) )
+      {
+        if( res >= 0 ) // Connection accepted for a detached listener
+          close( res );
+        break;
+      }
+      if( !(flags & IORING_CQE_F_MORE) && listener->accept_gen == gen ) // The request is not armed anymore
+        listener->accept_gen = 0;
+      if( res >= 0 && pushAcceptedFd( listener, res ) )
+      {
+        if( listener->n_fds >= TCPIP_URING_ACCEPT_QUEUE && listener->accept_gen == gen )
+        {
+          // Enough connections wait: the next ones wait in the backlog until the request is armed again. The ones accepted
+          // before the cancellation is submitted (e.g. the whole backlog, when the request is armed) are still queued
+          cancelRequest( u, requestData( listener->accept_gen, fd, TCPIP_URING_ACCEPT ) );
+          listener->stopped_gen = gen;
+          listener->accept_gen = 0;
+        }
+      }
+      else if( res >= 0 )
+      {
+        PRINT_ERROR ( "handleCompletion() : Not enough memory to queue a connection accepted by listener FD %i: it has been closed\n", fd );
+        close( res );
+      }
+      else if( res == -EINVAL ) // The kernel does not support multishot accept: the listener is polled
+      {
+        slot->ops &= ~TCPIP_URING_OP_ACCEPT;
+        clearFdBit( u->read_attached, fd );
+      }
+      else if( res != -ECANCELED )
+        listener->accept_error = -res;
+      updateReadBits( u, fd );
+      break;
+    }
+
+    case TCPIP_URING_SEND:
+      u->n_sends_in_flight--;
+      if( slot->send_state != TCPIP_URING_ARMED || slot->send_gen != gen )
+        break;
+      // The links complete in order. A link that sends less than its data fails (MSG_WAITALL), and the next ones are canceled
+      if( res > 0 )
+        slot->send_bytes += res;
+      else if( res < 0 && res != -ECANCELED && slot->send_error == 0 )
+        slot->send_error = -res;
+      if( --slot->n_links_left == 0 )
+        slot->send_state = TCPIP_URING_DONE;
+      break;
+
+    default:
+      break;
+  }
+}
+
+// Get the bit map of the file descriptors of a set that are below nfds
+static void getWaitedFds( const fd_set *set, int nfds, unsigned long *words )
+{
+  int w;
+
+  memcpy( words, set, sizeof(fd_set) );
+  for( w = 0; w < TCPIP_URING_N_WORDS; w++ )
+  {
+    int first_fd = w * TCPIP_URING_WORD_BITS;
+    if( first_fd >= nfds )
+      words[w] = 0;
+    else if( nfds - first_fd < TCPIP_URING_WORD_BITS )
+      words[w] &= (1UL << (nfds - first_fd)) - 1;
+  }
+}
+
+// Arm or remove poll requests of a direction, so that they are armed only for the file descriptors waited for
+static int updatePollRequests( TcpIpUring *u, int dir, const unsigned long *waited )
+{
+  int w;
+
+  for( w = 0; w < TCPIP_URING_N_WORDS; w++ )
+  {
+    unsigned long changed = waited[w] ^ u->armed[dir][w];
+    while( changed != 0 )
+    {
+      int bit = __builtin_ctzl( changed );
+      int fd = w * TCPIP_URING_WORD_BITS + bit;
+      changed &= changed - 1;
+      if( (waited[w] >> bit) & 1 )
+      {
+        if( !armPollRequest( u, fd, dir ) )
+          return 0;
+      }
+      else if( !removePollRequest( u, fd, dir ) )
+        return 0;
+    }
+  }
+  return 1;
+}
+
+// Arm the RECV or ACCEPT request of a socket waited for reading
+static int armReadRequest( TcpIpUring *u, int fd )
+{
+  if( u->slots[fd].ops & TCPIP_URING_OP_RECV )
+    return armRecvRequest( u, fd );
+  return armAcceptRequest( u, fd );
+}
+
+TcpIpUring *tcpIpUringCreate( void )
+{
+  TcpIpUring *u;
+  struct io_uring_params params;
+  size_t sq_rings_size, cq_rings_size;
+  int fd;
+
+  PRINT_VVDEBUG ( "tcpIpUringCreate()\n" );
+
+  u = (TcpIpUring *)calloc( 1, sizeof(TcpIpUring) );
+  if( u == NULL )
+  {
+    PRINT_ERROR ( "tcpIpUringCreate() : Not enough memory\n" );
+    return NULL;
+  }
+
+  memset( &params, 0, sizeof(params) );
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = TCPIP_URING_CQ_ENTRIES;
+  u->ring_fd = (int)syscall( __NR_io_uring_setup, TCPIP_URING_SQ_ENTRIES, &params );
+  if( u->ring_fd < 0 )
+  {
+    PRINT_INFO ( "tcpIpUringCreate() : io_uring is not available (error code: %i). select() is used instead\n", errno );
+    free( u );
+    return NULL;
+  }
+  // The timeout of io_uring_enter() needs IORING_FEAT_EXT_ARG and no completion may be lost (IORING_FEAT_NODROP)
+  if( (params.features & (IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG)) !=
+      (IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG) )
+  {
+    PRINT_INFO ( "tcpIpUringCreate() : The kernel io_uring does not support the needed features. select() is used instead\n" );
+    close( u->ring_fd );
+    free( u );
+    return NULL;
+  }
+
+  sq_rings_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_rings_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  u->rings_size = (sq_rings_size > cq_rings_size)? sq_rings_size : cq_rings_size;
+  u->rings = (unsigned char *)mmap( NULL, u->rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQ_RING );
+  u->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  u->sqes = (struct io_uring_sqe *)mmap( NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQES );
+  if( u->rings == MAP_FAILED || u->sqes == MAP_FAILED || !cRosMutexInit( &u->lock ) )
+  {
+    PRINT_ERROR ( "tcpIpUringCreate() : The io_uring rings could not be mapped. select() is used instead\n" );
+    if( u->rings != MAP_FAILED )
+      munmap( u->rings, u->rings_size );
+    if( u->sqes != MAP_FAILED )
+      munmap( u->sqes, u->sqes_size );
+    close( u->ring_fd );
+    free( u );
+    return NULL;
+  }
+
+  u->sq_head = (unsigned *)(u->rings + params.sq_off.head);
+  u->sq_tail = (unsigned *)(u->rings + params.sq_off.tail);
+  u->sq_mask = (unsigned *)(u->rings + params.sq_off.ring_mask);
+  u->sq_entries = (unsigned *)(u->rings + params.sq_off.ring_entries);
+  u->sq_array = (unsigned *)(u->rings + params.sq_off.array);
+  u->cq_head = (unsigned *)(u->rings + params.cq_off.head);
+  u->cq_tail = (unsigned *)(u->rings + params.cq_off.tail);
+  u->cq_mask = (unsigned *)(u->rings + params.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe *)(u->rings + params.cq_off.cqes);
+  for( fd = 0; fd < FD_SETSIZE; fd++ )
+    u->slots[fd].listener = -1;
+
+  cRosMutexLock( &uring_list_lock );
+  u->next = uring_list;
+  uring_list = u;
+  cRosMutexUnlock( &uring_list_lock );
+
+  PRINT_VDEBUG ( "tcpIpUringCreate() : Waiting for the sockets with io_uring\n" );
+  return u;
+}
+
+void tcpIpUringDestroy( TcpIpUring *u )
+{
+  TcpIpUring **prev;
+  uint64_t start_time;
+  int fd;
+
+  PRINT_VVDEBUG ( "tcpIpUringDestroy()\n" );
+
+  if( u == NULL )
+    return;
+
+  cRosMutexLock( &uring_list_lock );
+  for( prev = &uring_list; *prev != NULL && *prev != u; prev = &(*prev)->next );
+  if( *prev != NULL )
+    *prev = u->next;
+  cRosMutexUnlock( &uring_list_lock );
+
+  // The pending RECV requests may still write into the provided buffers and the ACCEPT ones install new file descriptors,
+  // so they are canceled and waited for before releasing the instance
+  cRosMutexLock( &u->lock );
+  for( fd = 0; fd < FD_SETSIZE; fd++ )
+  {
+    if( u->slots[fd].serial != 0 )
+      detachSlot( u, fd );
+  }
+  start_time = cRosClockGetTimeMs();
+  while( u->n_pending > 0 && submitRequests( u ) && cRosClockGetTimeMs() - start_time < TCPIP_URING_DESTROY_TIME_OUT )
+  {
+    struct __kernel_timespec timeout_ts = { 0, 10000000 };
+    struct io_uring_getevents_arg getevents_arg;
+
+    memset( &getevents_arg, 0, sizeof(getevents_arg) );
+    getevents_arg.ts = (uint64_t)(uintptr_t)&timeout_ts;
+    enterRing( u, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &getevents_arg, sizeof(getevents_arg) );
+    reapCompletions( u );
+  }
+  cRosMutexUnlock( &u->lock );
+
+  munmap( u->sqes, u->sqes_size );
+  munmap( u->rings, u->rings_size );
+  close( u->ring_fd ); // The armed poll requests are canceled
+  if( u->recv_ring != NULL )
+    munmap( u->recv_ring, u->recv_ring_size );
+  free( u->recv_buffers );
+  cRosMutexRelease( &u->lock );
+  free( u );
+}
+
+int tcpIpUringAttachSocket( TcpIpUring *u, TcpIpSocket *s, unsigned ops )
+{
+  TcpIpUringSlot *slot;
+  int fd = s->fd;
+
+  if( u == NULL || !s->open || fd < 0 || fd >= FD_SETSIZE )
+    return 0;
+  if( s->uring != NULL ) // Attached already (to this instance or to another one)
+    return( s->uring == u );
+
+  if( s->zerocopy_min_size > 0 )
+    ops &= ~TCPIP_URING_OP_SEND_FRAMES; // A chain could not tell when the kernel is done with the zero-copy data
+  if( s->rx_timestamps )
+    ops &= ~TCPIP_URING_OP_RECV;
+
+  cRosMutexLock( &u->lock );
+  slot = &u->slots[fd];
+  if( slot->serial != 0 ) // The socket that had this file descriptor has been closed
+    detachSlot( u, fd );
+  if( (ops & TCPIP_URING_OP_RECV) && !setUpRecvBuffers( u ) )
+    ops &= ~TCPIP_URING_OP_RECV;
+  if( ops & TCPIP_URING_OP_ACCEPT )
+  {
+    int listener_idx;
+    for( listener_idx = 0; listener_idx < TCPIP_URING_MAX_LISTENERS && u->listeners[listener_idx].in_use; listener_idx++ );
+#ifdef IORING_ACCEPT_MULTISHOT
+    if( listener_idx < TCPIP_URING_MAX_LISTENERS && !(ops & TCPIP_URING_OP_RECV) )
+    {
+      memset( &u->listeners[listener_idx], 0, sizeof(TcpIpUringListener) );
+      u->listeners[listener_idx].in_use = 1;
+      slot->listener = listener_idx;
+    }
+    else
+#endif
+      ops &= ~TCPIP_URING_OP_ACCEPT;
+  }
+  if( ops & (TCPIP_URING_OP_RECV | TCPIP_URING_OP_ACCEPT) )
+    setFdBit( u->read_attached, fd );
+
+  slot->ops = ops;
+  slot->serial = __atomic_add_fetch( &last_serial, 1, __ATOMIC_RELAXED );
+  if( slot->serial == 0 ) // 0 means that no socket is attached
+    slot->serial = __atomic_add_fetch( &last_serial, 1, __ATOMIC_RELAXED );
+  s->uring = u;
+  s->uring_serial = slot->serial;
+  s->uring_ops = (unsigned char)ops;
+  cRosMutexUnlock( &u->lock );
+
+  PRINT_VDEBUG ( "tcpIpUringAttachSocket() : Socket FD %i attached with operations 0x%x\n", fd, ops );
+  return 1;
+}
+
+int tcpIpUringSelect( TcpIpUring *u, int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, uint64_t time_out )
+{
+  fd_set wanted_r, wanted_w, wanted_e;
+  struct __kernel_timespec timeout_ts;
+  struct io_uring_getevents_arg getevents_arg;
+  unsigned long waited[TCPIP_URING_N_POLL_DIRS][TCPIP_URING_N_WORDS], attached_r[TCPIP_URING_N_WORDS], bits;
+  int fd, dir, w, nfds_set, n_ready;
+
+  if( u == NULL )
+    return tcpIpSocketSelect( nfds, readfds, writefds, exceptfds, time_out );
+
+  PRINT_VVDEBUG( "tcpIpUringSelect(): nfds: %i\n", nfds);
+
+  if( nfds > FD_SETSIZE )
+    nfds = FD_SETSIZE;
+
+  // The sets are both the input and the output of select(), so the file descriptors waited for are kept apart
+  FD_ZERO( &wanted_r );
+  FD_ZERO( &wanted_w );
+  FD_ZERO( &wanted_e );
+  if( readfds != NULL ) { wanted_r = *readfds; FD_ZERO( readfds ); }
+  if( writefds != NULL ) { wanted_w = *writefds; FD_ZERO( writefds ); }
+  if( exceptfds != NULL ) { wanted_e = *exceptfds; FD_ZERO( exceptfds ); }
+
+  cRosMutexLock( &u->lock );
+  if( u->n_queued_sends > 0 && !submitRequests( u ) )
+  {
+    cRosMutexUnlock( &u->lock );
+    return -1;
+  }
+
+  getWaitedFds( &wanted_r, nfds, waited[TCPIP_URING_POLL_IN] );
+  getWaitedFds( &wanted_w, nfds, waited[TCPIP_URING_POLL_OUT] );
+  getWaitedFds( &wanted_e, nfds, waited[TCPIP_URING_POLL_PRI] );
+
+  // The attached sockets waited for reading are not polled: their RECV or ACCEPT request reports them when it completes
+  for( w = 0; w < TCPIP_URING_N_WORDS; w++ )
+  {
+    attached_r[w] = waited[TCPIP_URING_POLL_IN][w] & u->read_attached[w];
+    waited[TCPIP_URING_POLL_IN][w] &= ~u->read_attached[w];
+    for( bits = attached_r[w] & ~u->read_ready[w] & ~u->read_armed[w]; bits != 0; bits &= bits - 1 )
+    {
+      fd = w * TCPIP_URING_WORD_BITS + __builtin_ctzl( bits );
+      if( !armReadRequest( u, fd ) )
+      {
+        cRosMutexUnlock( &u->lock );
+        return -1;
+      }
+    }
+  }
+
+  // Poll requests stay armed between waits. Only the changes of the waited file descriptors are submitted. The ones that
+  // completed before this wait (while the sends were submitted) are reported without arming them again
+  for( dir = 0; dir < TCPIP_URING_N_POLL_DIRS; dir++ )
+  {
+    for( w = 0; w < TCPIP_URING_N_WORDS; w++ )
+    {
+      u->ready[dir][w] &= waited[dir][w];
+      waited[dir][w] &= ~u->ready[dir][w];
+    }
+    if( !updatePollRequests( u, dir, waited[dir] ) )
+    {
+      cRosMutexUnlock( &u->lock );
+      return -1;
+    }
+  }
+
+  // The requests may have completed while they were being armed, if the submission queue filled up
+  n_ready = 0;
+  for( w = 0; w < TCPIP_URING_N_WORDS && n_ready == 0; w++ )
+  {
+    for( dir = 0; dir < TCPIP_URING_N_POLL_DIRS; dir++ )
+      n_ready += ( u->ready[dir][w] != 0 );
+    n_ready += ( (attached_r[w] & u->read_ready[w]) != 0 );
+  }
+  cRosMutexUnlock( &u->lock );
+
+  if( n_ready > 0 )
+  {
+    // Do not wait: just submit the changes
+    if( *u->sq_tail != __atomic_load_n( u->sq_head, __ATOMIC_ACQUIRE ) && enterRing( u, 0, 0, NULL, 0 ) < 0 &&
+        errno != EINTR && errno != EAGAIN && errno != EBUSY )
+    {
+      PRINT_ERROR("tcpIpUringSelect() : io_uring_enter() call failed. Error code: %i\n", errno);
+      return -1;
+    }
+  }
+  else
+  {
+    timeout_ts.tv_sec = (long long)(time_out / 1000);
+    timeout_ts.tv_nsec = (long long)(time_out % 1000) * 1000000;
+    memset( &getevents_arg, 0, sizeof(getevents_arg) );
+    getevents_arg.ts = (uint64_t)(uintptr_t)&timeout_ts;
+    // Submit the changes and wait for one completion at least in the same system call
+    if( enterRing( u, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &getevents_arg, sizeof(getevents_arg) ) < 0 &&
+        errno != ETIME && errno != EINTR && errno != EAGAIN && errno != EBUSY )
+    {
+      PRINT_ERROR("tcpIpUringSelect() : io_uring_enter() call failed. Error code: %i\n", errno);
+      return -1;
+    }
+  }
+
+  cRosMutexLock( &u->lock );
+  reapCompletions( u );
+
+  nfds_set = 0;
+  for( w = 0; w < TCPIP_URING_N_WORDS; w++ )
+  {
+    for( bits = attached_r[w] & u->read_attached[w] & u->read_ready[w]; bits != 0; bits &= bits - 1 )
+    {
+      fd = w * TCPIP_URING_WORD_BITS + __builtin_ctzl( bits );
+      if( readfds != NULL )
+      {
+        FD_SET( fd, readfds );
+        nfds_set++;
+      }
+    }
+
+    for( dir = 0; dir < TCPIP_URING_N_POLL_DIRS; dir++ )
+    {
+      unsigned long ready = u->ready[dir][w];
+      u->ready[dir][w] = 0;
+      while( ready != 0 )
+      {
+        int revents;
+
+        fd = w * TCPIP_URING_WORD_BITS + __builtin_ctzl( ready );
+        ready &= ready - 1;
+        // The kernel always reports POLLHUP and POLLERR, whatever the poll mask. As select(), the hang-ups and errors are reported
+        // as readable. They are reported as writable and exceptional too if the socket is not waited for reading: otherwise,
+        // its poll request would complete again at once in every wait, and the operation that reports the error would not be tried
+        revents = u->revents[fd][dir];
+        if( dir == TCPIP_URING_POLL_IN )
+        {
+          if( (revents & (POLLIN | POLLHUP | POLLERR)) && readfds != NULL && FD_ISSET( fd, &wanted_r ) )
+          {
+            FD_SET( fd, readfds );
+            nfds_set++;
+          }
+        }
+        else if( dir == TCPIP_URING_POLL_OUT )
+        {
+          if( ((revents & POLLOUT) || ((revents & (POLLHUP | POLLERR)) && !FD_ISSET( fd, &wanted_r ))) &&
+              writefds != NULL && FD_ISSET( fd, &wanted_w ) )
+          {
+            FD_SET( fd, writefds );
+            nfds_set++;
+          }
+        }
+        else if( ((revents & POLLPRI) || ((revents & (POLLHUP | POLLERR)) && !FD_ISSET( fd, &wanted_r ) && !FD_ISSET( fd, &wanted_w ))) &&
+                 exceptfds != NULL && FD_ISSET( fd, &wanted_e ) )
+        {
+          FD_SET( fd, exceptfds );
+          nfds_set++;
+        }
+      }
+    }
+  }
+  cRosMutexUnlock( &u->lock );
+
+  return(nfds_set);
+}
+
+int tcpIpUringFlushSends( TcpIpUring *u )
+{
+  int n_chains;
+
+  if( u == NULL )
+    return 0;
+
+  cRosMutexLock( &u->lock );
+  n_chains = u->n_queued_sends;
+  if( n_chains > 0 && !submitRequests( u ) )
+    n_chains = -1;
+  cRosMutexUnlock( &u->lock );
+  return n_chains;
+}
+
+int tcpIpUringSendDone( TcpIpSocket *s )
+{
+  TcpIpUring *u = s->uring;
+  int done;
+
+  if( u == NULL || !(s->uring_ops & TCPIP_URING_OP_SEND_FRAMES) )
+    return 0;
+
+  cRosMutexLock( &u->lock );
+  done = ( u->slots[s->fd].serial == s->uring_serial && u->slots[s->fd].send_state == TCPIP_URING_DONE );
+  cRosMutexUnlock( &u->lock );
+  return done;
+}
+
+int tcpIpUringRecv( TcpIpSocket *s, char *buf, size_t max_size )
+{
+  TcpIpUring *u = s->uring;
+  TcpIpUringSlot *slot = &u->slots[s->fd];
+  int n_read, filled;
+
+  cRosMutexLock( &u->lock );
+  if( slot->serial != s->uring_serial || !(slot->ops & TCPIP_URING_OP_RECV) || slot->recv_state == TCPIP_URING_IDLE )
+  {
+    // No request has been armed yet, so the socket can be read directly
+    if( s->rx_timestamps && slot->serial == s->uring_serial ) // Enabled after the socket was attached: the next reads get them
+    {
+      slot->ops &= ~TCPIP_URING_OP_RECV;
+      s->uring_ops &= ~TCPIP_URING_OP_RECV;
+      clearFdBit( u->read_attached, s->fd );
+    }
+    cRosMutexUnlock( &u->lock );
+    return (int)recv( s->fd, buf, max_size, 0 );
+  }
+  if( slot->recv_state == TCPIP_URING_ARMED ) // The data will be received by the RECV request
+  {
+    cRosMutexUnlock( &u->lock );
+    errno = EAGAIN;
+    return -1;
+  }
+
+  if( slot->recv_res <= 0 )
+  {
+    n_read = slot->recv_res;
+    slot->recv_state = TCPIP_URING_IDLE;
+    updateReadBits( u, s->fd );
+    cRosMutexUnlock( &u->lock );
+    if( n_read == TCPIP_URING_RECV_RETRY )
+      return (int)recv( s->fd, buf, max_size, 0 );
+    if( n_read == 0 )
+      return 0;
+    errno = -n_read;
+    return -1;
+  }
+
+  n_read = slot->recv_res - (int)slot->recv_off;
+  if( (size_t)n_read > max_size )
+    n_read = (int)max_size;
+  memcpy( buf, u->recv_buffers + (size_t)slot->recv_buf * TCPIP_URING_RECV_BUFFER_SIZE + slot->recv_off, n_read );
+  slot->recv_off += n_read;
+  if( slot->recv_off < (unsigned)slot->recv_res ) // The rest is returned by the next reads
+  {
+    cRosMutexUnlock( &u->lock );
+    return n_read;
+  }
+
+  recycleRecvBuffer( u, slot->recv_buf );
+  filled = ( slot->recv_res == TCPIP_URING_RECV_BUFFER_SIZE );
+  slot->recv_state = TCPIP_URING_IDLE;
+  updateReadBits( u, s->fd );
+  cRosMutexUnlock( &u->lock );
+  if( filled && (size_t)n_read < max_size )
+  {
+    // The buffer was filled, so more data is probably waiting in the socket: read it now instead of in the next loop pass
+    int n_more = (int)recv( s->fd, buf + n_read, max_size - n_read, MSG_DONTWAIT );
+    if( n_more > 0 )
+      n_read += n_more;
+  }
+  return n_read;
+}
+
+// Read the length of the TCPROS frame that starts at data (little-endian)
+static size_t frameSize( const char *data )
+{
+  const unsigned char *bytes = (const unsigned char *)data;
+  return 4 + ((size_t)bytes[0] | ((size_t)bytes[1] << 8) | ((size_t)bytes[2] << 16) | ((size_t)bytes[3] << 24));
+}
+
+// Advance the position of the socket in its TCPROS frames after size bytes of data have been sent
+static void advanceFrames( TcpIpUringSlot *slot, const char *data, size_t size )
+{
+  while( size > 0 )
+  {
+    size_t step;
+    if( slot->frame_left == 0 )
+      slot->frame_left = frameSize( data ); // The frame was fully present in the data sent by the chain
+    step = (slot->frame_left < size)? slot->frame_left : size;
+    slot->frame_left -= step;
+    data += step;
+    size -= step;
+  }
+}
+
+// Queue a chain of linked send requests for the data. Each link sends whole TCPROS frames, grouped up to
+// TCPIP_URING_SEND_LINK_SIZE bytes, or a piece of a larger frame. The frames only decide where the links are cut: the data
+// is sent in order whatever it contains. Called with the lock held
+static int queueSendChain( TcpIpUring *u, int fd, const char *data, size_t size )
+{
+  TcpIpUringSlot *slot = &u->slots[fd];
+  size_t link_sizes[TCPIP_URING_MAX_SEND_LINKS], pos = 0, link_size = 0, frame_left = slot->frame_left, offset;
+  int n_links = 0, link;
+
+  while( pos < size )
+  {
+    size_t step;
+
+    if( n_links == TCPIP_URING_MAX_SEND_LINKS - 1 ) // The last link sends the rest
+    {
+      link_size += size - pos;
+      break;
+    }
+    if( frame_left == 0 )
+    {
+      frame_left = ( size - pos >= 4 )? frameSize( data + pos ) : size - pos;
+      if( link_size > 0 && link_size + frame_left > TCPIP_URING_SEND_LINK_SIZE ) // The frame does not fit in the current link
+      {
+        link_sizes[n_links++] = link_size;
+        link_size = 0;
+        continue;
+      }
+    }
+    step = TCPIP_URING_SEND_LINK_SIZE - link_size;
+    if( step > frame_left ) step = frame_left;
+    if( step > size - pos ) step = size - pos;
+    pos += step;
+    link_size += step;
+    frame_left -= step;
+    if( link_size == TCPIP_URING_SEND_LINK_SIZE )
+    {
+      link_sizes[n_links++] = link_size;
+      link_size = 0;
+    }
+  }
+  if( link_size > 0 )
+    link_sizes[n_links++] = link_size;
+
+  // The links of a chain must be submitted together, since the link flag of the last entry of a submission is ignored
+  if( *u->sq_entries - (*u->sq_tail - __atomic_load_n( u->sq_head, __ATOMIC_ACQUIRE )) < (unsigned)n_links &&
+      !submitRequests( u ) )
+    return 0;
+
+  slot->send_gen = nextGen( u );
+  slot->sq_first = *u->sq_tail;
+  for( link = 0, offset = 0; link < n_links; offset += link_sizes[link], link++ )
+  {
+    struct io_uring_sqe *sqe = getSqe( u );
+
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)(data + offset);
+    sqe->len = (uint32_t)link_sizes[link];
+    // A link that cannot send all its data fails, so that the next links are canceled and the data is sent in order
+    sqe->msg_flags = MSG_DONTWAIT | MSG_NOSIGNAL | ((link < n_links - 1)? MSG_WAITALL : 0);
+    sqe->flags = (link < n_links - 1)? IOSQE_IO_LINK : 0;
+    sqe->user_data = requestData( slot->send_gen, fd, TCPIP_URING_SEND );
+    commitSqe( u );
+  }
+  slot->send_data = data;
+  slot->n_links = slot->n_links_left = n_links;
+  slot->send_bytes = 0;
+  slot->send_error = 0;
+  slot->send_state = TCPIP_URING_QUEUED;
+  u->queued_sends[u->n_queued_sends++] = fd;
+  u->n_sends_in_flight += n_links;
+  return 1;
+}
+
+int tcpIpUringSend( TcpIpSocket *s, const char *data, size_t size )
+{
+  TcpIpUring *u = s->uring;
+  TcpIpUringSlot *slot = &u->slots[s->fd];
+  int ret;
+
+  cRosMutexLock( &u->lock );
+  if( slot->serial != s->uring_serial || !(slot->ops & TCPIP_URING_OP_SEND_FRAMES) )
+  {
+    cRosMutexUnlock( &u->lock );
+    return (int)send( s->fd, data, size, MSG_NOSIGNAL );
+  }
+
+  switch( slot->send_state )
+  {
+    case TCPIP_URING_DONE:
+      slot->send_state = TCPIP_URING_IDLE;
+      if( data != slot->send_data ) // The data sent by the chain was not the start of this data
+      {
+        PRINT_ERROR ( "tcpIpUringSend() : The data of socket FD %i changed while it was being sent\n", s->fd );
+        errno = EPROTO;
+        ret = -1;
+      }
+      else if( slot->send_bytes > 0 ) // If a link failed after sending data, the next send reports the error
+      {
+        advanceFrames( slot, data, slot->send_bytes );
+        ret = (int)slot->send_bytes;
+      }
+      else
+      {
+        errno = ( slot->send_error != 0 )? slot->send_error : EAGAIN;
+        ret = -1;
+      }
+      break;
+
+    case TCPIP_URING_QUEUED:
+    case TCPIP_URING_ARMED:
+      errno = EAGAIN;
+      ret = -1;
+      break;
+
+    default:
+      if( queueSendChain( u, s->fd, data, size ) )
+      {
+        errno = EAGAIN; // The chain is sent by tcpIpUringFlushSends() or by the next wait
+        ret = -1;
+      }
+      else
+        ret = (int)send( s->fd, data, size, MSG_NOSIGNAL );
+      break;
+  }
+  cRosMutexUnlock( &u->lock );
+  return ret;
+}
+
+int tcpIpUringAccept( TcpIpSocket *s, struct sockaddr_in *rem_addr )
+{
+  TcpIpUring *u = s->uring;
+  TcpIpUringSlot *slot = &u->slots[s->fd];
+  TcpIpUringListener *listener;
+  socklen_t addr_len = sizeof(struct sockaddr_in);
+  int new_fd = -1, error = 0;
+
+  cRosMutexLock( &u->lock );
+  if( slot->serial != s->uring_serial || !(slot->ops & TCPIP_URING_OP_ACCEPT) )
+  {
+    cRosMutexUnlock( &u->lock );
+    return accept( s->fd, (struct sockaddr *)rem_addr, &addr_len );
+  }
+
+  listener = &u->listeners[slot->listener];
+  if( listener->n_fds > 0 )
+  {
+    new_fd = listener->fds[listener->first_fd++];
+    if( --listener->n_fds == 0 )
+      listener->first_fd = 0;
+  }
+  else if( listener->accept_error != 0 )
+  {
+    error = listener->accept_error;
+    listener->accept_error = 0;
+  }
+  else if( listener->accept_gen != 0 ) // The next connection will be accepted by the ACCEPT request
+    error = EAGAIN;
+  else
+  {
+    cRosMutexUnlock( &u->lock );
+    return accept( s->fd, (struct sockaddr *)rem_addr, &addr_len );
+  }
+  updateReadBits( u, s->fd );
+  cRosMutexUnlock( &u->lock );
+
+  if( new_fd < 0 )
+  {
+    errno = error;
+    return -1;
+  }
+  if( getpeername( new_fd, (struct sockaddr *)rem_addr, &addr_len ) != 0 )
+    memset( rem_addr, 0, sizeof(struct sockaddr_in) );
+  return new_fd;
+}
+
+void tcpIpUringDetachSocket( TcpIpSocket *s )
+{
+  TcpIpUring *u;
+  int fd = s->fd, dir;
+
+  if( fd < 0 || fd >= FD_SETSIZE )
+    return;
+
+  // The requests hold a reference to the socket, which would keep it open (and its port bound) after it is closed, and
+  // the poll requests would watch the old socket if its file descriptor is reused. So they are removed from every instance,
+  // keyed by their user_data, before the file descriptor is closed
+  cRosMutexLock( &uring_list_lock );
+  for( u = uring_list; u != NULL; u = u->next )
+  {
+    unsigned sq_tail;
+
+    cRosMutexLock( &u->lock );
+    sq_tail = *u->sq_tail;
+    if( s->uring_serial != 0 && u->slots[fd].serial == s->uring_serial )
+      detachSlot( u, fd );
+    for( dir = 0; dir < TCPIP_URING_N_POLL_DIRS; dir++ )
+    {
+      clearFdBit( u->ready[dir], fd );
+      if( (u->armed[dir][fd / TCPIP_URING_WORD_BITS] >> (fd % TCPIP_URING_WORD_BITS)) & 1 )
+        removePollRequest( u, fd, dir );
+    }
+    if( *u->sq_tail != sq_tail )
+      submitRequests( u );
+    cRosMutexUnlock( &u->lock );
+  }
+  cRosMutexUnlock( &uring_list_lock );
+
+  s->uring = NULL;
+  s->uring_serial = 0;
+  s->uring_ops = 0;
+}
+
+#else // The io_uring backend is not compiled in: the event loops use select() and the sockets are never attached
+
+TcpIpUring *tcpIpUringCreate( void )
+{
+  return NULL;
+}
+
+void tcpIpUringDestroy( TcpIpUring *u )
+{
+}
+
+int tcpIpUringAttachSocket( TcpIpUring *u, TcpIpSocket *s, unsigned ops )
+{
+  return 0;
+}
+
+int tcpIpUringSelect( TcpIpUring *u, int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, uint64_t time_out )
+{
+  return tcpIpSocketSelect( nfds, readfds, writefds, exceptfds, time_out );
+}
+
+int tcpIpUringFlushSends( TcpIpUring *u )
+{
+  return 0;
+}
+
+int tcpIpUringSendDone( TcpIpSocket *s )
+{
+  return 0;
+}
+
+int tcpIpUringRecv( TcpIpSocket *s, char *buf, size_t max_size )
+{
+  return -1;
+}
+
+int tcpIpUringSend( TcpIpSocket *s, const char *data, size_t size )
+{
+  return -1;
+}
+
+int tcpIpUringAccept( TcpIpSocket *s, struct sockaddr_in *rem_addr )
+{
+  return -1;
+}
+
+void tcpIpUringDetachSocket( TcpIpSocket *s )
+{
+}
+
+#endif
@@ -13,16 +13,27 @@ void tcprosProcessInit( TcprosProcess *p )
   dynStringInit( &(p->servicerequest_type) );
   dynStringInit( &(p->serviceresponse_type) );
   dynStringInit( &(p->md5sum) );
+  dynStringInit( &(p->message_definition) );
   dynBufferInit( &(p->packet) );
   p->latching = p->tcp_nodelay = p->persistent = 0;
   p->probe = 0;
   p->last_change_time = 0;
+  p->clock = NULL;
   p->topic_idx = -1;
   p->service_idx = -1;
   p->ok_byte = 0;
   p->left_to_recv = 0;
   p->sub_tcpros_host = NULL;
   p->sub_tcpros_port = -1;
+  cRosTokenBucketInit( &(p->shaper), 0, 0, 0 );
+  p->shaping_deferred = 0;
+  p->frame_rx_time_stamp = 0;
+  cRosTopicStatsInit( &(p->stats), 0 );
+  dynStringInit( &(p->filter_expr) );
+  cRosMessageFilterInit( &(p->filter) );
+  dynBufferInit( &(p->filtered_batch) );
+  dynBufferInit( &(p->filtered_packet) );
+  dynBufferInit( &(p->shared_packet) );
 }
 
 void tcprosProcessRelease( TcprosProcess *p )
@@ -37,16 +48,27 @@ void tcprosProcessRelease( TcprosProcess *p )
   dynStringRelease( &(p->servicerequest_type) );
   dynStringRelease( &(p->serviceresponse_type) );
   dynStringRelease( &(p->md5sum) );
+  dynStringRelease( &(p->message_definition) );
   dynBufferRelease( &(p->packet) );
   free(p->sub_tcpros_host);
+  dynStringRelease( &(p->filter_expr) );
+  cRosMessageFilterRelease( &(p->filter) );
+  dynBufferRelease( &(p->filtered_batch) );
+  dynBufferRelease( &(p->filtered_packet) );
 }
 
 void tcprosProcessClear( TcprosProcess *p)
 {
   dynBufferClear( &(p->packet) );
+  dynBufferInit( &(p->shared_packet) ); // The view does not own its data
   p->left_to_recv = 0;
 }
 
+DynBuffer *tcprosProcessGetWritePacket( TcprosProcess *p )
+{
+  return ( p->shared_packet.data != NULL )? &(p->shared_packet) : &(p->packet);
+}
+
 void tcprosProcessReset( TcprosProcess *p)
 {
   tcprosProcessClear( p );
@@ -58,6 +80,7 @@ void tcprosProcessReset( TcprosProcess *p)
   dynStringClear( &(p->servicerequest_type) );
   dynStringClear( &(p->serviceresponse_type) );
   dynStringClear( &(p->md5sum) );
+  dynStringClear( &(p->message_definition) );
   p->latching = 0;
   p->tcp_nodelay = 0;
   p->persistent = 0;
@@ -68,6 +91,12 @@ void tcprosProcessReset( TcprosProcess *p)
   free(p->sub_tcpros_host);
   p->sub_tcpros_host = NULL;
   p->sub_tcpros_port = -1;
+  cRosTokenBucketInit( &(p->shaper), 0, 0, 0 );
+  p->shaping_deferred = 0;
+  dynStringClear( &(p->filter_expr) );
+  cRosMessageFilterRelease( &(p->filter) );
+  dynBufferClear( &(p->filtered_batch) );
+  dynBufferClear( &(p->filtered_packet) );
 
   tcprosProcessChangeState( p, TCPROS_PROCESS_STATE_IDLE );
 }
@@ -75,5 +104,5 @@ void tcprosProcessReset( TcprosProcess *p)
 void tcprosProcessChangeState( TcprosProcess *p, TcprosProcessState state )
 {
   p->state = state;
-  p->last_change_time = cRosClockGetTimeMs();
+  p->last_change_time = cRosClockGetTime( p->clock );
 }
@@ -15,6 +15,7 @@ void xmlrpcProcessInit( XmlrpcProcess *p )
   xmlrpcParamVectorInit( &(p->params) );
   xmlrpcParamVectorInit( &(p->response) );
   p->last_change_time = 0;
+  p->clock = NULL;
   memset(p->host, 0, sizeof(p->host));
   p->port = -1;
 }
@@ -58,5 +59,5 @@ void xmlrpcProcessReset( XmlrpcProcess *p)
 void xmlrpcProcessChangeState( XmlrpcProcess *p, XmlrpcProcessState state )
 {
   p->state = state;
-  p->last_change_time = cRosClockGetTimeMs();
+  p->last_change_time = cRosClockGetTime( p->clock );
 }